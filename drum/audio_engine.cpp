@@ -55,31 +55,50 @@ AudioEngine::Voice::Voice() : sound(reader) {
 // Runs in the I2S DMA interrupt: must stay RAM-resident (see AGENTS.md).
 void __not_in_flash_func(AudioEngine::Voice::fill_buffer)(
     AudioBlock &out_samples) {
+  scheduler.fill_buffer(out_samples, clock->block_start_frame(), *this);
+}
+
+void __not_in_flash_func(AudioEngine::Voice::render)(
+    AudioBlock &out_samples) {
   sound.fill_buffer(out_samples);
 
   if (!decay_active) {
+    for (int16_t &sample : out_samples) {
+      sample = static_cast<int16_t>(static_cast<float>(sample) * gain);
+    }
     return;
   }
 
   uint32_t position = frames_rendered;
   for (int16_t &sample : out_samples) {
-    float gain = 0.0f;
+    float envelope = 0.0f;
     if (position < decay_end_frame) {
-      gain = static_cast<float>(decay_end_frame - position) * decay_scale;
+      envelope = static_cast<float>(decay_end_frame - position) * decay_scale;
     }
-    sample = static_cast<int16_t>(static_cast<float>(sample) * gain);
+    sample = static_cast<int16_t>(static_cast<float>(sample) * gain *
+                                  envelope);
     ++position;
   }
   frames_rendered = position;
 }
 
+void __not_in_flash_func(AudioEngine::Voice::start)(const Trigger &trigger) {
+  reader.set_source(trigger.data, trigger.length);
+  gain = trigger.gain;
+  decay_active = trigger.decay_active;
+  decay_end_frame = trigger.decay_end_frame;
+  decay_scale = trigger.decay_scale;
+  frames_rendered = 0;
+  sound.play(trigger.pitch);
+}
+
 AudioEngine::AudioEngine(const SampleRepository &repository,
                          SampleSlotManager &slot_manager, musin::Logger &logger)
     : sample_repository_(repository), slot_manager_(slot_manager),
       logger_(logger),
       voice_sources_{&voices_[0], &voices_[1], &voices_[2], &voices_[3]},
       mixer_(voice_sources_), crusher_(mixer_), lowpass_(crusher_),
-      highpass_(lowpass_) {
+      highpass_(lowpass_), render_clock_(highpass_) {
   // Initialize to a known, silent state.
   set_volume(1.0f); // Set master volume to full.
 
@@ -93,9 +112,10 @@ AudioEngine::AudioEngine(const SampleRepository &repository,
   set_crush_depth(1.0f); // Maximum bit depth (i.e., no crush).
   set_crush_rate(1.0f);  // Maximum sample rate (i.e., no crush).
 
-  // Initialize all voice gains to zero to ensure silence.
+  // Voices apply their own trigger gain, from the trigger's first sample.
   for (size_t i = 0; i < NUM_VOICES; ++i) {
-    mixer_.gain(i, 0.25f);
+    mixer_.gain(i, 1.0f);
+    voices_[i].clock = &render_clock_;
   }
 }
 
@@ -107,7 +127,7 @@ bool AudioEngine::init() {
   if (!AudioOutput::init()) {
     return false;
   }
-  AudioOutput::attach_source(highpass_);
+  AudioOutput::attach_source(render_clock_);
   is_initialized_ = true;
   return true;
 }
@@ -120,11 +140,20 @@ void AudioEngine::deinit() {
 }
 
 void AudioEngine::process() {
+  // Triggers are resolved here rather than in the block interrupt, since
+  // starting a voice may read sample data from flash.
+  if (note_events_ != nullptr) {
+    note_events_->drain(
+        [this](const drum::Events::NoteEvent &event) { notification(event); });
+  }
   AudioOutput::update();
 }
 
 void AudioEngine::play_on_voice(uint8_t voice_index, size_t sample_index,
-                                uint8_t velocity) {
+                                uint8_t velocity,
+                                const musin::timing::ParamLocks &locks,
+                                std::optional<uint32_t> sound_at_us) {
+  using musin::timing::ParamLocks;
   musin::hal::DebugUtils::ScopedProfile p(
       musin::hal::DebugUtils::g_section_profiler,
       static_cast<size_t>(ProfileSection::PLAY_ON_VOICE_UPDATE));
@@ -146,9 +175,13 @@ void AudioEngine::play_on_voice(uint8_t voice_index, size_t sample_index,
     if (path_opt.has_value() &&
         slot_manager_.request_load(voice_index, sample_index, *path_opt)) {
       // The voice may still be sounding from the buffer being overwritten;
-      // keep the interrupt-driven render out while it is replaced.
+      // keep the interrupt-driven render out while it is replaced, and
+      // silence it until this trigger starts. Queued triggers would read the
+      // new data, so they are dropped.
       const uint32_t saved_irq = save_and_disable_interrupts();
       slot_manager_.commit_staging();
+      voice.gain = 0.0f;
+      voice.scheduler.clear();
       restore_interrupts(saved_irq);
     }
     // On load failure the voice keeps its current sample.
@@ -158,43 +191,83 @@ void AudioEngine::play_on_voice(uint8_t voice_index, size_t sample_index,
     return;
   }
 
+  // Locked parameters override the track values for this trigger only.
+  const auto locked_pitch = locks.get_normalized(ParamLocks::PITCH);
+  const float pitch = locked_pitch.has_value()
+                          ? map_value_pitch_fast(locked_pitch.value())
+                          : voice.current_pitch;
+  const float track_gain =
+      locks.get_normalized(ParamLocks::GAIN).value_or(voice.current_gain);
+  const float decay =
+      locks.get_normalized(ParamLocks::DECAY).value_or(voice.current_decay);
+
   const float normalized_velocity = static_cast<float>(velocity) / 127.0f;
-  const float gain = normalized_velocity * voice.current_gain;
+  const float gain = normalized_velocity * track_gain;
 
   // Decay envelope: gain ramps linearly from full at the trigger to zero at
-  // current_decay of the sample's playback duration, silencing the rest.
+  // `decay` of the sample's playback duration, silencing the rest.
   // 1.0 disables the envelope. A floor keeps very low values click-free.
   constexpr uint32_t MIN_DECAY_FRAMES = 128;
-  const float speed = std::max(voice.current_pitch, 0.2f);
+  const float speed = std::max(pitch, 0.2f);
   const uint32_t total_frames = static_cast<uint32_t>(
       static_cast<float>(slot_manager_.voice_length(voice_index)) / speed);
-  const uint32_t decay_end_frame =
-      std::max(static_cast<uint32_t>(static_cast<float>(total_frames) *
-                                     voice.current_decay),
-               MIN_DECAY_FRAMES);
-  const bool decay_active = voice.current_decay < 1.0f;
+  const uint32_t decay_end_frame = std::max(
+      static_cast<uint32_t>(static_cast<float>(total_frames) * decay),
+      MIN_DECAY_FRAMES);
+  const bool decay_active = decay < 1.0f;
   const float decay_scale =
       decay_active ? 1.0f / static_cast<float>(decay_end_frame) : 0.0f;
 
-  // The render runs in the DMA interrupt; keep it from reading the voice
-  // mid-retrigger.
+  Trigger trigger{.data = slot_manager_.voice_data(voice_index),
+                  .length = slot_manager_.voice_length(voice_index),
+                  .pitch = pitch,
+                  .gain = gain,
+                  .decay_active = decay_active,
+                  .decay_end_frame = decay_end_frame,
+                  .decay_scale = decay_scale};
+
+  // The render runs in the DMA interrupt; mask it so the render clock and
+  // the voice's queue are seen consistently.
   const uint32_t saved_irq = save_and_disable_interrupts();
-  voice.reader.set_source(slot_manager_.voice_data(voice_index),
-                          slot_manager_.voice_length(voice_index));
-  mixer_.gain(voice_index, gain);
-  voice.decay_active = decay_active;
-  voice.decay_end_frame = decay_end_frame;
-  voice.decay_scale = decay_scale;
-  voice.frames_rendered = 0;
-  voice.sound.play(voice.current_pitch);
+  trigger.frame = render_clock_.next_frame();
+  if (sound_at_us.has_value()) {
+    const uint32_t target = render_clock_.frame_at(*sound_at_us);
+    if (static_cast<int32_t>(target - trigger.frame) >= 0) {
+      trigger.frame = target;
+    } else {
+      ++musin::hal::DebugUtils::g_late_audio_triggers;
+    }
+  }
+  const bool scheduled = voice.scheduler.schedule(trigger);
   restore_interrupts(saved_irq);
+  if (!scheduled) {
+    return;
+  }
+
+  const auto filter_offset = locks.get(ParamLocks::FILTER_OFFSET);
+  if (filter_offset.has_value()) {
+    filter_lock_offset_ =
+        static_cast<float>(static_cast<int>(filter_offset.value()) -
+                           ParamLocks::FILTER_OFFSET_CENTER) /
+        static_cast<float>(ParamLocks::FILTER_OFFSET_CENTER);
+    filter_lock_voice_ = voice_index;
+    apply_filter_frequency();
+  } else if (filter_lock_voice_ == voice_index) {
+    filter_lock_offset_ = 0.0f;
+    filter_lock_voice_.reset();
+    apply_filter_frequency();
+  }
 }
 
 void AudioEngine::stop_voice(uint8_t voice_index) {
   if (!is_initialized_ || voice_index >= NUM_VOICES) {
     return;
   }
-  mixer_.gain(voice_index, 0.0f);
+  Voice &voice = voices_[voice_index];
+  const uint32_t saved_irq = save_and_disable_interrupts();
+  voice.gain = 0.0f;
+  voice.scheduler.clear();
+  restore_interrupts(saved_irq);
   // TODO: Consider if voice.sound needs a reset/stop method for efficiency
 }
 
@@ -246,8 +319,13 @@ void AudioEngine::unmute() {
 }
 
 void AudioEngine::set_filter_frequency(float normalized_value) {
+  filter_frequency_ = std::clamp(normalized_value, 0.0f, 1.0f);
+  apply_filter_frequency();
+}
 
-  const float freq = map_value_filter_fast(normalized_value);
+void AudioEngine::apply_filter_frequency() {
+  const float freq =
+      map_value_filter_fast(filter_frequency_ + filter_lock_offset_);
   lowpass_.filter.frequency(freq);
 }
 void AudioEngine::set_filter_resonance(float normalized_value) {
@@ -271,7 +349,8 @@ void AudioEngine::set_crush_depth(float normalized_value) {
 void AudioEngine::notification(drum::Events::NoteEvent event) {
   // Direct mapping: MIDI note = sample slot
   size_t sample_id = event.note;
-  play_on_voice(event.track_index, sample_id, event.velocity);
+  play_on_voice(event.track_index, sample_id, event.velocity, event.locks,
+                event.sound_at_us);
 }
 
 } // namespace drum
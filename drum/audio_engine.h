@@ -2,18 +2,20 @@
 #define DRUM_AUDIO_ENGINE_H_
 
 #include "etl/array.h"
-#include "etl/observer.h" // Required for etl::observer
 #include "etl/optional.h"
 #include "events.h" // Required for drum::Events::NoteEvent
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 
 #include "musin/audio/buffer_source.h"
 #include "musin/audio/crusher.h"
 #include "musin/audio/filter.h"
 #include "musin/audio/memory_reader.h"
 #include "musin/audio/mixer.h"
+#include "musin/audio/render_clock.h"
 #include "musin/audio/sound.h"
+#include "musin/audio/voice_scheduler.h"
 #include "musin/hal/logger.h"
 
 namespace drum {
@@ -26,31 +28,59 @@ constexpr size_t NUM_VOICES = 4;
 /**
  * @brief Manages audio playback, mixing, and effects for the drum machine.
  */
-class AudioEngine : public etl::observer<drum::Events::NoteEvent> {
+class AudioEngine {
 private:
+  /**
+   * @brief Everything a voice needs to start a sound, resolved on the main
+   * loop so the interrupt only copies it in.
+   */
+  struct Trigger {
+    uint32_t frame = 0; // Render frame the sound starts on
+    const int16_t *data = nullptr;
+    uint32_t length = 0;
+    float pitch = 1.0f;
+    float gain = 0.0f; // Velocity times track gain
+    bool decay_active = false;
+    uint32_t decay_end_frame = 0;
+    float decay_scale = 0.0f;
+  };
+
   /**
    * @brief Internal structure representing a single audio voice.
    *
-   * Renders its Sound and applies an optional linear decay envelope that
-   * fades the voice to silence over the tail of the sample. fill_buffer runs
-   * in the I2S DMA interrupt and must stay RAM-resident.
+   * Renders its Sound and applies its gain and an optional linear decay
+   * envelope that fades the voice to silence over the tail of the sample.
+   * Triggers are queued on a VoiceScheduler, which starts each on its exact
+   * frame. fill_buffer runs in the I2S DMA interrupt and must stay
+   * RAM-resident.
    */
   struct Voice : BufferSource {
+    static constexpr size_t MAX_PENDING_TRIGGERS = 4;
+
     musin::MemorySampleReader reader;
     Sound sound;
     float current_pitch = 1.0f;
     float current_gain = 1.0f;
     float current_decay = 1.0f; // Fraction of duration where gain reaches 0.
 
-    // Decay envelope state, set at trigger time and consumed in the ISR.
+    // State of the sounding trigger, consumed in the ISR.
+    float gain = 0.0f;
     bool decay_active = false;
     uint32_t decay_end_frame = 0;
     float decay_scale = 0.0f; // 1 / decay_end_frame
     uint32_t frames_rendered = 0;
 
+    // Queued by the main loop with interrupts masked.
+    musin::audio::VoiceScheduler<Trigger, MAX_PENDING_TRIGGERS> scheduler;
+
+    const musin::audio::RenderClock *clock = nullptr;
+
     Voice();
 
     void fill_buffer(AudioBlock &out_samples) override;
+
+    void start(const Trigger &trigger);
+    void render(AudioBlock &out_samples);
   };
 
 public:
@@ -77,20 +107,36 @@ public:
   void deinit();
 
   /**
-   * @brief Periodically updates the audio output buffer.
+   * @brief Plays the NoteEvents queued since the last call, then updates the
+   * audio output buffer.
    * This should be called frequently from the main application loop.
    */
   void process();
 
+  /**
+   * @brief Sets the ring process() plays NoteEvents from.
+   * @param note_events A consumer of MessageRouter's note events, or nullptr.
+   */
+  void set_note_events(NoteEventBus::Consumer *note_events) {
+    note_events_ = note_events;
+  }
+
   /**
    * @brief Starts playback of a sample on a specific voice/track.
    * If the voice is already playing, it should be re-triggered.
    * @param voice_index The voice/track index (0 to NUM_VOICES - 1).
    * @param sample_index The index of the sample within the global sample bank.
    * @param velocity Playback velocity (0-127), affecting volume.
+   * @param locks Parameter locks overriding the voice's pitch, decay and gain
+   * for this trigger, and offsetting the shared filter cutoff.
+   * @param sound_at_us Time (time_us_32) the trigger should sound, placed on
+   * its exact sample if it has not been rendered yet. Without it the trigger
+   * starts with the next rendered block.
    */
   void play_on_voice(uint8_t voice_index, size_t sample_index,
-                     uint8_t velocity);
+                     uint8_t velocity,
+                     const musin::timing::ParamLocks &locks = {},
+                     std::optional<uint32_t> sound_at_us = std::nullopt);
 
   /**
    * @brief Stops playback on a specific voice/track immediately by setting
@@ -170,7 +216,7 @@ public:
    * @brief Handles incoming NoteEvents to play or stop sounds.
    * @param event The NoteEvent received.
    */
-  void notification(drum::Events::NoteEvent event) override;
+  void notification(drum::Events::NoteEvent event);
 
 private:
   const SampleRepository &sample_repository_;
@@ -183,6 +229,8 @@ private:
   musin::audio::Crusher crusher_;
   musin::audio::Lowpass lowpass_;
   musin::audio::Highpass highpass_;
+  musin::audio::RenderClock render_clock_;
+  NoteEventBus::Consumer *note_events_ = nullptr;
 
   // profiler_ member is removed, ProfileSection enum remains for use with the
   // global profiler
@@ -191,9 +239,18 @@ private:
     PLAY_ON_VOICE_UPDATE
   };
 
+  void apply_filter_frequency();
+
   bool is_initialized_ = false;
   bool muted_ = false;
   float current_volume_ = 1.0f;
+
+  // Filter cutoff as set by the control, and the offset of the most recent
+  // filter-locked trigger; the lock is released when its voice next triggers
+  // without one.
+  float filter_frequency_ = 1.0f;
+  float filter_lock_offset_ = 0.0f;
+  std::optional<uint8_t> filter_lock_voice_;
 };
 
 } // namespace drum
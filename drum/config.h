@@ -17,7 +17,10 @@ namespace config {
 
 // General PizzaControls & Sequencer Configuration
 constexpr size_t NUM_TRACKS = 4;
-constexpr size_t NUM_STEPS_PER_TRACK = 8;
+constexpr size_t NUM_STEPS_PER_TRACK = 8; // Default track length; one page
+constexpr size_t MAX_STEPS_PER_TRACK = 64;
+constexpr size_t NUM_PATTERNS = 16;
+constexpr size_t MAX_PATTERN_CHAIN_LENGTH = 16;
 constexpr size_t NUM_DRUMPADS = 4;
 constexpr size_t NUM_ANALOG_MUX_CONTROLS = 11;
 constexpr uint32_t PROFILER_REPORT_INTERVAL_MS = 2000;
@@ -31,6 +34,15 @@ constexpr bool SEND_MIDI_CLOCK_WHEN_STOPPED_AS_MASTER = true;
 constexpr bool SEND_SYNC_CLOCK_WHEN_STOPPED_AS_MASTER = true;
 constexpr bool RETRIGGER_SYNC_ON_PLAYBUTTON = true;
 constexpr bool IGNORE_MIDI_NOTE_OFF = true;
+// Incoming MIDI notes sound this long after they arrive, placed on the exact
+// sample. Covers the main-loop delay before a note is handled plus one audio
+// block; notes handled later than that sound late.
+constexpr uint32_t MIDI_INPUT_LATENCY_US = 6000;
+// Micro-timed sequencer notes are handed to the audio engine this long
+// before they are due, so they start on their exact sample rather than on
+// the first block after the main loop notices them: one 2.9 ms audio block
+// plus a typical loop pass. Their MIDI Note On goes out when handed over.
+constexpr uint32_t SEQUENCER_NOTE_LEAD_US = 4000;
 constexpr uint32_t COLOR_MIDI_CLOCK_LISTENER = 0x88FF55;
 
 // SysEx Manufacturer and Device IDs
@@ -44,6 +56,19 @@ constexpr size_t MAX_FILENAME_LENGTH = 32;
 constexpr uint32_t TIMEOUT_US = 5000000; // 5 seconds
 // 146 * 7 bytes of raw data -> 146 * 8 = 1168 bytes of encoded data
 constexpr size_t DECODED_CHUNK_SIZE = 1022;
+// Windowed file transfers: the most chunks a host may have unacknowledged,
+// and how many chunks that arrive ahead of a gap are held until it is filled.
+constexpr uint8_t MAX_TRANSFER_WINDOW = 16;
+constexpr size_t TRANSFER_REORDER_SLOTS = 4;
+// Received file data is staged in RAM and written to flash from the main
+// loop, spending at most WRITE_BUDGET_US per pass once a block is written.
+constexpr size_t WRITE_STAGING_BYTES = 8192;
+constexpr uint32_t WRITE_BUDGET_US = 1000;
+// Files in one kit transfer: the 32 samples of a kit plus /kit.bin.
+constexpr size_t MAX_KIT_FILES = 33;
+// StatFile hashes a stored file this many 256-byte blocks per main loop
+// pass.
+constexpr size_t HASH_BLOCKS_PER_SERVICE = 16;
 } // namespace sysex
 
 // Keypad Component Configuration
@@ -203,6 +228,27 @@ static_assert(SWING_OFFSET_PHASES > 0 && SWING_OFFSET_PHASES < 6,
               "SWING_OFFSET_PHASES must be between 1 and 5 at 12 PPQN");
 } // namespace timing
 
+// Live recording
+namespace record {
+// 0 keeps the played micro-timing, 100 snaps hits onto the step grid.
+constexpr uint8_t DEFAULT_QUANTIZE_STRENGTH = 0;
+// MIDI CCs controlling recording: >= 64 arms record mode; 0-127 maps to
+// quantize strength 0-100%.
+constexpr uint8_t RECORD_ENABLE_CC = 18;
+constexpr uint8_t QUANTIZE_STRENGTH_CC = 19;
+} // namespace record
+
+namespace pattern {
+// MIDI CCs driving the pattern bank: the value selects a pattern (queued to
+// the next bar while playing), or names the pattern the active one is copied
+// to; >= 64 turns song mode on; one CC per track sets its length in steps.
+// The chain itself is set with the SetPatternChain SysEx command.
+constexpr uint8_t SELECT_CC = 102;
+constexpr uint8_t COPY_TO_CC = 103;
+constexpr uint8_t SONG_MODE_CC = 104;
+constexpr uint8_t FIRST_TRACK_LENGTH_CC = 105; // Tracks 1-4: CC 105-108
+} // namespace pattern
+
 // PizzaControls specific
 namespace main_controls {
 constexpr uint8_t RETRIGGER_DIVISOR_FOR_DOUBLE_MODE = 2;
@@ -215,6 +261,15 @@ constexpr size_t MAX_SYSEX_EVENT_OBSERVERS = 4;
 namespace message_router {
 constexpr uint32_t DEBOUNCE_TIME_MS =
     40; // Minimum time between triggers for the same note
+// A pending NRPN value (four CCs) is only queued for output while the MIDI
+// control lane holds at most this many messages, so continuous filter sweeps
+// send as fast as DIN drains instead of piling up behind it.
+constexpr uint16_t NRPN_MAX_CONTROL_LANE_DEPTH = 4;
+// Local consumers of note and parameter events (AudioEngine, PizzaDisplay),
+// each with its own ring of this many events
+constexpr size_t MAX_EVENT_CONSUMERS = 2;
+constexpr size_t NOTE_EVENT_RING_SIZE = 32;
+constexpr size_t PARAMETER_EVENT_RING_SIZE = 16;
 } // namespace message_router
 
 } // namespace config
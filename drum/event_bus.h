@@ -0,0 +1,104 @@
+#ifndef DRUM_EVENT_BUS_H
+#define DRUM_EVENT_BUS_H
+
+#include "etl/array.h"
+#include "etl/queue_spsc_atomic.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace drum {
+
+/**
+ * @brief Preallocated fan-out of one event type, with a ring per consumer.
+ *
+ * publish() copies the event into every subscriber's ring and returns; each
+ * consumer drains its own ring at its own rate (the audio engine once per
+ * process(), the display once per frame). A burst therefore costs the
+ * producer a few copies and never makes one consumer wait on another. A full
+ * ring drops the event for that consumer only, and counts it.
+ *
+ * Each ring is single-producer/single-consumer: publish from one context,
+ * and drain each consumer from one context. Subscribe during setup, before
+ * the first publish.
+ *
+ * @tparam Event Copyable, default-constructible event type.
+ * @tparam MaxConsumers Number of consumers that can subscribe.
+ * @tparam Capacity Ring size per consumer, in events (at most 255).
+ */
+template <typename Event, size_t MaxConsumers, size_t Capacity>
+class EventBus {
+public:
+  class Consumer {
+  public:
+    bool pop(Event &event) {
+      return ring_.pop(event);
+    }
+
+    /**
+     * @brief Hands every queued event to @p handler, oldest first.
+     *
+     * Stops at what was queued on entry, so a producer on another context
+     * cannot keep the consumer here.
+     *
+     * @return The number of events handled.
+     */
+    template <typename Handler> size_t drain(Handler &&handler) {
+      size_t handled = 0;
+      Event event;
+      for (size_t queued = ring_.size(); queued > 0 && ring_.pop(event);
+           --queued) {
+        handler(event);
+        ++handled;
+      }
+      return handled;
+    }
+
+    size_t size() const {
+      return ring_.size();
+    }
+
+    /** @brief Events published while this consumer's ring was full. */
+    uint32_t dropped() const {
+      return dropped_;
+    }
+
+  private:
+    friend class EventBus;
+
+    etl::queue_spsc_atomic<Event, Capacity,
+                           etl::memory_model::MEMORY_MODEL_SMALL>
+        ring_;
+    uint32_t dropped_ = 0; // Written by the producer only
+  };
+
+  /**
+   * @brief Adds a consumer.
+   * @return Its ring, or nullptr if MaxConsumers have already subscribed.
+   */
+  Consumer *subscribe() {
+    if (consumer_count_ == MaxConsumers) {
+      return nullptr;
+    }
+    return &consumers_[consumer_count_++];
+  }
+
+  void publish(const Event &event) {
+    for (size_t i = 0; i < consumer_count_; ++i) {
+      if (!consumers_[i].ring_.push(event)) {
+        ++consumers_[i].dropped_;
+      }
+    }
+  }
+
+  size_t consumer_count() const {
+    return consumer_count_;
+  }
+
+private:
+  etl::array<Consumer, MaxConsumers> consumers_{};
+  size_t consumer_count_ = 0;
+};
+
+} // namespace drum
+
+#endif // DRUM_EVENT_BUS_H
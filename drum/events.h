@@ -1,6 +1,9 @@
 #ifndef DRUM_EVENTS_H_
 #define DRUM_EVENTS_H_
 
+#include "drum/config.h"
+#include "drum/event_bus.h"
+#include "musin/timing/param_locks.h"
 #include <cstdint>
 #include <optional> // Required for std::optional
 
@@ -35,6 +38,11 @@ struct NoteEvent {
   uint8_t track_index; // Logical track index (0-3)
   uint8_t note;        // MIDI note number
   uint8_t velocity;    // MIDI velocity (0-127, 0 means note off)
+  // Per-step overrides applied with this trigger only
+  musin::timing::ParamLocks locks{};
+  // Time (time_us_32) the note should sound; the audio engine starts it on
+  // that exact sample. Empty to start with the next rendered block.
+  std::optional<uint32_t> sound_at_us{};
 };
 
 /**
@@ -64,4 +72,19 @@ struct SysExTransferStateChangeEvent {
 
 } // namespace drum::Events
 
+namespace drum {
+
+/** @brief Note events MessageRouter plays locally, one ring per consumer. */
+using NoteEventBus =
+    EventBus<Events::NoteEvent, config::message_router::MAX_EVENT_CONSUMERS,
+             config::message_router::NOTE_EVENT_RING_SIZE>;
+
+/** @brief Parameter changes MessageRouter applies, one ring per consumer. */
+using ParameterChangeEventBus =
+    EventBus<Events::ParameterChangeEvent,
+             config::message_router::MAX_EVENT_CONSUMERS,
+             config::message_router::PARAMETER_EVENT_RING_SIZE>;
+
+} // namespace drum
+
 #endif // DRUM_EVENTS_H_
@@ -30,8 +30,6 @@ extern "C" {
 #include "hardware/watchdog.h"
 #include "pico/rand.h"
 
-#include <cstdlib>
-
 #include "audio_engine.h"
 #include "drum/drum_pizza_hardware.h"
 #include "drum/ui/pizza_display.h"
@@ -106,9 +104,9 @@ static drum::PizzaControls pizza_controls(pizza_display, tempo_handler,
 int main() {
   stdio_usb_init();
 
-  // Seed rand() from the hardware RNG; seeding from the boot clock in static
-  // constructors produced the same sequence every power-up.
-  srand(get_rand_32());
+  // Seed the random effects from the hardware RNG; seeding from the boot
+  // clock in static constructors produced the same sequence every power-up.
+  sequencer_controller.set_random_seed(get_rand_32());
 
 #ifdef VERBOSE
   musin::usb::init(true); // Wait for serial connection in debug builds
@@ -124,6 +122,7 @@ int main() {
   } else {
     filesystem.list_files("/"); // List files in the root directory
 
+    sysex_handler.recover_kit_transfer();
     config_manager.load();
     settings_manager.init();
 
@@ -162,6 +161,9 @@ int main() {
       pizza_controls); // PizzaControls needs tempo events for sample cycling
   // SyncOut observes ClockRouter for raw 24 PPQN ticks
 
+  // MIDI Start/Continue/Stop drive the sequencer transport
+  midi_clock_processor.set_transport_listener(&sequencer_controller);
+
   // SequencerController notifies MessageRouter, which queues the events
   // internally.
   sequencer_controller.add_observer(message_router);
@@ -179,10 +181,10 @@ int main() {
   sysex_handler.add_observer(system_state_machine);
   sysex_handler.add_observer(pizza_display);
 
-  // Register observers for events from MessageRouter
-  message_router.add_note_event_observer(pizza_display);
-  message_router.add_parameter_change_event_observer(pizza_display);
-  message_router.add_note_event_observer(audio_engine);
+  // Subscribe to events from MessageRouter; each consumer drains its own ring
+  pizza_display.set_event_sources(message_router.subscribe_note_events(),
+                                  message_router.subscribe_parameter_changes());
+  audio_engine.set_note_events(message_router.subscribe_note_events());
 
   sync_out.enable();
 
@@ -261,28 +263,34 @@ int main() {
       sequencer_controller
           .update(); // Checks if a step is due and queues NoteEvents
       message_router
-          .update(); // Drains NoteEvent queue, sending to observers and MIDI
+          .update(); // Drains NoteEvent queue, publishing locally and to MIDI
       audio_engine.process();
       pizza_display.update(now);
       midi_manager.process_input();
-      musin::midi::process_midi_output_queue(null_logger);
       internal_clock.update(now);
       clock_router.update_auto_source_switching();
-
-      // Second drain: process_midi_output_queue sends at most one message
-      // per call, so draining twice per loop halves MIDI output latency
-      // (see #527).
+      // Drained last so clock ticks produced above go out this iteration
       musin::midi::process_midi_output_queue(null_logger);
+      musin::usb::midi_flush();
       sleep_us(10);
       break;
     }
     case drum::SystemStateId::FileTransfer: {
-      // File transfer mode - only service bare essentials for performance
+      // Received data is written to flash a budgeted slice per pass, so
+      // playback, the sequencer and MIDI keep running during a transfer
       musin::usb::background_update();
       sysex_handler.update(now);
+      pizza_controls.update(now);
+      sync_in.update(now);
+      sequencer_controller.update();
+      message_router.update();
+      audio_engine.process();
       pizza_display.update(now); // Keep display alive for progress updates
       midi_manager.process_input();
+      internal_clock.update(now);
+      clock_router.update_auto_source_switching();
       musin::midi::process_midi_output_queue(logger); // For sending ACKs
+      musin::usb::midi_flush();
       break;
     }
     case drum::SystemStateId::FallingAsleep: {
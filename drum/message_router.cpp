@@ -1,6 +1,7 @@
 #include "message_router.h"
 #include "config.h" // For drum::config::track_ranges and NUM_TRACKS
-#include "musin/midi/midi_wrapper.h" // For MIDI:: calls
+#include "musin/midi/midi_output_queue.h" // For control lane depth
+#include "musin/midi/midi_wrapper.h"      // For MIDI:: calls
 #include "musin/ports/pico/libraries/arduino_midi_library/src/midi_Defs.h"
 #include "sample_repository.h"    // For SampleRepository::MAX_SAMPLES
 #include "sequencer_controller.h" // For SequencerController
@@ -111,6 +112,7 @@ MessageRouter::MessageRouter(
   note_event_queue_.clear();
   // Initialize debounce tracking array to 0 (no previous triggers)
   note_last_trigger_time_.fill(0);
+  sent_cc_values_.fill(UNSENT);
   // TODO: Initialize _track_sample_map if added
 }
 
@@ -150,20 +152,14 @@ void MessageRouter::set_parameter(Parameter param_id, float value,
 
   value = std::clamp(value, 0.0f, 1.0f);
 
-  // Notify observers about the parameter change.
-  drum::Events::ParameterChangeEvent event{param_id, value, track_index};
-  etl::observable<etl::observer<drum::Events::ParameterChangeEvent>,
-                  2>::notify_observers(event);
+  // Queue the change for subscribers to apply on their next update.
+  parameter_change_bus_.publish(
+      drum::Events::ParameterChangeEvent{param_id, value, track_index});
 
   if (_output_mode == OutputMode::MIDI || _output_mode == OutputMode::BOTH) {
     uint8_t cc_number = map_parameter_to_midi_cc(param_id, track_index);
     if (cc_number > 0) {
-      uint8_t midi_channel = settings_.get(settings::Id::MidiChannel);
-      uint8_t midi_value = static_cast<uint8_t>(std::round(value * 127.0f));
-      midi_value = std::min(midi_value, static_cast<uint8_t>(127));
-
-      _midi_sender.sendControlChange(midi_channel, cc_number, midi_value);
-      // TODO: Future enhancement - Add logic here to send 14-bit CC if desired
+      send_parameter_cc(cc_number, value);
     }
   }
 
@@ -213,7 +209,137 @@ void MessageRouter::set_parameter(Parameter param_id, float value,
   }
 }
 
+void MessageRouter::send_parameter_cc(uint8_t cc_number, float value) {
+  const uint8_t midi_channel = settings_.get(settings::Id::MidiChannel);
+  if (midi_channel != sent_channel_) {
+    sent_cc_values_.fill(UNSENT);
+    selected_nrpn_ = UNSENT;
+    pending_nrpns_.clear();
+    sent_channel_ = midi_channel;
+  }
+
+  if (settings_.get(settings::Id::HighResolutionCc) == 0) {
+    const uint8_t midi_value = std::min(
+        static_cast<uint8_t>(std::round(value * 127.0f)), uint8_t{127});
+    const uint16_t scaled = static_cast<uint16_t>(midi_value << 7);
+    if (sent_cc_values_[cc_number] != scaled) {
+      sent_cc_values_[cc_number] = scaled;
+      _midi_sender.sendControlChange(midi_channel, cc_number, midi_value);
+    }
+    return;
+  }
+
+  const uint16_t fine_value =
+      static_cast<uint16_t>(std::round(value * 16383.0f));
+  if (cc_number < 32) {
+    // 14-bit pair. An MSB resets the receiver's LSB, so the LSB always
+    // follows it; when only the fine part moved, the LSB alone is enough.
+    const uint16_t previous = sent_cc_values_[cc_number];
+    if (previous == fine_value) {
+      return;
+    }
+    sent_cc_values_[cc_number] = fine_value;
+    if (previous == UNSENT || (previous >> 7) != (fine_value >> 7)) {
+      _midi_sender.sendControlChange(midi_channel, cc_number,
+                                     static_cast<uint8_t>(fine_value >> 7));
+    }
+    _midi_sender.sendControlChange(midi_channel, cc_number + 32,
+                                   static_cast<uint8_t>(fine_value & 0x7F));
+    return;
+  }
+
+  // Controllers without an LSB partner go out as NRPN 0/<cc>. Those four
+  // CCs are never coalesced by the output queue, so only the latest value
+  // is kept here until the queue has room (see update()).
+  for (auto &pending : pending_nrpns_) {
+    if (pending.number == cc_number) {
+      pending.value = fine_value;
+      return;
+    }
+  }
+  if (sent_cc_values_[cc_number] != fine_value && !pending_nrpns_.full()) {
+    pending_nrpns_.push_back({cc_number, fine_value});
+  }
+}
+
+void MessageRouter::send_pending_nrpns() {
+  const uint8_t midi_channel = settings_.get(settings::Id::MidiChannel);
+  while (!pending_nrpns_.empty()) {
+    const uint16_t lane_depth =
+        musin::midi::get_midi_output_lane_stats(
+            musin::midi::MidiOutputLane::CONTROL)
+            .depth;
+    if (lane_depth > config::message_router::NRPN_MAX_CONTROL_LANE_DEPTH) {
+      break;
+    }
+
+    const PendingNrpn pending = pending_nrpns_.front();
+    pending_nrpns_.erase(pending_nrpns_.begin());
+
+    const uint16_t previous = sent_cc_values_[pending.number];
+    if (previous == pending.value) {
+      continue;
+    }
+    sent_cc_values_[pending.number] = pending.value;
+
+    bool force_msb = previous == UNSENT;
+    if (selected_nrpn_ != pending.number) {
+      _midi_sender.sendControlChange(midi_channel, 99, 0);
+      _midi_sender.sendControlChange(midi_channel, 98, pending.number);
+      selected_nrpn_ = pending.number;
+      force_msb = true;
+    }
+    if (force_msb || (previous >> 7) != (pending.value >> 7)) {
+      _midi_sender.sendControlChange(midi_channel, 6,
+                                     static_cast<uint8_t>(pending.value >> 7));
+    }
+    _midi_sender.sendControlChange(midi_channel, 38,
+                                   static_cast<uint8_t>(pending.value & 0x7F));
+  }
+}
+
+void MessageRouter::set_step_parameter_lock(Parameter param_id, float value,
+                                            uint8_t track_index,
+                                            uint8_t step_index) {
+  using musin::timing::ParamLocks;
+
+  if (track_index >= config::NUM_TRACKS) {
+    return;
+  }
+
+  value = std::clamp(value, 0.0f, 1.0f);
+  const uint8_t lock_value =
+      static_cast<uint8_t>(std::round(value * ParamLocks::MAX_VALUE));
+
+  switch (param_id) {
+  case Parameter::PITCH: {
+    const uint8_t slider_mode = settings_.get(settings::Id::SliderMode);
+    if (slider_mode & settings::slider_mode::PITCH) {
+      _sequencer_controller.set_step_lock(track_index, step_index,
+                                          ParamLocks::PITCH, lock_value);
+    }
+    if (slider_mode & settings::slider_mode::GAIN) {
+      _sequencer_controller.set_step_lock(track_index, step_index,
+                                          ParamLocks::GAIN, lock_value);
+    }
+    if (slider_mode & settings::slider_mode::DECAY) {
+      _sequencer_controller.set_step_lock(track_index, step_index,
+                                          ParamLocks::DECAY, lock_value);
+    }
+    break;
+  }
+  case Parameter::FILTER_FREQUENCY:
+    _sequencer_controller.set_step_lock(track_index, step_index,
+                                        ParamLocks::FILTER_OFFSET, lock_value);
+    break;
+  default:
+    break;
+  }
+}
+
 void MessageRouter::update() {
+  send_pending_nrpns();
+
   while (!note_event_queue_.empty()) {
     drum::Events::NoteEvent event = note_event_queue_.front();
     note_event_queue_.pop();
@@ -228,11 +354,8 @@ void MessageRouter::update() {
     if ((_output_mode == OutputMode::AUDIO ||
          _output_mode == OutputMode::BOTH) &&
         _local_control_mode == LocalControlMode::ON) {
-      // Notify observers like AudioEngine and PizzaDisplay to handle the event
-      // locally
-      etl::observable<
-          etl::observer<drum::Events::NoteEvent>,
-          drum::config::MAX_NOTE_EVENT_OBSERVERS>::notify_observers(event);
+      // Queue the event for AudioEngine and PizzaDisplay to handle locally
+      note_event_bus_.publish(event);
     }
   }
 }
@@ -284,7 +407,8 @@ void MessageRouter::notification(
   }
 }
 
-void MessageRouter::handle_incoming_note_on(uint8_t note, uint8_t velocity) {
+void MessageRouter::handle_incoming_note_on(uint8_t note, uint8_t velocity,
+                                            uint32_t timestamp_us) {
   // Find first track that contains this note (first match wins)
   for (uint8_t track_idx = 0; track_idx < drum::config::NUM_TRACKS;
        ++track_idx) {
@@ -298,13 +422,17 @@ void MessageRouter::handle_incoming_note_on(uint8_t note, uint8_t velocity) {
       }
 
       // Queue the event to be processed in the main loop
-      drum::Events::NoteEvent event{
-          .track_index = track_idx, .note = note, .velocity = velocity};
+      drum::Events::NoteEvent event{.track_index = track_idx,
+                                    .note = note,
+                                    .velocity = velocity,
+                                    .sound_at_us =
+                                        timestamp_us +
+                                        drum::config::MIDI_INPUT_LATENCY_US};
       notification(event);
 
       // Set the active note for that track in the sequencer controller
       _sequencer_controller.set_active_note_for_track(track_idx, note);
-      _sequencer_controller.get_sequencer().get_track(track_idx).set_note(note);
+      _sequencer_controller.record_hit(track_idx, velocity);
 
       return; // First match wins - stop searching
     }
@@ -319,12 +447,51 @@ void MessageRouter::handle_incoming_note_off(uint8_t note,
   (void)velocity;
 }
 
-void MessageRouter::handle_incoming_midi_cc(uint8_t controller, uint8_t value) {
-  auto mapping = map_midi_cc_to_parameter(controller);
+void MessageRouter::handle_incoming_controller(
+    const musin::midi::ControllerValue &controller) {
+  if (controller.number > 127) {
+    return; // NRPNs beyond 0/127 have no mapping
+  }
+  const uint8_t number = static_cast<uint8_t>(controller.number);
+
+  // Record mode has no panel gesture; it is driven by CC only.
+  if (number == drum::config::record::RECORD_ENABLE_CC) {
+    _sequencer_controller.set_record_enabled(controller.coarse() >= 64);
+    return;
+  }
+  if (number == drum::config::record::QUANTIZE_STRENGTH_CC) {
+    _sequencer_controller.set_quantize_strength(
+        static_cast<uint8_t>((controller.coarse() * 100u) / 127u));
+    return;
+  }
+  if (handle_pattern_cc(number, controller.coarse())) {
+    return;
+  }
+
+  auto mapping = map_midi_cc_to_parameter(number);
   if (mapping.has_value()) {
-    float normalized_value = static_cast<float>(value) / 127.0f;
-    set_parameter(mapping->param_id, normalized_value, mapping->track_index);
+    set_parameter(mapping->param_id, controller.normalized(),
+                  mapping->track_index);
+  }
+}
+
+bool MessageRouter::handle_pattern_cc(uint8_t number, uint8_t value) {
+  using namespace drum::config::pattern;
+  if (number == SELECT_CC) {
+    _sequencer_controller.select_pattern(value);
+  } else if (number == COPY_TO_CC) {
+    _sequencer_controller.copy_pattern(
+        _sequencer_controller.get_active_pattern(), value);
+  } else if (number == SONG_MODE_CC) {
+    _sequencer_controller.set_song_mode(value >= 64);
+  } else if (number >= FIRST_TRACK_LENGTH_CC &&
+             number < FIRST_TRACK_LENGTH_CC + config::NUM_TRACKS) {
+    _sequencer_controller.set_track_length(
+        static_cast<uint8_t>(number - FIRST_TRACK_LENGTH_CC), value);
+  } else {
+    return false;
   }
+  return true;
 }
 
 } // namespace drum
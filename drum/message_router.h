@@ -7,7 +7,10 @@
 #include "etl/observer.h"
 #include "etl/queue.h"
 #include "events.h" // Include NoteEvent definition
+#include "etl/array.h"
+#include "etl/vector.h"
 #include "musin/hal/logger.h"
+#include "musin/midi/controller_decoder.h"
 #include "musin/midi/midi_sender.h"
 #include <array>
 #include <cstdint>
@@ -44,11 +47,7 @@ enum class LocalControlMode : uint8_t {
  */
 class MessageRouter
     : public etl::observer<drum::Events::NoteEvent>,
-      public etl::observer<drum::Events::SysExTransferStateChangeEvent>,
-      public etl::observable<etl::observer<drum::Events::NoteEvent>,
-                             drum::config::MAX_NOTE_EVENT_OBSERVERS>,
-      public etl::observable<etl::observer<drum::Events::ParameterChangeEvent>,
-                             2> {
+      public etl::observer<drum::Events::SysExTransferStateChangeEvent> {
 public:
   /**
    * @brief Constructor.
@@ -113,7 +112,22 @@ public:
                      std::optional<uint8_t> track_index = std::nullopt);
 
   /**
-   * @brief Processes events from the note event queue.
+   * @brief Locks a parameter on one step of the active pattern instead of
+   * changing the live value.
+   * PITCH locks whatever the slider mode maps the track slider to (pitch,
+   * gain and/or decay). FILTER_FREQUENCY locks a cutoff offset, where 0.5f
+   * means no change. Other parameters are ignored.
+   * @param param_id The logical identifier of the parameter.
+   * @param value The locked value, normalized between 0.0f and 1.0f.
+   * @param track_index The track (0-3) owning the step.
+   * @param step_index The step within the track.
+   */
+  void set_step_parameter_lock(Parameter param_id, float value,
+                               uint8_t track_index, uint8_t step_index);
+
+  /**
+   * @brief Processes events from the note event queue and sends pending
+   * NRPN values once the MIDI output has room.
    * This should be called from the main loop.
    */
   void update();
@@ -139,8 +153,11 @@ public:
    * should handle velocity 0 as silence or note off).
    * @param note The MIDI note number.
    * @param velocity The MIDI velocity.
+   * @param timestamp_us Arrival time (time_us_32) of the message, which the
+   * audio engine plays a fixed latency later.
    */
-  void handle_incoming_note_on(uint8_t note, uint8_t velocity);
+  void handle_incoming_note_on(uint8_t note, uint8_t velocity,
+                               uint32_t timestamp_us);
 
   /**
    * @brief Handles an incoming MIDI Note Off message.
@@ -151,35 +168,57 @@ public:
   void handle_incoming_note_off(uint8_t note, uint8_t velocity) const;
 
   /**
-   * @brief Handles an incoming MIDI Control Change message.
+   * @brief Handles an incoming controller value: a 7-bit or 14-bit CC, or an
+   * NRPN.
    * This method will map the CC number to a `drum::Parameter` and apply the
-   * change.
-   * @param controller The MIDI CC number.
-   * @param value The MIDI CC value.
+   * change. NRPN parameters 0-127 map like the CC of the same number.
+   * @param controller The value assembled by musin::midi::ControllerDecoder.
    */
-  void handle_incoming_midi_cc(uint8_t controller, uint8_t value);
+  void
+  handle_incoming_controller(const musin::midi::ControllerValue &controller);
 
   /**
-   * @brief Adds an observer for NoteEvents, resolving ambiguity.
+   * @brief Subscribes to the NoteEvents played locally.
+   * @return A ring to drain, or nullptr if all consumers are taken.
    */
-  void
-  add_note_event_observer(etl::observer<drum::Events::NoteEvent> &observer) {
-    etl::observable<
-        etl::observer<drum::Events::NoteEvent>,
-        drum::config::MAX_NOTE_EVENT_OBSERVERS>::add_observer(observer);
+  NoteEventBus::Consumer *subscribe_note_events() {
+    return note_event_bus_.subscribe();
   }
 
   /**
-   * @brief Adds an observer for ParameterChangeEvents, resolving ambiguity.
+   * @brief Subscribes to parameter changes.
+   * @return A ring to drain, or nullptr if all consumers are taken.
    */
-  void add_parameter_change_event_observer(
-      etl::observer<drum::Events::ParameterChangeEvent> &observer) {
-    etl::observable<etl::observer<drum::Events::ParameterChangeEvent>,
-                    2>::add_observer(observer);
+  ParameterChangeEventBus::Consumer *subscribe_parameter_changes() {
+    return parameter_change_bus_.subscribe();
   }
 
 private:
+  /**
+   * @brief Sends a parameter value on its CC number, at 7 or 14 bits
+   * depending on the HighResolutionCc setting. Unchanged values are skipped.
+   */
+  void send_parameter_cc(uint8_t cc_number, float value);
+
+  /**
+   * @brief Applies a pattern bank CC (see config::pattern).
+   * @return false if @p number is not one of them.
+   */
+  bool handle_pattern_cc(uint8_t number, uint8_t value);
+
+  /** @brief Sends pending NRPN values while the control lane has room. */
+  void send_pending_nrpns();
+
+  struct PendingNrpn {
+    uint8_t number;
+    uint16_t value;
+  };
+
+  static constexpr uint16_t UNSENT = 0xFFFF;
+
   etl::queue<drum::Events::NoteEvent, 32> note_event_queue_;
+  NoteEventBus note_event_bus_;
+  ParameterChangeEventBus parameter_change_bus_;
   AudioEngine &_audio_engine;
   SequencerController<config::NUM_TRACKS, config::NUM_STEPS_PER_TRACK>
       &_sequencer_controller;
@@ -193,6 +232,13 @@ private:
   // Debouncing: track last trigger time for each note (indexed by note number
   // 0-127)
   std::array<uint32_t, 128> note_last_trigger_time_;
+
+  // Last value sent per CC (or NRPN) number, at 14-bit scale, and the NRPN
+  // the receiver has selected; reset when the MIDI channel changes.
+  etl::array<uint16_t, 128> sent_cc_values_;
+  uint16_t selected_nrpn_ = UNSENT;
+  uint8_t sent_channel_ = 0;
+  etl::vector<PendingNrpn, 4> pending_nrpns_;
 };
 
 } // namespace drum
@@ -37,6 +37,7 @@ void MidiManager::init() {
       .start = start_callback,
       .cont = continue_callback,
       .stop = stop_callback,
+      .song_position = song_position_callback,
       .cc = cc_callback,
       .pitch_bend = nullptr,
       .sysex = sysex_callback,
@@ -47,14 +48,14 @@ void MidiManager::process_input() {
   // Drain every buffered message instead of one per loop iteration: each
   // read() returns after at most one complete message, and a single call per
   // loop paces inbound SysEx far below what USB delivers during sample
-  // transfers. The loop is bounded because the transport buffers only refill
-  // from usb::background_update(); the cap guards the loop period against a
-  // pathological flood.
+  // transfers. The USB buffer only refills from usb::background_update(), but
+  // the DIN ring refills from its interrupt while we read; the cap guards
+  // the loop period against a continuous or pathological flood.
   constexpr int MAX_MESSAGES_PER_UPDATE = 32;
   for (int i = 0; i < MAX_MESSAGES_PER_UPDATE; ++i) {
     const bool message_parsed = MIDI::read();
-    // The SysEx chunk queue is only two entries deep, so consume chunks
-    // between reads or back-to-back SysEx messages would be dropped.
+    // Handle SysEx chunks between reads, in place in the SysEx ring, so a
+    // long burst of them frees ring space as it arrives.
     while (const sysex::Chunk *chunk =
                musin::midi::peek_incoming_sysex_chunk()) {
       handle_sysex(*chunk);
@@ -65,19 +66,19 @@ void MidiManager::process_input() {
     }
   }
 
-  musin::midi::IncomingMidiMessage message;
+  musin::midi::TimestampedMidiMessage message;
   while (musin::midi::dequeue_incoming_midi_message(message)) {
-    // Gate all other messages during a file transfer to prevent conflicts.
-    if (sysex_handler_.is_busy()) {
-      continue;
-    }
-
     etl::visit(
-        [this](auto &&arg) {
+        [this, timestamp_us = message.timestamp_us](auto &&arg) {
           using T = typename std::decay<decltype(arg)>::type;
+          if constexpr (!std::is_same_v<T, musin::midi::ControlChangeData>) {
+            // Apply a held CC MSB before anything that follows it
+            flush_controllers();
+          }
           if constexpr (std::is_same_v<T, musin::midi::NoteOnData>) {
             if (arg.velocity > 0) {
-              handle_note_on(arg.channel, arg.note, arg.velocity);
+              handle_note_on(arg.channel, arg.note, arg.velocity,
+                             timestamp_us);
             } else {
               // Note On with velocity 0 is a Note Off
               if constexpr (!drum::config::IGNORE_MIDI_NOTE_OFF) {
@@ -94,10 +95,14 @@ void MidiManager::process_input() {
           } else if constexpr (std::is_same_v<
                                    T, musin::midi::SystemRealtimeData>) {
             handle_realtime(arg.type);
+          } else if constexpr (std::is_same_v<T,
+                                              musin::midi::SongPositionData>) {
+            handle_song_position(arg.sixteenths);
           }
         },
-        message);
+        message.message);
   }
+  flush_controllers();
 }
 
 // --- C-style Callbacks ---
@@ -105,19 +110,22 @@ void MidiManager::process_input() {
 void MidiManager::note_on_callback(uint8_t channel, uint8_t note,
                                    uint8_t velocity) {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::NoteOnData{channel, note, velocity});
+      musin::midi::NoteOnData{channel, note, velocity},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::note_off_callback(uint8_t channel, uint8_t note,
                                     uint8_t velocity) {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::NoteOffData{channel, note, velocity});
+      musin::midi::NoteOffData{channel, note, velocity},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::cc_callback(uint8_t channel, uint8_t controller,
                               uint8_t value) {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::ControlChangeData{channel, controller, value});
+      musin::midi::ControlChangeData{channel, controller, value},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::sysex_callback(uint8_t *data, unsigned length) {
@@ -131,32 +139,42 @@ void MidiManager::sysex_callback(uint8_t *data, unsigned length) {
 
 void MidiManager::clock_callback() {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::SystemRealtimeData{::midi::Clock});
+      musin::midi::SystemRealtimeData{::midi::Clock},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::start_callback() {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::SystemRealtimeData{::midi::Start});
+      musin::midi::SystemRealtimeData{::midi::Start},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::continue_callback() {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::SystemRealtimeData{::midi::Continue});
+      musin::midi::SystemRealtimeData{::midi::Continue},
+      MIDI::message_timestamp_us());
 }
 
 void MidiManager::stop_callback() {
   musin::midi::enqueue_incoming_midi_message(
-      musin::midi::SystemRealtimeData{::midi::Stop});
+      musin::midi::SystemRealtimeData{::midi::Stop},
+      MIDI::message_timestamp_us());
+}
+
+void MidiManager::song_position_callback(unsigned beats) {
+  musin::midi::enqueue_incoming_midi_message(
+      musin::midi::SongPositionData{static_cast<uint16_t>(beats)},
+      MIDI::message_timestamp_us());
 }
 
 // --- Message Handlers ---
 
 void MidiManager::handle_note_on(uint8_t channel, uint8_t note,
-                                 uint8_t velocity) {
+                                 uint8_t velocity, uint32_t timestamp_us) {
   if (channel != settings_.get(settings::Id::MidiChannel)) {
     return; // Ignore messages not on our input channel
   }
-  message_router_.handle_incoming_note_on(note, velocity);
+  message_router_.handle_incoming_note_on(note, velocity, timestamp_us);
 }
 
 void MidiManager::handle_note_off(uint8_t channel, uint8_t note,
@@ -172,7 +190,17 @@ void MidiManager::handle_control_change(uint8_t channel, uint8_t controller,
   if (channel != settings_.get(settings::Id::MidiChannel)) {
     return; // Ignore messages not on our input channel
   }
-  message_router_.handle_incoming_midi_cc(controller, value);
+  controller_decoder_.process(
+      controller, value, [this](const musin::midi::ControllerValue &decoded) {
+        message_router_.handle_incoming_controller(decoded);
+      });
+}
+
+void MidiManager::flush_controllers() {
+  controller_decoder_.flush(
+      [this](const musin::midi::ControllerValue &decoded) {
+        message_router_.handle_incoming_controller(decoded);
+      });
 }
 
 void MidiManager::handle_sysex(const sysex::Chunk &chunk) {
@@ -180,11 +208,26 @@ void MidiManager::handle_sysex(const sysex::Chunk &chunk) {
 }
 
 void MidiManager::handle_realtime(uint16_t type) {
-  // This could be a switch, but for now, only clock is handled.
-  if (type == ::midi::Clock) {
+  switch (type) {
+  case ::midi::Clock:
     midi_clock_processor_.on_midi_clock_tick_received();
+    break;
+  case ::midi::Start:
+    midi_clock_processor_.on_midi_start();
+    break;
+  case ::midi::Continue:
+    midi_clock_processor_.on_midi_continue();
+    break;
+  case ::midi::Stop:
+    midi_clock_processor_.on_midi_stop();
+    break;
+  default:
+    break;
   }
-  // TODO: Handle Start, Stop, Continue if needed by the clock processor
+}
+
+void MidiManager::handle_song_position(uint16_t sixteenths) {
+  midi_clock_processor_.on_song_position(sixteenths);
 }
 
 } // namespace drum
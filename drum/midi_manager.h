@@ -2,6 +2,7 @@
 #define DRUM_MIDI_MANAGER_H
 
 #include "drum/settings.h"
+#include "musin/midi/controller_decoder.h"
 #include "musin/midi/sysex_chunk.h"
 #include <cstdint>
 
@@ -64,6 +65,9 @@ private:
   const settings::Settings &settings_;
   musin::Logger &logger_;
 
+  // Assembles 14-bit CC pairs and NRPN sequences on our input channel
+  musin::midi::ControllerDecoder controller_decoder_;
+
   // --- Singleton Instance for C Callbacks ---
   // A raw pointer is used to interface with the C-style MIDI library,
   // which does not support context pointers in its callbacks.
@@ -81,15 +85,19 @@ private:
   static void start_callback();
   static void continue_callback();
   static void stop_callback();
+  static void song_position_callback(unsigned beats);
 
   // --- Message Handlers ---
   // These methods are called by process_input() to act on dequeued messages.
-  void handle_note_on(uint8_t channel, uint8_t note, uint8_t velocity);
+  void handle_note_on(uint8_t channel, uint8_t note, uint8_t velocity,
+                      uint32_t timestamp_us);
   void handle_note_off(uint8_t channel, uint8_t note, uint8_t velocity);
   void handle_control_change(uint8_t channel, uint8_t controller,
                              uint8_t value);
+  void flush_controllers();
   void handle_sysex(const sysex::Chunk &chunk);
   void handle_realtime(uint16_t type);
+  void handle_song_position(uint16_t sixteenths);
 };
 
 } // namespace drum
@@ -241,7 +241,6 @@ void PizzaControls::KeypadComponent::KeypadEventHandler::handle_sequencer_step(
     if (now_enabled) {
       const uint8_t step_velocity = config::keypad::DEFAULT_STEP_VELOCITY;
       uint8_t note = controls->drumpad_component.get_note_for_pad(track_index);
-      track.set_step_note(step_index, note);
       track.set_step_velocity(step_index, step_velocity);
       if (!controls->is_running()) {
         controls->_sequencer_controller_ref.trigger_note_on(track_index, note,
@@ -252,12 +251,21 @@ void PizzaControls::KeypadComponent::KeypadEventHandler::handle_sequencer_step(
     controls->_sequencer_controller_ref.mark_state_dirty_public();
   }
   if (event.type == musin::ui::KeypadEvent::Type::Hold) {
-    if (!track.get_step(step_index).enabled) {
+    if (!track.is_step_enabled(step_index)) {
       track.set_step_enabled(step_index, true);
     }
     track.set_step_velocity(step_index, config::keypad::STEP_VELOCITY_ON_HOLD);
     // Mark sequencer state dirty after velocity edit
     controls->_sequencer_controller_ref.mark_state_dirty_public();
+    // While held, the track slider and filter knob lock this step
+    controls->held_step_ = HeldStep{track_index, step_index};
+  }
+  if (event.type == musin::ui::KeypadEvent::Type::Release) {
+    if (controls->held_step_.has_value() &&
+        controls->held_step_->track == track_index &&
+        controls->held_step_->step == step_index) {
+      controls->held_step_.reset();
+    }
   }
 }
 
@@ -334,9 +342,6 @@ void PizzaControls::DrumpadComponent::select_note_for_pad(uint8_t pad_index,
 
   parent_controls->_sequencer_controller_ref.set_active_note_for_track(
       pad_index, new_selected_note_value);
-  parent_controls->_sequencer_controller_ref.get_sequencer()
-      .get_track(pad_index)
-      .set_note(new_selected_note_value);
   // Mark sequencer state dirty after changing track note assignments
   parent_controls->_sequencer_controller_ref.mark_state_dirty_public();
 }
@@ -364,6 +369,7 @@ void PizzaControls::DrumpadComponent::DrumpadEventHandler::notification(
         uint8_t velocity = event.velocity.value();
         seq_controller.trigger_note_on(event.pad_index, note, velocity);
         seq_controller.record_velocity_hit(event.pad_index);
+        seq_controller.record_hit(event.pad_index, velocity);
       }
     } else if (event.type == musin::ui::DrumpadEvent::Type::Release) {
       logger.debug("RELEASED ", static_cast<uint32_t>(event.pad_index));
@@ -499,6 +505,11 @@ void PizzaControls::AnalogControlComponent::handle_control_change(
     uint16_t control_id, float value) {
   PizzaControls *controls = parent_controls;
 
+  if (controls->held_step_.has_value() &&
+      handle_step_lock(controls->held_step_.value(), control_id, value)) {
+    return;
+  }
+
   switch (control_id) {
   case FILTER:
     // For initialization, set current value directly.
@@ -571,6 +582,42 @@ void PizzaControls::AnalogControlComponent::handle_control_change(
   }
 }
 
+bool PizzaControls::AnalogControlComponent::handle_step_lock(
+    const HeldStep &held, uint16_t control_id, float value) {
+  std::optional<uint8_t> slider_track;
+  switch (control_id) {
+  case PITCH1:
+    slider_track = 0;
+    break;
+  case PITCH2:
+    slider_track = 1;
+    break;
+  case PITCH3:
+    slider_track = 2;
+    break;
+  case PITCH4:
+    slider_track = 3;
+    break;
+  case FILTER: {
+    // Lock the cutoff relative to the live one; 0.5 is no offset.
+    const float offset = 0.5f + (value - filter_current_value_) * 0.5f;
+    parent_controls->_message_router_ref.set_step_parameter_lock(
+        drum::Parameter::FILTER_FREQUENCY, offset, held.track, held.step);
+    return true;
+  }
+  default:
+    return false;
+  }
+
+  // Other tracks' sliders keep their live behaviour
+  if (slider_track.value() != held.track) {
+    return false;
+  }
+  parent_controls->_message_router_ref.set_step_parameter_lock(
+      drum::Parameter::PITCH, value, held.track, held.step);
+  return true;
+}
+
 void PizzaControls::AnalogControlComponent::AnalogControlEventHandler::
     notification(musin::ui::AnalogControlEvent event) {
   parent->handle_control_change(event.control_id, event.value);
@@ -39,6 +39,11 @@ class PizzaControls : public etl::observer<musin::timing::TempoEvent> {
   friend class AnalogControlComponent;
   friend class PlaybuttonComponent;
 
+  struct HeldStep {
+    uint8_t track;
+    uint8_t step;
+  };
+
 public:
   // Constructor takes essential shared resources and dependencies
   explicit PizzaControls(
@@ -183,6 +188,11 @@ public:
     void reset_repeat_state();
 
   private:
+    // Routes a control to a lock on the held step; false if it is not one
+    // of the lockable controls.
+    bool handle_step_lock(const HeldStep &held, uint16_t control_id,
+                          float value);
+
     struct AnalogControlEventHandler
         : public etl::observer<musin::ui::AnalogControlEvent> {
       AnalogControlComponent *parent;
@@ -249,6 +259,8 @@ public:
 
 private:
   bool _was_running_ = false;
+  // Sequencer step key being held; analog moves lock parameters on it.
+  std::optional<HeldStep> held_step_;
   PlaybuttonComponent playbutton_component;
 
 public:
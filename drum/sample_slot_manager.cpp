@@ -87,6 +87,13 @@ void SampleSlotManager::invalidate_sample(size_t sample_index) {
   }
 }
 
+void SampleSlotManager::invalidate_all() {
+  for (VoiceSlot &slot : voice_slots_) {
+    slot.sample_index.reset();
+  }
+  staging_ready_ = false;
+}
+
 const int16_t *SampleSlotManager::voice_data(uint8_t voice_index) const {
   if (voice_index >= NUM_VOICE_SLOTS) {
     return nullptr;
@@ -75,6 +75,12 @@ public:
    */
   void invalidate_sample(size_t sample_index);
 
+  /**
+   * @brief Forgets the RAM copy of every sample, as after a whole kit has
+   * been replaced.
+   */
+  void invalidate_all();
+
   const int16_t *voice_data(uint8_t voice_index) const;
   uint32_t voice_length(uint8_t voice_index) const;
   etl::optional<size_t> voice_sample_index(uint8_t voice_index) const;
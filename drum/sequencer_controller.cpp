@@ -4,6 +4,7 @@
 #include "pico/time.h"
 #include "sequencer_persistence.h"
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
@@ -13,13 +14,14 @@ namespace drum {
 template <size_t NumTracks, size_t NumSteps>
 SequencerController<NumTracks, NumSteps>::SequencerController(
     musin::timing::TempoHandler &tempo_handler_ref, musin::Logger &logger)
-    : sequencer_(main_sequencer_), scheduled_step_counter_{0},
+    : scheduled_step_counter_{0},
       tempo_source(tempo_handler_ref), _running(false), _step_is_due{false},
       persistence_(logger), logger_(logger) {
 
   initialize_active_notes();
   initialize_all_sequencers();
   initialize_timing_and_random();
+  recorder_.set_quantize_strength(config::record::DEFAULT_QUANTIZE_STRENGTH);
 
   // Note: Persistence initialization deferred until filesystem is ready
   // Call init_persistence() after filesystem.init() succeeds
@@ -35,59 +37,141 @@ SequencerController<NumTracks, NumSteps>::~SequencerController() {
 template <size_t NumTracks, size_t NumSteps>
 size_t
 SequencerController<NumTracks, NumSteps>::calculate_base_step_index() const {
-  return repeat_effect_.calculate_step_index(scheduled_step_counter_,
-                                             sequencer_.get().get_num_steps());
+  // Tracks of different lengths only realign after the full cycle, so the
+  // base index runs over the cycle and each track wraps it by its own length.
+  return repeat_effect_.calculate_step_index(
+      pattern_step_counter_, get_sequencer().get_cycle_length());
 }
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::process_track_step(
-    size_t track_idx, size_t step_index_to_play) {
-  const size_t num_steps = sequencer_.get().get_num_steps();
-  uint8_t track_index_u8 = static_cast<uint8_t>(track_idx);
+    size_t track_idx, size_t step_index_to_play, uint32_t onset_us,
+    bool micro_timing, std::optional<size_t> next_step_index) {
   TrackState &track_state = track_states_[track_idx];
+  const auto &track = get_sequencer().get_track(track_idx);
+  const size_t wrapped_step = step_index_to_play % track.size();
 
-  // Emit Note Off event if a note was previously playing on this track
-  if (track_state.last_played_note.has_value()) {
-    drum::Events::NoteEvent note_off_event{
-        .track_index = track_index_u8,
-        .note = track_state.last_played_note.value(),
-        .velocity = 0};
-    this->notify_observers(note_off_event);
-    track_state.last_played_note = std::nullopt;
+  // Notes scheduled within the previous step never spill past this onset.
+  for (const PendingNote &pending : track_state.pending_notes) {
+    play_track_note(track_idx, pending.step, pending.velocity);
   }
+  track_state.pending_notes.clear();
 
-  const int effective_step_with_fixed_offset =
-      static_cast<int>(step_index_to_play);
-  const size_t wrapped_step =
-      (num_steps > 0)
-          ? ((effective_step_with_fixed_offset % static_cast<int>(num_steps) +
-              num_steps) %
-             num_steps)
-          : 0;
-
-  const musin::timing::Step &step =
-      sequencer_.get().get_track(track_idx).get_step(wrapped_step);
-  bool actually_enabled = step.enabled;
-  uint8_t effective_velocity = step.velocity.value_or(0);
-
-  // Apply probability flip for hard press random mode
-  if (random_effect_.is_probability_mode_enabled()) {
-    // 50% chance of flipping any step's enabled state using lowest bit
-    if (rand() & 1) {
-      actually_enabled = !actually_enabled;
-      // If flipping a disabled step to enabled, ensure it has velocity
-      if (actually_enabled && effective_velocity == 0) {
-        effective_velocity = drum::config::keypad::DEFAULT_STEP_VELOCITY;
+  if (track_state.early_scheduled_step == wrapped_step) {
+    // Already sounded ahead of the onset; let it ring.
+    track_state.early_scheduled_step.reset();
+  } else {
+    track_state.early_scheduled_step.reset();
+
+    // Emit Note Off event if a note was previously playing on this track
+    if (track_state.last_played_note.has_value()) {
+      drum::Events::NoteEvent note_off_event{
+          .track_index = static_cast<uint8_t>(track_idx),
+          .note = track_state.last_played_note.value(),
+          .velocity = 0};
+      this->notify_observers(note_off_event);
+      track_state.last_played_note = std::nullopt;
+    }
+
+    if (track_state.skip_step == wrapped_step) {
+      track_state.skip_step.reset();
+    } else if (const auto velocity =
+                   resolve_step_velocity(track_idx, wrapped_step)) {
+      const int8_t offset =
+          micro_timing ? track.get_step(wrapped_step).micro_offset : 0;
+      if (offset > 0) {
+        track_state.pending_notes.push_back(
+            {onset_us + SequencerRecorder::units_to_us(
+                            offset, tick_interval_us_.load()),
+             velocity.value(), static_cast<uint8_t>(wrapped_step)});
+      } else {
+        play_track_note(track_idx, wrapped_step, velocity.value());
       }
     }
   }
 
-  if (actually_enabled && step.note.has_value() && effective_velocity > 0) {
-    drum::Events::NoteEvent note_on_event{.track_index = track_index_u8,
-                                          .note = step.note.value(),
-                                          .velocity = effective_velocity};
-    this->notify_observers(note_on_event);
-    track_state.last_played_note = step.note.value();
+  // Look ahead: an early step of the next index sounds before its onset.
+  if (micro_timing && next_step_index.has_value()) {
+    const size_t next_step = next_step_index.value() % track.size();
+    const int8_t next_offset = track.get_step(next_step).micro_offset;
+    if (next_offset < 0 && track_state.skip_step != next_step) {
+      if (const auto velocity = resolve_step_velocity(track_idx, next_step)) {
+        track_state.pending_notes.push_back(
+            {onset_us + SequencerRecorder::units_to_us(
+                            step_ticks_.load(std::memory_order_relaxed) *
+                                    SequencerRecorder::UNITS_PER_TICK +
+                                next_offset,
+                            tick_interval_us_.load()),
+             velocity.value(), static_cast<uint8_t>(next_step)});
+        track_state.early_scheduled_step = next_step;
+      }
+    }
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+std::optional<uint8_t>
+SequencerController<NumTracks, NumSteps>::resolve_step_velocity(
+    size_t track_idx, size_t step_idx) {
+  const auto &track = get_sequencer().get_track(track_idx);
+  bool actually_enabled = track.is_step_enabled(step_idx);
+  uint8_t effective_velocity = track.get_step(step_idx).velocity;
+
+  // Apply probability flip for hard press random mode: 50% chance of
+  // flipping any step's enabled state
+  if (random_effect_.is_step_flipped(track_idx)) {
+    actually_enabled = !actually_enabled;
+    // If flipping a disabled step to enabled, ensure it has velocity
+    if (actually_enabled && effective_velocity == 0) {
+      effective_velocity = drum::config::keypad::DEFAULT_STEP_VELOCITY;
+    }
+  }
+
+  if (!actually_enabled || !track.get_note().has_value() ||
+      effective_velocity == 0) {
+    return std::nullopt;
+  }
+  return effective_velocity;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::play_track_note(
+    size_t track_idx, size_t step_idx, uint8_t velocity,
+    std::optional<uint32_t> sound_at_us) {
+  const auto &track = get_sequencer().get_track(track_idx);
+  const std::optional<uint8_t> note = track.get_note();
+  if (note.has_value()) {
+    // Locks are resolved here so they reach the engine with the trigger.
+    trigger_note_on(static_cast<uint8_t>(track_idx), note.value(), velocity,
+                    track.get_step_locks(step_idx), sound_at_us);
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::fire_due_notes(
+    uint32_t now_us) {
+  for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
+    auto &pending_notes = track_states_[track_idx].pending_notes;
+    for (size_t i = 0; i < pending_notes.size();) {
+      const uint32_t due_us = pending_notes[i].due_us;
+      if (static_cast<int32_t>(
+              now_us + drum::config::SEQUENCER_NOTE_LEAD_US - due_us) >= 0) {
+        play_track_note(track_idx, pending_notes[i].step,
+                        pending_notes[i].velocity, due_us);
+        pending_notes.erase(pending_notes.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::clear_pending_notes() {
+  for (auto &track_state : track_states_) {
+    track_state.pending_notes.clear();
+    track_state.early_scheduled_step.reset();
+    track_state.skip_step.reset();
   }
 }
 
@@ -123,13 +207,16 @@ void SequencerController<NumTracks, NumSteps>::reset() {
     }
   }
   scheduled_step_counter_ = 0;
+  pattern_step_counter_ = 0;
   last_phase_12_ = 0;
+  clear_pending_notes();
 
   // Pre-populate last-played step indices so the UI has a cursor immediately
   // after starting, even before the first incoming tick.
   size_t base_step_index = calculate_base_step_index();
-  for (auto &track_state : track_states_) {
-    track_state.just_played_step = base_step_index;
+  for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
+    track_states_[track_idx].just_played_step =
+        base_step_index % get_sequencer().get_track(track_idx).size();
   }
 
   deactivate_repeat();
@@ -148,30 +235,43 @@ void SequencerController<NumTracks, NumSteps>::mark_step_due() {
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::start() {
-  if (_running) {
+  if (!begin_playback()) {
     return;
   }
 
+  // To maintain swing timing, align the clock phase on restart.
+  const auto [anchor_phase, primed_phase] =
+      align_to_last_anchor(last_phase_12_);
+  last_phase_12_ = primed_phase;
+  if (drum::config::RETRIGGER_SYNC_ON_PLAYBUTTON) {
+    tempo_source.trigger_manual_sync(anchor_phase);
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::begin_playback() {
+  if (_running) {
+    return false;
+  }
+
   for (auto &track_state : track_states_) {
     track_state.just_played_step = std::nullopt;
   }
 
+  // The tick interval is re-measured once the clock runs again.
+  last_tick_us_ = 0;
+  tick_interval_us_ = 0;
+
   tempo_source.add_observer(*this);
   tempo_source.set_playback_state(musin::timing::PlaybackState::PLAYING);
 
   _running = true;
-
-  // To maintain swing timing, align the clock phase on restart.
-  const auto [anchor_phase, primed_phase] =
-      align_to_last_anchor(last_phase_12_);
-  last_phase_12_ = primed_phase;
-  if (drum::config::RETRIGGER_SYNC_ON_PLAYBUTTON) {
-    tempo_source.trigger_manual_sync(anchor_phase);
-  }
+  return true;
 }
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::stop() {
+  awaiting_song_position_ = false;
   if (!_running) {
     return;
   }
@@ -191,6 +291,7 @@ void SequencerController<NumTracks, NumSteps>::stop() {
   for (size_t i = 0; i < NumTracks; ++i) {
     deactivate_play_on_every_step(static_cast<uint8_t>(i));
   }
+  clear_pending_notes();
 
   random_effect_.reset_to_inactive();
   random_intends_flip_ = false;
@@ -220,6 +321,18 @@ void SequencerController<NumTracks, NumSteps>::notification(
 
   // event.phase_12 is guaranteed in [0, PPQN-1] by TempoHandler
 
+  if (event.song_position.has_value()) {
+    awaiting_song_position_ = false;
+    relocate_to_position(event.song_position.value());
+  } else if (awaiting_song_position_) {
+    // Started by MIDI transport: wait for the host's position, which only a
+    // MIDI clock brings. Any other source plays from where we are.
+    if (tempo_source.get_clock_source() == musin::timing::ClockSource::MIDI) {
+      return;
+    }
+    awaiting_song_position_ = false;
+  }
+
   // Handle resync events by setting up the look-behind window
   // This makes the next expected phase catchable by normal scheduling
   if (event.is_resync) {
@@ -239,10 +352,20 @@ void SequencerController<NumTracks, NumSteps>::notification(
       musin::timing::DEFAULT_PPQN;
   pending_trace_fade_ticks_.fetch_add(elapsed_ticks, std::memory_order_relaxed);
 
-  // Calculate swing timing using the dedicated effect
-  const size_t next_index = calculate_base_step_index();
+  // Measure the tick length so micro-timing can be converted to wall time.
+  const uint32_t now_us = time_us_32();
+  if (last_tick_us_ != 0 && !event.is_resync) {
+    tick_interval_us_.store((now_us - last_tick_us_) / elapsed_ticks,
+                            std::memory_order_relaxed);
+  }
+  last_tick_us_ = now_us;
+
+  // Calculate swing timing using the dedicated effect. Parity follows the
+  // transport count: an odd-length pattern or a song-mode advance would make
+  // the pattern index repeat a parity and stall the onset by a whole step.
   const auto timing = swing_effect_.calculate_step_timing(
-      next_index, repeat_effect_.is_active(), scheduled_step_counter_);
+      scheduled_step_counter_, repeat_effect_.is_active(),
+      scheduled_step_counter_);
   const uint8_t expected_phase = timing.expected_phase;
 
   // --- Look-behind scheduling check for the main step ---
@@ -258,6 +381,7 @@ void SequencerController<NumTracks, NumSteps>::notification(
   }
 
   if (is_step_due) {
+    step_onset_us_.store(now_us, std::memory_order_relaxed);
     mark_step_due();
   }
 
@@ -289,10 +413,7 @@ void SequencerController<NumTracks, NumSteps>::notification(
 template <size_t NumTracks, size_t NumSteps>
 [[nodiscard]] uint32_t
 SequencerController<NumTracks, NumSteps>::get_current_step() const noexcept {
-  const size_t num_steps = sequencer_.get().get_num_steps();
-  if (num_steps == 0)
-    return 0;
-  return scheduled_step_counter_ % num_steps;
+  return pattern_step_counter_ % get_sequencer().get_num_steps();
 }
 
 template <size_t NumTracks, size_t NumSteps>
@@ -315,8 +436,8 @@ template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::activate_repeat(
     uint32_t length) {
   if (_running) {
-    repeat_effect_.activate(length, scheduled_step_counter_,
-                            sequencer_.get().get_num_steps());
+    repeat_effect_.activate(length, pattern_step_counter_,
+                            get_sequencer().get_cycle_length());
   }
 }
 
@@ -347,7 +468,7 @@ template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::set_random(float value) {
   random_effect_.set_random_intensity(value);
   if (value >= 0.2f) {
-    random_effect_.regenerate_offsets(sequencer_.get().get_num_steps(),
+    random_effect_.regenerate_offsets(get_sequencer().get_num_steps(),
                                       NumTracks);
   }
 }
@@ -387,6 +508,44 @@ void SequencerController<NumTracks, NumSteps>::toggle() {
   }
 }
 
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::on_transport_command(
+    musin::timing::TransportCommand command) {
+  using musin::timing::TransportCommand;
+  if (tempo_source.get_clock_source() ==
+      musin::timing::ClockSource::EXTERNAL_SYNC) {
+    return;
+  }
+
+  switch (command) {
+  case TransportCommand::START:
+    reset();
+    [[fallthrough]];
+  case TransportCommand::CONTINUE:
+    // Also when already running: the host's position takes over. Without a
+    // MIDI clock there is none coming, so play straight away.
+    awaiting_song_position_ = tempo_source.get_clock_source() ==
+                              musin::timing::ClockSource::MIDI;
+    begin_playback();
+    break;
+  case TransportCommand::STOP:
+    stop();
+    break;
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::relocate_to_position(
+    uint32_t position) {
+  constexpr uint32_t ticks_per_step = musical_timing::TICKS_PER_STEP;
+  const uint32_t step = (position + ticks_per_step - 1) / ticks_per_step;
+  scheduled_step_counter_ = step;
+  pattern_step_counter_ = pattern_bank_.steps_into_pattern_at(
+      step, musical_timing::STEPS_PER_BAR);
+  clear_pending_notes();
+  _step_is_due = false;
+}
+
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::notification(
     drum::Events::SysExTransferStateChangeEvent event) {
@@ -397,7 +556,9 @@ void SequencerController<NumTracks, NumSteps>::notification(
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::trigger_note_on(
-    uint8_t track_index, uint8_t note, uint8_t velocity) {
+    uint8_t track_index, uint8_t note, uint8_t velocity,
+    const musin::timing::ParamLocks &locks,
+    std::optional<uint32_t> sound_at_us) {
   // Debug: Log that trigger_note_on was called
   static_cast<void>(0); // Placeholder for debug log - will add proper logging
 
@@ -414,8 +575,11 @@ void SequencerController<NumTracks, NumSteps>::trigger_note_on(
     }
   }
 
-  drum::Events::NoteEvent note_on_event{
-      .track_index = track_index, .note = note, .velocity = velocity};
+  drum::Events::NoteEvent note_on_event{.track_index = track_index,
+                                        .note = note,
+                                        .velocity = velocity,
+                                        .locks = locks,
+                                        .sound_at_us = sound_at_us};
   this->notify_observers(note_on_event);
   track_state.last_played_note = note;
 }
@@ -438,13 +602,23 @@ template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::set_active_note_for_track(
     uint8_t track_index, uint8_t note) {
   if (track_index < NumTracks) {
-    track_states_[track_index].active_note = note;
+    assign_active_note(track_index, note);
     persistence_.mark_dirty();
   }
   // else: track_index is out of bounds, do nothing or log an error.
   // For now, we silently ignore out-of-bounds access to prevent crashes.
 }
 
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::assign_active_note(
+    uint8_t track_index, uint8_t note) {
+  track_states_[track_index].active_note = note;
+  // The note belongs to the drum voice, so it follows across patterns.
+  for (size_t i = 0; i < pattern_bank_.size(); ++i) {
+    pattern_bank_.get_pattern(i).get_track(track_index).set_note(note);
+  }
+}
+
 template <size_t NumTracks, size_t NumSteps>
 uint8_t SequencerController<NumTracks, NumSteps>::get_active_note_for_track(
     uint8_t track_index) const {
@@ -471,6 +645,72 @@ void SequencerController<NumTracks, NumSteps>::record_velocity_hit(
   }
 }
 
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::record_hit(uint8_t track_index,
+                                                          uint8_t velocity) {
+  if (!recorder_.is_enabled() || !_running || track_index >= NumTracks ||
+      velocity == 0) {
+    return;
+  }
+  TrackState &track_state = track_states_[track_index];
+  if (!track_state.just_played_step.has_value()) {
+    return; // No step has played yet to time the hit against
+  }
+
+  const auto hit = recorder_.capture(
+      time_us_32() - step_onset_us_.load(std::memory_order_relaxed),
+      tick_interval_us_.load(std::memory_order_relaxed),
+      step_ticks_.load(std::memory_order_relaxed));
+
+  auto &track = get_sequencer().get_track(track_index);
+  const size_t current_step = track_state.just_played_step.value();
+  const size_t target_step =
+      hit.on_next_step ? (current_step + 1) % track.size() : current_step;
+
+  track.set_step_enabled(target_step, true);
+  track.set_step_velocity(target_step, velocity);
+  track.set_step_micro_offset(target_step, hit.micro_offset);
+
+  // The hit was heard live: drop anything still scheduled for the step and
+  // don't play it again when its onset comes round this pass.
+  auto &pending_notes = track_state.pending_notes;
+  for (size_t i = 0; i < pending_notes.size();) {
+    if (pending_notes[i].step == target_step) {
+      pending_notes.erase(pending_notes.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+  if (hit.on_next_step) {
+    track_state.early_scheduled_step.reset();
+    track_state.skip_step = target_step;
+  }
+  persistence_.mark_dirty();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::set_record_enabled(
+    bool enabled) {
+  recorder_.set_enabled(enabled);
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::is_record_enabled() const {
+  return recorder_.is_enabled();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::set_quantize_strength(
+    uint8_t percent) {
+  recorder_.set_quantize_strength(percent);
+}
+
+template <size_t NumTracks, size_t NumSteps>
+uint8_t SequencerController<NumTracks, NumSteps>::get_quantize_strength()
+    const {
+  return recorder_.get_quantize_strength();
+}
+
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::record_pad_hit_trace(
     uint8_t track_index) {
@@ -496,10 +736,14 @@ void SequencerController<NumTracks, NumSteps>::record_pad_hit_trace(
     case SequencerEffectSwing::HitZone::Middle:
       return;
     case SequencerEffectSwing::HitZone::Late:
-      trace_step = (trace_step + 1) % NumSteps;
+      trace_step =
+          (trace_step + 1) % get_sequencer().get_track(track_index).size();
       break;
     }
-    trace_velocities_[track_index][trace_step] = TRACE_INITIAL_VELOCITY;
+    // Traces exist only for the steps shown on the keypad.
+    if (trace_step < NumSteps) {
+      trace_velocities_[track_index][trace_step] = TRACE_INITIAL_VELOCITY;
+    }
   }
 }
 
@@ -567,7 +811,7 @@ void SequencerController<NumTracks, NumSteps>::update() {
   if (persistence_.should_save_now()) {
     SequencerPersistentState state;
     create_persistent_state(state);
-    if (persistence_.save(state)) {
+    if (persistence_.save(state, pattern_bank_)) {
       logger_.debug("Periodic save completed successfully");
     } else {
       logger_.warn("Periodic save failed");
@@ -591,29 +835,61 @@ void SequencerController<NumTracks, NumSteps>::update() {
     fade_traces(fade_ticks);
   }
 
+  fire_due_notes(time_us_32());
+
   if (!_step_is_due) {
     return;
   }
   _step_is_due = false;
 
+  // Pattern changes wait for the bar line and are held while REPEAT loops.
+  if (!repeat_effect_.is_active() &&
+      pattern_bank_.on_step_boundary(pattern_step_counter_,
+                                     musical_timing::STEPS_PER_BAR)) {
+    pattern_step_counter_ = 0;
+  }
+
   size_t base_step_index = calculate_base_step_index();
 
   for (auto &track_state : track_states_) {
     track_state.just_played_step = std::nullopt;
   }
 
-  size_t num_tracks = sequencer_.get().get_num_tracks();
+  random_effect_.begin_step(scheduled_step_counter_);
+
+  const auto &pattern = get_sequencer();
+  size_t num_tracks = pattern.get_num_tracks();
+
+  // Micro-timing follows the written pattern; effects that rearrange steps
+  // play them on the grid. Offsets are measured against the swung onsets, so
+  // the step's actual length places early notes and recorded hits.
+  step_ticks_.store(swing_effect_.step_length_ticks(scheduled_step_counter_),
+                    std::memory_order_relaxed);
+  const uint32_t onset_us = step_onset_us_.load(std::memory_order_relaxed);
+  const bool micro_timing = !repeat_effect_.is_active() &&
+                            !random_effect_.is_offset_mode_enabled() &&
+                            tick_interval_us_.load() > 0;
+  // The next step is only known ahead if no pattern change comes first.
+  std::optional<size_t> next_base_step_index;
+  if (micro_timing &&
+      !pattern_bank_.will_change_at(pattern_step_counter_ + 1,
+                                    musical_timing::STEPS_PER_BAR)) {
+    next_base_step_index =
+        (pattern_step_counter_ + 1) % pattern.get_cycle_length();
+  }
 
   for (size_t track_idx = 0; track_idx < num_tracks; ++track_idx) {
     // Calculate randomized step using the effect
-    const size_t num_steps = sequencer_.get().get_num_steps();
+    const size_t track_length = pattern.get_track(track_idx).size();
     auto randomized_step = random_effect_.calculate_randomized_step(
-        base_step_index, track_idx, num_steps, repeat_effect_.is_active());
+        base_step_index % track_length, track_idx, track_length,
+        repeat_effect_.is_active());
 
     size_t step_index_to_play_for_track = randomized_step.effective_step_index;
 
     track_states_[track_idx].just_played_step = step_index_to_play_for_track;
-    process_track_step(track_idx, step_index_to_play_for_track);
+    process_track_step(track_idx, step_index_to_play_for_track, onset_us,
+                       micro_timing, next_base_step_index);
 
     // Handle the first retrigger note for the main step event
     // Simple guard: only add explicit boundary retrigger for Step mode
@@ -635,8 +911,9 @@ void SequencerController<NumTracks, NumSteps>::update() {
                                           repeat_effect_.get_length());
   }
 
-  // Increment scheduled_step_counter_ AFTER processing the step
+  // Increment the step counters AFTER processing the step
   scheduled_step_counter_++;
+  pattern_step_counter_++;
 }
 
 template <size_t NumTracks, size_t NumSteps>
@@ -651,17 +928,17 @@ void SequencerController<NumTracks, NumSteps>::initialize_active_notes() {
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::initialize_all_sequencers() {
-  for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
-    uint8_t initial_note = track_states_[track_idx].active_note;
-    auto &main_track = main_sequencer_.get_track(track_idx);
-    auto &random_track = random_sequencer_.get_track(track_idx);
-    for (size_t step_idx = 0; step_idx < NumSteps; ++step_idx) {
-      auto &main_step = main_track.get_step(step_idx);
-      auto &random_step = random_track.get_step(step_idx);
-      main_step.note = initial_note;
-      main_step.velocity = drum::config::keypad::DEFAULT_STEP_VELOCITY;
-      random_step.note = initial_note;
-      random_step.velocity = drum::config::keypad::DEFAULT_STEP_VELOCITY;
+  for (size_t pattern_idx = 0; pattern_idx < pattern_bank_.size();
+       ++pattern_idx) {
+    auto &pattern = pattern_bank_.get_pattern(pattern_idx);
+    for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
+      auto &track = pattern.get_track(track_idx);
+      track.set_note(track_states_[track_idx].active_note);
+      track.set_length(NumSteps);
+      for (size_t step_idx = 0; step_idx < track.capacity(); ++step_idx) {
+        track.set_step_velocity(step_idx,
+                                drum::config::keypad::DEFAULT_STEP_VELOCITY);
+      }
     }
   }
 }
@@ -680,21 +957,19 @@ void SequencerController<NumTracks, NumSteps>::create_persistent_state(
   // Clear the state and set header
   state = SequencerPersistentState();
 
-  // Copy track data from main sequencer only
+  // Snapshot the first page of the active pattern
   for (size_t track_idx = 0;
        track_idx < NumTracks && track_idx < config::NUM_TRACKS; ++track_idx) {
-    const auto &track = main_sequencer_.get_track(track_idx);
-    for (size_t step_idx = 0;
-         step_idx < NumSteps && step_idx < config::NUM_STEPS_PER_TRACK;
-         ++step_idx) {
-      const auto &step = track.get_step(step_idx);
-      // Persist only velocity; 0 velocity means disabled.
-      if (step.enabled && step.velocity.has_value() &&
-          step.velocity.value() > 0) {
-        state.tracks[track_idx].velocities[step_idx] = step.velocity.value();
-      } else {
-        state.tracks[track_idx].velocities[step_idx] = 0;
-      }
+    const auto &track = get_sequencer().get_track(track_idx);
+    constexpr size_t page_steps =
+        std::min<size_t>(NumSteps, config::NUM_STEPS_PER_TRACK);
+    // Persist only velocity; 0 velocity (the default) means disabled.
+    uint64_t enabled = track.enabled_mask() & track.length_mask(page_steps);
+    while (enabled != 0) {
+      const auto step_idx = static_cast<size_t>(std::countr_zero(enabled));
+      state.tracks[track_idx].velocities[step_idx] =
+          track.get_step(step_idx).velocity;
+      enabled &= enabled - 1;
     }
   }
 
@@ -703,48 +978,66 @@ void SequencerController<NumTracks, NumSteps>::create_persistent_state(
        track_idx < NumTracks && track_idx < config::NUM_TRACKS; ++track_idx) {
     state.active_notes[track_idx] = track_states_[track_idx].active_note;
   }
+
+  state.active_pattern = pattern_bank_.active_index();
+  state.song_mode = pattern_bank_.is_song_mode() ? 1 : 0;
+  const auto chain = pattern_bank_.get_chain();
+  state.chain_length = static_cast<uint8_t>(chain.size());
+  std::copy(chain.begin(), chain.end(), state.chain.begin());
 }
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::apply_persistent_state(
     const SequencerPersistentState &state) {
-  // Apply active notes first
+  // Apply active notes first; they carry over to every pattern
   for (size_t track_idx = 0;
        track_idx < NumTracks && track_idx < config::NUM_TRACKS; ++track_idx) {
-    track_states_[track_idx].active_note = state.active_notes[track_idx];
+    assign_active_note(static_cast<uint8_t>(track_idx),
+                       state.active_notes[track_idx]);
   }
 
-  // Apply per-step velocities to main sequencer; note is derived from active
-  // note
+  // Apply per-step velocities to the first page of the active pattern
   for (size_t track_idx = 0;
        track_idx < NumTracks && track_idx < config::NUM_TRACKS; ++track_idx) {
-    auto &track = main_sequencer_.get_track(track_idx);
-    uint8_t track_note = track_states_[track_idx].active_note;
-    // Ensure track default note matches active note
-    track.set_note(track_note);
+    auto &track = get_sequencer().get_track(track_idx);
     for (size_t step_idx = 0;
          step_idx < NumSteps && step_idx < config::NUM_STEPS_PER_TRACK;
          ++step_idx) {
-      auto &step = track.get_step(step_idx);
-      uint8_t velocity = state.tracks[track_idx].velocities[step_idx];
-      if (velocity > 0) {
-        step.note = track_note;
-        step.velocity = velocity;
-        step.enabled = true;
-      } else {
-        step.note = std::nullopt;
-        step.velocity = std::nullopt;
-        step.enabled = false;
-      }
+      const uint8_t velocity = state.tracks[track_idx].velocities[step_idx];
+      track.set_step_velocity(step_idx, velocity);
+      track.set_step_enabled(step_idx, velocity > 0);
     }
   }
 }
 
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::apply_loaded_state(
+    const SequencerPersistentState &state) {
+  if (state.is_legacy()) {
+    // A v2 file holds one pattern; it becomes the active pattern's first page.
+    apply_persistent_state(state);
+    return;
+  }
+
+  for (size_t track_idx = 0;
+       track_idx < NumTracks && track_idx < config::NUM_TRACKS; ++track_idx) {
+    assign_active_note(static_cast<uint8_t>(track_idx),
+                       state.active_notes[track_idx]);
+  }
+  const size_t chain_length =
+      std::min<size_t>(state.chain_length, state.chain.size());
+  pattern_bank_.set_chain(
+      etl::span<const uint8_t>{state.chain.data(), chain_length});
+  pattern_bank_.set_song_mode(state.song_mode != 0);
+  // Song mode queues the chain start; selecting resumes on the saved pattern.
+  pattern_bank_.select(state.active_pattern);
+}
+
 template <size_t NumTracks, size_t NumSteps>
 bool SequencerController<NumTracks, NumSteps>::save_state_to_flash() {
   SequencerPersistentState state;
   create_persistent_state(state);
-  bool success = persistence_.save(state);
+  bool success = persistence_.save(state, pattern_bank_);
   if (success) {
     logger_.info("Manual save to flash completed successfully");
   } else {
@@ -756,8 +1049,8 @@ bool SequencerController<NumTracks, NumSteps>::save_state_to_flash() {
 template <size_t NumTracks, size_t NumSteps>
 bool SequencerController<NumTracks, NumSteps>::load_state_from_flash() {
   SequencerPersistentState state;
-  if (persistence_.load(state)) {
-    apply_persistent_state(state);
+  if (persistence_.load(state, pattern_bank_)) {
+    apply_loaded_state(state);
     logger_.info("Manual load from flash completed successfully");
     return true;
   }
@@ -773,8 +1066,8 @@ bool SequencerController<NumTracks, NumSteps>::init_persistence() {
 
   // Attempt to load existing state
   SequencerPersistentState loaded_state;
-  if (persistence_.load(loaded_state)) {
-    apply_persistent_state(loaded_state);
+  if (persistence_.load(loaded_state, pattern_bank_)) {
+    apply_loaded_state(loaded_state);
     logger_.info("Sequencer state loaded from flash during init_persistence");
     return true;
   } else {
@@ -818,11 +1111,16 @@ bool SequencerController<NumTracks, NumSteps>::apply_state(
   return true;
 }
 
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::set_random_seed(uint32_t seed) {
+  random_effect_.seed(seed);
+}
+
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::enable_random_offset_mode() {
   random_effect_.request_state(RandomEffectState::OffsetActive,
                                is_repeat_active());
-  random_effect_.regenerate_offsets(main_sequencer_.get_num_steps(), NumTracks);
+  random_effect_.regenerate_offsets(get_sequencer().get_num_steps(), NumTracks);
 }
 
 template <size_t NumTracks, size_t NumSteps>
@@ -839,7 +1137,7 @@ SequencerController<NumTracks, NumSteps>::is_random_offset_mode_active() const {
 
 template <size_t NumTracks, size_t NumSteps>
 void SequencerController<NumTracks, NumSteps>::regenerate_random_offsets() {
-  random_effect_.regenerate_offsets(main_sequencer_.get_num_steps(), NumTracks);
+  random_effect_.regenerate_offsets(get_sequencer().get_num_steps(), NumTracks);
 }
 
 template <size_t NumTracks, size_t NumSteps>
@@ -874,7 +1172,7 @@ void SequencerController<NumTracks,
   }
 
   // Generate random steps and store them for highlighting
-  const size_t num_steps = main_sequencer_.get_num_steps();
+  const size_t num_steps = get_sequencer().get_num_steps();
   random_effect_.trigger_step_highlighting(num_steps, NumTracks);
   random_effect_.start_step_highlighting();
 
@@ -886,15 +1184,17 @@ void SequencerController<NumTracks,
       continue;
     }
 
-    size_t random_step_index = random_step_opt.value();
-    auto &track = main_sequencer_.get_track(track_idx);
-    auto &step = track.get_step(random_step_index);
+    const auto &track = get_sequencer().get_track(track_idx);
+    size_t random_step_index = random_step_opt.value() % track.size();
+    const auto &step = track.get_step(random_step_index);
+    const std::optional<uint8_t> note = track.get_note();
 
-    if (step.enabled && step.note.has_value() && step.velocity.has_value()) {
+    if (track.is_step_enabled(random_step_index) && note.has_value() &&
+        step.velocity > 0) {
       uint8_t track_index_u8 = static_cast<uint8_t>(track_idx);
       drum::Events::NoteEvent note_on_event{.track_index = track_index_u8,
-                                            .note = step.note.value(),
-                                            .velocity = step.velocity.value()};
+                                            .note = note.value(),
+                                            .velocity = step.velocity};
       this->notify_observers(note_on_event);
     }
   }
@@ -929,6 +1229,114 @@ SequencerController<NumTracks, NumSteps>::get_highlighted_random_step_for_track(
   return step_opt.value_or(get_current_step());
 }
 
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::select_pattern(
+    uint8_t pattern_index) {
+  const bool accepted = _running ? pattern_bank_.queue(pattern_index)
+                                 : pattern_bank_.select(pattern_index);
+  if (accepted && !_running) {
+    pattern_step_counter_ = 0;
+  }
+  if (accepted) {
+    persistence_.mark_dirty();
+  }
+  return accepted;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+uint8_t SequencerController<NumTracks, NumSteps>::get_active_pattern() const {
+  return pattern_bank_.active_index();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+std::optional<uint8_t>
+SequencerController<NumTracks, NumSteps>::get_queued_pattern() const {
+  return pattern_bank_.queued_index();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::copy_pattern(uint8_t from_index,
+                                                            uint8_t to_index) {
+  if (!pattern_bank_.copy_pattern(from_index, to_index)) {
+    return false;
+  }
+  persistence_.mark_dirty();
+  return true;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::set_pattern_chain(
+    etl::span<const uint8_t> chain) {
+  if (chain.size() > config::MAX_PATTERN_CHAIN_LENGTH ||
+      std::any_of(chain.begin(), chain.end(), [](uint8_t entry) {
+        return entry >= config::NUM_PATTERNS;
+      })) {
+    return false;
+  }
+  pattern_bank_.set_chain(chain);
+  if (pattern_bank_.get_chain().empty()) {
+    pattern_bank_.set_song_mode(false);
+  }
+  persistence_.mark_dirty();
+  return true;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::set_song_mode(bool enabled) {
+  pattern_bank_.set_song_mode(enabled);
+  if (!_running && pattern_bank_.queued_index().has_value()) {
+    select_pattern(pattern_bank_.queued_index().value());
+  }
+  persistence_.mark_dirty();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::is_song_mode() const {
+  return pattern_bank_.is_song_mode();
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::set_track_length(
+    uint8_t track_index, size_t length) {
+  if (track_index < NumTracks) {
+    get_sequencer().get_track(track_index).set_length(length);
+    persistence_.mark_dirty();
+  }
+}
+
+template <size_t NumTracks, size_t NumSteps>
+size_t SequencerController<NumTracks, NumSteps>::get_track_length(
+    uint8_t track_index) const {
+  if (track_index < NumTracks) {
+    return get_sequencer().get_track(track_index).size();
+  }
+  return 0;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerController<NumTracks, NumSteps>::set_step_lock(
+    uint8_t track_index, size_t step_index,
+    musin::timing::ParamLocks::Param param, uint8_t value) {
+  if (track_index >= NumTracks || step_index >= config::MAX_STEPS_PER_TRACK) {
+    return false;
+  }
+  if (!get_sequencer().get_track(track_index).set_step_lock(step_index, param,
+                                                             value)) {
+    return false;
+  }
+  persistence_.mark_dirty();
+  return true;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+void SequencerController<NumTracks, NumSteps>::clear_step_locks(
+    uint8_t track_index, size_t step_index) {
+  if (track_index < NumTracks && step_index < config::MAX_STEPS_PER_TRACK) {
+    get_sequencer().get_track(track_index).clear_step_locks(step_index);
+    persistence_.mark_dirty();
+  }
+}
+
 template class SequencerController<config::NUM_TRACKS,
                                    config::NUM_STEPS_PER_TRACK>;
 
@@ -5,6 +5,7 @@
 #include "etl/array.h"
 #include "etl/observer.h"
 #include "events.h"
+#include "musin/timing/midi_clock_processor.h"
 #include "musin/timing/step_sequencer.h"
 #include "musin/timing/tempo_event.h"
 #include "musin/timing/tempo_handler.h"
@@ -16,7 +17,10 @@
 #include <functional>
 #include <optional>
 
+#include "etl/span.h"
+#include "etl/vector.h"
 #include "musin/hal/logger.h"
+#include "musin/timing/pattern_bank.h"
 #include "pico/time.h"
 #include "sequencer_effect_random.h"
 #include "sequencer_effect_repeat.h"
@@ -24,6 +28,7 @@
 #include "sequencer_effect_swing.h"
 #include "sequencer_persistence.h"
 #include "sequencer_persistence_manager.h"
+#include "sequencer_recorder.h"
 #include "sequencer_state_access.h"
 #include <cstddef>
 
@@ -36,8 +41,22 @@ constexpr uint8_t STRAIGHT_OFFBEAT = PPQN / 2;       // 6
 constexpr uint8_t TRIPLET_SUBDIVISION = PPQN / 3;    // 4
 constexpr uint8_t SIXTEENTH_SUBDIVISION = PPQN / 4;  // 3
 constexpr uint8_t TICKS_PER_STEP = STRAIGHT_OFFBEAT; // 6
+constexpr uint8_t STEPS_PER_BAR = (PPQN / TICKS_PER_STEP) * 4; // 8 in 4/4
+static_assert(SequencerRecorder::TICKS_PER_STEP == TICKS_PER_STEP,
+              "Micro-timing units must be based on the step length");
+static_assert(SequencerEffectRandom::BAR_STEPS == STEPS_PER_BAR,
+              "Random draws are batched per bar");
 } // namespace musical_timing
 
+/**
+ * @brief A micro-timed note waiting for its offset to elapse.
+ */
+struct PendingNote {
+  uint32_t due_us;
+  uint8_t velocity;
+  uint8_t step; // Track step the note belongs to
+};
+
 /**
  * @brief Per-track runtime state for the sequencer.
  */
@@ -46,24 +65,36 @@ struct TrackState {
   bool has_velocity_hit{false};
   std::optional<uint8_t> last_played_note{};
   std::optional<size_t> just_played_step{};
+  // Micro-timed notes: at most a late note of the current step and an early
+  // note of the next one.
+  etl::vector<PendingNote, 2> pending_notes{};
+  // Step whose early note was scheduled ahead of its onset.
+  std::optional<size_t> early_scheduled_step{};
+  // Step just recorded from a live hit that was already heard.
+  std::optional<size_t> skip_step{};
 };
 
 // Forward declare the specific Sequencer instantiation from its new namespace
 template <size_t NumTracks, size_t NumSteps> class Sequencer;
 
 /**
- * @brief Receives sequencer ticks and advances the main sequencer.
+ * @brief Receives sequencer ticks and advances the active pattern.
  *
  * Acts as the bridge between the tempo generation system (TempoMultiplier)
- * and the musical pattern storage (Sequencer). It operates on a high-resolution
- * internal clock tick derived from the tempo source. Emits NoteEvents when
- * steps play.
+ * and the musical pattern storage (PatternBank). It operates on a
+ * high-resolution internal clock tick derived from the tempo source. Emits
+ * NoteEvents when steps play.
+ *
+ * NumSteps is the default track length and the page of steps shown and
+ * edited on the keypad; tracks can be lengthened up to
+ * config::MAX_STEPS_PER_TRACK.
  */
 
 template <size_t NumTracks, size_t NumSteps>
 class SequencerController
     : public etl::observer<musin::timing::TempoEvent>,
       public etl::observer<drum::Events::SysExTransferStateChangeEvent>,
+      public musin::timing::ITransportListener,
       public etl::observable<etl::observer<drum::Events::NoteEvent>,
                              drum::config::MAX_NOTE_EVENT_OBSERVERS>,
       public SequencerStateAccess {
@@ -94,13 +125,26 @@ public:
    */
   void notification(drum::Events::SysExTransferStateChangeEvent event);
 
+  /**
+   * @brief Follows MIDI transport. Start plays from step 0, Continue resumes
+   * from the host's song position and Stop halts immediately. Playback waits
+   * for the position, which arrives with the next MIDI clock tick. Ignored
+   * while following the sync input.
+   */
+  void on_transport_command(musin::timing::TransportCommand command) override;
+
   /**
    * @brief Triggers a note on event directly.
    * @param track_index The logical track index.
    * @param note The MIDI note number.
    * @param velocity The MIDI velocity.
+   * @param locks Parameter locks to apply with this trigger.
+   * @param sound_at_us When the note should sound (time_us_32); without it,
+   * as soon as the audio engine can.
    */
-  void trigger_note_on(uint8_t track_index, uint8_t note, uint8_t velocity);
+  void trigger_note_on(uint8_t track_index, uint8_t note, uint8_t velocity,
+                       const musin::timing::ParamLocks &locks = {},
+                       std::optional<uint32_t> sound_at_us = std::nullopt);
 
   /**
    * @brief Triggers a note off event directly.
@@ -231,6 +275,22 @@ public:
 
   void record_velocity_hit(uint8_t track_index);
   void clear_velocity_hit(uint8_t track_index);
+
+  /**
+   * @brief Records a live hit (drumpad or MIDI note-on) into the active
+   * pattern when record mode is on and the sequencer is running. The hit is
+   * timed against the clock and stored with its micro-timing offset, reduced
+   * by the quantize strength. The caller still sounds the hit itself.
+   */
+  void record_hit(uint8_t track_index, uint8_t velocity);
+
+  void set_record_enabled(bool enabled);
+  [[nodiscard]] bool is_record_enabled() const;
+  /**
+   * @brief Set how strongly recorded hits snap to the grid, 0-100%.
+   */
+  void set_quantize_strength(uint8_t percent);
+  [[nodiscard]] uint8_t get_quantize_strength() const;
   [[nodiscard]] bool has_recent_velocity_hit(uint8_t track_index) const;
 
   /**
@@ -250,20 +310,79 @@ public:
    */
   [[nodiscard]] uint8_t get_retrigger_mode_for_track(uint8_t track_index) const;
 
+  using PatternBank =
+      musin::timing::PatternBank<config::NUM_PATTERNS, NumTracks,
+                                 config::MAX_STEPS_PER_TRACK,
+                                 config::MAX_PATTERN_CHAIN_LENGTH>;
+  using Pattern = typename PatternBank::Pattern;
+
   /**
-   * @brief Get a reference to the active sequencer instance.
+   * @brief Get a reference to the active pattern.
    */
-  [[nodiscard]] musin::timing::Sequencer<NumTracks, NumSteps> &get_sequencer() {
-    return sequencer_.get();
+  [[nodiscard]] Pattern &get_sequencer() {
+    return pattern_bank_.active();
   }
   /**
-   * @brief Get a const reference to the active sequencer instance.
+   * @brief Get a const reference to the active pattern.
    */
-  [[nodiscard]] const musin::timing::Sequencer<NumTracks, NumSteps> &
-  get_sequencer() const {
-    return sequencer_.get();
+  [[nodiscard]] const Pattern &get_sequencer() const {
+    return pattern_bank_.active();
   }
 
+  /**
+   * @brief Select the pattern to play. While stopped the switch is
+   * immediate; while running it is queued until the next bar line (and held
+   * while REPEAT is looping) so the current pattern never breaks off
+   * mid-bar.
+   * @return false if the index is out of range.
+   */
+  bool select_pattern(uint8_t pattern_index);
+
+  [[nodiscard]] uint8_t get_active_pattern() const;
+
+  /**
+   * @brief The pattern waiting for the next bar line, if any.
+   */
+  [[nodiscard]] std::optional<uint8_t> get_queued_pattern() const;
+
+  /**
+   * @brief Copy one pattern over another, e.g. to start a variation.
+   * @return false if either index is out of range.
+   */
+  bool copy_pattern(uint8_t from_index, uint8_t to_index);
+
+  /**
+   * @brief Set the chain of patterns played in song mode.
+   * @return false, leaving the chain as it was, if an entry is out of range
+   * or the chain is longer than config::MAX_PATTERN_CHAIN_LENGTH.
+   */
+  bool set_pattern_chain(etl::span<const uint8_t> chain) override;
+
+  /**
+   * @brief Enable or disable song mode, which plays the chain in order,
+   * advancing whenever a pattern has played through.
+   */
+  void set_song_mode(bool enabled);
+  [[nodiscard]] bool is_song_mode() const;
+
+  /**
+   * @brief Set a track's length in the active pattern, clamped to
+   * [1, config::MAX_STEPS_PER_TRACK].
+   */
+  void set_track_length(uint8_t track_index, size_t length);
+  [[nodiscard]] size_t get_track_length(uint8_t track_index) const;
+
+  /**
+   * @brief Lock one parameter of a step in the active pattern. The lock is
+   * sent with the step's trigger and overrides the track value for it.
+   * @param value 0-127 over the parameter's normalized range.
+   * @return false if the indices are out of range or the track's lock pool is
+   * full.
+   */
+  bool set_step_lock(uint8_t track_index, size_t step_index,
+                     musin::timing::ParamLocks::Param param, uint8_t value);
+  void clear_step_locks(uint8_t track_index, size_t step_index);
+
 private:
   /**
    * @brief Calculates the anchor phase and primed last_phase to maintain swing
@@ -288,7 +407,42 @@ private:
   }
 
   [[nodiscard]] size_t calculate_base_step_index() const;
-  void process_track_step(size_t track_idx, size_t step_index_to_play);
+
+  /**
+   * @brief Connects to the tempo source and marks the sequencer running.
+   * @return false if it was already running.
+   */
+  bool begin_playback();
+
+  /**
+   * @brief Moves the step counters to a song position (in tempo ticks) so
+   * the step at it, or the next one if it falls between steps, plays next.
+   */
+  void relocate_to_position(uint32_t position);
+
+  /**
+   * @brief Plays a track's step at its onset. With micro-timing, a late step
+   * is scheduled after the onset, and an early step of the next index is
+   * scheduled ahead of the next onset.
+   */
+  void process_track_step(size_t track_idx, size_t step_index_to_play,
+                          uint32_t onset_us, bool micro_timing,
+                          std::optional<size_t> next_step_index);
+  /**
+   * @brief Velocity a step plays with, after the probability flip; nullopt
+   * if it stays silent.
+   */
+  [[nodiscard]] std::optional<uint8_t>
+  resolve_step_velocity(size_t track_idx, size_t step_idx);
+  void play_track_note(size_t track_idx, size_t step_idx, uint8_t velocity,
+                       std::optional<uint32_t> sound_at_us = std::nullopt);
+  /**
+   * @brief Hands scheduled notes to the audio engine once they are within
+   * SEQUENCER_NOTE_LEAD_US of their time, so they sound on their exact
+   * sample however late in that window the main loop gets to them.
+   */
+  void fire_due_notes(uint32_t now_us);
+  void clear_pending_notes();
 
   /**
    * @brief Stores a display trace for a live hit (drumpad or retrigger) on the
@@ -332,18 +486,27 @@ private:
   void initialize_all_sequencers();
   void initialize_timing_and_random();
 
-  musin::timing::Sequencer<NumTracks, NumSteps> main_sequencer_;
-  musin::timing::Sequencer<NumTracks, NumSteps> random_sequencer_;
-  std::reference_wrapper<musin::timing::Sequencer<NumTracks, NumSteps>>
-      sequencer_;
+  PatternBank pattern_bank_;
+  // Transport step count; drives swing parity.
   uint32_t scheduled_step_counter_;
+  // Steps played since the active pattern (re)started; drives step indices.
+  uint32_t pattern_step_counter_{0};
   etl::array<TrackState, NumTracks> track_states_{};
   etl::array<etl::array<uint8_t, NumSteps>, NumTracks> trace_velocities_{};
   std::atomic<uint32_t> pending_trace_fade_ticks_{0};
   musin::timing::TempoHandler &tempo_source;
   bool _running = false;
+  // Started by MIDI transport; steps wait for the host's song position.
+  bool awaiting_song_position_ = false;
   std::atomic<bool> _step_is_due = false;
   uint8_t last_phase_12_{0};
+  // Wall-clock timing of the tempo source, for micro-timing.
+  std::atomic<uint32_t> step_onset_us_{0};
+  std::atomic<uint32_t> tick_interval_us_{0};
+  // Ticks from the current step's onset to the next, following swing
+  std::atomic<uint8_t> step_ticks_{musical_timing::TICKS_PER_STEP};
+  uint32_t last_tick_us_{0};
+  SequencerRecorder recorder_;
 
   SequencerEffectRepeat repeat_effect_;
   SequencerEffectRetrigger retrigger_effect_;
@@ -364,6 +527,14 @@ private:
 
   void create_persistent_state(SequencerPersistentState &state) const;
   void apply_persistent_state(const SequencerPersistentState &state);
+  // Sets a track's note in every pattern without marking the state dirty, so
+  // applying a loaded state does not write it straight back to flash.
+  void assign_active_note(uint8_t track_index, uint8_t note);
+  /**
+   * @brief Applies a state loaded together with the pattern bank; legacy
+   * single-pattern states are migrated into the active pattern.
+   */
+  void apply_loaded_state(const SequencerPersistentState &state);
 
 public:
   void activate_repeat(uint32_t length);
@@ -383,11 +554,6 @@ public:
   [[nodiscard]] bool is_repeat_active() const;
   [[nodiscard]] uint32_t get_repeat_length() const;
 
-  /**
-   * @brief Copy the main pattern to the random pattern.
-   */
-  void copy_to_random();
-
   /**
    * @brief Save the current sequencer state to persistent storage.
    * @return true if save was successful, false otherwise
@@ -432,6 +598,12 @@ public:
    * @return true if state was applied successfully, false on error.
    */
   bool apply_state(const SequencerPersistentState &state) override;
+
+  /**
+   * @brief Reseeds the random effects' generator. Seeded at boot from the
+   * hardware RNG; set over SysEx to replay a random performance.
+   */
+  void set_random_seed(uint32_t seed) override;
 };
 
 } // namespace drum
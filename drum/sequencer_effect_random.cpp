@@ -2,7 +2,6 @@
 #include "config.h"
 #include "pico/time.h"
 #include <algorithm>
-#include <cstdlib>
 
 namespace drum {
 
@@ -13,6 +12,38 @@ SequencerEffectRandom::SequencerEffectRandom() {
   }
 }
 
+void SequencerEffectRandom::seed(uint32_t seed) {
+  rng_.seed(seed);
+  bar_drawn_ = false;
+}
+
+void SequencerEffectRandom::begin_step(uint32_t bar_step) {
+  bar_step_ = static_cast<uint8_t>(bar_step % BAR_STEPS);
+  // A batch is also drawn mid-bar after (re)activation or reseeding.
+  if (random_offset_mode_active_ && (bar_step_ == 0 || !bar_drawn_)) {
+    draw_bar();
+  }
+}
+
+bool SequencerEffectRandom::is_step_flipped(size_t track_idx) const {
+  if (!random_probability_active_ || track_idx >= MAX_TRACKS) {
+    return false;
+  }
+  return (bar_flips_ >> (track_idx * BAR_STEPS + bar_step_)) & 1u;
+}
+
+void SequencerEffectRandom::draw_bar() {
+  for (auto &track_offsets : bar_offsets_) {
+    for (size_t i = 0; i < BAR_STEPS; i += 2) {
+      const uint32_t value = rng_.next();
+      track_offsets[i] = static_cast<uint16_t>(value);
+      track_offsets[i + 1] = static_cast<uint16_t>(value >> 16);
+    }
+  }
+  bar_flips_ = rng_.next();
+  bar_drawn_ = true;
+}
+
 SequencerEffectRandom::RandomizedStep
 SequencerEffectRandom::calculate_randomized_step(size_t base_step_index,
                                                  size_t track_idx,
@@ -32,7 +63,8 @@ SequencerEffectRandom::calculate_randomized_step(size_t base_step_index,
           random_offsets_per_track_[track_idx]
                                    [current_offset_index_per_track_[track_idx]];
     } else {
-      offset = calculate_offset(num_steps);
+      // Scale the 16-bit draw into [0, num_steps).
+      offset = (bar_offsets_[track_idx][bar_step_] * num_steps) >> 16;
     }
 
     result.effective_step_index = (base_step_index + offset) % num_steps;
@@ -66,6 +98,9 @@ bool SequencerEffectRandom::is_probability_mode_enabled() const {
 void SequencerEffectRandom::enable_offset_mode(bool enabled) {
   // Internal toggle; does not modify current_state_. Also clears probability
   // when disabling.
+  if (enabled && !random_offset_mode_active_) {
+    bar_drawn_ = false; // Fresh values for the rest of the bar
+  }
   random_offset_mode_active_ = enabled;
   if (!enabled) {
     random_probability_active_ = false;
@@ -122,9 +157,8 @@ void SequencerEffectRandom::trigger_step_highlighting(size_t num_steps,
                                                       size_t num_tracks) {
   const size_t tracks_to_highlight = std::min(num_tracks, MAX_TRACKS);
   for (size_t track_idx = 0; track_idx < tracks_to_highlight; ++track_idx) {
-    uint32_t random_value = rand();
-    size_t random_step_index = random_value % num_steps;
-    highlighted_random_steps_[track_idx] = random_step_index;
+    highlighted_random_steps_[track_idx] =
+        rng_.next_below(static_cast<uint32_t>(num_steps));
   }
 }
 
@@ -141,14 +175,6 @@ void SequencerEffectRandom::stop_step_highlighting() {
   }
 }
 
-size_t SequencerEffectRandom::calculate_offset(size_t num_steps) {
-  if (num_steps == 0) {
-    return 0;
-  }
-
-  return rand() % num_steps;
-}
-
 etl::array<size_t, SequencerEffectRandom::MAX_OFFSETS_PER_TRACK>
 SequencerEffectRandom::generate_repeat_offsets(size_t num_steps) {
   etl::array<size_t, MAX_OFFSETS_PER_TRACK> offsets{};
@@ -158,7 +184,7 @@ SequencerEffectRandom::generate_repeat_offsets(size_t num_steps) {
   }
 
   for (size_t i = 0; i < MAX_OFFSETS_PER_TRACK; ++i) {
-    offsets[i] = rand() % num_steps;
+    offsets[i] = rng_.next_below(static_cast<uint32_t>(num_steps));
   }
 
   return offsets;
@@ -2,6 +2,7 @@
 #define DRUM_SEQUENCER_EFFECT_RANDOM_H
 
 #include "etl/array.h"
+#include "sequencer_rng.h"
 #include <array>
 #include <cstddef>
 #include <cstdint>
@@ -25,6 +26,11 @@ enum class RandomEffectState {
  * offsets and additionally flips each step's enabled state with 50%
  * probability at play time (OffsetWithFlip). While stopped, pressing
  * previews randomly chosen steps instead (StepPreview).
+ *
+ * All randomness comes from an owned, seedable SequencerRng. The per-step
+ * offsets and flips are drawn as one batch at each bar line (see
+ * begin_step()), so playing a step costs no generator calls and a given seed
+ * replays the same bars.
  */
 class SequencerEffectRandom {
 public:
@@ -33,8 +39,29 @@ public:
     bool probability_flip_applied;
   };
 
+  // Steps covered by one batch of draws.
+  static constexpr size_t BAR_STEPS = 8;
+
   SequencerEffectRandom();
 
+  /**
+   * @brief Reseed the generator, e.g. to replay a random performance.
+   */
+  void seed(uint32_t seed);
+
+  /**
+   * @brief Advance to a scheduled step. Call once per step before querying
+   * it; draws the next batch when a bar starts.
+   * @param bar_step Step count since the transport started.
+   */
+  void begin_step(uint32_t bar_step);
+
+  /**
+   * @brief Whether hard-press probability mode flips the current step of a
+   * track.
+   */
+  [[nodiscard]] bool is_step_flipped(size_t track_idx) const;
+
   RandomizedStep calculate_randomized_step(size_t base_step_index,
                                            size_t track_idx, size_t num_steps,
                                            bool repeat_active) const;
@@ -63,10 +90,12 @@ public:
 private:
   static constexpr size_t MAX_TRACKS = 4;
   static constexpr size_t MAX_OFFSETS_PER_TRACK = 3;
+  static_assert(BAR_STEPS * MAX_TRACKS <= 32,
+                "A bar's flip bits must fit in one 32-bit draw");
 
-  static size_t calculate_offset(size_t num_steps);
-  static etl::array<size_t, MAX_OFFSETS_PER_TRACK>
+  etl::array<size_t, MAX_OFFSETS_PER_TRACK>
   generate_repeat_offsets(size_t num_steps);
+  void draw_bar();
 
   // Internal helpers
   void enable_probability_mode(bool enabled);
@@ -86,6 +115,14 @@ private:
   std::array<size_t, MAX_TRACKS> highlighted_random_steps_{};
   bool random_steps_highlighted_{false};
   size_t saved_current_step_{0};
+
+  SequencerRng rng_;
+  // Current bar's draws: a 16-bit fraction of the track length per step, and
+  // one flip bit per step and track.
+  std::array<etl::array<uint16_t, BAR_STEPS>, MAX_TRACKS> bar_offsets_{};
+  uint32_t bar_flips_{0};
+  uint8_t bar_step_{0};
+  bool bar_drawn_{false};
 };
 
 } // namespace drum
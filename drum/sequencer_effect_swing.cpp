@@ -53,6 +53,14 @@ SequencerEffectSwing::StepTiming SequencerEffectSwing::calculate_step_timing(
   return {expected_phase, substep_mask, is_delay_applied};
 }
 
+uint8_t
+SequencerEffectSwing::step_length_ticks(uint64_t transport_step) const {
+  const bool is_even = (transport_step & 1u) == 0;
+  const uint8_t onset = onset_phase_for_parity(is_even);
+  const uint8_t next_onset = onset_phase_for_parity(!is_even);
+  return static_cast<uint8_t>((next_onset + PPQN - onset) % PPQN);
+}
+
 SequencerEffectSwing::HitZone
 SequencerEffectSwing::classify_hit_phase(uint8_t phase_12) const {
   // Zone masks anchored at phase 0: Early covers the ticks at and just after
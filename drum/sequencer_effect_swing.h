@@ -61,6 +61,14 @@ public:
                                                  bool repeat_active,
                                                  uint64_t transport_step) const;
 
+  /**
+   * @brief Ticks from a step's (swung) onset to the next step's onset.
+   * @param transport_step Transport step counter of the step, for parity
+   * @return TICKS_PER_STEP when straight; with swing, a delayed step is
+   * shorter and the step before it longer by SWING_OFFSET_PHASES
+   */
+  [[nodiscard]] uint8_t step_length_ticks(uint64_t transport_step) const;
+
   /**
    * @brief Enable or disable swing timing.
    * @param enabled true to enable swing, false for straight timing
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "etl/array.h"
+#include <cstddef>
 #include <cstdint>
 
 namespace drum {
@@ -10,24 +11,28 @@ namespace drum {
 /**
  * @brief Data structure for persisting sequencer state to flash storage.
  *
- * Contains all necessary state to restore the main sequencer at boot:
- * - Per-step velocities (0 = disabled)
+ * Contains all necessary state to restore the sequencer at boot:
+ * - Per-step velocities of the active pattern's first page (0 = disabled)
  * - Active MIDI note numbers for each track (used for all enabled steps)
+ * - Pattern bank selection and chain
  *
- * Only the main sequencer is saved - variation and random sequencers
- * are generated on-the-fly and don't need persistence.
+ * In the state file this header is followed by the pattern bank body (see
+ * SequencerStorage), which holds every pattern at its full length. The
+ * `tracks` snapshot is what SysEx state transfer exchanges.
  */
 struct SequencerPersistentState {
   // File format version and validation
   static constexpr uint32_t MAGIC_NUMBER = 0x53455143; // 'SEQC'
   // v2 drops per-step notes; relies on per-track active note.
-  static constexpr uint8_t FORMAT_VERSION = 2;
+  // v3 appends pattern bank fields; a pattern bank body follows the header.
+  static constexpr uint8_t FORMAT_VERSION = 3;
+  static constexpr uint8_t LEGACY_FORMAT_VERSION = 2;
 
   uint32_t magic;
   uint8_t version;
   uint8_t reserved[3]; // Padding for alignment
 
-  // Sequencer pattern data - main sequencer only
+  // Sequencer pattern data - first page of the active pattern
   struct TrackData {
     // Only store velocity per step; 0 means disabled.
     etl::array<uint8_t, config::NUM_STEPS_PER_TRACK> velocities;
@@ -37,8 +42,16 @@ struct SequencerPersistentState {
   // Active note assignments per track (for drumpad triggering)
   etl::array<uint8_t, config::NUM_TRACKS> active_notes;
 
+  // Everything above is laid out exactly as in v2 files.
+  uint8_t active_pattern;
+  uint8_t song_mode;
+  uint8_t chain_length;
+  uint8_t reserved_v3;
+  etl::array<uint8_t, config::MAX_PATTERN_CHAIN_LENGTH> chain;
+
   SequencerPersistentState()
-      : magic(MAGIC_NUMBER), version(FORMAT_VERSION), reserved{} {
+      : magic(MAGIC_NUMBER), version(FORMAT_VERSION), reserved{},
+        active_pattern(0), song_mode(0), chain_length(0), reserved_v3(0) {
     // Initialize active notes with first note from each track's range
     active_notes[0] = config::track_ranges[0]
                           .high_note; // Track 1: 37 Kick on old drumcomputers
@@ -51,6 +64,7 @@ struct SequencerPersistentState {
     for (auto &track : tracks) {
       track.velocities.fill(0);
     }
+    chain.fill(0);
   }
 
   /**
@@ -58,10 +72,23 @@ struct SequencerPersistentState {
    * @return true if valid, false if corrupted or unsupported version
    */
   bool is_valid() const {
-    return magic == MAGIC_NUMBER && version == FORMAT_VERSION;
+    return magic == MAGIC_NUMBER && version >= LEGACY_FORMAT_VERSION &&
+           version <= FORMAT_VERSION;
+  }
+
+  /**
+   * @brief Whether this state was loaded from a v2 file, which carries a
+   * single 8-step pattern and no pattern bank.
+   */
+  bool is_legacy() const {
+    return version == LEGACY_FORMAT_VERSION;
   }
 };
 
+// Size of the v2 layout, which v3 extends in place.
+constexpr size_t SEQUENCER_LEGACY_STATE_SIZE =
+    offsetof(SequencerPersistentState, active_pattern);
+
 // Compile-time size check to ensure we're not too large
 static_assert(sizeof(SequencerPersistentState) < 512,
               "SequencerPersistentState too large for efficient flash storage");
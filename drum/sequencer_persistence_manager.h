@@ -68,6 +68,24 @@ public:
     return storage_->load_state_from_flash(state);
   }
 
+  template <typename PatternBank>
+  bool save(const SequencerPersistentState &state, const PatternBank &bank) {
+    if (!storage_.has_value()) {
+      logger_.error("Save to flash failed - persistence not initialized");
+      return false;
+    }
+    return storage_->save_state_to_flash(state, bank);
+  }
+
+  template <typename PatternBank>
+  bool load(SequencerPersistentState &state, PatternBank &bank) {
+    if (!storage_.has_value()) {
+      logger_.error("Load from flash failed - persistence not initialized");
+      return false;
+    }
+    return storage_->load_state_from_flash(state, bank);
+  }
+
 private:
   std::optional<SequencerStorage<NumTracks, NumSteps>> storage_;
   musin::Logger &logger_;
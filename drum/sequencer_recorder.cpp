@@ -0,0 +1,57 @@
+#include "sequencer_recorder.h"
+#include <algorithm>
+
+namespace drum {
+
+void SequencerRecorder::set_enabled(bool enabled) {
+  enabled_ = enabled;
+}
+
+bool SequencerRecorder::is_enabled() const {
+  return enabled_;
+}
+
+void SequencerRecorder::set_quantize_strength(uint8_t percent) {
+  quantize_strength_ = std::min<uint8_t>(percent, 100);
+}
+
+uint8_t SequencerRecorder::get_quantize_strength() const {
+  return quantize_strength_;
+}
+
+SequencerRecorder::CapturedHit
+SequencerRecorder::capture(uint32_t us_since_step_onset,
+                           uint32_t tick_interval_us,
+                           uint8_t step_ticks) const {
+  if (tick_interval_us == 0 || step_ticks == 0) {
+    return {false, 0};
+  }
+  const int32_t step_units = step_ticks * UNITS_PER_TICK;
+
+  // A hit can't be later than one step after the onset it is measured
+  // from; the next onset would have been taken as reference instead.
+  const uint64_t raw_units =
+      static_cast<uint64_t>(us_since_step_onset) * UNITS_PER_TICK /
+      tick_interval_us;
+  int32_t units =
+      static_cast<int32_t>(std::min<uint64_t>(raw_units, step_units - 1));
+
+  const bool on_next_step = units >= step_units / 2;
+  if (on_next_step) {
+    units -= step_units;
+  }
+
+  const int32_t offset = units * (100 - quantize_strength_) / 100;
+  return {on_next_step, static_cast<int8_t>(offset)};
+}
+
+uint32_t SequencerRecorder::units_to_us(int32_t units,
+                                        uint32_t tick_interval_us) {
+  if (units <= 0) {
+    return 0;
+  }
+  return static_cast<uint32_t>(static_cast<uint64_t>(units) *
+                               tick_interval_us / UNITS_PER_TICK);
+}
+
+} // namespace drum
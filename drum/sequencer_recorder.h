@@ -0,0 +1,73 @@
+#ifndef DRUM_SEQUENCER_RECORDER_H
+#define DRUM_SEQUENCER_RECORDER_H
+
+#include <cstdint>
+
+namespace drum {
+
+/**
+ * @brief Live recording policy: maps the moment of a hit to a step and a
+ * micro-timing offset.
+ *
+ * Offsets are stored per step in units of 1/UNITS_PER_TICK of a 12 PPQN clock
+ * tick, measured from the step's (swung) onset. A hit in the first half of a
+ * step records onto that step with a positive offset; a hit in the second
+ * half anticipates the next step and records onto it with a negative offset,
+ * measured back from the next onset. Swing makes steps alternately longer
+ * and shorter than TICKS_PER_STEP, so the caller passes the length of the
+ * step being played; MIN_OFFSET and MAX_OFFSET are the straight-step range.
+ * Quantize strength pulls the offset towards the grid: 0% keeps the played
+ * timing, 100% snaps onto the step.
+ */
+class SequencerRecorder {
+public:
+  static constexpr int32_t TICKS_PER_STEP = 6;
+  static constexpr int32_t UNITS_PER_TICK = 8;
+  static constexpr int32_t UNITS_PER_STEP = TICKS_PER_STEP * UNITS_PER_TICK;
+  static constexpr int32_t MIN_OFFSET = -UNITS_PER_STEP / 2;
+  static constexpr int32_t MAX_OFFSET = UNITS_PER_STEP / 2 - 1;
+
+  /**
+   * @brief Where a hit lands in the pattern.
+   */
+  struct CapturedHit {
+    bool on_next_step;   // True if the hit anticipates the upcoming step
+    int8_t micro_offset; // Quantized offset from that step's onset
+  };
+
+  void set_enabled(bool enabled);
+  [[nodiscard]] bool is_enabled() const;
+
+  /**
+   * @brief Set the quantize strength.
+   * @param percent 0-100; larger values are clamped to 100.
+   */
+  void set_quantize_strength(uint8_t percent);
+  [[nodiscard]] uint8_t get_quantize_strength() const;
+
+  /**
+   * @brief Place a hit relative to the step that is currently playing.
+   * @param us_since_step_onset Time since the current step's onset
+   * @param tick_interval_us Current 12 PPQN tick length; 0 if unknown, in
+   * which case the hit is placed on the current step's grid position
+   * @param step_ticks Ticks from the current step's onset to the next one
+   */
+  [[nodiscard]] CapturedHit
+  capture(uint32_t us_since_step_onset, uint32_t tick_interval_us,
+          uint8_t step_ticks = TICKS_PER_STEP) const;
+
+  /**
+   * @brief Convert a non-negative micro-timing distance to microseconds at
+   * the current tempo.
+   */
+  [[nodiscard]] static uint32_t units_to_us(int32_t units,
+                                            uint32_t tick_interval_us);
+
+private:
+  bool enabled_{false};
+  uint8_t quantize_strength_{0};
+};
+
+} // namespace drum
+
+#endif // DRUM_SEQUENCER_RECORDER_H
@@ -0,0 +1,53 @@
+#ifndef DRUM_SEQUENCER_RNG_H
+#define DRUM_SEQUENCER_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace drum {
+
+/**
+ * @brief Small deterministic pseudo-random generator (xorshift32) for the
+ * sequencer's random effects.
+ *
+ * Unlike libc rand() it has no hidden global state, so a given seed always
+ * reproduces the same sequence, on the device and in host tests.
+ */
+class SequencerRng {
+public:
+  // xorshift has an all-zero fixed point; a zero seed is replaced by this.
+  static constexpr uint32_t DEFAULT_SEED = 0x2545F491u;
+
+  constexpr SequencerRng() = default;
+  constexpr explicit SequencerRng(uint32_t seed) {
+    this->seed(seed);
+  }
+
+  constexpr void seed(uint32_t seed) {
+    state_ = seed != 0 ? seed : DEFAULT_SEED;
+  }
+
+  constexpr uint32_t next() {
+    uint32_t x = state_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state_ = x;
+    return x;
+  }
+
+  /**
+   * @brief Uniform value in [0, bound); 0 if bound is 0.
+   */
+  constexpr uint32_t next_below(uint32_t bound) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >>
+                                 32);
+  }
+
+private:
+  uint32_t state_ = DEFAULT_SEED;
+};
+
+} // namespace drum
+
+#endif // DRUM_SEQUENCER_RNG_H
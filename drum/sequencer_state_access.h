@@ -2,6 +2,7 @@
 #define DRUM_SEQUENCER_STATE_ACCESS_H
 
 #include "drum/sequencer_persistence.h"
+#include "etl/span.h"
 
 namespace drum {
 
@@ -29,6 +30,19 @@ public:
    * @return true if state was applied successfully, false on error.
    */
   virtual bool apply_state(const SequencerPersistentState &state) = 0;
+
+  /**
+   * @brief Reseeds the generator behind the sequencer's random effects.
+   * @param seed Any value; the same seed replays the same random sequence.
+   */
+  virtual void set_random_seed(uint32_t seed) = 0;
+
+  /**
+   * @brief Sets the chain of patterns played in song mode.
+   * @return false, leaving the chain as it was, if an entry is not a pattern
+   * index or the chain is too long.
+   */
+  virtual bool set_pattern_chain(etl::span<const uint8_t> chain) = 0;
 };
 
 } // namespace drum
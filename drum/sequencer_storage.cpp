@@ -59,10 +59,10 @@ bool SequencerStorage<NumTracks, NumSteps>::save_to_file(
     return false;
   }
 
-  size_t written = fwrite(&state, sizeof(SequencerPersistentState), 1, file);
+  const bool written = write_header(file, state);
   fclose(file);
 
-  return written == 1;
+  return written;
 }
 
 template <size_t NumTracks, size_t NumSteps>
@@ -73,14 +73,42 @@ bool SequencerStorage<NumTracks, NumSteps>::load_from_file(
     return false; // File doesn't exist, not an error
   }
 
-  size_t read_size = fread(&state, sizeof(SequencerPersistentState), 1, file);
+  const bool valid = read_header(file, state);
   fclose(file);
 
-  if (read_size != 1 || !state.is_valid()) {
+  return valid;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerStorage<NumTracks, NumSteps>::write_header(
+    FILE *file, const SequencerPersistentState &state) {
+  return fwrite(&state, sizeof(SequencerPersistentState), 1, file) == 1;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+bool SequencerStorage<NumTracks, NumSteps>::read_header(
+    FILE *file, SequencerPersistentState &state) {
+  // Read the v2-compatible prefix first, then the v3 extension only if the
+  // file claims to have one.
+  auto *bytes = reinterpret_cast<uint8_t *>(&state);
+  if (fread(bytes, SEQUENCER_LEGACY_STATE_SIZE, 1, file) != 1 ||
+      !state.is_valid()) {
     return false; // Corrupted or invalid file
   }
 
-  return true;
+  if (state.is_legacy()) {
+    const SequencerPersistentState defaults;
+    state.active_pattern = defaults.active_pattern;
+    state.song_mode = defaults.song_mode;
+    state.chain_length = defaults.chain_length;
+    state.reserved_v3 = defaults.reserved_v3;
+    state.chain = defaults.chain;
+    return true;
+  }
+
+  return fread(bytes + SEQUENCER_LEGACY_STATE_SIZE,
+               sizeof(SequencerPersistentState) - SEQUENCER_LEGACY_STATE_SIZE,
+               1, file) == 1;
 }
 
 // Explicit template instantiation for 4 tracks, 8 steps
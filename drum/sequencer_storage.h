@@ -2,9 +2,11 @@
 #define DRUM_SEQUENCER_STORAGE_H
 
 #include "config.h"
+#include "musin/timing/step_sequencer.h"
 #include "save_timing_manager.h"
 #include "sequencer_persistence.h"
 #include <cstdint>
+#include <cstdio>
 
 namespace drum {
 
@@ -14,6 +16,15 @@ namespace drum {
  * This class composes SaveTimingManager (for timing logic)
  * to provide a testable, modular architecture following SOLID principles.
  * The file I/O operations are handled internally.
+ *
+ * File layout: a SequencerPersistentState header, optionally followed by a
+ * pattern bank body:
+ *   [pattern count][tracks per pattern][max steps per track][step size]
+ *   then per pattern, per track: [length][max steps x step]
+ *                                [lock count][lock count x (step, locks)]
+ * Every step of a track is written, including those past its length, since
+ * shortening a track keeps them. A body whose layout does not match this
+ * build is rejected.
  */
 template <size_t NumTracks, size_t NumSteps> class SequencerStorage {
 public:
@@ -37,6 +48,28 @@ public:
    */
   bool load_state_from_flash(SequencerPersistentState &state);
 
+  /**
+   * @brief Save sequencer state followed by the full pattern bank.
+   * @param state The header state to save
+   * @param bank The pattern bank (musin::timing::PatternBank) to save
+   * @return true if save was successful, false otherwise
+   */
+  template <typename PatternBank>
+  bool save_state_to_flash(const SequencerPersistentState &state,
+                           const PatternBank &bank);
+
+  /**
+   * @brief Load sequencer state and, for current-format files, the pattern
+   * bank. A legacy (v2) file loads the header only, leaving the bank
+   * untouched; check state.is_legacy() to migrate its single pattern.
+   * @param state Output parameter to receive the loaded state
+   * @param bank Output parameter to receive the loaded patterns
+   * @return true if load was successful, false otherwise
+   */
+  template <typename PatternBank>
+  bool load_state_from_flash(SequencerPersistentState &state,
+                             PatternBank &bank);
+
   /**
    * @brief Mark the sequencer state as dirty (needs saving).
    * This starts the debounce timer for automatic persistence.
@@ -70,6 +103,16 @@ private:
   bool save_to_file(const char *filepath,
                     const SequencerPersistentState &state);
   bool load_from_file(const char *filepath, SequencerPersistentState &state);
+  static bool write_header(FILE *file, const SequencerPersistentState &state);
+  static bool read_header(FILE *file, SequencerPersistentState &state);
+
+  template <typename PatternBank>
+  static bool write_bank(FILE *file, const PatternBank &bank);
+  template <typename PatternBank>
+  static bool read_bank(FILE *file, PatternBank &bank);
+  template <typename Track>
+  static bool read_track(FILE *file, Track &track, size_t stored_steps);
+  template <typename Track> static bool read_locks(FILE *file, Track &track);
 
   // Composed architecture - testable components with dependency injection
   PicoTimeSource pico_time_;
@@ -77,6 +120,176 @@ private:
   const char *state_path_;
 };
 
+template <size_t NumTracks, size_t NumSteps>
+template <typename PatternBank>
+bool SequencerStorage<NumTracks, NumSteps>::save_state_to_flash(
+    const SequencerPersistentState &state, const PatternBank &bank) {
+  FILE *file = fopen(state_path_, "wb");
+  if (!file) {
+    return false;
+  }
+  const bool success = write_header(file, state) && write_bank(file, bank);
+  fclose(file);
+
+  if (success) {
+    timing_manager_.mark_clean();
+  }
+  return success;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+template <typename PatternBank>
+bool SequencerStorage<NumTracks, NumSteps>::load_state_from_flash(
+    SequencerPersistentState &state, PatternBank &bank) {
+  FILE *file = fopen(state_path_, "rb");
+  if (!file) {
+    return false; // File doesn't exist, not an error
+  }
+  bool success = read_header(file, state);
+  if (success && !state.is_legacy()) {
+    success = read_bank(file, bank);
+  }
+  fclose(file);
+
+  if (success) {
+    timing_manager_.mark_clean();
+  }
+  return success;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+template <typename PatternBank>
+bool SequencerStorage<NumTracks, NumSteps>::write_bank(
+    FILE *file, const PatternBank &bank) {
+  using Pattern = typename PatternBank::Pattern;
+  const uint8_t layout[4] = {static_cast<uint8_t>(PatternBank::size()),
+                             static_cast<uint8_t>(NumTracks),
+                             static_cast<uint8_t>(Pattern::get_max_steps()),
+                             static_cast<uint8_t>(sizeof(musin::timing::Step))};
+  if (fwrite(layout, sizeof(layout), 1, file) != 1) {
+    return false;
+  }
+
+  for (size_t pattern_idx = 0; pattern_idx < PatternBank::size();
+       ++pattern_idx) {
+    const Pattern &pattern = bank.get_pattern(pattern_idx);
+    for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
+      const auto &track = pattern.get_track(track_idx);
+      // Steps and locks past the length are kept too: shortening a track
+      // does not discard them, so neither does saving it.
+      const uint8_t length = static_cast<uint8_t>(track.size());
+      const auto steps = track.get_steps();
+      if (fwrite(&length, 1, 1, file) != 1 ||
+          fwrite(steps.data(), sizeof(musin::timing::Step), steps.size(),
+                 file) != steps.size()) {
+        return false;
+      }
+      const auto locked_steps = track.get_locked_steps();
+      const uint8_t lock_count = static_cast<uint8_t>(locked_steps.size());
+      if (fwrite(&lock_count, 1, 1, file) != 1) {
+        return false;
+      }
+      for (const auto &entry : locked_steps) {
+        if (fwrite(&entry.step, 1, 1, file) != 1 ||
+            fwrite(entry.locks.values.data(), 1, entry.locks.values.size(),
+                   file) != entry.locks.values.size()) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+template <typename PatternBank>
+bool SequencerStorage<NumTracks, NumSteps>::read_bank(FILE *file,
+                                                      PatternBank &bank) {
+  using Pattern = typename PatternBank::Pattern;
+  uint8_t layout[4] = {};
+  if (fread(layout, sizeof(layout), 1, file) != 1) {
+    // A header saved without a bank body leaves the bank untouched.
+    return feof(file) &&
+           ftell(file) == static_cast<long>(sizeof(SequencerPersistentState));
+  }
+  const size_t stored_patterns = layout[0];
+  const size_t stored_steps = layout[2];
+  if (layout[1] != NumTracks || stored_steps > Pattern::get_max_steps() ||
+      layout[3] != sizeof(musin::timing::Step)) {
+    return false; // Written by an incompatible build
+  }
+
+  // The first pass only decodes, so a truncated or corrupt body leaves the
+  // bank as it was; the second applies what the first has checked. Tracks
+  // are decoded into a copy, keeping the stack small.
+  const long body_start = ftell(file);
+  for (const bool apply : {false, true}) {
+    if (body_start < 0 || fseek(file, body_start, SEEK_SET) != 0) {
+      return false;
+    }
+    // Patterns beyond the bank size (from a larger build) are left unread.
+    for (size_t pattern_idx = 0;
+         pattern_idx < stored_patterns && pattern_idx < PatternBank::size();
+         ++pattern_idx) {
+      Pattern &pattern = bank.get_pattern(pattern_idx);
+      for (size_t track_idx = 0; track_idx < NumTracks; ++track_idx) {
+        auto decoded = pattern.get_track(track_idx);
+        if (!read_track(file, decoded, stored_steps)) {
+          return false;
+        }
+        if (apply) {
+          pattern.get_track(track_idx) = decoded;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+template <size_t NumTracks, size_t NumSteps>
+template <typename Track>
+bool SequencerStorage<NumTracks, NumSteps>::read_track(FILE *file,
+                                                       Track &track,
+                                                       size_t stored_steps) {
+  using musin::timing::Step;
+  uint8_t length = 0;
+  if (fread(&length, 1, 1, file) != 1 || length == 0 ||
+      length > Track::capacity()) {
+    return false;
+  }
+  etl::array<Step, Track::capacity()> steps{};
+  if (fread(steps.data(), sizeof(Step), stored_steps, file) != stored_steps) {
+    return false;
+  }
+  track.set_steps(etl::span<const Step>{steps.data(), stored_steps});
+  track.set_length(length);
+  return read_locks(file, track);
+}
+
+template <size_t NumTracks, size_t NumSteps>
+template <typename Track>
+bool SequencerStorage<NumTracks, NumSteps>::read_locks(FILE *file,
+                                                       Track &track) {
+  uint8_t lock_count = 0;
+  if (fread(&lock_count, 1, 1, file) != 1) {
+    return false;
+  }
+  for (size_t i = 0; i < lock_count; ++i) {
+    uint8_t step = 0;
+    musin::timing::ParamLocks locks;
+    if (fread(&step, 1, 1, file) != 1 ||
+        fread(locks.values.data(), 1, locks.values.size(), file) !=
+            locks.values.size()) {
+      return false;
+    }
+    // Entries beyond this build's pool or step range are dropped.
+    if (step < Track::capacity()) {
+      static_cast<void>(track.set_step_locks(step, locks));
+    }
+  }
+  return true;
+}
+
 } // namespace drum
 
 #endif // DRUM_SEQUENCER_STORAGE_H
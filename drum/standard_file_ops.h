@@ -4,11 +4,17 @@
 #include "etl/optional.h"
 #include "etl/span.h"
 #include "etl/string_view.h"
+#include "drum/config.h"
 #include "etl/utility.h"
 #include "musin/filesystem/filesystem.h"
+#include "musin/filesystem/staged_writer.h"
+#include "musin/flash/overlapped_sha256.h"
+#include "musin/flash/pico_sha256_engine.h"
 #include "musin/hal/logger.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 struct StandardFileOps {
   explicit StandardFileOps(musin::Logger &logger,
@@ -17,6 +23,16 @@ struct StandardFileOps {
   }
   static const unsigned BlockSize = 256;
 
+  // Written files are staged in RAM and written out a block at a time by
+  // service(), so a transfer does not hold up the main loop.
+  using Writer = musin::filesystem::StagedWriter<
+      musin::filesystem::StdioFile,
+      drum::config::sysex::WRITE_STAGING_BYTES, BlockSize>;
+
+  // Hashes stored files for StatFile, a block at a time
+  using Sha256 = musin::flash::OverlappedSha256<musin::flash::PicoSha256Engine,
+                                                BlockSize>;
+
   struct Handle {
     // Non-copyable but movable RAII wrapper for file handles
     Handle(const Handle &) = delete;
@@ -24,31 +40,28 @@ struct StandardFileOps {
 
     // Move constructor
     Handle(Handle &&other) noexcept
-        : logger(other.logger), file_pointer(other.file_pointer) {
-      other.file_pointer = nullptr; // Transfer ownership
+        : logger(other.logger), writer(other.writer), file_id(other.file_id) {
+      other.writer = nullptr; // Transfer ownership
     }
 
     // Move assignment operator
     Handle &operator=(Handle &&other) noexcept {
       if (this != &other) {
         close(); // Close current file if any
-        file_pointer = other.file_pointer;
-        other.file_pointer = nullptr; // Transfer ownership
+        writer = other.writer;
+        file_id = other.file_id;
+        other.writer = nullptr; // Transfer ownership
       }
       return *this;
     }
 
-    Handle(const etl::string_view &path, musin::Logger &logger)
-        : logger(logger) {
-      if (file_pointer) {
-        fclose(file_pointer);
-        // TODO: Report some error. This should not happen;
-      }
-
-      logger.info("Writing file:");
+    Handle(const etl::string_view &path, Writer &writer, musin::Logger &logger,
+           bool append = false)
+        : logger(logger), writer(&writer) {
+      logger.info(append ? "Appending to file:" : "Writing file:");
       logger.info(path);
-      file_pointer = fopen(path.data(), "wb");
-      if (!file_pointer) {
+      file_id = writer.open(path.data(), append);
+      if (file_id == 0) {
         logger.error("Failed opening file");
       }
     }
@@ -57,34 +70,40 @@ struct StandardFileOps {
       close();
     }
 
+    // The file is closed once its staged data has been written.
     void close() {
-      logger.info("Closing file!");
-      if (file_pointer) {
-        fflush(file_pointer);
-        fclose(file_pointer);
-        file_pointer = nullptr;
-      } else {
-        // TODO: Error closing a non-existent handle
+      if (writer) {
+        logger.info("Closing file!");
+        if (!writer->finish(file_id)) {
+          logger.error("Failed writing file");
+        }
+        writer = nullptr;
       }
-      return;
     }
 
     size_t write(const etl::span<const uint8_t> &bytes) {
-      // printf("Writing %i bytes\n", bytes.size());
-      if (file_pointer) {
-        const auto written =
-            fwrite(bytes.cbegin(), sizeof(uint8_t), bytes.size(), file_pointer);
-        // printf("written: %i\n", written);
-        return written;
-      } else {
-        // TODO: Error writing to a handle that should be exist.
+      if (!writer) {
         return 0;
       }
+      return writer->stage(file_id, bytes);
+    }
+
+    // Staging space to fill in place, then commit(); see
+    // StagedWriter::reserve(). Empty once the handle is closed or failed.
+    etl::span<uint8_t> reserve() {
+      return writer ? writer->reserve(file_id) : etl::span<uint8_t>{};
+    }
+
+    void commit(size_t count) {
+      if (writer) {
+        writer->commit(file_id, count);
+      }
     }
 
   private:
     musin::Logger &logger;
-    FILE *file_pointer = nullptr;
+    Writer *writer = nullptr;
+    uint32_t file_id = 0;
   };
 
   struct ReadHandle {
@@ -149,6 +168,10 @@ struct StandardFileOps {
   };
 
   etl::optional<ReadHandle> open_read(const etl::string_view &path) {
+    // Reads see everything written so far
+    if (!writer_.complete()) {
+      logger.error("Failed writing file");
+    }
     logger.info("Opening file for reading:");
     logger.info(path);
     ReadHandle handle(path);
@@ -161,15 +184,67 @@ struct StandardFileOps {
 
   // Handle should close upon destruction
   // TODO: Return optional instead, if handle could not be opened.
-  Handle open(const etl::string_view &path) {
+  Handle open(const etl::string_view &path, bool append = false) {
     // TODO: Use actual path
     // const char *path = "/tmp_sample";
     logger.info("Opening new file:");
     logger.info(path);
-    return Handle(path, logger);
+    return Handle(path, writer_, logger, append);
+  }
+
+  // Path operations complete any staged write first, so a file is never
+  // renamed or removed with data still to be written to it.
+
+  /** @brief Moves @p from to @p to, replacing any file already there. */
+  bool rename_path(const char *from, const char *to) {
+    writer_.complete();
+    return ::rename(from, to) == 0;
+  }
+
+  /** @brief Removes a file or an empty directory. */
+  bool remove_path(const char *path) {
+    writer_.complete();
+    return ::remove(path) == 0;
+  }
+
+  /** @brief Creates a directory; one that already exists counts as made. */
+  bool make_directory(const char *path) {
+    writer_.complete();
+    return mkdir(path, 0777) == 0 || errno == EEXIST;
+  }
+
+  /**
+   * @brief Writes staged data to flash until @p budget_us has passed.
+   * Called once per main loop pass.
+   */
+  void service(uint32_t budget_us) {
+    writer_.service(budget_us);
+  }
+
+  /** @brief A closed file still has staged data to write. */
+  bool finishing_write() const {
+    return writer_.finishing();
+  }
+
+  /** @brief A write to the last file opened has failed. */
+  bool write_failed() const {
+    return writer_.failed();
+  }
+
+  /**
+   * @brief Writes everything staged now rather than over later loop passes.
+   * @return false if a write failed.
+   */
+  bool complete_write() {
+    return writer_.complete();
+  }
+
+  const Writer &writer() const {
+    return writer_;
   }
 
   bool format() {
+    writer_.complete();
     logger.info("Formatting filesystem...");
     bool success = filesystem_.format();
     if (success) {
@@ -183,6 +258,7 @@ struct StandardFileOps {
 private:
   musin::Logger &logger;
   musin::filesystem::Filesystem &filesystem_;
+  Writer writer_;
 };
 
 #endif /* end of include guard: PRINTING_FILE_OPS_H_CVXHHJDO */
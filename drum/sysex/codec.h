@@ -71,6 +71,26 @@ etl::pair<size_t, size_t> decode_8_to_7(InputIt start, InputIt end,
   return {bytes_read, bytes_written};
 }
 
+// Encodes raw bytes as 8-byte SysEx-safe groups, the inverse of
+// decode_8_to_7: seven 7-bit data bytes, then their MSBs (bit i for byte i).
+// A final partial group is padded with zeros. Returns the number of bytes
+// written, 8 per started group.
+template <typename InputIt, typename OutputIt>
+size_t encode_8_to_7(InputIt start, InputIt end, OutputIt output) {
+  size_t bytes_written = 0;
+  while (start != end) {
+    uint8_t msbs = 0;
+    for (size_t i = 0; i < 7; ++i) {
+      const uint8_t byte = (start != end) ? static_cast<uint8_t>(*start++) : 0;
+      *output++ = byte & 0x7F;
+      msbs |= static_cast<uint8_t>((byte >> 7) << i);
+    }
+    *output++ = msbs;
+    bytes_written += 8;
+  }
+  return bytes_written;
+}
+
 } // namespace sysex::codec
 
 #endif /* end of include guard: SYSEX_CODEC_H_JDGZXSHN */
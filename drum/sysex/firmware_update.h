@@ -18,16 +18,19 @@ namespace sysex {
 
 // State machine for firmware transfer to the inactive A/B partition.
 //
-// The Writer dependency receives the raw UF2 byte stream and owns parsing,
+// The Writer dependency receives the raw image stream and owns parsing,
 // flash programming and SHA-256 verification:
-//   bool begin(uint32_t total_size, etl::span<const uint8_t> sha256);
+//   bool begin(uint32_t total_size, etl::span<const uint8_t> sha256,
+//              uint8_t format);
 //   bool write(etl::span<const uint8_t> bytes);
 //   bool finalize();
 //   void abort();
 template <typename Writer> struct FirmwareUpdate {
   static constexpr uint64_t TIMEOUT_US = 5000000; // 5 seconds
   static constexpr size_t SHA256_SIZE = 32;
-  // total size (4 bytes) + SHA-256 + version major/minor/patch
+  // total size (4 bytes) + SHA-256 + version major/minor/patch, optionally
+  // followed by the image format (0 = UF2, 1 = compact container). Older
+  // hosts leave the format byte as the encoding's zero padding.
   static constexpr size_t BEGIN_PAYLOAD_SIZE = 4 + SHA256_SIZE + 3;
 
   enum Tag {
@@ -164,8 +167,10 @@ private:
                                 (static_cast<uint32_t>(bytes[2]) << 16) |
                                 (static_cast<uint32_t>(bytes[3]) << 24);
     const auto sha256 = etl::span<const uint8_t>{bytes.data() + 4, SHA256_SIZE};
+    const uint8_t format =
+        byte_count > BEGIN_PAYLOAD_SIZE ? bytes[BEGIN_PAYLOAD_SIZE] : 0;
 
-    if (total_size == 0 || !writer_.begin(total_size, sha256)) {
+    if (total_size == 0 || !writer_.begin(total_size, sha256, format)) {
       logger_.error("SysEx: BeginFirmwareUpdate rejected by writer");
       send_reply(Tag::Nack);
       return Result::WriteError;
@@ -0,0 +1,647 @@
+#ifndef SYSEX_KIT_TRANSFER_H_R7NW3CZA
+#define SYSEX_KIT_TRANSFER_H_R7NW3CZA
+
+#include "drum/config.h"
+#include "etl/algorithm.h"
+#include "etl/array.h"
+#include "etl/crc32.h"
+#include "etl/optional.h"
+#include "etl/span.h"
+
+#include <cstdio>
+
+extern "C" {
+#include "pico/time.h"
+}
+
+#include "musin/hal/logger.h"
+
+#include "./codec.h"
+#include "musin/midi/sysex_chunk.h"
+
+namespace sysex {
+
+// Installs a whole kit (the sample files and /kit.bin) in one session rather
+// than one BeginFileWrite exchange per file.
+//
+// Files are written to a staging directory and only moved into place by
+// CommitKit, so a transfer that stops part way leaves the installed kit as
+// it was. The commit writes a marker before renaming anything; recover()
+// finishes an interrupted commit at boot, so a kit is never left half
+// swapped. Staged files outlive a dropped connection: beginning the same kit
+// again resumes each file from the bytes already staged.
+//
+// Message bodies are 8-to-7 encoded and little-endian unless noted:
+//   BeginKitTransfer  kit id (u32), file count (u8)
+//       Ack. Files staged by an earlier attempt with the same kit id and
+//       count are kept for resuming; anything else staged is discarded.
+//   KitFileEntry      index (u8), size (u32), CRC-32 (u32), name, NUL
+//       Sent for every file, in index order. Answered with KitFileStatus
+//       for that file: 0 for a new file, its size once it is staged and
+//       verified, or how far an earlier attempt got.
+//   KitFileBytes      index, offset (raw, not 8-to-7 encoded: one byte,
+//                     then five 7-bit groups LSB first), data
+//       Ack. Data at any offset other than the bytes staged so far is
+//       answered with KitFileStatus, so the host can pick up from there.
+//       The Ack for a file's last bytes waits until they are written (see
+//       service()). A file that completes with the wrong CRC-32, or that
+//       could not be written, is Nacked and starts over from offset 0.
+//   CommitKit         (no body)
+//       Ack once every file is in place, or KitFileStatus for the first
+//       file still incomplete.
+//   AbortKitTransfer  (no body)
+//       Discards the staged files. Ack.
+//
+// KitFileStatus payload: index, then the staged byte count as five 7-bit
+// groups, LSB first.
+//
+// Besides open_read(), FileOperations provides:
+//   Handle open(const etl::string_view &path, bool append);
+//   bool rename_path(const char *from, const char *to);
+//   bool remove_path(const char *path);
+//   bool make_directory(const char *path);
+//   bool finishing_write() const;
+//   bool write_failed() const;
+//   bool complete_write();
+template <typename FileOperations> struct KitTransfer {
+  static constexpr uint64_t TIMEOUT_US = 5000000; // 5 seconds
+  static constexpr size_t MAX_FILES = drum::config::sysex::MAX_KIT_FILES;
+  static constexpr size_t MAX_NAME_LENGTH =
+      drum::config::sysex::MAX_FILENAME_LENGTH;
+  static constexpr const char *STAGING_DIR = "/kit.new";
+  static constexpr const char *MANIFEST_PATH = "/kit.new/.manifest";
+  static constexpr const char *COMMIT_PATH = "/kit.new/.commit";
+  static constexpr size_t BEGIN_SIZE = 5;
+  static constexpr size_t ENTRY_HEADER_SIZE = 9;
+  static constexpr size_t BYTES_HEADER_SIZE = 6;
+
+  enum Tag {
+    BeginKitTransfer = 0x50,
+    KitFileEntry = 0x51,
+    KitFileBytes = 0x52,
+    CommitKit = 0x53,
+    AbortKitTransfer = 0x54,
+    KitFileStatus = 0x55,
+    Ack = 0x13,
+    Nack = 0x14,
+  };
+
+  enum class Result {
+    OK,
+    // Every file has been moved into place, also when Begin or Abort
+    // finishes the moves of a failed commit
+    KitCommitted,
+    NotKitTransfer,
+    InvalidContent,
+    FileError,
+    Aborted,
+  };
+
+  enum class State {
+    Idle,
+    Manifest,
+    Receiving,
+    Finishing, // A file's last bytes are being written; its Ack waits
+  };
+
+  constexpr KitTransfer(FileOperations &file_ops, musin::Logger &logger)
+      : file_ops_(file_ops), logger_(logger), last_activity_time_{} {
+  }
+
+  // Returns true for chunks this state machine should handle (correct
+  // manufacturer/device header and a kit transfer tag).
+  static constexpr bool claims(const Chunk &chunk) {
+    if (chunk.size() < 5) {
+      return false;
+    }
+    if (chunk[0] != drum::config::sysex::MANUFACTURER_ID_0 ||
+        chunk[1] != drum::config::sysex::MANUFACTURER_ID_1 ||
+        chunk[2] != drum::config::sysex::MANUFACTURER_ID_2 ||
+        chunk[3] != drum::config::sysex::DEVICE_ID) {
+      return false;
+    }
+    const uint8_t tag = chunk[4];
+    return tag >= Tag::BeginKitTransfer && tag <= Tag::AbortKitTransfer;
+  }
+
+  // Sender is called as send_reply(tag), or send_reply(tag, payload) for
+  // KitFileStatus.
+  template <typename Sender>
+  constexpr Result handle_chunk(const Chunk &chunk, Sender &&send_reply,
+                                absolute_time_t now) {
+    if (!claims(chunk)) {
+      return Result::NotKitTransfer;
+    }
+
+    const uint8_t tag = chunk[4];
+    const auto body =
+        etl::span<const uint8_t>{chunk.cbegin() + 5, chunk.cend()};
+    last_activity_time_ = now;
+
+    // Answer the last file first, writing the rest of it now
+    if (state_ == State::Finishing) {
+      file_ops_.complete_write();
+      finish_file(send_reply);
+    }
+
+    switch (tag) {
+    case Tag::BeginKitTransfer:
+      return handle_begin(body, send_reply);
+    case Tag::KitFileEntry:
+      return handle_entry(body, send_reply);
+    case Tag::KitFileBytes:
+      return handle_bytes(body, send_reply);
+    case Tag::CommitKit:
+      return handle_commit(send_reply);
+    case Tag::AbortKitTransfer:
+      return handle_abort(send_reply);
+    default:
+      return Result::NotKitTransfer;
+    }
+  }
+
+  // The staged files stay on flash, so the host can resume after a timeout.
+  constexpr bool check_timeout(absolute_time_t now) {
+    if (state_ != State::Idle &&
+        absolute_time_diff_us(last_activity_time_, now) >
+            static_cast<int64_t>(TIMEOUT_US)) {
+      logger_.warn("SysEx: Kit transfer timed out.");
+      file_.reset();
+      state_ = State::Idle;
+      return true;
+    }
+    return false;
+  }
+
+  // Acks a completed file once its staged data is written. Called once per
+  // main loop pass, after the file operations' own service().
+  template <typename Sender> constexpr void service(Sender &&send_reply) {
+    if (state_ == State::Finishing && !file_ops_.finishing_write()) {
+      finish_file(send_reply);
+    }
+  }
+
+  constexpr bool busy() const {
+    return state_ != State::Idle;
+  }
+
+  constexpr State get_state() const {
+    return state_;
+  }
+
+  // Finishes a commit that was interrupted after its marker was written.
+  // Call at boot, before the kit is loaded; a new transfer or an abort also
+  // finishes one left by a failed commit. Returns true if a commit was
+  // completed.
+  bool recover() {
+    if (!load_manifest(staged_) ||
+        !file_ops_.open_read(COMMIT_PATH).has_value()) {
+      return false;
+    }
+    logger_.warn("SysEx: Completing an interrupted kit commit.");
+    // Files moved before the interruption are no longer staged, so their
+    // renames fail harmlessly.
+    move_into_place(staged_);
+    clear_staging();
+    return true;
+  }
+
+private:
+  static constexpr uint32_t MANIFEST_MAGIC = 0x3154494B; // "KIT1"
+
+  struct Entry {
+    uint32_t size = 0;
+    uint32_t crc = 0;
+    etl::array<char, MAX_NAME_LENGTH> name{};
+
+    bool operator==(const Entry &other) const {
+      return size == other.size && crc == other.crc && name == other.name;
+    }
+  };
+
+  // Written to MANIFEST_PATH as-is once every entry has arrived
+  struct Manifest {
+    uint32_t magic = MANIFEST_MAGIC;
+    uint32_t kit_id = 0;
+    uint8_t count = 0;
+    etl::array<Entry, MAX_FILES> entries{};
+  };
+
+  static constexpr uint32_t read_u32(etl::span<const uint8_t> bytes,
+                                     size_t offset) {
+    return static_cast<uint32_t>(bytes[offset]) |
+           (static_cast<uint32_t>(bytes[offset + 1]) << 8) |
+           (static_cast<uint32_t>(bytes[offset + 2]) << 16) |
+           (static_cast<uint32_t>(bytes[offset + 3]) << 24);
+  }
+
+  // Decodes a short 8-to-7 body into decode_buffer_
+  constexpr etl::span<const uint8_t> decode(etl::span<const uint8_t> body) {
+    const auto result = codec::decode_8_to_7(
+        body.begin(), body.end(), decode_buffer_.begin(), decode_buffer_.end());
+    return etl::span<const uint8_t>{decode_buffer_.data(), result.second};
+  }
+
+  static bool staged_path(const Entry &entry,
+                          char (&path)[drum::config::MAX_PATH_LENGTH]) {
+    const int written = snprintf(path, sizeof(path), "%s/%s", STAGING_DIR,
+                                 entry.name.data());
+    return written > 0 && static_cast<size_t>(written) < sizeof(path);
+  }
+
+  static bool installed_path(const Entry &entry,
+                             char (&path)[drum::config::MAX_PATH_LENGTH]) {
+    const int written = snprintf(path, sizeof(path), "/%s", entry.name.data());
+    return written > 0 && static_cast<size_t>(written) < sizeof(path);
+  }
+
+  // A plain file name in the root directory. A leading '.' is refused so
+  // a name can neither climb out of the staging directory nor clash with
+  // the manifest and commit marker.
+  static constexpr bool valid_name(etl::span<const uint8_t> name) {
+    if (name.empty() || name.size() >= MAX_NAME_LENGTH || name[0] == '.') {
+      return false;
+    }
+    for (const uint8_t character : name) {
+      if (character == '/' || character < ' ' || character > '~') {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename Sender>
+  constexpr void send_status(Sender &send_reply, uint8_t index) {
+    const uint32_t staged = received_[index];
+    const etl::array<uint8_t, 6> payload{
+        index,
+        static_cast<uint8_t>(staged & 0x7F),
+        static_cast<uint8_t>((staged >> 7) & 0x7F),
+        static_cast<uint8_t>((staged >> 14) & 0x7F),
+        static_cast<uint8_t>((staged >> 21) & 0x7F),
+        static_cast<uint8_t>((staged >> 28) & 0x7F)};
+    send_reply(Tag::KitFileStatus,
+               etl::span<const uint8_t>{payload.data(), payload.size()});
+  }
+
+  template <typename Sender>
+  constexpr Result handle_begin(etl::span<const uint8_t> body,
+                                Sender &send_reply) {
+    if (state_ != State::Idle) {
+      logger_.warn("SysEx: BeginKitTransfer during a kit transfer; "
+                   "restarting.");
+      file_.reset();
+      state_ = State::Idle;
+    }
+
+    const auto bytes = decode(body);
+    if (bytes.size() < BEGIN_SIZE || bytes[4] == 0 || bytes[4] > MAX_FILES) {
+      logger_.error("SysEx: Invalid BeginKitTransfer");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+
+    // Once its marker exists a commit may have moved some files already;
+    // the installed kit is only whole again once the rest follow.
+    const bool recovered = recover();
+    manifest_ = Manifest{};
+    manifest_.kit_id = read_u32(bytes, 0);
+    manifest_.count = bytes[4];
+    resuming_ = load_manifest(staged_) &&
+                staged_.kit_id == manifest_.kit_id &&
+                staged_.count == manifest_.count;
+    if (resuming_) {
+      logger_.info("SysEx: Resuming kit transfer, files",
+                   static_cast<uint32_t>(manifest_.count));
+    } else {
+      clear_staging();
+      logger_.info("SysEx: Kit transfer started, files",
+                   static_cast<uint32_t>(manifest_.count));
+    }
+    if (!file_ops_.make_directory(STAGING_DIR)) {
+      logger_.error("SysEx: Could not create the kit staging directory");
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+
+    entries_received_ = 0;
+    received_.fill(0);
+    state_ = State::Manifest;
+    send_reply(Tag::Ack);
+    return recovered ? Result::KitCommitted : Result::OK;
+  }
+
+  template <typename Sender>
+  constexpr Result handle_entry(etl::span<const uint8_t> body,
+                                Sender &send_reply) {
+    if (state_ != State::Manifest) {
+      logger_.error("SysEx: KitFileEntry outside a kit manifest.");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+
+    const auto bytes = decode(body);
+    const auto name = bytes.size() > ENTRY_HEADER_SIZE
+                          ? bytes.subspan(ENTRY_HEADER_SIZE)
+                          : etl::span<const uint8_t>{};
+    const auto name_end = etl::find(name.begin(), name.end(), '\0');
+    const auto name_bytes = etl::span<const uint8_t>{name.begin(), name_end};
+    if (bytes.size() < ENTRY_HEADER_SIZE || bytes[0] != entries_received_ ||
+        name_end == name.end() || !valid_name(name_bytes)) {
+      logger_.error("SysEx: Invalid KitFileEntry");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+
+    const uint8_t index = bytes[0];
+    Entry &entry = manifest_.entries[index];
+    entry.size = read_u32(bytes, 1);
+    entry.crc = read_u32(bytes, 5);
+    etl::copy(name_bytes.begin(), name_bytes.end(), entry.name.begin());
+
+    crcs_[index].reset();
+    if (resuming_ && entry == staged_.entries[index]) {
+      received_[index] = measure_staged(index);
+    } else if (resuming_) {
+      // A different file at this index; drop what was staged for it
+      remove_staged(staged_.entries[index]);
+    }
+
+    if (++entries_received_ == manifest_.count) {
+      if (!save_manifest()) {
+        logger_.error("SysEx: Could not write the kit manifest");
+        state_ = State::Idle;
+        send_reply(Tag::Nack);
+        return Result::FileError;
+      }
+      state_ = State::Receiving;
+    }
+    send_status(send_reply, index);
+    return Result::OK;
+  }
+
+  template <typename Sender>
+  constexpr Result handle_bytes(etl::span<const uint8_t> body,
+                                Sender &send_reply) {
+    if (state_ != State::Receiving || body.size() < BYTES_HEADER_SIZE ||
+        body[0] >= manifest_.count) {
+      logger_.error("SysEx: KitFileBytes outside a kit transfer.");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+
+    const uint8_t index = body[0];
+    uint32_t offset = 0;
+    for (size_t i = 0; i < 5; ++i) {
+      offset |= static_cast<uint32_t>(body[1 + i] & 0x7F) << (7 * i);
+    }
+    const Entry &entry = manifest_.entries[index];
+    if (offset != received_[index] || offset == entry.size) {
+      send_status(send_reply, index);
+      return Result::OK;
+    }
+
+    if (!open_staged(index)) {
+      return fail(send_reply, "SysEx: Could not open a staged kit file");
+    }
+
+    auto start = body.begin() + BYTES_HEADER_SIZE;
+    const auto end = body.end();
+    while (start != end) {
+      const auto result = codec::decode_8_to_7(
+          start, end, decode_buffer_.begin(), decode_buffer_.end());
+      if (result.second == 0) {
+        break;
+      }
+      start += result.first;
+
+      // The final 8-to-7 group of a file carries up to 6 padding bytes
+      const size_t remaining = entry.size - received_[index];
+      const size_t to_write = etl::min(result.second, remaining);
+      if (result.second - to_write >= 7) {
+        logger_.error("SysEx: KitFileBytes exceed the file size");
+        send_reply(Tag::Nack);
+        return Result::InvalidContent;
+      }
+      const auto data =
+          etl::span<const uint8_t>{decode_buffer_.data(), to_write};
+      if (file_->write(data) != to_write) {
+        return fail(send_reply, "SysEx: Failed writing a staged kit file");
+      }
+      crcs_[index].add(data.begin(), data.end());
+      received_[index] += to_write;
+    }
+
+    if (received_[index] == entry.size) {
+      file_.reset();
+      if (crcs_[index].value() != entry.crc) {
+        logger_.error("SysEx: Kit file CRC mismatch, index",
+                      static_cast<uint32_t>(index));
+        received_[index] = 0;
+        crcs_[index].reset();
+        send_reply(Tag::Nack);
+        return Result::InvalidContent;
+      }
+      finishing_index_ = index;
+      state_ = State::Finishing;
+      if (!file_ops_.finishing_write()) {
+        finish_file(send_reply);
+      }
+      return Result::OK;
+    }
+    send_reply(Tag::Ack);
+    return Result::OK;
+  }
+
+  // The CRC only covers the bytes that were staged; a file whose data then
+  // failed to reach flash starts over.
+  template <typename Sender> constexpr void finish_file(Sender &send_reply) {
+    state_ = State::Receiving;
+    if (file_ops_.write_failed()) {
+      logger_.error("SysEx: Failed writing a staged kit file, index",
+                    static_cast<uint32_t>(finishing_index_));
+      received_[finishing_index_] = 0;
+      crcs_[finishing_index_].reset();
+      send_reply(Tag::Nack);
+      return;
+    }
+    send_reply(Tag::Ack);
+  }
+
+  template <typename Sender>
+  constexpr Result handle_commit(Sender &send_reply) {
+    if (state_ != State::Receiving) {
+      logger_.error("SysEx: CommitKit outside a kit transfer.");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+    for (uint8_t index = 0; index < manifest_.count; ++index) {
+      if (received_[index] != manifest_.entries[index].size) {
+        logger_.warn("SysEx: CommitKit with a file incomplete, index",
+                     static_cast<uint32_t>(index));
+        send_status(send_reply, index);
+        return Result::OK;
+      }
+    }
+
+    file_.reset();
+    state_ = State::Idle;
+    {
+      auto marker = file_ops_.open(COMMIT_PATH, false);
+      const etl::array<uint8_t, 1> mark{1};
+      if (marker.write(etl::span<const uint8_t>{mark.data(), mark.size()}) !=
+          mark.size()) {
+        return fail(send_reply, "SysEx: Could not write the commit marker");
+      }
+    }
+    // From here on an interruption is finished by recover() at boot
+    if (!move_into_place(manifest_)) {
+      return fail(send_reply, "SysEx: Failed moving the kit into place");
+    }
+    clear_staging();
+    logger_.info("SysEx: Kit committed, files",
+                 static_cast<uint32_t>(manifest_.count));
+    send_reply(Tag::Ack);
+    return Result::KitCommitted;
+  }
+
+  template <typename Sender>
+  constexpr Result handle_abort(Sender &send_reply) {
+    file_.reset();
+    state_ = State::Idle;
+    // Files a failed commit already moved cannot be put back; finish it
+    const bool recovered = recover();
+    clear_staging();
+    logger_.info("SysEx: Kit transfer aborted by host.");
+    send_reply(Tag::Ack);
+    return recovered ? Result::KitCommitted : Result::Aborted;
+  }
+
+  template <typename Sender>
+  constexpr Result fail(Sender &send_reply, const char *message) {
+    logger_.error(message);
+    file_.reset();
+    state_ = State::Idle;
+    send_reply(Tag::Nack);
+    return Result::FileError;
+  }
+
+  // Keeps the file being received open across KitFileBytes messages,
+  // appending when an earlier attempt already staged part of it.
+  bool open_staged(uint8_t index) {
+    if (file_.has_value() && file_index_ == index) {
+      return true;
+    }
+    file_.reset();
+    char path[drum::config::MAX_PATH_LENGTH];
+    if (!staged_path(manifest_.entries[index], path)) {
+      return false;
+    }
+    file_.emplace(file_ops_.open(path, received_[index] > 0));
+    file_index_ = index;
+    return true;
+  }
+
+  // Returns how many bytes of a file an earlier attempt staged, feeding
+  // them into its CRC. A staged file that is too long, or complete but
+  // wrong, is started over.
+  uint32_t measure_staged(uint8_t index) {
+    const Entry &entry = manifest_.entries[index];
+    char path[drum::config::MAX_PATH_LENGTH];
+    if (!staged_path(entry, path)) {
+      return 0;
+    }
+    auto handle = file_ops_.open_read(path);
+    if (!handle.has_value() || handle->size() > entry.size) {
+      return 0;
+    }
+    uint32_t staged = 0;
+    size_t count = 0;
+    while ((count = handle->read(etl::span<uint8_t>{
+                decode_buffer_.data(), decode_buffer_.size()})) > 0) {
+      crcs_[index].add(decode_buffer_.begin(), decode_buffer_.begin() + count);
+      staged += count;
+    }
+    if (staged == entry.size && crcs_[index].value() != entry.crc) {
+      crcs_[index].reset();
+      return 0;
+    }
+    return staged;
+  }
+
+  bool move_into_place(const Manifest &manifest) {
+    bool moved = true;
+    for (uint8_t index = 0; index < manifest.count; ++index) {
+      char from[drum::config::MAX_PATH_LENGTH];
+      char to[drum::config::MAX_PATH_LENGTH];
+      const Entry &entry = manifest.entries[index];
+      if (!staged_path(entry, from) || !installed_path(entry, to) ||
+          !file_ops_.rename_path(from, to)) {
+        moved = false;
+      }
+    }
+    return moved;
+  }
+
+  void remove_staged(const Entry &entry) {
+    char path[drum::config::MAX_PATH_LENGTH];
+    if (entry.name[0] != '\0' && staged_path(entry, path)) {
+      file_ops_.remove_path(path);
+    }
+  }
+
+  // Every staged file is listed in the manifest on flash, which is written
+  // before any file data, so the directory ends up empty and is removed.
+  void clear_staging() {
+    if (load_manifest(staged_)) {
+      for (uint8_t index = 0; index < staged_.count; ++index) {
+        remove_staged(staged_.entries[index]);
+      }
+    }
+    staged_ = Manifest{};
+    file_ops_.remove_path(COMMIT_PATH);
+    file_ops_.remove_path(MANIFEST_PATH);
+    file_ops_.remove_path(STAGING_DIR);
+  }
+
+  bool save_manifest() {
+    auto handle = file_ops_.open(MANIFEST_PATH, false);
+    const auto bytes = etl::span<const uint8_t>{
+        reinterpret_cast<const uint8_t *>(&manifest_), sizeof(manifest_)};
+    return handle.write(bytes) == bytes.size();
+  }
+
+  bool load_manifest(Manifest &manifest) {
+    auto handle = file_ops_.open_read(MANIFEST_PATH);
+    if (!handle.has_value() || handle->size() != sizeof(Manifest)) {
+      return false;
+    }
+    const auto bytes = etl::span<uint8_t>{
+        reinterpret_cast<uint8_t *>(&manifest), sizeof(manifest)};
+    return handle->read(bytes) == bytes.size() &&
+           manifest.magic == MANIFEST_MAGIC && manifest.count > 0 &&
+           manifest.count <= MAX_FILES;
+  }
+
+  FileOperations &file_ops_;
+  musin::Logger &logger_;
+  State state_ = State::Idle;
+  absolute_time_t last_activity_time_;
+
+  Manifest manifest_{};
+  Manifest staged_{}; // The manifest of an earlier attempt, when resuming
+  bool resuming_ = false;
+  uint8_t entries_received_ = 0;
+  etl::array<uint32_t, MAX_FILES> received_{};
+  etl::array<etl::crc32, MAX_FILES> crcs_{};
+
+  etl::optional<typename FileOperations::Handle> file_;
+  uint8_t file_index_ = 0;
+  uint8_t finishing_index_ = 0; // The file whose Ack waits in Finishing
+  // Large enough for a full 2048-byte SysEx message decoded 8-to-7.
+  etl::array<uint8_t, 1792> decode_buffer_{};
+};
+
+} // namespace sysex
+
+#endif /* end of include guard: SYSEX_KIT_TRANSFER_H_R7NW3CZA */
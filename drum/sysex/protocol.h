@@ -7,6 +7,8 @@
 #include "etl/span.h"
 #include "etl/string_view.h"
 
+#include <algorithm>
+
 extern "C" {
 #include "pico/time.h"
 }
@@ -35,16 +37,77 @@ static constexpr size_t SYSEX_HEADER_SIZE =
 static constexpr size_t SYSEX_CHUNK_PAYLOAD_OFFSET =
     SYSEX_MFR_ID_SIZE + SYSEX_DEVICE_ID_SIZE + SYSEX_TAG_SIZE;
 
+/*
+ * File transfers run in one of two modes, chosen by the host in
+ * BeginFileWrite:
+ *
+ * - Legacy: every FileBytes chunk is answered with Ack or Nack.
+ * - Windowed: the BeginFileWrite path is followed by its NUL and a requested
+ *   window size. Chunks are sent as SequencedFileBytes with a 14-bit
+ *   sequence number, and the host may have up to `window` of them
+ *   unacknowledged. The device answers with a WindowAck every window / 2
+ *   chunks, and as soon as a retransmitted chunk fills a gap. It sends a
+ *   WindowNack for each chunk found missing when a later one arrives, and
+ *   holds a few chunks that arrive ahead of a gap until it is filled. The
+ *   host ends with EndFileTransfer carrying the chunk count. The device
+ *   answers Ack once every chunk has arrived and been written, or else a
+ *   WindowAck listing what it has.
+ *
+ * In both modes EndFileTransfer is answered once the file's staged data has
+ * reached flash (see service()): Ack, or Nack if a write failed.
+ *
+ * In BeginFileWrite the window byte (0 for a legacy transfer) may be
+ * followed by the file's size, 32-bit little-endian. Data is sent in 8-to-7
+ * groups, so the last group of a file whose size is not a multiple of 7 is
+ * zero padded; with the size given, the padding is not stored, and a
+ * transfer that ends short of the size is answered Nack.
+ *
+ * WindowAck payload: next expected sequence (MSB, LSB), the accepted window,
+ * then three 7-bit bitmap bytes (LSB first); bit i is set when chunk
+ * next + 1 + i is already held. The reply to a windowed BeginFileWrite is a
+ * WindowAck for sequence 0. WindowNack payload: the missing sequence (MSB,
+ * LSB).
+ *
+ * Resuming and skipping files:
+ *
+ * - StatFile carries a path, encoded like BeginFileWrite. The device answers
+ *   with FileStat: an exists byte, the size as five 7-bit bytes (MSB
+ *   first), then for an existing file its SHA-256 as 8-to-7 groups (40
+ *   bytes, the last group zero padded). The file is hashed a few blocks per
+ *   service() call, so a large file does not stall the main loop.
+ * - ResumeFileWrite carries the path, its NUL, the window byte (0 for a
+ *   legacy transfer), a 32-bit little-endian offset and optionally the whole
+ *   file's size, encoded like the offset. The transfer appends
+ *   to the file and otherwise runs as one begun with BeginFileWrite. It is
+ *   refused unless the offset equals the stored size, so the host stats the
+ *   file first and checks that the stored bytes match its own.
+ *
+ * Sender is called as send_reply(tag), or as send_reply(tag, payload) for
+ * the windowed and FileStat replies.
+ */
 template <typename FileOperations> struct Protocol {
   static constexpr uint64_t TIMEOUT_US = 5000000; // 5 seconds
+  static constexpr uint8_t MAX_WINDOW =
+      drum::config::sysex::MAX_TRANSFER_WINDOW;
+  static constexpr uint16_t SEQUENCE_MASK = 0x3FFF;
+  static_assert(MAX_WINDOW <= 22, "WindowAck's bitmap covers 21 chunks");
+  static constexpr size_t HASH_BLOCKS_PER_SERVICE =
+      drum::config::sysex::HASH_BLOCKS_PER_SERVICE;
+  using Sha256 = typename FileOperations::Sha256;
+  using Digest = typename Sha256::Digest;
+  // Exists byte, 5-byte size and the 8-to-7 encoded digest
+  static constexpr size_t ENCODED_DIGEST_SIZE =
+      (Digest::SIZE + 6) / 7 * 8;
+  static constexpr size_t FILE_STAT_PAYLOAD_SIZE = 1 + 5 + ENCODED_DIGEST_SIZE;
 
   constexpr Protocol(FileOperations &file_ops, musin::Logger &logger)
       : file_ops(file_ops), logger(logger), last_activity_time_{} {
   }
 
   struct File {
-    constexpr File(FileOperations &file_ops, const etl::string_view &path)
-        : handle(file_ops.open(path)) {
+    constexpr File(FileOperations &file_ops, const etl::string_view &path,
+                   bool append)
+        : handle(file_ops.open(path, append)) {
     }
 
     constexpr bool is_valid() const {
@@ -59,6 +122,17 @@ template <typename FileOperations> struct Protocol {
       }
     }
 
+    // Staging space to decode into in place; see the FileOperations Handle
+    constexpr etl::span<uint8_t> reserve() {
+      return handle.has_value() ? handle->reserve() : etl::span<uint8_t>{};
+    }
+
+    constexpr void commit(size_t count) {
+      if (handle.has_value()) {
+        handle->commit(count);
+      }
+    }
+
     constexpr ~File() {
       if (handle.has_value()) {
         handle->close();
@@ -85,6 +159,12 @@ template <typename FileOperations> struct Protocol {
     Ack = 0x13,
     Nack = 0x14,
     FormatFilesystem = 0x15,
+    SequencedFileBytes = 0x16,
+    WindowAck = 0x17,
+    WindowNack = 0x18,
+    StatFile = 0x19,
+    FileStat = 0x1A,
+    ResumeFileWrite = 0x1B,
 
     // Firmware Update Commands (0x20-0x23) are handled by
     // sysex::FirmwareUpdate in drum/sysex/firmware_update.h.
@@ -93,6 +173,8 @@ template <typename FileOperations> struct Protocol {
     RequestSequencerState = 0x30,
     SequencerStateResponse = 0x31,
     SetSequencerState = 0x32,
+    SetRandomSeed = 0x33,
+    SetPatternChain = 0x34,
 
     // Settings Commands (generic key-value, see drum/settings.h)
     GetSetting = 0x40,
@@ -109,6 +191,8 @@ template <typename FileOperations> struct Protocol {
     PrintStorageInfo,
     PrintSequencerState,
     SetSequencerState,
+    SetRandomSeed,
+    SetPatternChain,
     GetSetting,
     SetSetting,
     FileError,
@@ -133,12 +217,27 @@ template <typename FileOperations> struct Protocol {
       return Result::InvalidManufacturer;
     }
 
+    // The last transfer's reply is still waiting on flash writes; write the
+    // rest now so it goes out first. A resent EndFileTransfer is answered
+    // by it.
+    if (state == State::Finishing) {
+      file_ops.complete_write();
+      reply_written(send_reply);
+      if (get_tag_from_chunk(chunk) == Tag::EndFileTransfer) {
+        return Result::OK;
+      }
+    }
+
     // Fast path for FileBytes, which is the most common command during a
     // transfer. This avoids the overhead of the 3-to-16bit decoding.
     if (is_file_bytes_command(chunk)) {
       return handle_file_bytes_fast(iterator + 1, chunk.cend(), send_reply,
                                     now);
     }
+    if (get_tag_from_chunk(chunk) == Tag::SequencedFileBytes) {
+      return handle_sequenced_file_bytes(iterator + 1, chunk.cend(),
+                                         send_reply, now);
+    }
 
     // SetSequencerState carries a raw 7-bit payload (see
     // sequencer_state_codec.h); skip the legacy 3-to-16bit body decoding and
@@ -146,6 +245,12 @@ template <typename FileOperations> struct Protocol {
     if (get_tag_from_chunk(chunk) == Tag::SetSequencerState) {
       return Result::SetSequencerState;
     }
+    if (get_tag_from_chunk(chunk) == Tag::SetRandomSeed) {
+      return Result::SetRandomSeed;
+    }
+    if (get_tag_from_chunk(chunk) == Tag::SetPatternChain) {
+      return Result::SetPatternChain;
+    }
 
     // Settings commands also carry raw 7-bit payloads (setting id and
     // value bytes); the handler reads them directly from the chunk.
@@ -178,12 +283,7 @@ template <typename FileOperations> struct Protocol {
       if (state == State::FileTransfer) {
         if (tag == EndFileTransfer) {
           logger.info("SysEx: EndFileTransfer received");
-          flush_write_buffer();
-          opened_file.reset();
-          state = State::Idle;
-          logger.info("SysEx: Sending Ack for EndFileTransfer");
-          send_reply(Tag::Ack);
-          return Result::FileWritten;
+          return finish_transfer(send_reply);
         }
       }
 
@@ -208,7 +308,6 @@ template <typename FileOperations> struct Protocol {
       if (absolute_time_diff_us(last_activity_time_, now) >
           static_cast<int64_t>(TIMEOUT_US)) {
         logger.warn("SysEx: File transfer timed out.");
-        flush_write_buffer();
         opened_file.reset();
         state = State::Idle;
         return true;
@@ -217,6 +316,32 @@ template <typename FileOperations> struct Protocol {
     return false;
   }
 
+  // Answers an ended transfer once its staged data is written. Hashes the
+  // next few blocks of a file being stat'ed, and sends its FileStat once the
+  // whole file is hashed. Called once per main loop pass, after the file
+  // operations' own service().
+  template <typename Sender> constexpr void service(Sender send_reply) {
+    if (state == State::Finishing) {
+      if (!file_ops.finishing_write()) {
+        reply_written(send_reply);
+      }
+      return;
+    }
+    if (state != State::Hashing) {
+      return;
+    }
+    for (size_t i = 0; i < HASH_BLOCKS_PER_SERVICE; ++i) {
+      const size_t count = stat_file_->read(
+          etl::span<uint8_t>{hash_block_.data(), hash_block_.size()});
+      if (count == 0) {
+        finish_stat(send_reply);
+        return;
+      }
+      sha_.update(etl::span<const uint8_t>{hash_block_.data(), count});
+      hashed_bytes_ += count;
+    }
+  }
+
   constexpr bool busy() const {
     return state != State::Idle;
   }
@@ -224,6 +349,8 @@ template <typename FileOperations> struct Protocol {
   enum class State {
     Idle,
     FileTransfer,
+    Finishing, // Ended, the reply waits for the staged data to be written
+    Hashing,
   };
 
   constexpr State get_state() const {
@@ -237,8 +364,28 @@ private:
   etl::optional<File> opened_file;
   absolute_time_t last_activity_time_;
 
-  etl::array<uint8_t, FileOperations::BlockSize> write_buffer;
-  size_t write_buffer_pos = 0;
+  // The file being hashed for StatFile, read a block at a time
+  etl::optional<typename FileOperations::ReadHandle> stat_file_;
+  Sha256 sha_{};
+  uint32_t hashed_bytes_ = 0;
+  etl::array<uint8_t, FileOperations::BlockSize> hash_block_;
+
+  // A decoded chunk that arrived ahead of a gap in a windowed transfer
+  struct HeldChunk {
+    bool used = false;
+    uint16_t sequence = 0;
+    uint16_t size = 0;
+    etl::array<uint8_t, FileOperations::BlockSize> bytes{};
+  };
+
+  // Bytes of the file still to come, when the host declared its size
+  etl::optional<uint32_t> bytes_left_;
+
+  uint8_t window_ = 0; // 0 for a legacy transfer
+  uint16_t next_sequence_ = 0;
+  uint16_t nack_horizon_ = 0; // Chunks before this have been NACKed once
+  uint8_t chunks_since_ack_ = 0;
+  etl::array<HeldChunk, drum::config::sysex::TRANSFER_REORDER_SLOTS> held_{};
 
   enum class SanitizeResult {
     Success,
@@ -309,6 +456,12 @@ private:
     switch (tag) {
     case BeginFileWrite:
       return handle_begin_file_write(bytes, send_reply, now);
+    case ResumeFileWrite:
+      return handle_resume_file_write(bytes, send_reply, now);
+    case StatFile:
+      return handle_stat_file(bytes, send_reply);
+    case EndFileTransfer:
+      return handle_end_windowed(bytes, send_reply);
     default:
       logger.error("SysEx: Unknown tag with body", static_cast<uint32_t>(tag));
       if (state == State::FileTransfer) {
@@ -324,13 +477,7 @@ private:
   constexpr Result
   handle_begin_file_write(const etl::span<const uint8_t> &bytes,
                           Sender send_reply, absolute_time_t now) {
-    if (state != State::Idle) {
-      logger.warn("SysEx: BeginFileWrite received while another file transfer "
-                  "is in progress. "
-                  "Canceling previous transfer.");
-      flush_write_buffer();
-      opened_file.reset();
-    }
+    cancel_previous();
 
     char path[drum::config::MAX_PATH_LENGTH];
     const auto sanitize_result = sanitize_path(bytes, path);
@@ -342,13 +489,68 @@ private:
 
     logger.info("SysEx: BeginFileWrite received for path:");
     logger.info(path);
-    opened_file.emplace(file_ops, path);
+    return start_transfer(path, false, requested_window(bytes),
+                          u32_after_path(bytes, BEGIN_SIZE_POSITION),
+                          send_reply, now);
+  }
+
+  template <typename Sender>
+  constexpr Result
+  handle_resume_file_write(const etl::span<const uint8_t> &bytes,
+                           Sender send_reply, absolute_time_t now) {
+    cancel_previous();
+
+    char path[drum::config::MAX_PATH_LENGTH];
+    const auto offset = u32_after_path(bytes, RESUME_OFFSET_POSITION);
+    const auto size = u32_after_path(bytes, RESUME_SIZE_POSITION);
+    if (!offset.has_value() || (size.has_value() && *size < *offset) ||
+        sanitize_path(bytes, path) != SanitizeResult::Success) {
+      logger.error("SysEx: Malformed ResumeFileWrite");
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+
+    logger.info("SysEx: ResumeFileWrite received for path:");
+    logger.info(path);
+    uint32_t stored_size = 0;
+    if (auto stored = file_ops.open_read(path); stored.has_value()) {
+      stored_size = static_cast<uint32_t>(stored->size());
+    }
+    if (stored_size != *offset) {
+      logger.warn("SysEx: Resume offset does not match stored size",
+                  stored_size);
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+
+    etl::optional<uint32_t> rest;
+    if (size.has_value()) {
+      rest = *size - *offset;
+    }
+    return start_transfer(path, *offset > 0, requested_window(bytes), rest,
+                          send_reply, now);
+  }
+
+  // @p size is the number of bytes to come, if the host declared it
+  template <typename Sender>
+  constexpr Result start_transfer(const char *path, bool append,
+                                  uint8_t window,
+                                  etl::optional<uint32_t> size,
+                                  Sender &send_reply, absolute_time_t now) {
+    opened_file.emplace(file_ops, path, append);
     if (opened_file.has_value() && opened_file->is_valid()) {
       state = State::FileTransfer;
-      write_buffer_pos = 0;
       last_activity_time_ = now;
-      logger.info("SysEx: Sending Ack for BeginFileWrite");
-      send_reply(Tag::Ack);
+      bytes_left_ = size;
+      start_window(window);
+      if (window_ > 0) {
+        logger.info("SysEx: Windowed transfer, window",
+                    static_cast<uint32_t>(window_));
+        send_window_ack(send_reply);
+      } else {
+        logger.info("SysEx: Sending Ack for file write");
+        send_reply(Tag::Ack);
+      }
       return Result::OK;
     } else {
       opened_file.reset();
@@ -359,6 +561,96 @@ private:
     }
   }
 
+  constexpr void cancel_previous() {
+    if (state == State::FileTransfer) {
+      logger.warn("SysEx: File write received while another file transfer "
+                  "is in progress. "
+                  "Canceling previous transfer.");
+      opened_file.reset();
+    } else if (state == State::Hashing) {
+      sha_.abort();
+      stat_file_.reset();
+    }
+    state = State::Idle;
+  }
+
+  template <typename Sender>
+  constexpr Result handle_stat_file(const etl::span<const uint8_t> &bytes,
+                                    Sender send_reply) {
+    char path[drum::config::MAX_PATH_LENGTH];
+    if (state != State::Idle ||
+        sanitize_path(bytes, path) != SanitizeResult::Success) {
+      logger.error("SysEx: StatFile refused");
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+
+    logger.info("SysEx: StatFile received for path:");
+    logger.info(path);
+    stat_file_ = file_ops.open_read(path);
+    if (!stat_file_.has_value()) {
+      const etl::array<uint8_t, 6> payload{};
+      send_reply(Tag::FileStat,
+                 etl::span<const uint8_t>{payload.data(), payload.size()});
+      return Result::OK;
+    }
+    if (!sha_.start()) {
+      logger.error("SysEx: SHA-256 engine unavailable");
+      stat_file_.reset();
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+    hashed_bytes_ = 0;
+    state = State::Hashing;
+    return Result::OK;
+  }
+
+  template <typename Sender> constexpr void finish_stat(Sender &send_reply) {
+    Digest digest{};
+    const bool hashed = sha_.finish(digest);
+    stat_file_.reset();
+    state = State::Idle;
+    if (!hashed) {
+      send_reply(Tag::Nack);
+      return;
+    }
+
+    etl::array<uint8_t, FILE_STAT_PAYLOAD_SIZE> payload{};
+    payload[0] = 1;
+    for (size_t i = 0; i < 5; ++i) {
+      payload[1 + i] =
+          static_cast<uint8_t>((hashed_bytes_ >> (7 * (4 - i))) & 0x7F);
+    }
+    codec::encode_8_to_7(digest.cbegin(), digest.cend(), payload.begin() + 6);
+    send_reply(Tag::FileStat,
+               etl::span<const uint8_t>{payload.data(), payload.size()});
+  }
+
+  // Positions after the path's NUL of the 32-bit fields that follow the
+  // window byte
+  static constexpr size_t BEGIN_SIZE_POSITION = 2;
+  static constexpr size_t RESUME_OFFSET_POSITION = 2;
+  static constexpr size_t RESUME_SIZE_POSITION = 6;
+
+  // The little-endian value @p position bytes after the path's NUL, or
+  // nullopt if the message ends first
+  static constexpr etl::optional<uint32_t>
+  u32_after_path(const etl::span<const uint8_t> &bytes, size_t position) {
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      if (bytes[i] == '\0') {
+        const size_t at = i + position;
+        if (at + 4 > bytes.size()) {
+          return etl::nullopt;
+        }
+        return static_cast<uint32_t>(bytes[at]) |
+               (static_cast<uint32_t>(bytes[at + 1]) << 8) |
+               (static_cast<uint32_t>(bytes[at + 2]) << 16) |
+               (static_cast<uint32_t>(bytes[at + 3]) << 24);
+      }
+    }
+    return etl::nullopt;
+  }
+
   template <typename Sender, typename InputIt>
   constexpr Result handle_file_bytes_fast(InputIt start, InputIt end,
                                           Sender send_reply,
@@ -371,26 +663,8 @@ private:
     }
 
     if (opened_file.has_value()) {
-      while (start != end) {
-        const auto result = codec::decode_8_to_7(
-            start, end, write_buffer.begin() + write_buffer_pos,
-            write_buffer.end());
-
-        const size_t bytes_read = result.first;
-        const size_t bytes_decoded = result.second;
-
-        write_buffer_pos += bytes_decoded;
-        start += bytes_read;
-
-        if (write_buffer_pos >= write_buffer.size()) {
-          if (!flush_write_buffer()) {
-            logger.error("SysEx: Failed to write buffer, aborting transfer.");
-            opened_file.reset();
-            state = State::Idle;
-            send_reply(Tag::Nack);
-            return Result::FileError;
-          }
-        }
+      if (!write_encoded(start, end)) {
+        return abort_transfer(send_reply);
       }
       last_activity_time_ = now;
       send_reply(Tag::Ack);
@@ -403,19 +677,288 @@ private:
     }
   }
 
-  constexpr bool flush_write_buffer() {
-    if (opened_file.has_value() && write_buffer_pos > 0) {
-      const size_t written = opened_file->write(
-          etl::span{write_buffer.cbegin(), write_buffer_pos});
-      if (written != write_buffer_pos) {
-        logger.error("SysEx: Failed to write all bytes to file.");
+  template <typename Sender, typename InputIt>
+  constexpr Result handle_sequenced_file_bytes(InputIt start, InputIt end,
+                                               Sender send_reply,
+                                               absolute_time_t now) {
+    if (state != State::FileTransfer || window_ == 0 ||
+        etl::distance(start, end) < 2) {
+      logger.error("SysEx: SequencedFileBytes outside a windowed transfer.");
+      send_reply(Tag::Nack);
+      return Result::FileError;
+    }
+
+    const uint16_t sequence = static_cast<uint16_t>((start[0] << 7) | start[1]);
+    start += 2;
+    last_activity_time_ = now;
+
+    const uint16_t offset = sequence_offset(sequence);
+    if (offset >= window_) {
+      // Already written, so the host missed an ack, or beyond the window
+      send_window_ack(send_reply);
+      return Result::OK;
+    }
+    if (offset > 0) {
+      const bool held = hold_chunk(sequence, start, end);
+      nack_missing_before(sequence, held, send_reply);
+      return Result::OK;
+    }
+
+    if (!write_encoded(start, end)) {
+      return abort_transfer(send_reply);
+    }
+    advance_sequence();
+
+    bool filled_gap = false;
+    for (HeldChunk *held = find_held(next_sequence_); held != nullptr;
+         held = find_held(next_sequence_)) {
+      held->used = false;
+      if (!write_decoded(etl::span<const uint8_t>{held->bytes.data(),
+                                                  held->size})) {
+        return abort_transfer(send_reply);
+      }
+      advance_sequence();
+      filled_gap = true;
+    }
+
+    if (filled_gap || chunks_since_ack_ >= (window_ + 1) / 2) {
+      send_window_ack(send_reply);
+    }
+    return Result::OK;
+  }
+
+  template <typename Sender>
+  constexpr Result handle_end_windowed(const etl::span<const uint8_t> &bytes,
+                                       Sender send_reply) {
+    if (state != State::FileTransfer || window_ == 0 || bytes.size() < 2) {
+      logger.error("SysEx: EndFileTransfer with a chunk count outside a "
+                   "windowed transfer.");
+      send_reply(Tag::Nack);
+      return Result::InvalidContent;
+    }
+
+    const uint16_t chunk_count =
+        static_cast<uint16_t>(bytes[0] | (bytes[1] << 8)) & SEQUENCE_MASK;
+    if (chunk_count != next_sequence_) {
+      logger.warn("SysEx: EndFileTransfer before all chunks arrived, next",
+                  static_cast<uint32_t>(next_sequence_));
+      send_window_ack(send_reply);
+      return Result::OK;
+    }
+
+    logger.info("SysEx: Windowed EndFileTransfer received");
+    return finish_transfer(send_reply);
+  }
+
+  // Closes the file; its reply goes out once the staged data is written.
+  template <typename Sender>
+  constexpr Result finish_transfer(Sender &send_reply) {
+    if (bytes_left_.has_value() && *bytes_left_ > 0) {
+      logger.error("SysEx: Transfer ended short of the file size, missing",
+                   *bytes_left_);
+      return abort_transfer(send_reply);
+    }
+    opened_file.reset();
+    state = State::Finishing;
+    if (!file_ops.finishing_write()) {
+      reply_written(send_reply);
+    }
+    return Result::FileWritten;
+  }
+
+  template <typename Sender> constexpr void reply_written(Sender &send_reply) {
+    state = State::Idle;
+    if (file_ops.write_failed()) {
+      logger.error("SysEx: File could not be written, sending Nack");
+      send_reply(Tag::Nack);
+    } else {
+      logger.info("SysEx: File written, sending Ack");
+      send_reply(Tag::Ack);
+    }
+  }
+
+  template <typename Sender>
+  constexpr Result abort_transfer(Sender &send_reply) {
+    logger.error("SysEx: Failed to write buffer, aborting transfer.");
+    opened_file.reset();
+    state = State::Idle;
+    send_reply(Tag::Nack);
+    return Result::FileError;
+  }
+
+  // Tools that predate windowed transfers end the path with NUL padding, so
+  // a missing or zero window byte selects a legacy transfer.
+  static constexpr uint8_t
+  requested_window(const etl::span<const uint8_t> &bytes) {
+    for (size_t i = 0; i + 1 < bytes.size(); ++i) {
+      if (bytes[i] == '\0') {
+        return std::min(bytes[i + 1], MAX_WINDOW);
+      }
+    }
+    return 0;
+  }
+
+  constexpr void start_window(uint8_t window) {
+    window_ = window;
+    next_sequence_ = 0;
+    nack_horizon_ = 0;
+    chunks_since_ack_ = 0;
+    for (auto &held : held_) {
+      held.used = false;
+    }
+  }
+
+  constexpr uint16_t sequence_offset(uint16_t sequence) const {
+    return static_cast<uint16_t>(sequence - next_sequence_) & SEQUENCE_MASK;
+  }
+
+  constexpr void advance_sequence() {
+    next_sequence_ = (next_sequence_ + 1) & SEQUENCE_MASK;
+    ++chunks_since_ack_;
+  }
+
+  constexpr HeldChunk *find_held(uint16_t sequence) {
+    for (auto &held : held_) {
+      if (held.used && held.sequence == sequence) {
+        return &held;
+      }
+    }
+    return nullptr;
+  }
+
+  // Keeps a chunk that arrived ahead of a gap. With every slot taken, or if
+  // it decodes to more than a block, it is dropped and NACKed later.
+  template <typename InputIt>
+  constexpr bool hold_chunk(uint16_t sequence, InputIt start, InputIt end) {
+    if (find_held(sequence) != nullptr) {
+      return true;
+    }
+    for (auto &held : held_) {
+      if (held.used) {
+        continue;
+      }
+      const size_t encoded_size = etl::distance(start, end) / 8 * 8;
+      const auto result = codec::decode_8_to_7(start, end, held.bytes.begin(),
+                                               held.bytes.end());
+      if (result.first != encoded_size) {
         return false;
       }
-      write_buffer_pos = 0;
+      held.used = true;
+      held.sequence = sequence;
+      held.size = static_cast<uint16_t>(encoded_size / 8 * 7);
+      return true;
+    }
+    return false;
+  }
+
+  // NACKs each chunk before `sequence` that is neither written nor held,
+  // unless an earlier arrival already NACKed it. A chunk that could not be
+  // held stays behind the horizon, so the next arrival NACKs it.
+  template <typename Sender>
+  constexpr void nack_missing_before(uint16_t sequence, bool held,
+                                     Sender &send_reply) {
+    uint16_t from = sequence_offset(nack_horizon_);
+    if (from > window_) {
+      from = 0; // next_sequence_ has moved past the horizon
+    }
+    const uint16_t to = sequence_offset(sequence);
+    for (uint16_t offset = from; offset < to; ++offset) {
+      const uint16_t missing = (next_sequence_ + offset) & SEQUENCE_MASK;
+      if (find_held(missing) == nullptr) {
+        const etl::array<uint8_t, 2> payload{
+            static_cast<uint8_t>(missing >> 7),
+            static_cast<uint8_t>(missing & 0x7F)};
+        send_reply(Tag::WindowNack,
+                   etl::span<const uint8_t>{payload.data(), payload.size()});
+      }
+    }
+    if (to >= from) {
+      nack_horizon_ = (sequence + (held ? 1 : 0)) & SEQUENCE_MASK;
+    }
+  }
+
+  template <typename Sender>
+  constexpr void send_window_ack(Sender &send_reply) {
+    uint32_t held_bits = 0;
+    for (const auto &held : held_) {
+      if (held.used) {
+        held_bits |= 1u << (sequence_offset(held.sequence) - 1);
+      }
+    }
+    const etl::array<uint8_t, 6> payload{
+        static_cast<uint8_t>(next_sequence_ >> 7),
+        static_cast<uint8_t>(next_sequence_ & 0x7F),
+        window_,
+        static_cast<uint8_t>(held_bits & 0x7F),
+        static_cast<uint8_t>((held_bits >> 7) & 0x7F),
+        static_cast<uint8_t>((held_bits >> 14) & 0x7F)};
+    send_reply(Tag::WindowAck,
+               etl::span<const uint8_t>{payload.data(), payload.size()});
+    chunks_since_ack_ = 0;
+  }
+
+  // Decodes whole 8-byte groups straight into the file's staging space, so
+  // a chunk is copied once on its way from the SysEx ring to flash. A group
+  // that would straddle the end of that space is decoded aside and written
+  // whole.
+  template <typename InputIt>
+  constexpr bool write_encoded(InputIt start, InputIt end) {
+    if (!opened_file.has_value()) {
+      return false;
+    }
+    while (etl::distance(start, end) >= 8) {
+      const etl::span<uint8_t> space = opened_file->reserve();
+      if (space.size() >= 7) {
+        const auto result = codec::decode_8_to_7(
+            start, end, space.begin(), space.begin() + space.size() / 7 * 7);
+        start += result.first;
+        const auto count = file_part(result.second);
+        if (!count.has_value()) {
+          return false;
+        }
+        opened_file->commit(*count);
+      } else {
+        etl::array<uint8_t, 7> group{};
+        codec::decode_8_to_7(start, start + 8, group.begin(), group.end());
+        start += 8;
+        if (!write_decoded(
+                etl::span<const uint8_t>{group.data(), group.size()})) {
+          return false;
+        }
+      }
     }
     return true;
   }
 
+  constexpr bool write_decoded(etl::span<const uint8_t> bytes) {
+    const auto count = file_part(bytes.size());
+    if (!count.has_value()) {
+      return false;
+    }
+    bytes = bytes.first(*count);
+    if (!opened_file.has_value() ||
+        opened_file->write(bytes) != bytes.size()) {
+      logger.error("SysEx: Failed to write all bytes to file.");
+      return false;
+    }
+    return true;
+  }
+
+  // How many of @p decoded bytes belong to the file. The final 8-to-7 group
+  // carries up to 6 padding bytes past the declared size; more is an error.
+  constexpr etl::optional<size_t> file_part(size_t decoded) {
+    if (!bytes_left_.has_value()) {
+      return decoded;
+    }
+    const size_t count = etl::min<size_t>(decoded, *bytes_left_);
+    if (decoded - count >= 7) {
+      logger.error("SysEx: File data exceeds the declared size");
+      return etl::nullopt;
+    }
+    *bytes_left_ -= static_cast<uint32_t>(count);
+    return count;
+  }
+
   constexpr bool
   check_and_advance_manufacturer_id(Chunk::const_iterator &iterator,
                                     Chunk::const_iterator end) const {
@@ -0,0 +1,152 @@
+#ifndef SDS_CONVERSION_H_R5KM2WQT
+#define SDS_CONVERSION_H_R5KM2WQT
+
+/**
+ * @file sds_conversion.h
+ * @brief Sample word packing and sample rate conversion for SDS transfers
+ *
+ * SDS carries sample words of 8 to 28 bits, unsigned (0 = full negative) and
+ * left-justified in two, three or four 7-bit bytes, at any sample period.
+ * The engine plays 16-bit PCM at 44.1 kHz. These helpers convert between the
+ * two a word at a time, so both the receiver and the dump sender can stream
+ * with small fixed buffers.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sds {
+
+constexpr uint8_t MIN_BIT_DEPTH = 8;
+constexpr uint8_t MAX_BIT_DEPTH = 28;
+constexpr uint32_t ENGINE_SAMPLE_RATE_HZ = 44100;
+constexpr uint32_t ENGINE_SAMPLE_PERIOD_NS =
+    1000000000U / ENGINE_SAMPLE_RATE_HZ;
+// Sample periods accepted in a Dump Header: 2 kHz to 192 kHz
+constexpr uint32_t MIN_SAMPLE_PERIOD_NS = 5208;
+constexpr uint32_t MAX_SAMPLE_PERIOD_NS = 500000;
+constexpr size_t PACKET_DATA_BYTES = 120;
+
+constexpr bool is_valid_bit_depth(uint8_t bit_depth) {
+  return bit_depth >= MIN_BIT_DEPTH && bit_depth <= MAX_BIT_DEPTH;
+}
+
+constexpr bool is_valid_sample_period(uint32_t period_ns) {
+  return period_ns >= MIN_SAMPLE_PERIOD_NS && period_ns <= MAX_SAMPLE_PERIOD_NS;
+}
+
+// 7-bit bytes per sample word: 2 up to 14 bits, 3 up to 21, 4 up to 28
+constexpr size_t bytes_per_word(uint8_t bit_depth) {
+  return (bit_depth + 6) / 7;
+}
+
+// Whole words in a data packet's 120 bytes: 60, 40 or 30
+constexpr size_t words_per_packet(uint8_t bit_depth) {
+  return PACKET_DATA_BYTES / bytes_per_word(bit_depth);
+}
+
+// Reads one word and scales it to signed 16 bits. Deeper words are
+// truncated to their top 16 bits, shallower ones shifted up.
+constexpr int16_t unpack_word(const uint8_t *bytes, uint8_t bit_depth) {
+  const size_t byte_count = bytes_per_word(bit_depth);
+  uint32_t packed = 0;
+  for (size_t i = 0; i < byte_count; ++i) {
+    packed = (packed << 7) | (bytes[i] & 0x7F);
+  }
+  const uint32_t word = packed >> (byte_count * 7 - bit_depth);
+  const int32_t sample =
+      static_cast<int32_t>(word) - (static_cast<int32_t>(1) << (bit_depth - 1));
+  if (bit_depth >= 16) {
+    return static_cast<int16_t>(sample >> (bit_depth - 16));
+  }
+  return static_cast<int16_t>(sample * (1 << (16 - bit_depth)));
+}
+
+// Writes a signed 16-bit sample as one word of bit_depth bits, the inverse
+// of unpack_word for depths up to 16.
+constexpr void pack_word(int16_t sample, uint8_t bit_depth, uint8_t *bytes) {
+  const size_t byte_count = bytes_per_word(bit_depth);
+  const int32_t scaled =
+      bit_depth >= 16 ? static_cast<int32_t>(sample) * (1 << (bit_depth - 16))
+                      : static_cast<int32_t>(sample) >> (16 - bit_depth);
+  const uint32_t word = static_cast<uint32_t>(
+      scaled + (static_cast<int32_t>(1) << (bit_depth - 1)));
+  const uint32_t packed = word << (byte_count * 7 - bit_depth);
+  for (size_t i = 0; i < byte_count; ++i) {
+    bytes[i] = (packed >> (7 * (byte_count - 1 - i))) & 0x7F;
+  }
+}
+
+/**
+ * @brief Streaming linear-interpolation sample rate converter.
+ *
+ * Samples are pushed one at a time and every output sample that falls
+ * before the pushed one is emitted through a callback, so no more than the
+ * previous input sample is buffered. A ratio within 0.1% of 1 passes each
+ * sample straight through: 44.1 kHz expressed as a whole number of
+ * nanoseconds is never exact.
+ */
+class RateConverter {
+public:
+  static constexpr uint32_t ONE = 1u << 16;
+
+  constexpr RateConverter() = default;
+
+  constexpr RateConverter(uint32_t from_period_ns, uint32_t to_period_ns) {
+    // Input samples advanced per output sample, Q16
+    step_ = static_cast<uint32_t>((static_cast<uint64_t>(to_period_ns) * ONE +
+                                   from_period_ns / 2) /
+                                  from_period_ns);
+    if (step_ > ONE - ONE / 1000 && step_ < ONE + ONE / 1000) {
+      step_ = ONE;
+    }
+  }
+
+  constexpr bool passes_through() const {
+    return step_ == ONE;
+  }
+
+  template <typename Emit> constexpr void push(int16_t sample, Emit &&emit) {
+    if (passes_through()) {
+      emit(sample);
+      return;
+    }
+    if (!primed_) {
+      previous_ = sample;
+      primed_ = true;
+      return;
+    }
+    const int32_t delta = static_cast<int32_t>(sample) - previous_;
+    while (phase_ < ONE) {
+      emit(static_cast<int16_t>(
+          previous_ + static_cast<int32_t>(
+                          (static_cast<int64_t>(delta) * phase_) >> 16)));
+      phase_ += step_;
+    }
+    phase_ -= ONE;
+    previous_ = sample;
+  }
+
+  // Emits the outputs that fall on or after the last input sample
+  template <typename Emit> constexpr void finish(Emit &&emit) {
+    if (!primed_) {
+      return;
+    }
+    while (phase_ < ONE) {
+      emit(previous_);
+      phase_ += step_;
+    }
+    primed_ = false;
+    phase_ = 0;
+  }
+
+private:
+  uint32_t step_ = ONE;
+  uint32_t phase_ = 0;
+  int16_t previous_ = 0;
+  bool primed_ = false;
+};
+
+} // namespace sds
+
+#endif /* end of include guard: SDS_CONVERSION_H_R5KM2WQT */
@@ -17,8 +17,16 @@
  * Sending is paced from the main loop via update(); no blocking occurs, so
  * audio and the sequencer keep running during a download.
  *
- * The device does not persist sample rates, so outgoing headers always claim
- * 44100 Hz (see SAMPLE_RATE_HZ).
+ * Packets are double-buffered: while one is in flight, update() reads and
+ * builds the next, so an ACK (or the open-loop interval) is answered without
+ * touching the filesystem. The stored sample is read a block at a time. The
+ * achieved rate of a completed dump is logged and kept for
+ * last_bytes_per_second().
+ *
+ * A sample received over SDS is sent back in the format it came in, as
+ * recorded in its /NN.sds (see StoredFormat): the stored 16-bit 44.1 kHz PCM
+ * is converted back to the original bit depth and sample period as each
+ * packet is built. Any other sample is sent as 16-bit 44.1 kHz.
  */
 
 #include "drum/sysex/sds_protocol.h"
@@ -48,11 +56,8 @@ public:
   static constexpr uint64_t OPEN_LOOP_INTERVAL_US = 10000;
   // A host that sent WAIT but never followed up is assumed gone.
   static constexpr uint64_t STALL_TIMEOUT_US = 30000000;
-  // Sample rate reported in outgoing dump headers; the stored .pcm files
-  // carry no rate metadata.
-  static constexpr uint32_t SAMPLE_RATE_HZ = 44100;
-  static constexpr size_t BYTES_PER_PACKET = 80; // 40 16-bit samples
-  static constexpr size_t PACKET_SIZE = 123;     // type + num + 120 + checksum
+  static constexpr size_t PACKET_SIZE = 123; // type + num + 120 + checksum
+  static constexpr size_t READ_BLOCK_BYTES = 256;
 
   enum class State {
     Idle,
@@ -84,7 +89,8 @@ public:
                      ((static_cast<uint16_t>(message[2]) & 0x7F) << 7);
 
     char filename[16];
-    snprintf(filename, sizeof(filename), "/%02u.pcm", sample_number_);
+    const StoredFormat stored = read_stored_format();
+    sample_path(filename, sample_number_, "pcm");
 
     file_ = file_ops_.open_read(filename);
     if (!file_.has_value() || file_->size() < 2) {
@@ -95,17 +101,35 @@ public:
       return Result::FileError;
     }
 
-    total_bytes_ = file_->size() & ~static_cast<size_t>(1); // whole words only
-    bytes_sent_ = 0;
+    source_bytes_left_ = file_->size() & ~static_cast<size_t>(1); // whole words
+    block_pos_ = 0;
+    block_size_ = 0;
+    if (stored.describes(file_->size())) {
+      format_ = stored;
+    } else {
+      format_ = StoredFormat{};
+      format_.length_words = static_cast<uint32_t>(source_bytes_left_ / 2);
+    }
+    converter_ = RateConverter{ENGINE_SAMPLE_PERIOD_NS,
+                               format_.sample_period_ns};
+    source_finished_ = false;
+    pending_size_ = 0;
+    pending_index_ = 0;
+    words_sent_ = 0;
+    words_built_ = 0;
     packet_num_ = 0;
+    next_ready_ = false;
+    read_failed_ = false;
     wait_pending_ = false;
 
     send_dump_header(send_message);
     state_ = State::AwaitingHeaderResponse;
     last_activity_time_ = now;
     last_send_time_ = now;
-    logger_.info("SDS: Dump started, bytes:",
-                 static_cast<uint32_t>(total_bytes_));
+    start_time_ = now;
+    logger_.info("SDS: Dump started, words:", format_.length_words);
+    logger_.info("SDS: Dump bit depth:",
+                 static_cast<uint32_t>(format_.bit_depth));
     return Result::OK;
   }
 
@@ -121,13 +145,12 @@ public:
     switch (type) {
     case ACK:
       wait_pending_ = false;
-      // Complete only after the final packet went out (bytes_sent_ is zero
+      // Complete only after the final packet went out (words_sent_ is zero
       // while the header awaits its response). Checked in every sending
       // state: a late-handshaking host may ACK the final open-loop packet,
       // and advancing would emit a spurious zero-filled packet past the end.
       if (transfer_complete()) {
-        finish();
-        logger_.info("SDS: Dump complete");
+        complete(now);
         return Result::SampleComplete;
       }
       send_next_packet(send_message, now);
@@ -154,6 +177,7 @@ public:
     if (state_ == State::Idle) {
       return Result::OK;
     }
+    read_ahead();
     const int64_t elapsed = absolute_time_diff_us(last_activity_time_, now);
     if (elapsed > static_cast<int64_t>(STALL_TIMEOUT_US)) {
       logger_.warn("SDS: Dump stalled, aborting");
@@ -202,26 +226,129 @@ public:
     return etl::nullopt;
   }
 
+  // Data packet bytes per second of the last completed dump, counted from
+  // the Dump Header to the final packet's ACK (or open-loop completion).
+  constexpr uint32_t last_bytes_per_second() const {
+    return last_bytes_per_second_;
+  }
+
 private:
   FileOperations &file_ops_;
   musin::Logger &logger_;
   State state_ = State::Idle;
   etl::optional<typename FileOperations::ReadHandle> file_;
   uint16_t sample_number_ = 0;
-  size_t total_bytes_ = 0;
-  size_t bytes_sent_ = 0;
+  StoredFormat format_{};
+  uint32_t words_sent_ = 0;
   uint8_t packet_num_ = 0;
+
+  // packets_[sent_] is the packet last sent, kept for retransmission; the
+  // other buffer holds the next one once next_ready_ is set.
+  etl::array<etl::array<uint8_t, PACKET_SIZE>, 2> packets_{};
+  size_t sent_ = 0;
+  bool next_ready_ = false;
+  bool read_failed_ = false;
+  uint32_t words_built_ = 0;
+  uint32_t next_words_ = 0;
+  etl::array<uint8_t, READ_BLOCK_BYTES> block_{};
+  size_t block_pos_ = 0;
+  size_t block_size_ = 0;
+  absolute_time_t start_time_{};
+  uint32_t last_bytes_per_second_ = 0;
+
+  // Stored samples not yet read, and converted ones not yet sent. A stored
+  // sample converts to at most five outgoing ones (44.1 kHz to 192 kHz).
+  size_t source_bytes_left_ = 0;
+  bool source_finished_ = false;
+  RateConverter converter_{};
+  etl::array<int16_t, 8> pending_{};
+  size_t pending_size_ = 0;
+  size_t pending_index_ = 0;
   bool wait_pending_ = false;
   // Last host response (or transfer start); drives the stall timeout.
   absolute_time_t last_activity_time_{};
   // Last outgoing header/packet; drives retransmit and open-loop pacing.
   absolute_time_t last_send_time_{};
-  etl::array<uint8_t, PACKET_SIZE> last_packet_{};
   bool header_is_last_sent_ = true;
   etl::array<uint8_t, 17> header_{};
 
   constexpr bool transfer_complete() const {
-    return bytes_sent_ >= total_bytes_;
+    return words_sent_ >= format_.length_words;
+  }
+
+  StoredFormat read_stored_format() {
+    char filename[16];
+    sample_path(filename, sample_number_, "sds");
+    StoredFormat format{};
+    auto stored = file_ops_.open_read(filename);
+    if (!stored.has_value() ||
+        stored->read(etl::span<uint8_t>{reinterpret_cast<uint8_t *>(&format),
+                                        sizeof(format)}) != sizeof(format)) {
+      return StoredFormat{};
+    }
+    return format;
+  }
+
+  // Next outgoing sample in the original format. Returns false when the
+  // stored file cannot be read. A conversion that comes out a sample short
+  // is padded with silence.
+  bool next_sample(int16_t &sample) {
+    while (pending_index_ == pending_size_) {
+      pending_size_ = 0;
+      pending_index_ = 0;
+      auto queue = [this](int16_t converted) {
+        if (pending_size_ < pending_.size()) {
+          pending_[pending_size_++] = converted;
+        }
+      };
+      if (source_bytes_left_ == 0) {
+        if (source_finished_) {
+          sample = 0;
+          return true;
+        }
+        converter_.finish(queue);
+        source_finished_ = true;
+        continue;
+      }
+      if (block_pos_ == block_size_ && !read_block()) {
+        return false;
+      }
+      const auto stored =
+          static_cast<int16_t>(static_cast<uint16_t>(block_[block_pos_]) |
+                               (static_cast<uint16_t>(block_[block_pos_ + 1])
+                                << 8));
+      block_pos_ += 2;
+      source_bytes_left_ -= 2;
+      converter_.push(stored, queue);
+    }
+    sample = pending_[pending_index_++];
+    return true;
+  }
+
+  bool read_block() {
+    const size_t length = etl::min(source_bytes_left_, block_.size());
+    block_pos_ = 0;
+    block_size_ = file_->read(etl::span<uint8_t>{block_.data(), length});
+    return block_size_ == length;
+  }
+
+  void complete(absolute_time_t now) {
+    const int64_t elapsed_us = absolute_time_diff_us(start_time_, now);
+    const uint64_t data_bytes =
+        static_cast<uint64_t>(packet_count()) * PACKET_DATA_BYTES;
+    last_bytes_per_second_ =
+        elapsed_us > 0
+            ? static_cast<uint32_t>(data_bytes * 1000000 /
+                                    static_cast<uint64_t>(elapsed_us))
+            : 0;
+    finish();
+    logger_.info("SDS: Dump complete, bytes/s:", last_bytes_per_second_);
+  }
+
+  constexpr uint32_t packet_count() const {
+    const size_t per_packet = words_per_packet(format_.bit_depth);
+    return static_cast<uint32_t>((format_.length_words + per_packet - 1) /
+                                 per_packet);
   }
 
   void finish() {
@@ -244,14 +371,13 @@ private:
 
   template <typename SendMessage>
   void send_dump_header(SendMessage send_message) {
-    constexpr uint32_t period_ns = 1000000000U / SAMPLE_RATE_HZ;
-    const uint32_t length_words = total_bytes_ / 2;
+    const uint32_t length_words = format_.length_words;
 
     header_[0] = DUMP_HEADER;
     header_[1] = sample_number_ & 0x7F;
     header_[2] = (sample_number_ >> 7) & 0x7F;
-    header_[3] = 16; // bit depth
-    encode_21bit(period_ns, &header_[4]);
+    header_[3] = format_.bit_depth;
+    encode_21bit(format_.sample_period_ns, &header_[4]);
     encode_21bit(length_words, &header_[7]);
     encode_21bit(length_words, &header_[10]); // loop start = length
     encode_21bit(length_words, &header_[13]); // loop end = length
@@ -261,44 +387,53 @@ private:
     send_message(etl::span<const uint8_t>{header_});
   }
 
-  // Pack a signed 16-bit sample into the SDS left-justified 3-byte format
-  // (inverse of Protocol::unpack_16bit_sample).
-  static constexpr void pack_16bit_sample(int16_t sample, uint8_t *out) {
-    const uint16_t unsigned_sample =
-        static_cast<uint16_t>(static_cast<int32_t>(sample) + 0x8000);
-    out[0] = (unsigned_sample >> 9) & 0x7F;
-    out[1] = (unsigned_sample >> 2) & 0x7F;
-    out[2] = (unsigned_sample << 5) & 0x7F;
+  // Builds the packet after the one last sent into the spare buffer, reading
+  // the stored sample as needed. A read failure is reported when that packet
+  // is due.
+  void read_ahead() {
+    if (next_ready_ || read_failed_ || words_built_ >= format_.length_words) {
+      return;
+    }
+    const uint8_t bit_depth = format_.bit_depth;
+    const size_t word_bytes = bytes_per_word(bit_depth);
+    const size_t word_count =
+        etl::min(static_cast<size_t>(format_.length_words - words_built_),
+                 words_per_packet(bit_depth));
+    auto &packet = packets_[sent_ ^ 1];
+
+    packet[0] = DATA_PACKET;
+    packet[1] = packet_num_;
+    for (size_t i = 0; i < words_per_packet(bit_depth); ++i) {
+      int16_t sample = 0; // silence pads the final packet
+      if (i < word_count && !next_sample(sample)) {
+        read_failed_ = true;
+        return;
+      }
+      pack_word(sample, bit_depth, &packet[2 + i * word_bytes]);
+    }
+    packet[122] = calculate_data_checksum(
+        packet_num_, etl::span<const uint8_t>{&packet[2], 120});
+    next_words_ = static_cast<uint32_t>(word_count);
+    words_built_ += next_words_;
+    next_ready_ = true;
   }
 
   template <typename SendMessage>
   void send_next_packet(SendMessage send_message, absolute_time_t now) {
-    etl::array<uint8_t, BYTES_PER_PACKET> raw{}; // zero-padded final packet
-    const size_t remaining = total_bytes_ - bytes_sent_;
-    const size_t to_read = etl::min(remaining, BYTES_PER_PACKET);
-
-    if (file_->read(etl::span<uint8_t>{raw.data(), to_read}) != to_read) {
+    read_ahead(); // Only when update() has not run since the last send
+    if (!next_ready_) {
       logger_.error("SDS: Sample file read failed, aborting dump");
       send_cancel(send_message);
       finish();
       return;
     }
-
-    last_packet_[0] = DATA_PACKET;
-    last_packet_[1] = packet_num_;
-    for (size_t i = 0; i < BYTES_PER_PACKET / 2; ++i) {
-      const int16_t sample =
-          static_cast<int16_t>(static_cast<uint16_t>(raw[i * 2]) |
-                               (static_cast<uint16_t>(raw[i * 2 + 1]) << 8));
-      pack_16bit_sample(sample, &last_packet_[2 + i * 3]);
-    }
-    last_packet_[122] = calculate_data_checksum(
-        packet_num_, etl::span<const uint8_t>{&last_packet_[2], 120});
+    sent_ ^= 1;
+    next_ready_ = false;
 
     header_is_last_sent_ = false;
-    send_message(etl::span<const uint8_t>{last_packet_});
+    send_message(etl::span<const uint8_t>{packets_[sent_]});
 
-    bytes_sent_ += to_read;
+    words_sent_ += next_words_;
     packet_num_ = (packet_num_ + 1) & 0x7F;
     if (state_ != State::OpenLoop) {
       state_ = State::AwaitingPacketResponse;
@@ -315,7 +450,7 @@ private:
     if (header_is_last_sent_) {
       send_message(etl::span<const uint8_t>{header_});
     } else {
-      send_message(etl::span<const uint8_t>{last_packet_});
+      send_message(etl::span<const uint8_t>{packets_[sent_]});
     }
     last_send_time_ = now;
   }
@@ -323,8 +458,7 @@ private:
   template <typename SendMessage>
   Result advance_open_loop(SendMessage send_message, absolute_time_t now) {
     if (transfer_complete()) {
-      finish();
-      logger_.info("SDS: Dump complete (open-loop)");
+      complete(now);
       return Result::SampleComplete;
     }
     send_next_packet(send_message, now);
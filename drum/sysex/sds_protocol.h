@@ -6,17 +6,36 @@
  * @brief MIDI Sample Dump Standard (SDS) protocol implementation
  *
  * This implements a minimal subset of the SDS specification for receiving
- * 16-bit PCM audio samples without the padding corruption issues of the
- * custom SysEx protocol.
+ * PCM audio samples without the padding corruption issues of the custom
+ * SysEx protocol.
  *
  * Supported features:
  * - Dump Header parsing with basic sample metadata
- * - Data Packet processing with 16-bit sample unpacking
- * - ACK/NAK response generation
+ * - Data Packet processing for 8- to 28-bit words at any sample period from
+ *   2 kHz to 192 kHz, converted to 16-bit 44.1 kHz PCM as packets arrive
+ * - ACK/NAK response generation, per packet or per window (below)
  * - Checksum validation
  * - Integration with existing file operations
+ *
+ * Alongside each received /NN.pcm, the original format is stored in /NN.sds
+ * (see StoredFormat) so that a dump request can send the sample back as it
+ * came.
+ *
+ * Windowed handshaking: a host may append a requested window size to the
+ * 17-byte Dump Header. The header's ACK then carries the accepted window (up
+ * to MAX_ACK_WINDOW) in its packet number byte; a plain header is ACKed
+ * with 0 and every packet is handshaked as usual. In a window of more than
+ * one packet the host may have that many packets unacknowledged, and the
+ * device ACKs every window / 2 packets and the final one. An ACK covers the
+ * packet it names and everything before it. A bad or missing packet is
+ * NAKed once with the packet number the device expects, and packets that
+ * arrive after it are dropped until it is resent; the host goes back and
+ * resends from there. A packet the device already has is answered with an
+ * ACK for the last one it stored.
  */
 
+#include "drum/sysex/sds_conversion.h"
+#include "etl/algorithm.h"
 #include "etl/array.h"
 #include "etl/optional.h"
 #include "etl/span.h"
@@ -28,6 +47,8 @@ extern "C" {
 
 #include "musin/hal/logger.h"
 
+#include <cstdio>
+
 namespace sds {
 
 // SDS Message Types
@@ -86,20 +107,45 @@ struct SampleInfo {
     return sample_period_ns > 0 ? (1000000000U / sample_period_ns) : 44100;
   }
 
-  constexpr uint32_t get_byte_length() const {
-    return length_words * 2; // Words are 2 bytes each
+};
+
+// The format a sample was received in, stored raw in /NN.sds next to the
+// converted /NN.pcm. pcm_bytes ties it to that file: a .pcm written any
+// other way will not match, and is reported as 16-bit 44.1 kHz.
+struct StoredFormat {
+  static constexpr etl::array<char, 4> MAGIC{'S', 'D', 'S', '1'};
+
+  etl::array<char, 4> magic = MAGIC;
+  uint8_t bit_depth = 16;
+  uint32_t sample_period_ns = ENGINE_SAMPLE_PERIOD_NS;
+  uint32_t length_words = 0;
+  uint32_t pcm_bytes = 0;
+
+  constexpr bool describes(size_t pcm_size) const {
+    return magic == MAGIC && is_valid_bit_depth(bit_depth) &&
+           is_valid_sample_period(sample_period_ns) && length_words > 0 &&
+           pcm_bytes == pcm_size;
   }
 };
 
+// Writes "/NN.pcm" or "/NN.sds" for a sample number
+inline void sample_path(char (&path)[16], uint16_t sample_number,
+                        const char *extension) {
+  snprintf(path, sizeof(path), "/%02u.%s", sample_number, extension);
+}
+
 template <typename FileOperations> class Protocol {
 public:
   // A single sample transfer should take a few seconds at most; if no message
   // arrives for this long, assume the host has disconnected or errored out.
   static constexpr uint64_t TIMEOUT_US = 30000000; // 30 seconds
+  // Packet numbers are 7 bits, so a stale packet can only be told from one
+  // that arrived early while the window is well below 64.
+  static constexpr uint8_t MAX_ACK_WINDOW = 16;
 
   constexpr Protocol(FileOperations &file_ops, musin::Logger &logger)
       : file_ops_(file_ops), logger_(logger), state_(State::Idle),
-        expected_packet_num_(0), bytes_received_(0), current_sample_{},
+        expected_packet_num_(0), words_received_(0), current_sample_{},
         last_activity_time_{} {
   }
 
@@ -161,10 +207,25 @@ private:
   musin::Logger &logger_;
   State state_;
   uint8_t expected_packet_num_;
-  uint32_t bytes_received_;
+  uint32_t words_received_;
   SampleInfo current_sample_;
   absolute_time_t last_activity_time_;
 
+  // Converted samples are collected here and written when it fills and at
+  // the end of each packet, so the working memory is the same whatever the
+  // rate ratio.
+  static constexpr size_t OUTPUT_BUFFER_BYTES = 256;
+  RateConverter converter_{};
+  etl::array<uint8_t, OUTPUT_BUFFER_BYTES> output_{};
+  size_t output_pos_ = 0;
+  uint32_t pcm_bytes_ = 0;
+  bool write_failed_ = false;
+
+  // Windowed handshaking; a window of 1 ACKs every packet
+  uint8_t window_ = 1;
+  uint8_t packets_since_ack_ = 0;
+  bool nak_sent_ = false;
+
   // File handle wrapper (same pattern as existing protocol)
   struct File {
     constexpr File(FileOperations &file_ops, const etl::string_view &path)
@@ -205,18 +266,6 @@ private:
            ((static_cast<uint32_t>(b2) & 0x7F) << 14);
   }
 
-  // Unpack 16-bit sample from SDS 3-byte format
-  static constexpr int16_t unpack_16bit_sample(uint8_t b0, uint8_t b1,
-                                               uint8_t b2) {
-    // Reconstruct unsigned 16-bit value (left-justified in 3 bytes)
-    const uint16_t unsigned_sample = ((static_cast<uint16_t>(b0) & 0x7F) << 9) |
-                                     ((static_cast<uint16_t>(b1) & 0x7F) << 2) |
-                                     ((static_cast<uint16_t>(b2) & 0x7F) >> 5);
-
-    // Convert from SDS unsigned format (0x0000 = full negative) to signed
-    return static_cast<int16_t>(unsigned_sample - 0x8000);
-  }
-
   // Handle Cancel message
   constexpr Result handle_cancel_message() {
     logger_.info("SDS: Transfer cancelled by host.");
@@ -258,17 +307,24 @@ private:
     logger_.info("Bit depth:",
                  static_cast<uint32_t>(current_sample_.bit_depth));
     logger_.info("Sample rate:", current_sample_.get_sample_rate());
-    logger_.info("Length:", current_sample_.get_byte_length());
+    logger_.info("Length (words):", current_sample_.length_words);
 
     // Validate parameters
-    if (current_sample_.bit_depth != 16) {
-      logger_.error("SDS: Only 16-bit samples supported, got:",
+    if (!is_valid_bit_depth(current_sample_.bit_depth)) {
+      logger_.error("SDS: Unsupported bit depth:",
                     static_cast<uint32_t>(current_sample_.bit_depth));
       send_reply(NAK, 0);
       return Result::InvalidMessage;
     }
 
-    if (current_sample_.get_byte_length() == 0) {
+    if (!is_valid_sample_period(current_sample_.sample_period_ns)) {
+      logger_.error("SDS: Unsupported sample period (ns):",
+                    current_sample_.sample_period_ns);
+      send_reply(NAK, 0);
+      return Result::InvalidMessage;
+    }
+
+    if (current_sample_.length_words == 0) {
       logger_.error("SDS: Invalid sample length");
       send_reply(NAK, 0);
       return Result::InvalidMessage;
@@ -276,8 +332,7 @@ private:
 
     // Create filename from sample number
     char filename[16];
-    snprintf(filename, sizeof(filename), "/%02u.pcm",
-             current_sample_.sample_number);
+    sample_path(filename, current_sample_.sample_number, "pcm");
 
     // Open file for writing
     opened_file_.emplace(file_ops_, filename);
@@ -290,11 +345,24 @@ private:
     // Initialize receive state
     state_ = State::ReceivingData;
     expected_packet_num_ = 0;
-    bytes_received_ = 0;
+    words_received_ = 0;
+    converter_ = RateConverter{current_sample_.sample_period_ns,
+                               ENGINE_SAMPLE_PERIOD_NS};
+    output_pos_ = 0;
+    pcm_bytes_ = 0;
+    write_failed_ = false;
     last_activity_time_ = now;
 
-    logger_.info("SDS: Ready to receive data packets");
-    send_reply(ACK, 0);
+    const bool negotiates_window = message.size() > 17;
+    window_ = negotiates_window
+                  ? etl::clamp(message[17], uint8_t{1}, MAX_ACK_WINDOW)
+                  : uint8_t{1};
+    packets_since_ack_ = 0;
+    nak_sent_ = false;
+
+    logger_.info("SDS: Ready to receive data packets, window:",
+                 static_cast<uint32_t>(window_));
+    send_reply(ACK, negotiates_window ? window_ : 0);
     return Result::OK;
   }
 
@@ -327,17 +395,25 @@ private:
                     static_cast<uint32_t>(calculated_checksum));
       logger_.error("SDS: Checksum mismatch, got:",
                     static_cast<uint32_t>(received_checksum));
-      send_reply(NAK, packet_num);
+      if (window_ > 1) {
+        nak_gap(packet_num, send_reply);
+      } else {
+        send_reply(NAK, packet_num);
+      }
       return Result::ChecksumError;
     }
 
+    if (window_ > 1 && packet_num != expected_packet_num_) {
+      return handle_windowed_out_of_sequence(packet_num, send_reply, now);
+    }
+
     // Check packet sequence. A retransmission of the previous packet means
     // our ACK was lost in transit: re-ACK it without writing, or the data
     // would be appended twice and corrupt the sample. Anything else
     // out-of-sequence is NAKed so the host retries the packet we expect.
     if (packet_num != expected_packet_num_) {
       const uint8_t previous_packet_num = (expected_packet_num_ - 1) & 0x7F;
-      if (packet_num == previous_packet_num && bytes_received_ > 0) {
+      if (packet_num == previous_packet_num && words_received_ > 0) {
         logger_.warn("SDS: Duplicate packet re-ACKed:",
                      static_cast<uint32_t>(packet_num));
         last_activity_time_ = now;
@@ -354,63 +430,131 @@ private:
 
     last_activity_time_ = now;
 
-    // Unpack samples from data packet (40 samples, 3 bytes each)
-    etl::array<uint8_t, 80> unpacked_data; // 40 samples * 2 bytes each
-    size_t output_pos = 0;
-
-    for (size_t i = 0; i < 40 && output_pos < unpacked_data.size(); i++) {
-      const size_t data_offset = i * 3;
-      if (data_offset + 2 < data_span.size()) {
-        const int16_t sample = unpack_16bit_sample(data_span[data_offset],
-                                                   data_span[data_offset + 1],
-                                                   data_span[data_offset + 2]);
-
-        // Write as little-endian 16-bit
-        unpacked_data[output_pos++] = static_cast<uint8_t>(sample & 0xFF);
-        unpacked_data[output_pos++] =
-            static_cast<uint8_t>((sample >> 8) & 0xFF);
-      }
+    // Unpack the packet's words, converting them as they go. The final
+    // packet is padded past the end of the sample.
+    const uint8_t bit_depth = current_sample_.bit_depth;
+    const size_t word_bytes = bytes_per_word(bit_depth);
+    const uint32_t remaining_words =
+        current_sample_.length_words - words_received_;
+    const size_t word_count = etl::min(static_cast<size_t>(remaining_words),
+                                       words_per_packet(bit_depth));
+    for (size_t i = 0; i < word_count; ++i) {
+      converter_.push(unpack_word(&data_span[i * word_bytes], bit_depth),
+                      [this](int16_t sample) { stage_sample(sample); });
     }
+    words_received_ += word_count;
+    if (words_received_ >= current_sample_.length_words) {
+      converter_.finish([this](int16_t sample) { stage_sample(sample); });
+    }
+    flush_output();
 
-    // Determine how many bytes to actually write
-    const uint32_t remaining_bytes =
-        current_sample_.get_byte_length() - bytes_received_;
-    const size_t bytes_to_write =
-        etl::min(static_cast<size_t>(remaining_bytes), output_pos);
-
-    // Write unpacked samples to file
-    if (opened_file_ && opened_file_->is_valid()) {
-      const size_t written = opened_file_->write(
-          etl::span<const uint8_t>{unpacked_data.data(), bytes_to_write});
-
-      if (written != bytes_to_write) {
-        logger_.error("SDS: Failed to write sample data");
-        opened_file_.reset();
-        state_ = State::Idle;
-        send_reply(NAK, packet_num);
-        return Result::FileError;
-      }
-
-      bytes_received_ += written;
+    if (write_failed_) {
+      logger_.error("SDS: Failed to write sample data");
+      opened_file_.reset();
+      state_ = State::Idle;
+      send_reply(NAK, packet_num);
+      return Result::FileError;
     }
 
     // Update expected packet number (with wraparound)
     expected_packet_num_ = (packet_num + 1) & 0x7F;
 
-    logger_.info("SDS: Packet received, bytes:", bytes_received_);
+    logger_.info("SDS: Packet received, words:", words_received_);
 
     // Check if transfer is complete
-    if (bytes_received_ >= current_sample_.get_byte_length()) {
-      logger_.info("SDS: Sample transfer complete");
+    if (words_received_ >= current_sample_.length_words) {
+      logger_.info("SDS: Sample transfer complete, PCM bytes:", pcm_bytes_);
       opened_file_.reset();
+      store_format();
       state_ = State::Idle;
       send_reply(ACK, packet_num);
       return Result::SampleComplete;
     }
 
+    if (window_ > 1) {
+      // A resent packet that fills a gap is ACKed at once, so the host
+      // learns quickly how far it went back.
+      const bool filled_gap = nak_sent_;
+      nak_sent_ = false;
+      if (!filled_gap && ++packets_since_ack_ < (window_ + 1) / 2) {
+        return Result::OK;
+      }
+      packets_since_ack_ = 0;
+    }
     send_reply(ACK, packet_num);
     return Result::OK;
   }
+
+  template <typename Sender>
+  constexpr Result handle_windowed_out_of_sequence(uint8_t packet_num,
+                                                   Sender &send_reply,
+                                                   absolute_time_t now) {
+    last_activity_time_ = now;
+    const uint8_t offset = (packet_num - expected_packet_num_) & 0x7F;
+    if (offset < window_) {
+      // Sent after one that never arrived
+      nak_gap(packet_num, send_reply);
+      return Result::InvalidMessage;
+    }
+    // Already stored, so the host missed an ACK and went back
+    if (words_received_ > 0) {
+      send_reply(ACK, (expected_packet_num_ - 1) & 0x7F);
+    }
+    return Result::OK;
+  }
+
+  // The host resends everything from the NAKed packet, so a gap is NAKed
+  // once; only the resent packet itself, if damaged again, is NAKed again.
+  template <typename Sender>
+  constexpr void nak_gap(uint8_t packet_num, Sender &send_reply) {
+    if (!nak_sent_ || packet_num == expected_packet_num_) {
+      logger_.warn("SDS: Packet missing, NAK:",
+                   static_cast<uint32_t>(expected_packet_num_));
+      send_reply(NAK, expected_packet_num_);
+      nak_sent_ = true;
+    }
+  }
+
+  constexpr void stage_sample(int16_t sample) {
+    output_[output_pos_++] = static_cast<uint8_t>(sample & 0xFF);
+    output_[output_pos_++] = static_cast<uint8_t>((sample >> 8) & 0xFF);
+    if (output_pos_ == output_.size()) {
+      flush_output();
+    }
+  }
+
+  constexpr void flush_output() {
+    if (output_pos_ == 0 || write_failed_) {
+      output_pos_ = 0;
+      return;
+    }
+    const size_t written = opened_file_.has_value()
+                               ? opened_file_->write(etl::span<const uint8_t>{
+                                     output_.data(), output_pos_})
+                               : 0;
+    write_failed_ = written != output_pos_;
+    pcm_bytes_ += static_cast<uint32_t>(written);
+    output_pos_ = 0;
+  }
+
+  // Records the received format for dump requests. A sample that is played
+  // fine but cannot be described is still a complete transfer.
+  void store_format() {
+    StoredFormat format{};
+    format.bit_depth = current_sample_.bit_depth;
+    format.sample_period_ns = current_sample_.sample_period_ns;
+    format.length_words = current_sample_.length_words;
+    format.pcm_bytes = pcm_bytes_;
+
+    char filename[16];
+    sample_path(filename, current_sample_.sample_number, "sds");
+    File file(file_ops_, filename);
+    const auto bytes = etl::span<const uint8_t>{
+        reinterpret_cast<const uint8_t *>(&format), sizeof(format)};
+    if (!file.is_valid() || file.write(bytes) != bytes.size()) {
+      logger_.warn("SDS: Could not store the sample format");
+    }
+  }
 };
 
 } // namespace sds
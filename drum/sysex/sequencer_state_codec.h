@@ -93,6 +93,31 @@ decode_sequencer_state(const etl::span<const uint8_t> &input) {
   return state;
 }
 
+/**
+ * @brief Wire payload of SetRandomSeed: a 32-bit seed as five 7-bit groups,
+ * least significant first.
+ */
+static constexpr size_t RANDOM_SEED_PAYLOAD_SIZE = 5;
+
+/**
+ * @brief Decodes a SetRandomSeed payload.
+ *
+ * @param input SysEx payload data
+ * @return The seed, or nullopt if the payload is too short
+ */
+inline etl::optional<uint32_t>
+decode_random_seed(const etl::span<const uint8_t> &input) {
+  if (input.size() < RANDOM_SEED_PAYLOAD_SIZE) {
+    return etl::nullopt;
+  }
+
+  uint32_t seed = 0;
+  for (size_t i = 0; i < RANDOM_SEED_PAYLOAD_SIZE; ++i) {
+    seed |= static_cast<uint32_t>(input[i] & 0x7F) << (7 * i);
+  }
+  return seed;
+}
+
 } // namespace sysex
 
 #endif // DRUM_SYSEX_SEQUENCER_STATE_CODEC_H
@@ -4,6 +4,7 @@
 #include "etl/algorithm.h"
 #include "etl/array.h"
 #include "events.h"
+#include "musin/midi/midi_input_queue.h"
 #include "musin/midi/midi_wrapper.h"
 #include "version.h"
 #include <boot/picoboot_constants.h>
@@ -24,6 +25,36 @@ void send_sds_message(const etl::span<const uint8_t> &payload) {
   msg[3 + payload.size()] = 0xF7;
   MIDI::sendSysEx(payload.size() + 4, msg.data());
 }
+
+// Sends a custom protocol reply: the tag, then an optional short payload.
+void send_custom_reply(uint8_t tag, etl::span<const uint8_t> payload = {}) {
+  static constexpr size_t MAX_REPLY_PAYLOAD =
+      sysex::Protocol<StandardFileOps>::FILE_STAT_PAYLOAD_SIZE;
+  etl::array<uint8_t, 7 + MAX_REPLY_PAYLOAD> msg{
+      0xF0,
+      drum::config::sysex::MANUFACTURER_ID_0,
+      drum::config::sysex::MANUFACTURER_ID_1,
+      drum::config::sysex::MANUFACTURER_ID_2,
+      drum::config::sysex::DEVICE_ID,
+      tag};
+  size_t length = 6;
+  for (size_t i = 0; i < payload.size() && i < MAX_REPLY_PAYLOAD; ++i) {
+    msg[length++] = payload[i];
+  }
+  msg[length++] = 0xF7;
+  MIDI::sendSysEx(length, msg.data());
+}
+
+// Windowed transfer and FileStat replies carry a payload after the tag
+const auto send_protocol_reply = [](sysex::Protocol<StandardFileOps>::Tag tag,
+                                    etl::span<const uint8_t> payload = {}) {
+  send_custom_reply(static_cast<uint8_t>(tag), payload);
+};
+
+const auto send_kit_reply = [](sysex::KitTransfer<StandardFileOps>::Tag tag,
+                               etl::span<const uint8_t> payload = {}) {
+  send_custom_reply(static_cast<uint8_t>(tag), payload);
+};
 } // namespace
 
 SysExHandler::SysExHandler(ConfigurationManager &config_manager,
@@ -32,13 +63,18 @@ SysExHandler::SysExHandler(ConfigurationManager &config_manager,
                            musin::filesystem::Filesystem &filesystem)
     : config_manager_(config_manager), settings_manager_(settings_manager),
       logger_(logger), filesystem_(filesystem), file_ops_(logger, filesystem),
-      protocol_(file_ops_, logger), sds_protocol_(file_ops_, logger),
+      protocol_(file_ops_, logger), kit_transfer_(file_ops_, logger),
+      sds_protocol_(file_ops_, logger),
       sds_dump_sender_(file_ops_, logger), firmware_writer_(logger),
       firmware_update_(firmware_writer_, logger) {
 }
 
 void SysExHandler::update(absolute_time_t now) {
+  file_ops_.service(drum::config::sysex::WRITE_BUDGET_US);
   protocol_.check_timeout(now);
+  protocol_.service(send_protocol_reply);
+  kit_transfer_.service(send_kit_reply);
+  kit_transfer_.check_timeout(now);
   sds_protocol_.check_timeout(now);
   sds_dump_sender_.update(send_sds_message, now);
   firmware_update_.check_timeout(now);
@@ -111,6 +147,39 @@ void SysExHandler::update(absolute_time_t now) {
     last_notified_sample_slot_ = current_sample_slot;
   }
 
+  // A received file is only read back once its staged data is on flash
+  if (file_ops_.finishing_write()) {
+    return;
+  }
+  if (write_metrics_pending_) {
+    const auto &writer = file_ops_.writer();
+    logger_.info("SysEx: File written, peak staged bytes:",
+                 static_cast<uint32_t>(writer.peak_bytes_pending()));
+    logger_.info("SysEx: Worst flash write stall (us):",
+                 writer.worst_stall_us());
+    const auto &input = musin::midi::sysex_input_stats();
+    logger_.info("SysEx: Peak input ring bytes:", input.peak_bytes);
+    logger_.info("SysEx: Input messages dropped:", input.dropped);
+    const MIDI::DinStats din = MIDI::din_stats();
+    logger_.info("SysEx: DIN RX overruns:", din.rx_overruns);
+    logger_.info("SysEx: Peak DIN RX bytes:",
+                 static_cast<uint32_t>(din.rx_peak_depth));
+    logger_.info("SysEx: DIN TX starvations:", din.tx_starvations);
+    write_metrics_pending_ = false;
+  }
+  if (pending_sample_invalidation_.has_value()) {
+    if (sample_slot_manager_ != nullptr) {
+      sample_slot_manager_->invalidate_sample(
+          pending_sample_invalidation_.value());
+    }
+    pending_sample_invalidation_.reset();
+  }
+  if (pending_kit_invalidation_) {
+    if (sample_slot_manager_ != nullptr) {
+      sample_slot_manager_->invalidate_all();
+    }
+    pending_kit_invalidation_ = false;
+  }
   if (new_file_received_) {
     logger_.info("SysExHandler: New file received, reloading configuration.");
     config_manager_.load();
@@ -183,8 +252,8 @@ void SysExHandler::handle_sysex_message(const sysex::Chunk &chunk) {
     switch (result) {
     case sds::Result::SampleComplete:
       logger_.info("SDS: Sample transfer completed successfully");
-      if (sample_slot_manager_ != nullptr && active_sample_slot.has_value()) {
-        sample_slot_manager_->invalidate_sample(active_sample_slot.value());
+      if (active_sample_slot.has_value()) {
+        pending_sample_invalidation_ = active_sample_slot.value();
       }
       on_file_received();
       break;
@@ -207,20 +276,14 @@ void SysExHandler::handle_sysex_message(const sysex::Chunk &chunk) {
     return;
   }
 
-  // Not an SDS message - route to existing custom protocol
-  auto sender = [this](sysex::Protocol<StandardFileOps>::Tag tag) {
-    uint8_t msg[] = {0xF0,
-                     drum::config::sysex::MANUFACTURER_ID_0,
-                     drum::config::sysex::MANUFACTURER_ID_1,
-                     drum::config::sysex::MANUFACTURER_ID_2,
-                     drum::config::sysex::DEVICE_ID,
-                     static_cast<uint8_t>(tag),
-                     0xF7};
-    MIDI::sendSysEx(sizeof(msg), msg);
-  };
+  if (sysex::KitTransfer<StandardFileOps>::claims(chunk)) {
+    handle_kit_transfer_message(chunk, get_absolute_time());
+    return;
+  }
 
-  auto result = protocol_.template handle_chunk<decltype(sender)>(
-      chunk, sender, get_absolute_time());
+  // Not an SDS message - route to existing custom protocol
+  auto result = protocol_.handle_chunk(chunk, send_protocol_reply,
+                                       get_absolute_time());
 
   switch (result) {
   case sysex::Protocol<StandardFileOps>::Result::FileWritten:
@@ -248,6 +311,20 @@ void SysExHandler::handle_sysex_message(const sysex::Chunk &chunk) {
     handle_set_sequencer_state(payload);
     break;
   }
+  case sysex::Protocol<StandardFileOps>::Result::SetRandomSeed: {
+    const auto payload_start =
+        chunk.cbegin() + sysex::SYSEX_CHUNK_PAYLOAD_OFFSET;
+    const auto payload = etl::span<const uint8_t>{payload_start, chunk.cend()};
+    handle_set_random_seed(payload);
+    break;
+  }
+  case sysex::Protocol<StandardFileOps>::Result::SetPatternChain: {
+    const auto payload_start =
+        chunk.cbegin() + sysex::SYSEX_CHUNK_PAYLOAD_OFFSET;
+    const auto payload = etl::span<const uint8_t>{payload_start, chunk.cend()};
+    handle_set_pattern_chain(payload);
+    break;
+  }
   case sysex::Protocol<StandardFileOps>::Result::GetSetting: {
     const auto payload_start =
         chunk.cbegin() + sysex::SYSEX_CHUNK_PAYLOAD_OFFSET;
@@ -269,8 +346,9 @@ void SysExHandler::handle_sysex_message(const sysex::Chunk &chunk) {
 }
 
 bool SysExHandler::is_busy() const {
-  return protocol_.busy() || sds_protocol_.is_busy() ||
-         sds_dump_sender_.is_busy() || firmware_update_.busy();
+  return protocol_.busy() || kit_transfer_.busy() ||
+         sds_protocol_.is_busy() || sds_dump_sender_.is_busy() ||
+         firmware_update_.busy() || file_ops_.finishing_write();
 }
 
 void SysExHandler::set_firmware_update_allowed(bool allowed) {
@@ -326,8 +404,31 @@ void SysExHandler::handle_firmware_update_message(const sysex::Chunk &chunk,
   }
 }
 
+void SysExHandler::handle_kit_transfer_message(const sysex::Chunk &chunk,
+                                               absolute_time_t now) {
+  using Kit = sysex::KitTransfer<StandardFileOps>;
+  if (chunk[4] == Kit::Tag::BeginKitTransfer &&
+      (protocol_.busy() || sds_protocol_.is_busy() ||
+       sds_dump_sender_.is_busy() || firmware_update_.busy())) {
+    logger_.warn("SysEx: Kit transfer refused during another transfer.");
+    send_kit_reply(Kit::Tag::Nack);
+    return;
+  }
+
+  if (kit_transfer_.handle_chunk(chunk, send_kit_reply, now) ==
+      Kit::Result::KitCommitted) {
+    pending_kit_invalidation_ = true;
+    on_file_received();
+  }
+}
+
+void SysExHandler::recover_kit_transfer() {
+  kit_transfer_.recover();
+}
+
 void SysExHandler::on_file_received() {
   new_file_received_ = true;
+  write_metrics_pending_ = true;
 }
 
 void SysExHandler::print_firmware_version() const {
@@ -549,6 +650,45 @@ void SysExHandler::handle_set_setting(const etl::span<const uint8_t> &payload) {
   send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Ack);
 }
 
+void SysExHandler::handle_set_random_seed(
+    const etl::span<const uint8_t> &payload) {
+  if (!sequencer_state_access_) {
+    logger_.error("SysEx: Cannot set random seed - accessor not set");
+    send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Nack);
+    return;
+  }
+
+  const auto maybe_seed = sysex::decode_random_seed(payload);
+  if (!maybe_seed.has_value()) {
+    logger_.error("SysEx: SetRandomSeed payload too short");
+    send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Nack);
+    return;
+  }
+
+  sequencer_state_access_->set_random_seed(maybe_seed.value());
+  logger_.info("SysEx: Random seed set", maybe_seed.value());
+  send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Ack);
+}
+
+void SysExHandler::handle_set_pattern_chain(
+    const etl::span<const uint8_t> &payload) {
+  if (!sequencer_state_access_) {
+    logger_.error("SysEx: Cannot set pattern chain - accessor not set");
+    send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Nack);
+    return;
+  }
+
+  if (!sequencer_state_access_->set_pattern_chain(payload)) {
+    logger_.error("SysEx: SetPatternChain refused");
+    send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Nack);
+    return;
+  }
+
+  logger_.info("SysEx: Pattern chain set, length",
+               static_cast<uint32_t>(payload.size()));
+  send_reply_tag(sysex::Protocol<StandardFileOps>::Tag::Ack);
+}
+
 void SysExHandler::send_universal_identity_response() const {
   logger_.info("Sending universal SysEx identity response");
 
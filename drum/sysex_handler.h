@@ -6,6 +6,7 @@
 #include "drum/settings_manager.h"
 #include "drum/standard_file_ops.h"
 #include "drum/sysex/firmware_update.h"
+#include "drum/sysex/kit_transfer.h"
 #include "drum/sysex/protocol.h"
 #include "drum/sysex/sds_dump_sender.h"
 #include "drum/sysex/sds_protocol.h"
@@ -43,12 +44,19 @@ public:
   void handle_sysex_message(const sysex::Chunk &chunk);
 
   /**
-   * @brief Checks if a file transfer is currently in progress.
+   * @brief Checks if a file transfer is currently in progress, including
+   * received data still being written to flash.
    */
   bool is_busy() const;
 
   void on_file_received();
 
+  /**
+   * @brief Finishes a kit commit that a reset interrupted. Call once the
+   * filesystem is mounted and before the kit configuration is loaded.
+   */
+  void recover_kit_transfer();
+
   /**
    * @brief Gates BeginFirmwareUpdate. Disallowed while a trial-booted
    * firmware has not yet committed itself.
@@ -64,13 +72,16 @@ public:
 
   /**
    * @brief Wires the sample slot manager so a completed SDS sample
-   * transfer invalidates any RAM copy of the rewritten slot.
+   * transfer invalidates any RAM copy of the rewritten slot, once the
+   * sample has been written to flash.
    */
   void set_sample_slot_manager(SampleSlotManager *sample_slot_manager);
 
 private:
   void handle_firmware_update_message(const sysex::Chunk &chunk,
                                       absolute_time_t now);
+  void handle_kit_transfer_message(const sysex::Chunk &chunk,
+                                   absolute_time_t now);
   void notify_firmware_update_progress();
   void print_firmware_version() const;
   void print_serial_number() const;
@@ -78,6 +89,8 @@ private:
   void send_universal_identity_response() const;
   void send_sequencer_state() const;
   void handle_set_sequencer_state(const etl::span<const uint8_t> &payload);
+  void handle_set_random_seed(const etl::span<const uint8_t> &payload);
+  void handle_set_pattern_chain(const etl::span<const uint8_t> &payload);
   void send_setting_value(const etl::span<const uint8_t> &payload) const;
   void handle_set_setting(const etl::span<const uint8_t> &payload);
 
@@ -90,11 +103,16 @@ private:
 
   StandardFileOps file_ops_;
   sysex::Protocol<StandardFileOps> protocol_;
+  sysex::KitTransfer<StandardFileOps> kit_transfer_;
   sds::Protocol<StandardFileOps> sds_protocol_;
   sds::DumpSender<StandardFileOps> sds_dump_sender_;
   musin::flash::FirmwareWriter firmware_writer_;
   sysex::FirmwareUpdate<musin::flash::FirmwareWriter> firmware_update_;
   bool new_file_received_ = false;
+  bool write_metrics_pending_ = false;
+  // Applied once the sample's staged data has been written
+  std::optional<size_t> pending_sample_invalidation_ = std::nullopt;
+  bool pending_kit_invalidation_ = false;
   bool was_busy_ = false;
   std::optional<uint8_t> last_notified_sample_slot_ = std::nullopt;
   bool firmware_update_allowed_ = true;
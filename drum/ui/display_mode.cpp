@@ -114,14 +114,20 @@ void SequencerDisplayMode::draw_sequencer_state(PizzaDisplay &display,
       continue;
 
     const auto &track_data = sequencer.get_track(track_idx);
+    const std::optional<uint8_t> track_note = track_data.get_note();
+    const uint64_t enabled_steps = track_data.enabled_mask();
 
     for (size_t step_idx = 0; step_idx < config::NUM_STEPS_PER_TRACK;
          ++step_idx) {
       if (step_idx >= PizzaDisplay::SEQUENCER_STEPS_DISPLAYED)
         continue;
 
-      const auto &step = track_data.get_step(step_idx);
-      Color base_step_color = calculate_step_color(display, step);
+      // Disabled steps are dark; skip the color lookup for them.
+      Color base_step_color =
+          ((enabled_steps >> step_idx) & 1u)
+              ? calculate_step_color(display, track_data.get_step(step_idx),
+                                     track_note)
+              : Color(0);
       Color final_color = base_step_color;
 
       // Pad-hit traces only show on steps that display as empty; steps with
@@ -253,12 +259,13 @@ void SequencerDisplayMode::draw_animations(PizzaDisplay &display,
 }
 
 Color SequencerDisplayMode::calculate_step_color(
-    const PizzaDisplay &display, const musin::timing::Step &step) {
+    const PizzaDisplay &display, const musin::timing::Step &step,
+    std::optional<uint8_t> note) {
   Color color(0);
 
-  if (step.enabled && step.note.has_value()) {
+  if (step.is_enabled() && note.has_value()) {
     std::optional<Color> base_color_opt =
-        display.get_color_for_midi_note(step.note.value());
+        display.get_color_for_midi_note(note.value());
 
     if (!base_color_opt.has_value()) {
       return Color(0);
@@ -266,9 +273,9 @@ Color SequencerDisplayMode::calculate_step_color(
     Color base_color = base_color_opt.value();
 
     uint8_t brightness = PizzaDisplay::MAX_BRIGHTNESS;
-    if (step.velocity.has_value()) {
+    if (step.velocity > 0) {
       uint16_t calculated_brightness =
-          static_cast<uint16_t>(step.velocity.value()) *
+          static_cast<uint16_t>(step.velocity) *
           PizzaDisplay::VELOCITY_TO_BRIGHTNESS_SCALE;
       brightness = static_cast<uint8_t>(
           std::min(calculated_brightness,
@@ -40,7 +40,8 @@ private:
   void draw_sequencer_state(PizzaDisplay &display, absolute_time_t now);
   void update_track_override_colors(PizzaDisplay &display) const;
   static Color calculate_step_color(const PizzaDisplay &display,
-                                    const musin::timing::Step &step);
+                                    const musin::timing::Step &step,
+                                    std::optional<uint8_t> note);
   static Color apply_pulsing_highlight(Color base_color, bool bright_phase);
   void sync_highlight_phase_with_step();
   bool is_highlight_bright(const PizzaDisplay &display) const;
@@ -117,6 +117,17 @@ void PizzaDisplay::deinit() {
 }
 
 void PizzaDisplay::update(absolute_time_t now) {
+  if (note_events_ != nullptr) {
+    note_events_->drain(
+        [this](const drum::Events::NoteEvent &event) { notification(event); });
+  }
+  if (parameter_changes_ != nullptr) {
+    parameter_changes_->drain(
+        [this](const drum::Events::ParameterChangeEvent &event) {
+          notification(event);
+        });
+  }
+
   if (current_mode_) {
     current_mode_->draw(*this, now);
   }
@@ -33,9 +33,7 @@ class SleepDisplayMode;
 
 class PizzaDisplay
     : public etl::observer<musin::timing::TempoEvent>,
-      public etl::observer<drum::Events::NoteEvent>,
-      public etl::observer<drum::Events::SysExTransferStateChangeEvent>,
-      public etl::observer<drum::Events::ParameterChangeEvent> {
+      public etl::observer<drum::Events::SysExTransferStateChangeEvent> {
 public:
   friend class ui::SequencerDisplayMode;
   friend class ui::FileTransferDisplayMode;
@@ -77,7 +75,18 @@ public:
   void deinit();
 
   /**
-   * @brief Updates the entire display by drawing all elements and sending to
+   * @brief Sets the rings update() takes note and parameter events from.
+   * Either may be nullptr.
+   */
+  void set_event_sources(NoteEventBus::Consumer *note_events,
+                         ParameterChangeEventBus::Consumer *parameter_changes) {
+    note_events_ = note_events;
+    parameter_changes_ = parameter_changes;
+  }
+
+  /**
+   * @brief Applies the note and parameter events queued since the last frame,
+   * then updates the entire display by drawing all elements and sending to
    * hardware. This should be the primary method called from the main loop.
    * @param now The current absolute time, used for animations.
    */
@@ -241,6 +250,9 @@ private:
   float _filter_value = 0.0f;
   float _crush_value = 0.0f;
 
+  NoteEventBus::Consumer *note_events_ = nullptr;
+  ParameterChangeEventBus::Consumer *parameter_changes_ = nullptr;
+
   // Strategy pattern members
   // TODO: When adding StandbyState, this becomes implementation detail of
   // system-level state machine
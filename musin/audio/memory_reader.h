@@ -72,7 +72,7 @@ struct MemorySampleReader : SampleReader {
   }
 
   // Reader interface
-  constexpr void reset() override {
+  constexpr void __time_critical_func(reset)() override {
     reader.reset();
     m_buffer_read_idx = 0;
     m_buffer_valid_samples = 0;
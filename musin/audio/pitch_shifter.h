@@ -209,7 +209,7 @@ struct PitchShifter : SampleReader {
   }
 
   // Reader interface
-  void reset() override {
+  void __time_critical_func(reset)() override {
     sample_reader.reset();
 
     // Zero out the interpolation buffer to prevent clicks from stale data.
@@ -0,0 +1,68 @@
+#ifndef MUSIN_AUDIO_RENDER_CLOCK_H
+#define MUSIN_AUDIO_RENDER_CLOCK_H
+
+#include "audio_output.h"
+#include "buffer_source.h"
+#include "port/section_macros.h"
+#include <cstdint>
+
+extern "C" {
+#include "pico/time.h"
+}
+
+namespace musin::audio {
+
+/**
+ * @brief Pass-through source that counts rendered frames and notes when each
+ * block was rendered, so event timestamps can be mapped to sample positions.
+ *
+ * Blocks are rendered a fixed number of buffers ahead of playback, so an
+ * event placed at frame_at(timestamp + latency) sounds a constant time after
+ * its timestamp, regardless of when the main loop got round to it.
+ *
+ * fill_buffer() runs in the audio interrupt; read the accessors from the main
+ * loop with that interrupt masked so the frame and time pair stays coherent.
+ */
+struct RenderClock : ::BufferSource {
+  explicit RenderClock(::BufferSource &source) : source(source) {
+  }
+
+  void __time_critical_func(fill_buffer)(::AudioBlock &out_samples) override {
+    block_time_us = time_us_32();
+    block_frame = next_block_frame;
+    source.fill_buffer(out_samples);
+    next_block_frame += out_samples.size();
+  }
+
+  /** @brief First frame of the block being (or last) rendered. */
+  uint32_t block_start_frame() const {
+    return block_frame;
+  }
+
+  /** @brief First frame of the next block; earlier frames are rendered. */
+  uint32_t next_frame() const {
+    return next_block_frame;
+  }
+
+  /**
+   * @brief Frame that corresponds to @p time_us (time_us_32 scale) on the
+   * timeline of the last rendered block. May be earlier than next_frame()
+   * for events that are already too late to place.
+   */
+  uint32_t frame_at(uint32_t time_us) const {
+    const int32_t elapsed_us = static_cast<int32_t>(time_us - block_time_us);
+    const int64_t frames = static_cast<int64_t>(elapsed_us) *
+                           ::AudioOutput::SAMPLE_FREQUENCY / 1'000'000;
+    return block_frame + static_cast<uint32_t>(frames);
+  }
+
+private:
+  ::BufferSource &source;
+  uint32_t block_time_us = 0;
+  uint32_t block_frame = 0;
+  uint32_t next_block_frame = 0;
+};
+
+} // namespace musin::audio
+
+#endif // MUSIN_AUDIO_RENDER_CLOCK_H
@@ -9,7 +9,7 @@ struct Sound : BufferSource {
   Sound(SampleReader &reader) : pitch_shifter(reader) {
   }
 
-  void play(const double speed) {
+  void __not_in_flash_func(play)(const double speed) {
     // printf("Playing drum\n");
     pitch_shifter.set_speed(speed);
     pitch_shifter.reset();
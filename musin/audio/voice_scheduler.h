@@ -0,0 +1,114 @@
+#ifndef MUSIN_AUDIO_VOICE_SCHEDULER_H
+#define MUSIN_AUDIO_VOICE_SCHEDULER_H
+
+#include "block.h"
+#include "etl/array.h"
+#include "port/section_macros.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace musin::audio {
+
+/**
+ * @brief Starts a voice's sounds on exact render frames.
+ *
+ * Triggers wait in a short frame-ordered queue until the block holding their
+ * frame is rendered. A sound started mid-block is rendered in whole blocks
+ * and delayed by its start offset; the samples pushed past the end of a block
+ * are carried into the next one. A trigger whose frame has already been
+ * rendered starts at the block start.
+ *
+ * @tparam Trigger Holds a `uint32_t frame`, the render frame the sound starts
+ *         on, plus whatever the voice needs to start it.
+ * @tparam MaxPending Triggers that can wait at once.
+ */
+template <typename Trigger, size_t MaxPending> class VoiceScheduler {
+public:
+  /** @return false if the queue is full and the trigger was dropped. */
+  bool schedule(const Trigger &trigger) {
+    if (pending_count_ == MaxPending) {
+      return false;
+    }
+    // Keep frame order: an untimed trigger can land before queued MIDI ones.
+    size_t index = pending_count_;
+    while (index > 0 && static_cast<int32_t>(pending_[index - 1].frame -
+                                             trigger.frame) > 0) {
+      pending_[index] = pending_[index - 1];
+      --index;
+    }
+    pending_[index] = trigger;
+    ++pending_count_;
+    return true;
+  }
+
+  /** @brief Drops the triggers that have not started yet. */
+  void clear() {
+    pending_count_ = 0;
+  }
+
+  size_t pending_count() const {
+    return pending_count_;
+  }
+
+  /**
+   * @brief Renders the block starting at frame @p block_start.
+   *
+   * @p voice provides `start(const Trigger &)`, which makes the trigger its
+   * sounding one, and `render(AudioBlock &)`, which renders the next block of
+   * the sounding trigger from where it left off.
+   */
+  template <typename Voice>
+  void __time_critical_func(fill_buffer)(AudioBlock &out_samples,
+                                         uint32_t block_start, Voice &voice) {
+    const size_t size = out_samples.size();
+
+    // The sounding trigger, shifted by its start offset
+    if (start_offset_ == 0) {
+      voice.render(out_samples);
+    } else {
+      AudioBlock rendered;
+      voice.render(rendered);
+      for (size_t i = 0; i < start_offset_; ++i) {
+        out_samples[i] = carry_[i];
+        carry_[i] = rendered[size - start_offset_ + i];
+      }
+      for (size_t i = start_offset_; i < size; ++i) {
+        out_samples[i] = rendered[i - start_offset_];
+      }
+    }
+
+    // Triggers falling in this block cut in at their frame
+    while (pending_count_ > 0) {
+      const int32_t offset =
+          static_cast<int32_t>(pending_[0].frame - block_start);
+      if (offset >= static_cast<int32_t>(size)) {
+        break;
+      }
+      voice.start(pending_[0]);
+      for (size_t i = 1; i < pending_count_; ++i) {
+        pending_[i - 1] = pending_[i];
+      }
+      --pending_count_;
+
+      start_offset_ = offset > 0 ? static_cast<uint32_t>(offset) : 0;
+      AudioBlock rendered;
+      voice.render(rendered);
+      for (size_t i = start_offset_; i < size; ++i) {
+        out_samples[i] = rendered[i - start_offset_];
+      }
+      for (size_t i = 0; i < start_offset_; ++i) {
+        carry_[i] = rendered[size - start_offset_ + i];
+      }
+    }
+  }
+
+private:
+  uint32_t start_offset_ = 0;
+  AudioBlock carry_;
+  etl::array<Trigger, MaxPending> pending_{};
+  size_t pending_count_ = 0;
+};
+
+} // namespace musin::audio
+
+#endif // MUSIN_AUDIO_VOICE_SCHEDULER_H
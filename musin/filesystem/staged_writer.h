@@ -0,0 +1,268 @@
+#ifndef MUSIN_FILESYSTEM_STAGED_WRITER_H_
+#define MUSIN_FILESYSTEM_STAGED_WRITER_H_
+
+#include "etl/array.h"
+#include "etl/span.h"
+
+extern "C" {
+#include "pico/time.h"
+}
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace musin::filesystem {
+
+/**
+ * @brief File policy for StagedWriter backed by stdio (littlefs on the
+ * device, through pico-vfs).
+ */
+struct StdioFile {
+  bool open(const char *path, bool append) {
+    file_ = fopen(path, append ? "ab" : "wb");
+    return file_ != nullptr;
+  }
+
+  size_t write(etl::span<const uint8_t> bytes) {
+    return file_ ? fwrite(bytes.data(), 1, bytes.size(), file_) : 0;
+  }
+
+  bool close() {
+    if (!file_) {
+      return false;
+    }
+    const bool ok = fflush(file_) == 0 && fclose(file_) == 0;
+    file_ = nullptr;
+    return ok;
+  }
+
+private:
+  FILE *file_ = nullptr;
+};
+
+/**
+ * @brief Stages the data of one file being written in a RAM ring and writes
+ * it out in steps of StepSize bytes from the main loop.
+ *
+ * A flash write step can stall for a full erase (tens of milliseconds), and
+ * that cost cannot be split. What can be bounded is how many steps land on
+ * one loop pass: service() writes steps until its time budget is spent, so
+ * the loop gets back to audio, sequencer and MIDI work between them. A ring
+ * that fills up falls back to writing steps synchronously, so data is never
+ * refused.
+ *
+ * Closing is deferred until the ring has drained. Opening the next file
+ * first completes the previous one. Each open file gets an id, so a stale
+ * handle cannot write to or close its successor.
+ *
+ * @tparam File Provides bool open(const char *, bool append),
+ *              size_t write(span) and bool close().
+ * @tparam Capacity Ring size in bytes.
+ * @tparam StepSize Bytes written per step; only the final step of a file
+ *                  may be shorter.
+ */
+template <typename File, size_t Capacity, size_t StepSize>
+class StagedWriter {
+public:
+  static_assert(Capacity % StepSize == 0,
+                "The ring must hold a whole number of steps");
+
+  StagedWriter() = default;
+  explicit StagedWriter(const File &file) : file_(file) {
+  }
+
+  StagedWriter(const StagedWriter &) = delete;
+  StagedWriter &operator=(const StagedWriter &) = delete;
+
+  /**
+   * @brief Completes any previous file, then opens @p path, truncating it
+   * unless @p append is set.
+   * @return The new file's id, or 0 if it could not be opened.
+   */
+  uint32_t open(const char *path, bool append = false) {
+    close_current();
+    complete();
+    failed_ = false;
+    if (!file_.open(path, append)) {
+      return 0;
+    }
+    if (++file_id_ == 0) {
+      file_id_ = 1;
+    }
+    open_ = true;
+    return file_id_;
+  }
+
+  /**
+   * @brief Copies @p bytes into the ring, writing steps first if it is full.
+   * @return bytes.size(), or 0 if @p id is not the open file or a write
+   * has failed.
+   */
+  size_t stage(uint32_t id, etl::span<const uint8_t> bytes) {
+    size_t staged = 0;
+    while (staged < bytes.size()) {
+      const etl::span<uint8_t> space = reserve(id);
+      if (space.empty()) {
+        return 0;
+      }
+      const size_t length = std::min(bytes.size() - staged, space.size());
+      std::copy_n(bytes.begin() + staged, length, space.begin());
+      commit(id, length);
+      staged += length;
+    }
+    return bytes.size();
+  }
+
+  /**
+   * @brief Free ring space, up to the end of the ring, for the caller to
+   * fill in place and then commit(); a step is written first if the ring is
+   * full, so the span is never empty for the open file.
+   * @return An empty span if @p id is not the open file or a write has
+   * failed.
+   */
+  etl::span<uint8_t> reserve(uint32_t id) {
+    if (!open_ || id != file_id_ || failed_) {
+      return {};
+    }
+    if (count_ == Capacity && !write_step()) {
+      return {};
+    }
+    const size_t tail = (head_ + count_) % Capacity;
+    return etl::span<uint8_t>{ring_.data() + tail,
+                              std::min(Capacity - count_, Capacity - tail)};
+  }
+
+  /**
+   * @brief Stages the first @p count bytes of the span from the last
+   * reserve() for file @p id.
+   */
+  void commit(uint32_t id, size_t count) {
+    if (!open_ || id != file_id_ || failed_) {
+      return;
+    }
+    count_ += count;
+    peak_pending_ = std::max(peak_pending_, count_);
+  }
+
+  /**
+   * @brief Closes file @p id once everything staged has been written.
+   * @return false if a write for it has already failed.
+   */
+  bool finish(uint32_t id) {
+    if (!open_ || id != file_id_) {
+      return false;
+    }
+    open_ = false;
+    closing_ = true;
+    if (count_ == 0) {
+      close_file();
+    }
+    return !failed_;
+  }
+
+  /**
+   * @brief Writes steps until @p budget_us has passed, at least one if a
+   * whole step is pending. A short final step is only written once the file
+   * is finishing.
+   */
+  void service(uint32_t budget_us) {
+    const uint32_t start = time_us_32();
+    while (!failed_ && (count_ >= StepSize || (closing_ && count_ > 0))) {
+      write_step();
+      if (time_us_32() - start >= budget_us) {
+        break;
+      }
+    }
+    if (closing_ && (count_ == 0 || failed_)) {
+      close_file();
+    }
+  }
+
+  /**
+   * @brief Writes everything staged, and closes a finishing file.
+   * @return false if a write failed.
+   */
+  bool complete() {
+    while (count_ > 0 && !failed_) {
+      write_step();
+    }
+    if (closing_) {
+      close_file();
+    }
+    return !failed_;
+  }
+
+  /** @brief A file has been closed but still has data to write. */
+  bool finishing() const {
+    return closing_;
+  }
+
+  size_t bytes_pending() const {
+    return count_;
+  }
+
+  /** @brief Most bytes staged at once since boot. */
+  size_t peak_bytes_pending() const {
+    return peak_pending_;
+  }
+
+  /** @brief Longest single write step since boot. */
+  uint32_t worst_stall_us() const {
+    return worst_stall_us_;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+
+private:
+  bool write_step() {
+    const size_t length = std::min({count_, StepSize, Capacity - head_});
+    const uint32_t start = time_us_32();
+    const size_t written = file_.write(
+        etl::span<const uint8_t>{ring_.data() + head_, length});
+    worst_stall_us_ = std::max(worst_stall_us_, time_us_32() - start);
+
+    if (written != length) {
+      failed_ = true;
+      head_ = 0;
+      count_ = 0;
+      return false;
+    }
+    head_ = (head_ + length) % Capacity;
+    count_ -= length;
+    return true;
+  }
+
+  // An open file being replaced is finished first, as a handle close would.
+  void close_current() {
+    if (open_) {
+      open_ = false;
+      closing_ = true;
+    }
+  }
+
+  void close_file() {
+    closing_ = false;
+    if (!file_.close()) {
+      failed_ = true;
+    }
+  }
+
+  File file_{};
+  etl::array<uint8_t, Capacity> ring_{};
+  size_t head_ = 0;
+  size_t count_ = 0;
+  uint32_t file_id_ = 0;
+  bool open_ = false;
+  bool closing_ = false;
+  bool failed_ = false;
+  size_t peak_pending_ = 0;
+  uint32_t worst_stall_us_ = 0;
+};
+
+} // namespace musin::filesystem
+
+#endif // MUSIN_FILESYSTEM_STAGED_WRITER_H_
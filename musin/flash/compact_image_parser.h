@@ -0,0 +1,358 @@
+#ifndef MUSIN_FLASH_COMPACT_IMAGE_PARSER_H_T4HW8JQC
+#define MUSIN_FLASH_COMPACT_IMAGE_PARSER_H_T4HW8JQC
+
+#include <cstddef>
+#include <cstdint>
+
+#include "etl/algorithm.h"
+#include "etl/array.h"
+#include "etl/span.h"
+
+namespace musin::flash {
+
+// Incremental parser for the compact firmware container, the alternative to
+// streaming a UF2 file (which spends 512 bytes per 256-byte payload).
+//
+// Container layout, little-endian:
+//   header: magic "DFW1" (u32), range count (u16)
+//   range:  image offset (u32), length (u32), encoding (u8),
+//           SHA-256 of the decoded range (32 bytes), encoded data
+//
+// Image offsets are relative to the start of the image (the XIP link base)
+// and ranges must be in ascending, non-overlapping order. Encoding Raw
+// carries `length` bytes as-is. Encoding Ops carries operations until
+// `length` bytes have been produced; lengths and arguments are LEB128:
+//   0x00 n, <n bytes>  Literal
+//   0x01 n, distance   Copy n bytes from `distance` bytes back in this range
+//                      (LZ back-reference; may overlap the bytes it produces)
+//   0x02 n, offset     Copy n bytes from the running image at `offset`
+//                      (delta against the installed firmware)
+//
+// Decoded bytes go to a Sink, which also supplies the bytes copy operations
+// read and checks each range's SHA-256:
+//   bool begin_range(uint32_t flash_offset, uint32_t length);
+//   bool write(uint32_t flash_offset, etl::span<const uint8_t> bytes);
+//   bool end_range(etl::span<const uint8_t> sha256);
+//   bool read_output(uint32_t flash_offset, etl::span<uint8_t> out);
+//   bool read_base(uint32_t image_offset, etl::span<uint8_t> out);
+//
+// Header-only with no SDK dependencies so it can be tested on the host.
+class CompactImageParser {
+public:
+  static constexpr uint32_t MAGIC = 0x31574644; // "DFW1"
+  static constexpr size_t MAX_RANGES = 16;
+  static constexpr size_t SHA256_SIZE = 32;
+  static constexpr size_t HEADER_SIZE = 6;
+  static constexpr size_t RANGE_HEADER_SIZE = 9 + SHA256_SIZE;
+
+  enum Encoding : uint8_t {
+    Raw = 0,
+    Ops = 1,
+  };
+
+  enum Op : uint8_t {
+    Literal = 0,
+    CopyOutput = 1,
+    CopyBase = 2,
+  };
+
+  enum class Result {
+    Ok,            // All consumed bytes processed without error
+    Complete,      // The final range has been decoded and verified
+    BadMagic,      // Container magic did not match
+    BadHeader,     // Range count or a range length out of bounds
+    OutOfRange,    // Range outside the partition
+    NonSequential, // Range starts before the end of the previous one
+    BadEncoding,   // Unknown encoding or operation, or an invalid operation
+    HashMismatch,  // A decoded range did not match its SHA-256
+    EmitFailed,    // The sink reported a write or read failure
+    TrailingData,  // Bytes after the final range
+  };
+
+  // target_offset: flash offset of the partition the image is written to.
+  // partition_size: capacity of that partition in bytes.
+  constexpr CompactImageParser(uint32_t target_offset, uint32_t partition_size)
+      : target_offset_(target_offset), partition_size_(partition_size) {
+  }
+
+  // Feeds bytes into the parser. Returns Ok while more data is expected,
+  // Complete once the final range has been verified, or an error. After an
+  // error or Complete the parser must be reset before reuse.
+  template <typename Sink>
+  constexpr Result push(etl::span<const uint8_t> bytes, Sink &sink) {
+    size_t pos = 0;
+    while (pos < bytes.size()) {
+      if (state_ == State::Done) {
+        return Result::TrailingData;
+      }
+      Result result = Result::Ok;
+      if (state_ == State::RawData || state_ == State::LiteralData) {
+        // Pass runs of data through without copying them.
+        const size_t length = etl::min(bytes.size() - pos, run_remaining_);
+        result = emit(bytes.subspan(pos, length), sink);
+        pos += length;
+      } else {
+        result = consume(bytes[pos++], sink);
+      }
+      if (result != Result::Ok) {
+        return result;
+      }
+    }
+    return state_ == State::Done ? Result::Complete : Result::Ok;
+  }
+
+  constexpr bool is_complete() const {
+    return state_ == State::Done;
+  }
+
+  // Number of decoded image bytes emitted so far.
+  constexpr uint32_t bytes_emitted() const {
+    return bytes_emitted_;
+  }
+
+  constexpr void reset() {
+    state_ = State::Header;
+    field_pos_ = 0;
+    ranges_left_ = 0;
+    next_free_offset_ = 0;
+    bytes_emitted_ = 0;
+  }
+
+private:
+  enum class State {
+    Header,
+    RangeHeader,
+    RawData,
+    OpKind,
+    OpLength,
+    OpArgument,
+    LiteralData,
+    Done,
+  };
+
+  static constexpr size_t COPY_CHUNK = 64;
+  static constexpr size_t MAX_LEB128_BYTES = 5;
+
+  constexpr uint32_t field_u32(size_t offset) const {
+    return static_cast<uint32_t>(field_[offset]) |
+           (static_cast<uint32_t>(field_[offset + 1]) << 8) |
+           (static_cast<uint32_t>(field_[offset + 2]) << 16) |
+           (static_cast<uint32_t>(field_[offset + 3]) << 24);
+  }
+
+  template <typename Sink>
+  constexpr Result consume(uint8_t byte, Sink &sink) {
+    switch (state_) {
+    case State::Header:
+      field_[field_pos_++] = byte;
+      if (field_pos_ == HEADER_SIZE) {
+        return parse_header();
+      }
+      return Result::Ok;
+    case State::RangeHeader:
+      field_[field_pos_++] = byte;
+      if (field_pos_ == RANGE_HEADER_SIZE) {
+        return parse_range_header(sink);
+      }
+      return Result::Ok;
+    case State::OpKind:
+      if (byte > Op::CopyBase) {
+        return Result::BadEncoding;
+      }
+      op_ = static_cast<Op>(byte);
+      start_leb128(State::OpLength);
+      return Result::Ok;
+    case State::OpLength:
+    case State::OpArgument:
+      return consume_leb128(byte, sink);
+    default:
+      return Result::BadEncoding;
+    }
+  }
+
+  constexpr Result parse_header() {
+    field_pos_ = 0;
+    if (field_u32(0) != MAGIC) {
+      return Result::BadMagic;
+    }
+    ranges_left_ = static_cast<uint16_t>(field_[4] | (field_[5] << 8));
+    if (ranges_left_ == 0 || ranges_left_ > MAX_RANGES) {
+      return Result::BadHeader;
+    }
+    state_ = State::RangeHeader;
+    return Result::Ok;
+  }
+
+  template <typename Sink> constexpr Result parse_range_header(Sink &sink) {
+    field_pos_ = 0;
+    const uint32_t image_offset = field_u32(0);
+    const uint32_t length = field_u32(4);
+    const uint8_t encoding = field_[8];
+    etl::copy(field_.begin() + 9, field_.begin() + RANGE_HEADER_SIZE,
+              range_sha_.begin());
+
+    if (length == 0) {
+      return Result::BadHeader;
+    }
+    if (image_offset > partition_size_ ||
+        length > partition_size_ - image_offset) {
+      return Result::OutOfRange;
+    }
+    if (image_offset < next_free_offset_) {
+      return Result::NonSequential;
+    }
+    if (encoding > Encoding::Ops) {
+      return Result::BadEncoding;
+    }
+
+    range_start_ = target_offset_ + image_offset;
+    range_length_ = length;
+    range_produced_ = 0;
+    next_free_offset_ = image_offset + length;
+    if (!sink.begin_range(range_start_, length)) {
+      return Result::EmitFailed;
+    }
+
+    if (encoding == Encoding::Raw) {
+      run_remaining_ = length;
+      state_ = State::RawData;
+    } else {
+      state_ = State::OpKind;
+    }
+    return Result::Ok;
+  }
+
+  constexpr void start_leb128(State next) {
+    state_ = next;
+    leb128_value_ = 0;
+    leb128_bytes_ = 0;
+  }
+
+  template <typename Sink>
+  constexpr Result consume_leb128(uint8_t byte, Sink &sink) {
+    // The fifth byte may only carry the top four bits of a u32
+    if (leb128_bytes_ == MAX_LEB128_BYTES ||
+        (leb128_bytes_ == MAX_LEB128_BYTES - 1 && byte > 0x0F)) {
+      return Result::BadEncoding;
+    }
+    leb128_value_ |= static_cast<uint32_t>(byte & 0x7F)
+                     << (7 * leb128_bytes_++);
+    if (byte & 0x80) {
+      return Result::Ok;
+    }
+
+    if (state_ == State::OpLength) {
+      const uint32_t remaining = range_length_ - range_produced_;
+      if (leb128_value_ == 0 || leb128_value_ > remaining) {
+        return Result::BadEncoding;
+      }
+      op_length_ = leb128_value_;
+      if (op_ == Op::Literal) {
+        run_remaining_ = op_length_;
+        state_ = State::LiteralData;
+      } else {
+        start_leb128(State::OpArgument);
+      }
+      return Result::Ok;
+    }
+    return op_ == Op::CopyOutput ? copy_output(leb128_value_, sink)
+                                 : copy_base(leb128_value_, sink);
+  }
+
+  template <typename Sink>
+  constexpr Result copy_output(uint32_t distance, Sink &sink) {
+    if (distance == 0 || distance > range_produced_) {
+      return Result::BadEncoding;
+    }
+    // Chunks no longer than the distance only read bytes already produced,
+    // which makes overlapping (run-length style) copies work.
+    while (op_length_ > 0) {
+      const size_t length = etl::min<size_t>(
+          etl::min<size_t>(op_length_, distance), COPY_CHUNK);
+      const uint32_t source = range_start_ + range_produced_ - distance;
+      const auto chunk = etl::span<uint8_t>{copy_buffer_.data(), length};
+      if (!sink.read_output(source, chunk)) {
+        return Result::EmitFailed;
+      }
+      op_length_ -= length;
+      const Result result = emit(chunk, sink);
+      if (result != Result::Ok) {
+        return result;
+      }
+    }
+    return Result::Ok;
+  }
+
+  template <typename Sink>
+  constexpr Result copy_base(uint32_t offset, Sink &sink) {
+    while (op_length_ > 0) {
+      const size_t length = etl::min<size_t>(op_length_, COPY_CHUNK);
+      const auto chunk = etl::span<uint8_t>{copy_buffer_.data(), length};
+      if (!sink.read_base(offset, chunk)) {
+        return Result::EmitFailed;
+      }
+      offset += length;
+      op_length_ -= length;
+      const Result result = emit(chunk, sink);
+      if (result != Result::Ok) {
+        return result;
+      }
+    }
+    return Result::Ok;
+  }
+
+  // Writes decoded bytes and advances to the next operation, range or the
+  // end of the container as they complete.
+  template <typename Sink>
+  constexpr Result emit(etl::span<const uint8_t> bytes, Sink &sink) {
+    if (!sink.write(range_start_ + range_produced_, bytes)) {
+      return Result::EmitFailed;
+    }
+    range_produced_ += bytes.size();
+    bytes_emitted_ += bytes.size();
+    if (state_ == State::RawData || state_ == State::LiteralData) {
+      run_remaining_ -= bytes.size();
+      if (run_remaining_ > 0) {
+        return Result::Ok;
+      }
+    } else if (op_length_ > 0) {
+      return Result::Ok;
+    }
+
+    if (range_produced_ < range_length_) {
+      state_ = State::OpKind;
+      return Result::Ok;
+    }
+    if (!sink.end_range(
+            etl::span<const uint8_t>{range_sha_.data(), range_sha_.size()})) {
+      return Result::HashMismatch;
+    }
+    state_ = --ranges_left_ == 0 ? State::Done : State::RangeHeader;
+    return Result::Ok;
+  }
+
+  uint32_t target_offset_;
+  uint32_t partition_size_;
+  State state_ = State::Header;
+  etl::array<uint8_t, RANGE_HEADER_SIZE> field_{};
+  size_t field_pos_ = 0;
+  uint16_t ranges_left_ = 0;
+  uint32_t next_free_offset_ = 0;
+  uint32_t bytes_emitted_ = 0;
+
+  uint32_t range_start_ = 0;
+  uint32_t range_length_ = 0;
+  uint32_t range_produced_ = 0;
+  etl::array<uint8_t, SHA256_SIZE> range_sha_{};
+
+  Op op_ = Op::Literal;
+  uint32_t op_length_ = 0;
+  size_t run_remaining_ = 0;
+  uint32_t leb128_value_ = 0;
+  uint8_t leb128_bytes_ = 0;
+  etl::array<uint8_t, COPY_CHUNK> copy_buffer_{};
+};
+
+} // namespace musin::flash
+
+#endif /* end of include guard: MUSIN_FLASH_COMPACT_IMAGE_PARSER_H_T4HW8JQC */
@@ -1,10 +1,10 @@
 #include "musin/flash/firmware_writer.h"
 
 extern "C" {
+#include "hardware/regs/addressmap.h"
 #include "hardware/sync.h"
 #include "hardware/watchdog.h"
 #include "pico/bootrom.h"
-#include "pico/error.h"
 }
 
 #include "etl/algorithm.h"
@@ -17,13 +17,21 @@ namespace {
 constexpr uint32_t sector_base(uint32_t flash_offset) {
   return flash_offset & ~(FLASH_SECTOR_SIZE - 1u);
 }
+
+// Flash contents by physical offset, bypassing both the XIP cache (which may
+// hold sectors from before they were programmed) and the address
+// translation that maps the booted partition to the link base.
+const uint8_t *flash_bytes(uint32_t flash_offset) {
+  return reinterpret_cast<const uint8_t *>(
+      XIP_NOCACHE_NOALLOC_NOTRANSLATE_BASE + flash_offset);
+}
 } // namespace
 
 FirmwareWriter::FirmwareWriter(musin::Logger &logger) : logger_(logger) {
 }
 
 bool FirmwareWriter::begin(uint32_t total_size,
-                           etl::span<const uint8_t> sha256) {
+                           etl::span<const uint8_t> sha256, uint8_t format) {
   if (receiving_) {
     abort();
   }
@@ -33,32 +41,39 @@ bool FirmwareWriter::begin(uint32_t total_size,
     logger_.error("FirmwareWriter: Invalid SHA-256 length");
     return false;
   }
+  if (format != FORMAT_UF2 && format != FORMAT_COMPACT) {
+    logger_.error("FirmwareWriter: Unknown image format",
+                  static_cast<uint32_t>(format));
+    return false;
+  }
 
   if (!resolve_target_partition()) {
     return false;
   }
 
   // The UF2 stream is roughly twice the image size (512-byte blocks carrying
-  // 256-byte payloads); the parser range-checks the actual payload addresses
-  // against the partition, so only sanity-check the stream size here.
+  // 256-byte payloads) and a compact container is smaller; the parsers
+  // range-check the actual payload addresses against the partition, so only
+  // sanity-check the stream size here.
   if (total_size > 2 * target_size_ + 2 * Uf2Parser::BLOCK_SIZE) {
     logger_.error("FirmwareWriter: Announced size exceeds partition capacity");
     return false;
   }
-  if (total_size % Uf2Parser::BLOCK_SIZE != 0) {
+  if (format == FORMAT_UF2 && total_size % Uf2Parser::BLOCK_SIZE != 0) {
     logger_.error("FirmwareWriter: Size is not a multiple of UF2 block size");
     return false;
   }
 
-  // No DMA: avoids claiming a channel next to the LED/audio DMA users, and
-  // hashing speed is irrelevant against MIDI transfer speed.
-  if (pico_sha256_try_start(&sha_state_, SHA256_BIG_ENDIAN, false) != PICO_OK) {
+  // The compact format hashes each range instead, starting as it begins.
+  if (format == FORMAT_UF2 && !sha_.start()) {
     logger_.error("FirmwareWriter: SHA-256 hardware unavailable");
     return false;
   }
-  sha_active_ = true;
 
+  format_ = format;
   parser_ = Uf2Parser{target_offset_, target_size_};
+  compact_parser_ = CompactImageParser{target_offset_, target_size_};
+  range_count_ = 0;
   etl::copy(sha256.begin(), sha256.end(), expected_sha_.begin());
   total_stream_size_ = total_size;
   stream_bytes_seen_ = 0;
@@ -78,8 +93,13 @@ bool FirmwareWriter::write(etl::span<const uint8_t> bytes) {
     return false;
   }
 
-  pico_sha256_update_blocking(&sha_state_, bytes.data(), bytes.size());
   stream_bytes_seen_ += bytes.size();
+  if (format_ == FORMAT_COMPACT) {
+    return write_compact(bytes);
+  }
+
+  // Hashed by DMA while the parser programs flash
+  sha_.update(bytes);
 
   const auto result =
       parser_.push(bytes, [this](const Uf2Parser::Block &block) {
@@ -101,22 +121,24 @@ bool FirmwareWriter::finalize() {
   }
   receiving_ = false;
 
+  if (format_ == FORMAT_COMPACT) {
+    return finalize_compact();
+  }
+
   if (stream_bytes_seen_ != total_stream_size_ || !parser_.is_complete()) {
     logger_.error("FirmwareWriter: Incomplete UF2 stream");
-    release_sha();
+    sha_.abort();
     return false;
   }
 
   if (!flush_sector()) {
-    release_sha();
+    sha_.abort();
     return false;
   }
 
-  sha256_result_t result;
-  pico_sha256_finish(&sha_state_, &result);
-  sha_active_ = false;
-
-  if (!etl::equal(expected_sha_.begin(), expected_sha_.end(), result.bytes)) {
+  Sha256::Digest digest;
+  sha_.finish(digest);
+  if (digest != expected_sha_) {
     logger_.error("FirmwareWriter: SHA-256 mismatch");
     return false;
   }
@@ -131,7 +153,7 @@ void FirmwareWriter::abort() {
   receiving_ = false;
   image_ready_ = false;
   current_sector_base_ = NO_SECTOR;
-  release_sha();
+  sha_.abort();
 }
 
 std::optional<uint32_t> FirmwareWriter::target_flash_offset() const {
@@ -175,6 +197,118 @@ bool FirmwareWriter::resolve_target_partition() {
 
   target_offset_ = target->offset;
   target_size_ = target->size;
+  booted_offset_ = booted->offset;
+  booted_size_ = booted->size;
+  return true;
+}
+
+bool FirmwareWriter::write_compact(etl::span<const uint8_t> bytes) {
+  CompactSink sink{*this};
+  const auto result = compact_parser_.push(bytes, sink);
+  if (result != CompactImageParser::Result::Ok &&
+      result != CompactImageParser::Result::Complete) {
+    logger_.error("FirmwareWriter: Compact image error",
+                  static_cast<uint32_t>(result));
+    return false;
+  }
+  return true;
+}
+
+bool FirmwareWriter::finalize_compact() {
+  if (stream_bytes_seen_ != total_stream_size_ ||
+      !compact_parser_.is_complete()) {
+    logger_.error("FirmwareWriter: Incomplete compact image");
+    sha_.abort();
+    return false;
+  }
+  if (!flush_sector()) {
+    return false;
+  }
+
+  // Every range has matched its own digest; tie the set of ranges to the
+  // hash announced when the update began.
+  if (!sha_.start()) {
+    logger_.error("FirmwareWriter: SHA-256 hardware unavailable");
+    return false;
+  }
+  sha_.update(etl::span<const uint8_t>{range_digests_.data(),
+                                       range_count_ * SHA256_SIZE});
+  Sha256::Digest digest;
+  sha_.finish(digest);
+  if (digest != expected_sha_) {
+    logger_.error("FirmwareWriter: SHA-256 mismatch");
+    return false;
+  }
+
+  logger_.info("FirmwareWriter: Image verified, bytes written",
+               compact_parser_.bytes_emitted());
+  image_ready_ = true;
+  return true;
+}
+
+bool FirmwareWriter::CompactSink::begin_range(uint32_t, uint32_t) {
+  if (!writer.sha_.start()) {
+    writer.logger_.error("FirmwareWriter: SHA-256 hardware unavailable");
+    return false;
+  }
+  return true;
+}
+
+bool FirmwareWriter::CompactSink::write(uint32_t flash_offset,
+                                        etl::span<const uint8_t> bytes) {
+  // Hashed by DMA while staging programs any sector this completes
+  writer.sha_.update(bytes);
+  // Staging works a sector at a time
+  while (!bytes.empty()) {
+    const uint32_t sector_end = sector_base(flash_offset) + FLASH_SECTOR_SIZE;
+    const size_t length =
+        etl::min<size_t>(bytes.size(), sector_end - flash_offset);
+    if (!writer.stage_payload(flash_offset, bytes.first(length))) {
+      return false;
+    }
+    flash_offset += length;
+    bytes = bytes.subspan(length);
+  }
+  return true;
+}
+
+bool FirmwareWriter::CompactSink::end_range(etl::span<const uint8_t> sha256) {
+  Sha256::Digest digest;
+  writer.sha_.finish(digest);
+  if (!etl::equal(sha256.begin(), sha256.end(), digest.begin())) {
+    writer.logger_.error("FirmwareWriter: Range SHA-256 mismatch");
+    return false;
+  }
+  etl::copy(sha256.begin(), sha256.end(),
+            writer.range_digests_.begin() +
+                writer.range_count_++ * SHA256_SIZE);
+  return true;
+}
+
+bool FirmwareWriter::CompactSink::read_output(uint32_t flash_offset,
+                                              etl::span<uint8_t> out) {
+  // Decoded bytes are either staged in the sector buffer or, for earlier
+  // sectors of the range, already programmed.
+  for (uint8_t &byte : out) {
+    if (sector_base(flash_offset) == writer.current_sector_base_) {
+      byte = writer.sector_buffer_[flash_offset - writer.current_sector_base_];
+    } else {
+      byte = *flash_bytes(flash_offset);
+    }
+    ++flash_offset;
+  }
+  return true;
+}
+
+bool FirmwareWriter::CompactSink::read_base(uint32_t image_offset,
+                                            etl::span<uint8_t> out) {
+  if (image_offset > writer.booted_size_ ||
+      out.size() > writer.booted_size_ - image_offset) {
+    writer.logger_.error("FirmwareWriter: Delta reads past running image");
+    return false;
+  }
+  const uint8_t *source = flash_bytes(writer.booted_offset_ + image_offset);
+  etl::copy(source, source + out.size(), out.begin());
   return true;
 }
 
@@ -218,11 +352,4 @@ bool FirmwareWriter::flush_sector() {
   return true;
 }
 
-void FirmwareWriter::release_sha() {
-  if (sha_active_) {
-    pico_sha256_cleanup(&sha_state_);
-    sha_active_ = false;
-  }
-}
-
 } // namespace musin::flash
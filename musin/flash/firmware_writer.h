@@ -9,33 +9,47 @@
 
 extern "C" {
 #include "hardware/flash.h"
-#include "pico/sha256.h"
 }
 
+#include "musin/flash/compact_image_parser.h"
+#include "musin/flash/overlapped_sha256.h"
+#include "musin/flash/pico_sha256_engine.h"
 #include "musin/flash/uf2_parser.h"
 #include "musin/hal/logger.h"
 
 namespace musin::flash {
 
-// Streams a UF2 image into the inactive A/B firmware partition.
+// Streams a firmware image into the inactive A/B firmware partition.
 //
-// Receives the raw UF2 byte stream, feeds it through Uf2Parser (which rebases
-// payload addresses to the target partition), stages payloads into a
-// sector-sized buffer and erases/programs flash one sector at a time. A
-// running hardware SHA-256 over the raw stream is checked in finalize().
+// Receives either a raw UF2 byte stream or a compact container (see
+// CompactImageParser), rebases payload addresses to the target partition,
+// stages payloads into a sector-sized buffer and erases/programs flash one
+// sector at a time. Hashing is fed by DMA and runs while flash is erased
+// and programmed.
+//
+// For UF2, a running hardware SHA-256 over the raw stream is checked in
+// finalize(). For the compact container, each decoded range is hashed as it
+// is written and checked against the container, and the announced SHA-256
+// must equal the SHA-256 of those range digests concatenated in order.
 class FirmwareWriter {
 public:
   static constexpr size_t SHA256_SIZE = 32;
   static constexpr uint32_t FIRMWARE_A_PARTITION_ID = 0;
   static constexpr uint32_t FIRMWARE_B_PARTITION_ID = 1;
 
+  enum Format : uint8_t {
+    FORMAT_UF2 = 0,
+    FORMAT_COMPACT = 1,
+  };
+
   explicit FirmwareWriter(musin::Logger &logger);
 
   // Resolves the inactive partition and prepares for a stream of total_size
-  // raw UF2 bytes whose SHA-256 must equal sha256 (32 bytes).
-  bool begin(uint32_t total_size, etl::span<const uint8_t> sha256);
+  // bytes in the given format, whose SHA-256 must equal sha256 (32 bytes).
+  bool begin(uint32_t total_size, etl::span<const uint8_t> sha256,
+             uint8_t format = FORMAT_UF2);
 
-  // Consumes the next raw UF2 stream bytes; programs flash as sectors fill.
+  // Consumes the next stream bytes; programs flash as sectors fill.
   bool write(etl::span<const uint8_t> bytes);
 
   // Flushes the final sector and verifies stream completeness and SHA-256.
@@ -48,23 +62,45 @@ public:
   std::optional<uint32_t> target_flash_offset() const;
 
 private:
+  // Receives decoded compact container ranges; see CompactImageParser.
+  struct CompactSink {
+    FirmwareWriter &writer;
+
+    bool begin_range(uint32_t flash_offset, uint32_t length);
+    bool write(uint32_t flash_offset, etl::span<const uint8_t> bytes);
+    bool end_range(etl::span<const uint8_t> sha256);
+    bool read_output(uint32_t flash_offset, etl::span<uint8_t> out);
+    bool read_base(uint32_t image_offset, etl::span<uint8_t> out);
+  };
+
   bool resolve_target_partition();
+  bool write_compact(etl::span<const uint8_t> bytes);
+  bool finalize_compact();
   bool stage_payload(uint32_t flash_offset, etl::span<const uint8_t> payload);
   bool flush_sector();
-  void release_sha();
+
+  // Bytes per SHA staging buffer (two are used), one UF2 block.
+  static constexpr size_t SHA_BUFFER_SIZE = 512;
+  using Sha256 = OverlappedSha256<PicoSha256Engine, SHA_BUFFER_SIZE>;
 
   musin::Logger &logger_;
   Uf2Parser parser_{0, 0};
-  pico_sha256_state_t sha_state_{};
-  bool sha_active_ = false;
+  CompactImageParser compact_parser_{0, 0};
+  uint8_t format_ = FORMAT_UF2;
+  Sha256 sha_;
   bool receiving_ = false;
   bool image_ready_ = false;
 
   uint32_t target_offset_ = 0;
   uint32_t target_size_ = 0;
+  uint32_t booted_offset_ = 0;
+  uint32_t booted_size_ = 0;
   uint32_t total_stream_size_ = 0;
   uint32_t stream_bytes_seen_ = 0;
   etl::array<uint8_t, SHA256_SIZE> expected_sha_{};
+  etl::array<uint8_t, CompactImageParser::MAX_RANGES * SHA256_SIZE>
+      range_digests_{};
+  size_t range_count_ = 0;
 
   static constexpr uint32_t NO_SECTOR = 0xFFFFFFFF;
   uint32_t current_sector_base_ = NO_SECTOR;
@@ -0,0 +1,94 @@
+#ifndef MUSIN_FLASH_OVERLAPPED_SHA256_H_B9QK2XFD
+#define MUSIN_FLASH_OVERLAPPED_SHA256_H_B9QK2XFD
+
+#include <cstddef>
+#include <cstdint>
+
+#include "etl/algorithm.h"
+#include "etl/array.h"
+#include "etl/span.h"
+
+namespace musin::flash {
+
+// Feeds a SHA-256 engine that consumes its input asynchronously (the RP2350
+// SHA block fed by DREQ-paced DMA), so hashing runs while the caller goes on
+// to erase and program flash.
+//
+// update() copies the bytes into one of two staging buffers, hands that
+// buffer to the engine and returns; the caller's buffer is free at once.
+// The engine contract makes this safe with two buffers:
+//   bool start();
+//   void update(const uint8_t *data, size_t size);
+//       May return before `data` is consumed, but only once every earlier
+//       update has been.
+//   void finish(etl::array<uint8_t, 32> &digest);  // Waits, then releases
+//   void abort();                                  // Waits, then releases
+//
+// Header-only with no SDK dependencies so it can be tested on the host.
+template <typename Engine, size_t BufferSize> class OverlappedSha256 {
+  static_assert(BufferSize % 4 == 0, "DMA feeds the engine whole words");
+
+public:
+  static constexpr size_t DIGEST_SIZE = 32;
+  using Digest = etl::array<uint8_t, DIGEST_SIZE>;
+
+  OverlappedSha256() = default;
+  explicit OverlappedSha256(const Engine &engine) : engine_(engine) {
+  }
+
+  bool start() {
+    abort();
+    if (!engine_.start()) {
+      return false;
+    }
+    active_ = true;
+    return true;
+  }
+
+  void update(etl::span<const uint8_t> bytes) {
+    while (active_ && !bytes.empty()) {
+      // Submitting this buffer waits for the other one to be consumed, so
+      // the next call may refill that one.
+      auto &buffer = buffers_[next_buffer_];
+      next_buffer_ ^= 1;
+      const size_t length = etl::min(bytes.size(), BufferSize);
+      etl::copy(bytes.begin(), bytes.begin() + length, buffer.begin());
+      engine_.update(buffer.data(), length);
+      bytes = bytes.subspan(length);
+    }
+  }
+
+  bool finish(Digest &digest) {
+    if (!active_) {
+      return false;
+    }
+    engine_.finish(digest);
+    active_ = false;
+    return true;
+  }
+
+  void abort() {
+    if (active_) {
+      engine_.abort();
+      active_ = false;
+    }
+  }
+
+  bool active() const {
+    return active_;
+  }
+
+  const Engine &engine() const {
+    return engine_;
+  }
+
+private:
+  Engine engine_{};
+  alignas(4) etl::array<etl::array<uint8_t, BufferSize>, 2> buffers_{};
+  size_t next_buffer_ = 0;
+  bool active_ = false;
+};
+
+} // namespace musin::flash
+
+#endif /* end of include guard: MUSIN_FLASH_OVERLAPPED_SHA256_H_B9QK2XFD */
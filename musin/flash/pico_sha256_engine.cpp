@@ -0,0 +1,33 @@
+#include "musin/flash/pico_sha256_engine.h"
+
+extern "C" {
+#include "pico/error.h"
+}
+
+#include "etl/algorithm.h"
+
+namespace musin::flash {
+
+bool PicoSha256Engine::start() {
+  return pico_sha256_try_start(&state_, SHA256_BIG_ENDIAN, true) == PICO_OK;
+}
+
+// pico_sha256 waits for the previous DMA transfer before starting the next,
+// which is the ordering OverlappedSha256 relies on.
+void PicoSha256Engine::update(const uint8_t *data, size_t size) {
+  pico_sha256_update(&state_, data, size);
+}
+
+void PicoSha256Engine::finish(etl::array<uint8_t, 32> &digest) {
+  sha256_result_t result;
+  pico_sha256_finish(&state_, &result);
+  etl::copy(result.bytes, result.bytes + digest.size(), digest.begin());
+}
+
+// Finishing waits for DMA still in flight before releasing the channel
+void PicoSha256Engine::abort() {
+  sha256_result_t discarded;
+  pico_sha256_finish(&state_, &discarded);
+}
+
+} // namespace musin::flash
@@ -0,0 +1,31 @@
+#ifndef MUSIN_FLASH_PICO_SHA256_ENGINE_H_M4TW8RCE
+#define MUSIN_FLASH_PICO_SHA256_ENGINE_H_M4TW8RCE
+
+#include <cstddef>
+#include <cstdint>
+
+#include "etl/array.h"
+
+extern "C" {
+#include "pico/sha256.h"
+}
+
+namespace musin::flash {
+
+// The SHA-256 block fed by DMA, for OverlappedSha256. The channel is
+// claimed for the duration of one hash, and only one hash can run at a
+// time: start() fails while another user holds the block.
+class PicoSha256Engine {
+public:
+  bool start();
+  void update(const uint8_t *data, size_t size);
+  void finish(etl::array<uint8_t, 32> &digest);
+  void abort();
+
+private:
+  pico_sha256_state_t state_{};
+};
+
+} // namespace musin::flash
+
+#endif /* end of include guard: MUSIN_FLASH_PICO_SHA256_ENGINE_H_M4TW8RCE */
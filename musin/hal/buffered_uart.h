@@ -0,0 +1,292 @@
+#ifndef MUSIN_HAL_BUFFERED_UART_H
+#define MUSIN_HAL_BUFFERED_UART_H
+
+#include "musin/hal/UART.h"
+
+#include "etl/array.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace musin::hal {
+
+struct BufferedUartStats {
+  uint32_t rx_overruns = 0;    // Bytes lost: hardware FIFO or RX ring full
+  uint32_t tx_starvations = 0; // Writes that waited for room in the TX ring
+  uint16_t rx_peak_depth = 0;  // Highest RX ring occupancy, in bytes
+};
+
+/**
+ * @brief Interrupt-driven UART with RX and TX ring buffers and per-byte
+ *        arrival timestamps.
+ *
+ * The RX interrupt moves bytes from the 32-byte hardware FIFO into a ring as
+ * they arrive, so input survives main-loop stalls far longer than the FIFO
+ * alone (about 10 ms at 31250 baud). Writes are queued and fed to the
+ * hardware FIFO by the TX interrupt instead of blocking.
+ *
+ * The handler and its data are RAM-resident and run at the highest IRQ
+ * priority, so reception continues during flash erases, which mask every
+ * interrupt below that priority (see audio_safe_flash.h).
+ *
+ * Drop-in for UART with the Arduino SerialMIDI transport: begin(),
+ * available(), read() and write() keep their meaning.
+ *
+ * @tparam TxPin The GPIO pin number for the UART TX line.
+ * @tparam RxPin The GPIO pin number for the UART RX line.
+ * @tparam RxBufferSize RX ring size in bytes; a power of two.
+ * @tparam TxBufferSize TX ring size in bytes; a power of two.
+ */
+template <std::uint32_t TxPin, std::uint32_t RxPin,
+          std::size_t RxBufferSize = 256, std::size_t TxBufferSize = 256>
+class BufferedUART {
+public:
+  static constexpr auto uart_id = detail::uart_instance<TxPin, RxPin>::value;
+
+  static_assert(uart_id != detail::UartId::NONE,
+                "Invalid TX/RX pins: Must be a valid TX/RX pair for the same "
+                "UART instance (UART0 or UART1).");
+  static_assert((RxBufferSize & (RxBufferSize - 1)) == 0,
+                "RxBufferSize must be a power of two");
+  static_assert((TxBufferSize & (TxBufferSize - 1)) == 0,
+                "TxBufferSize must be a power of two");
+
+  BufferedUART() = default;
+  BufferedUART(const BufferedUART &) = delete;
+  BufferedUART &operator=(const BufferedUART &) = delete;
+
+  /**
+   * @brief Initializes the UART and installs the interrupt handler.
+   *
+   * Safe to call more than once (the MIDI library calls it again from its
+   * own begin()); later calls are ignored.
+   */
+  void begin(std::uint32_t baud_rate) {
+    if (_initialized) {
+      return;
+    }
+    instance_ = this;
+
+    uart_inst_t *uart = get_uart_instance();
+    const std::uint32_t actual_baud = uart_init(uart, baud_rate);
+    _byte_time_us = 10'000'000u / actual_baud; // Start, 8 data, stop bits
+    gpio_set_function(TxPin, GPIO_FUNC_UART);
+    gpio_set_function(RxPin, GPIO_FUNC_UART);
+    uart_set_fifo_enabled(uart, true);
+
+    irq_set_exclusive_handler(irq_number(), irq_handler);
+    irq_set_priority(irq_number(), PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq_number(), true);
+    uart_set_irq_enables(uart, true, false); // TX is enabled on demand
+
+    _initialized = true;
+  }
+
+  /** @return true if a received byte is waiting in the RX ring. */
+  bool available() const {
+    return _rx_head.load(std::memory_order_relaxed) !=
+           _rx_tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Pops the next received byte.
+   * @return The byte, or 0 if the ring is empty.
+   */
+  std::uint8_t read() {
+    const std::uint16_t head = _rx_head.load(std::memory_order_relaxed);
+    if (head == _rx_tail.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    const std::size_t slot = head & (RxBufferSize - 1);
+    const std::uint8_t byte = _rx_bytes[slot];
+    _last_read_timestamp_us = _rx_timestamps[slot];
+    _rx_head.store(static_cast<std::uint16_t>(head + 1),
+                   std::memory_order_release);
+    return byte;
+  }
+
+  /** @brief Arrival time (time_us_32) of the byte last returned by read(). */
+  std::uint32_t last_read_timestamp_us() const {
+    return _last_read_timestamp_us;
+  }
+
+  /**
+   * @brief Queues a byte for transmission.
+   *
+   * Only waits if the TX ring is full, which is counted as a starvation.
+   *
+   * @return 1, or 0 if not initialized.
+   */
+  size_t write(std::uint8_t byte) {
+    if (!_initialized) {
+      return 0;
+    }
+    if (tx_depth() == TxBufferSize) {
+      ++_stats.tx_starvations;
+      while (tx_depth() == TxBufferSize) {
+        tight_loop_contents();
+      }
+    }
+
+    const std::uint32_t saved_irq = save_and_disable_interrupts();
+    uart_inst_t *uart = get_uart_instance();
+    if (tx_depth() == 0 && uart_is_writable(uart)) {
+      uart_get_hw(uart)->dr = byte;
+    } else {
+      // Whenever the ring holds bytes the interrupt last left the hardware
+      // FIFO full, so it fires again once the FIFO drains past the trigger
+      // level.
+      const std::uint16_t tail = _tx_tail.load(std::memory_order_relaxed);
+      _tx_bytes[tail & (TxBufferSize - 1)] = byte;
+      _tx_tail.store(static_cast<std::uint16_t>(tail + 1),
+                     std::memory_order_release);
+      hw_set_bits(&uart_get_hw(uart)->imsc, UART_UARTIMSC_TXIM_BITS);
+    }
+    restore_interrupts(saved_irq);
+    return 1;
+  }
+
+  /**
+   * @brief Writes a byte straight to the hardware FIFO, ahead of anything
+   *        still in the TX ring.
+   *
+   * Only for MIDI real-time bytes, which may be interleaved anywhere in the
+   * stream.
+   *
+   * @return false if the hardware FIFO is full or the UART not initialized.
+   */
+  bool write_nonblocking(std::uint8_t byte) {
+    if (!_initialized) {
+      return false;
+    }
+    // The TX interrupt refills the FIFO from the ring; it must not run
+    // between the check and the write, or the byte would be dropped.
+    const std::uint32_t saved_irq = save_and_disable_interrupts();
+    uart_inst_t *uart = get_uart_instance();
+    const bool writable = uart_is_writable(uart);
+    if (writable) {
+      uart_get_hw(uart)->dr = byte;
+    }
+    restore_interrupts(saved_irq);
+    return writable;
+  }
+
+  // The RX interrupt updates the counters; mask it so a copy or reset
+  // never sees them half written.
+  BufferedUartStats stats() const {
+    const std::uint32_t saved_irq = save_and_disable_interrupts();
+    const BufferedUartStats stats = _stats;
+    restore_interrupts(saved_irq);
+    return stats;
+  }
+
+  void reset_stats() {
+    const std::uint32_t saved_irq = save_and_disable_interrupts();
+    _stats = BufferedUartStats{};
+    restore_interrupts(saved_irq);
+  }
+
+private:
+  static constexpr std::uint32_t DR_OVERRUN_BIT = 1u << 11;
+
+  static uart_inst_t *get_uart_instance() {
+    if constexpr (uart_id == detail::UartId::UART0) {
+      return uart0;
+    } else {
+      return uart1;
+    }
+  }
+
+  // Ring indices only ever increase (mod 2^16), and each is written by one
+  // side only; plain atomic loads and stores avoid read-modify-write
+  // atomics, which the RP2040 implements with flash-resident helpers.
+  std::uint16_t tx_depth() const {
+    return static_cast<std::uint16_t>(
+        _tx_tail.load(std::memory_order_acquire) -
+        _tx_head.load(std::memory_order_acquire));
+  }
+
+  static constexpr std::uint32_t irq_number() {
+    return uart_id == detail::UartId::UART0 ? UART0_IRQ : UART1_IRQ;
+  }
+
+  static void __not_in_flash_func(irq_handler)() {
+    BufferedUART &self = *instance_;
+    uart_hw_t *hw = uart_get_hw(get_uart_instance());
+    const std::uint32_t now = time_us_32();
+
+    // Back-date each byte by its position in the hardware FIFO. A receive
+    // timeout interrupt fires 32 bit periods after the last byte ended.
+    const bool timed_out = (hw->mis & UART_UARTMIS_RTMIS_BITS) != 0;
+    std::uint32_t received = 0;
+    etl::array<std::uint16_t, 32> fifo_data;
+    while (!(hw->fr & UART_UARTFR_RXFE_BITS) && received < fifo_data.size()) {
+      fifo_data[received++] = static_cast<std::uint16_t>(hw->dr);
+    }
+    const std::uint32_t last_arrival =
+        now - (timed_out ? self._byte_time_us * 32 / 10 : 0);
+
+    std::uint16_t tail = self._rx_tail.load(std::memory_order_relaxed);
+    for (std::uint32_t i = 0; i < received; ++i) {
+      if (fifo_data[i] & DR_OVERRUN_BIT) {
+        ++self._stats.rx_overruns;
+      }
+      const std::uint16_t depth = static_cast<std::uint16_t>(
+          tail - self._rx_head.load(std::memory_order_acquire));
+      if (depth == RxBufferSize) {
+        ++self._stats.rx_overruns;
+        continue;
+      }
+      const std::size_t slot = tail & (RxBufferSize - 1);
+      self._rx_bytes[slot] = static_cast<std::uint8_t>(fifo_data[i]);
+      self._rx_timestamps[slot] =
+          last_arrival - (received - 1 - i) * self._byte_time_us;
+      tail = static_cast<std::uint16_t>(tail + 1);
+      if (depth + 1 > self._stats.rx_peak_depth) {
+        self._stats.rx_peak_depth = static_cast<std::uint16_t>(depth + 1);
+      }
+    }
+    self._rx_tail.store(tail, std::memory_order_release);
+
+    // Refill the hardware TX FIFO from the ring
+    std::uint16_t tx_head = self._tx_head.load(std::memory_order_relaxed);
+    const std::uint16_t tx_tail =
+        self._tx_tail.load(std::memory_order_acquire);
+    while (tx_head != tx_tail && !(hw->fr & UART_UARTFR_TXFF_BITS)) {
+      hw->dr = self._tx_bytes[tx_head & (TxBufferSize - 1)];
+      tx_head = static_cast<std::uint16_t>(tx_head + 1);
+    }
+    self._tx_head.store(tx_head, std::memory_order_release);
+    if (tx_head == tx_tail) {
+      hw_clear_bits(&hw->imsc, UART_UARTIMSC_TXIM_BITS);
+    }
+  }
+
+  static inline BufferedUART *instance_ = nullptr;
+
+  bool _initialized = false;
+  std::uint32_t _byte_time_us = 320;
+
+  // RX: produced by the interrupt, consumed by read()
+  etl::array<std::uint8_t, RxBufferSize> _rx_bytes{};
+  etl::array<std::uint32_t, RxBufferSize> _rx_timestamps{};
+  std::atomic<std::uint16_t> _rx_head{0};
+  std::atomic<std::uint16_t> _rx_tail{0};
+  std::uint32_t _last_read_timestamp_us = 0;
+
+  // TX: produced by write(), consumed by the interrupt
+  etl::array<std::uint8_t, TxBufferSize> _tx_bytes{};
+  std::atomic<std::uint16_t> _tx_head{0};
+  std::atomic<std::uint16_t> _tx_tail{0};
+
+  BufferedUartStats _stats;
+};
+
+} // namespace musin::hal
+
+#endif // MUSIN_HAL_BUFFERED_UART_H
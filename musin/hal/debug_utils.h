@@ -26,6 +26,8 @@ namespace musin::hal {
 namespace DebugUtils {
 
 inline std::atomic<uint32_t> g_pitch_shifter_underruns{0};
+// Timed audio triggers handled too late to sound on their exact sample
+inline std::atomic<uint32_t> g_late_audio_triggers{0};
 
 #ifdef ENABLE_PROFILING
 
@@ -160,6 +162,8 @@ private:
     printf("--- Underrun Report ---\n");
     uint32_t pitch_shifter_underruns = g_pitch_shifter_underruns.exchange(0);
     printf("PitchShifter Underruns: %u\n", pitch_shifter_underruns);
+    uint32_t late_audio_triggers = g_late_audio_triggers.exchange(0);
+    printf("Late Audio Triggers: %u\n", late_audio_triggers);
     printf("------------------------\n");
   }
 
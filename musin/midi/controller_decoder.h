@@ -0,0 +1,196 @@
+#ifndef MUSIN_MIDI_CONTROLLER_DECODER_H
+#define MUSIN_MIDI_CONTROLLER_DECODER_H
+
+#include "etl/array.h"
+#include <cstdint>
+
+namespace musin::midi {
+
+/**
+ * @brief A controller value after 14-bit CC pairs and NRPN sequences have
+ * been assembled.
+ */
+struct ControllerValue {
+  enum class Kind : uint8_t {
+    CC,  // number is the controller (the MSB number for 14-bit pairs)
+    NRPN // number is the 14-bit parameter number
+  };
+
+  Kind kind;
+  uint16_t number;
+  uint16_t value;       // 0-127, or 0-16383 when high_resolution
+  bool high_resolution; // An LSB completed the value
+
+  /** @brief The value scaled to 0.0f-1.0f. */
+  float normalized() const {
+    return static_cast<float>(value) / (high_resolution ? 16383.0f : 127.0f);
+  }
+
+  /** @brief The value at 7-bit resolution. */
+  uint8_t coarse() const {
+    return static_cast<uint8_t>(high_resolution ? value >> 7 : value);
+  }
+};
+
+/**
+ * @brief Assembles incoming Control Change messages into complete values.
+ *
+ * Controllers 0-31 pair with 32-63 as MSB and LSB. An MSB is held until its
+ * LSB arrives, so a 14-bit sender's pair is applied once at full resolution
+ * instead of first as a coarse step. If any other controller arrives first,
+ * or flush() is called, the MSB is emitted on its own as a 7-bit value. An
+ * LSB on its own combines with the last MSB of its pair, as the MIDI spec
+ * has receivers do.
+ *
+ * NRPN parameters are selected with CC 99/98 and set with data entry CC 6/38,
+ * paired the same way. RPN selections (CC 101/100) are tracked only so their
+ * data entry is ignored, as are data increment and decrement.
+ *
+ * Feed the Control Changes of one channel in arrival order, and call flush()
+ * once the batch is done so a lone MSB is not held back.
+ */
+class ControllerDecoder {
+public:
+  static constexpr uint8_t DATA_ENTRY_MSB = 6;
+  static constexpr uint8_t DATA_ENTRY_LSB = 38;
+  static constexpr uint8_t DATA_INCREMENT = 96;
+  static constexpr uint8_t DATA_DECREMENT = 97;
+  static constexpr uint8_t NRPN_LSB = 98;
+  static constexpr uint8_t NRPN_MSB = 99;
+  static constexpr uint8_t RPN_LSB = 100;
+  static constexpr uint8_t RPN_MSB = 101;
+
+  /**
+   * @brief Processes one Control Change.
+   * @param emit Called with each completed ControllerValue.
+   */
+  template <typename Emit>
+  void process(uint8_t controller, uint8_t value, Emit &&emit) {
+    controller &= 0x7F;
+    value &= 0x7F;
+
+    switch (controller) {
+    case NRPN_MSB:
+    case NRPN_LSB:
+    case RPN_MSB:
+    case RPN_LSB:
+      flush(emit);
+      select_parameter(controller, value);
+      return;
+    case DATA_ENTRY_MSB:
+      flush(emit);
+      data_msb_ = value;
+      if (nrpn_selected()) {
+        pending_msb_ = DATA_ENTRY_MSB;
+      }
+      return;
+    case DATA_ENTRY_LSB:
+      take_pending(DATA_ENTRY_MSB, emit);
+      if (nrpn_selected()) {
+        emit(ControllerValue{ControllerValue::Kind::NRPN, parameter_number(),
+                             combine(data_msb_, value), true});
+      }
+      return;
+    case DATA_INCREMENT:
+    case DATA_DECREMENT:
+      flush(emit);
+      return;
+    default:
+      break;
+    }
+
+    if (controller < 32) {
+      flush(emit);
+      msb_[controller] = value;
+      pending_msb_ = controller;
+    } else if (controller < 64) {
+      const uint8_t msb_controller = controller - 32;
+      take_pending(msb_controller, emit);
+      emit(ControllerValue{ControllerValue::Kind::CC, msb_controller,
+                           combine(msb_[msb_controller], value), true});
+    } else {
+      flush(emit);
+      emit(ControllerValue{ControllerValue::Kind::CC, controller, value,
+                           false});
+    }
+  }
+
+  /** @brief Emits a held MSB as a 7-bit value. */
+  template <typename Emit> void flush(Emit &&emit) {
+    const uint8_t controller = pending_msb_;
+    if (controller == NO_PENDING_MSB) {
+      return;
+    }
+    pending_msb_ = NO_PENDING_MSB;
+    if (controller == DATA_ENTRY_MSB) {
+      emit(ControllerValue{ControllerValue::Kind::NRPN, parameter_number(),
+                           data_msb_, false});
+    } else {
+      emit(ControllerValue{ControllerValue::Kind::CC, controller,
+                           msb_[controller], false});
+    }
+  }
+
+  /** @brief Forgets held values and the selected parameter. */
+  void reset() {
+    msb_.fill(0);
+    pending_msb_ = NO_PENDING_MSB;
+    parameter_msb_ = NULL_PARAMETER;
+    parameter_lsb_ = NULL_PARAMETER;
+    parameter_is_nrpn_ = false;
+    data_msb_ = 0;
+  }
+
+private:
+  static constexpr uint8_t NO_PENDING_MSB = 0xFF;
+  static constexpr uint8_t NULL_PARAMETER = 0x7F; // 127/127 deselects
+
+  static constexpr uint16_t combine(uint8_t msb, uint8_t lsb) {
+    return static_cast<uint16_t>((msb << 7) | lsb);
+  }
+
+  // Drops the held MSB if it belongs to @p controller (its LSB completes
+  // it); any other held MSB is emitted on its own.
+  template <typename Emit> void take_pending(uint8_t controller, Emit &emit) {
+    if (pending_msb_ == controller) {
+      pending_msb_ = NO_PENDING_MSB;
+    } else {
+      flush(emit);
+    }
+  }
+
+  void select_parameter(uint8_t controller, uint8_t value) {
+    const bool nrpn = controller == NRPN_MSB || controller == NRPN_LSB;
+    if (nrpn != parameter_is_nrpn_) {
+      // Switching between RPN and NRPN starts a new selection
+      parameter_msb_ = NULL_PARAMETER;
+      parameter_lsb_ = NULL_PARAMETER;
+      parameter_is_nrpn_ = nrpn;
+    }
+    if (controller == NRPN_MSB || controller == RPN_MSB) {
+      parameter_msb_ = value;
+    } else {
+      parameter_lsb_ = value;
+    }
+  }
+
+  bool nrpn_selected() const {
+    return parameter_is_nrpn_ && !(parameter_msb_ == NULL_PARAMETER &&
+                                   parameter_lsb_ == NULL_PARAMETER);
+  }
+
+  uint16_t parameter_number() const {
+    return combine(parameter_msb_, parameter_lsb_);
+  }
+
+  etl::array<uint8_t, 32> msb_{};
+  uint8_t pending_msb_ = NO_PENDING_MSB;
+  uint8_t parameter_msb_ = NULL_PARAMETER;
+  uint8_t parameter_lsb_ = NULL_PARAMETER;
+  bool parameter_is_nrpn_ = false;
+  uint8_t data_msb_ = 0;
+};
+
+} // namespace musin::midi
+
+#endif // MUSIN_MIDI_CONTROLLER_DECODER_H
@@ -27,6 +27,10 @@ struct SystemRealtimeData {
   ::midi::MidiType type;
 };
 
+struct SongPositionData {
+  uint16_t sixteenths; // MIDI beats (sixteenth notes) since the song start
+};
+
 } // namespace musin::midi
 
 #endif // MUSIN_MIDI_MIDI_COMMON_H
\ No newline at end of file
@@ -2,48 +2,57 @@
 
 namespace musin::midi {
 
-etl::queue_spsc_atomic<IncomingMidiMessage, MIDI_INPUT_QUEUE_SIZE,
+etl::queue_spsc_atomic<TimestampedMidiMessage, MIDI_INPUT_QUEUE_SIZE,
                        etl::memory_model::MEMORY_MODEL_SMALL>
     midi_input_queue;
 
 template <typename T>
-bool enqueue_incoming_midi_message(const T &message_data) {
+bool enqueue_incoming_midi_message(const T &message_data,
+                                   uint32_t timestamp_us) {
   if (!midi_input_queue.full()) {
-    midi_input_queue.push(IncomingMidiMessage(message_data));
+    midi_input_queue.push(TimestampedMidiMessage{
+        IncomingMidiMessage(message_data), timestamp_us});
     return true;
   }
   return false; // Dropping new message if queue is full
 }
 
 // Explicit template instantiations
-template bool enqueue_incoming_midi_message<NoteOnData>(const NoteOnData &);
-template bool enqueue_incoming_midi_message<NoteOffData>(const NoteOffData &);
+template bool enqueue_incoming_midi_message<NoteOnData>(const NoteOnData &,
+                                                        uint32_t);
+template bool enqueue_incoming_midi_message<NoteOffData>(const NoteOffData &,
+                                                         uint32_t);
 template bool
-enqueue_incoming_midi_message<ControlChangeData>(const ControlChangeData &);
+enqueue_incoming_midi_message<ControlChangeData>(const ControlChangeData &,
+                                                 uint32_t);
 template bool
-enqueue_incoming_midi_message<SystemRealtimeData>(const SystemRealtimeData &);
+enqueue_incoming_midi_message<SystemRealtimeData>(const SystemRealtimeData &,
+                                                  uint32_t);
+template bool
+enqueue_incoming_midi_message<SongPositionData>(const SongPositionData &,
+                                                uint32_t);
 
 namespace {
-etl::queue_spsc_atomic<sysex::Chunk, SYSEX_INPUT_QUEUE_SIZE,
-                       etl::memory_model::MEMORY_MODEL_SMALL>
-    sysex_input_queue;
+SysexChunkRing<SYSEX_INPUT_RING_BYTES> sysex_input_ring;
 } // namespace
 
 bool enqueue_incoming_sysex_chunk(const uint8_t *data, size_t length) {
-  // emplace constructs the chunk in the queue slot, avoiding a 2 KB stack
-  // copy.
-  return sysex_input_queue.emplace(data, length);
+  return sysex_input_ring.push(data, length);
 }
 
 const sysex::Chunk *peek_incoming_sysex_chunk() {
-  return sysex_input_queue.empty() ? nullptr : &sysex_input_queue.front();
+  return sysex_input_ring.peek();
 }
 
 void pop_incoming_sysex_chunk() {
-  sysex_input_queue.pop();
+  sysex_input_ring.pop();
+}
+
+const SysexRingStats &sysex_input_stats() {
+  return sysex_input_ring.stats();
 }
 
-bool dequeue_incoming_midi_message(IncomingMidiMessage &message) {
+bool dequeue_incoming_midi_message(TimestampedMidiMessage &message) {
   if (midi_input_queue.empty()) {
     return false;
   }
@@ -2,6 +2,7 @@
 #define MUSIN_MIDI_MIDI_INPUT_QUEUE_H
 
 #include "musin/midi/sysex_chunk.h"
+#include "musin/midi/sysex_chunk_ring.h"
 #include "etl/queue_spsc_atomic.h"
 #include "etl/span.h"
 #include "etl/variant.h"
@@ -24,35 +25,48 @@ struct NoteOffData {
   uint8_t velocity;
 };
 
-using IncomingMidiMessage = etl::variant<NoteOnData, NoteOffData,
-                                         ControlChangeData, SystemRealtimeData>;
+using IncomingMidiMessage =
+    etl::variant<NoteOnData, NoteOffData, ControlChangeData,
+                 SystemRealtimeData, SongPositionData>;
 
-// SysEx chunks own a MAX_PAYLOAD_SIZE buffer each, so they get a dedicated
-// shallow queue instead of inflating every slot of the main message queue.
-// The transfer protocol is ACK-paced, so more than two in flight is abnormal.
-constexpr size_t SYSEX_INPUT_QUEUE_SIZE = 2;
+struct TimestampedMidiMessage {
+  IncomingMidiMessage message;
+  uint32_t timestamp_us; // Arrival time (time_us_32) at the transport
+};
+
+// SysEx payloads get a dedicated byte ring (see sysex_chunk_ring.h) instead of
+// inflating every slot of the main message queue. Payloads take only their
+// own size, so this holds dozens of SDS packets or windowed file chunks that
+// arrive in one burst, and always at least two of the largest payloads.
+constexpr size_t SYSEX_INPUT_RING_BYTES = 8192;
 
-extern etl::queue_spsc_atomic<IncomingMidiMessage, MIDI_INPUT_QUEUE_SIZE,
+extern etl::queue_spsc_atomic<TimestampedMidiMessage, MIDI_INPUT_QUEUE_SIZE,
                               etl::memory_model::MEMORY_MODEL_SMALL>
     midi_input_queue;
 
-template <typename T> bool enqueue_incoming_midi_message(const T &message_data);
+template <typename T>
+bool enqueue_incoming_midi_message(const T &message_data,
+                                   uint32_t timestamp_us);
 
-bool dequeue_incoming_midi_message(IncomingMidiMessage &message);
+bool dequeue_incoming_midi_message(TimestampedMidiMessage &message);
 
 /**
- * @brief Copies a SysEx payload into the sysex queue. Drops it if full.
+ * @brief Copies a SysEx payload into the sysex ring. Drops it if full.
  */
 bool enqueue_incoming_sysex_chunk(const uint8_t *data, size_t length);
 
 /**
- * @brief Returns the oldest queued chunk, or nullptr if the queue is empty.
- * Call pop_incoming_sysex_chunk() after processing it.
+ * @brief Returns the oldest queued chunk, or nullptr if the ring is empty.
+ * The chunk views the ring in place; call pop_incoming_sysex_chunk() once
+ * it has been processed.
  */
 const sysex::Chunk *peek_incoming_sysex_chunk();
 
 void pop_incoming_sysex_chunk();
 
+/** @brief Peak occupancy and drops of the SysEx ring since boot. */
+const SysexRingStats &sysex_input_stats();
+
 } // namespace musin::midi
 
 #endif // MUSIN_MIDI_MIDI_INPUT_QUEUE_H
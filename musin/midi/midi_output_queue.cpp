@@ -6,46 +6,151 @@
 #include "pico/time.h" // For RP2040 specific timing (get_absolute_time, absolute_time_diff_us, is_nil_time)
 #include <algorithm>   // For std::min, std::copy
 #include <cstdio>      // For printf
-#include <optional>
 
 namespace musin::midi {
 
-// Define the global queue instance and its spinlock
-etl::deque<OutgoingMidiMessage, MIDI_QUEUE_SIZE> midi_output_queue;
-// SysEx payloads live here; a SYSTEM_EXCLUSIVE marker in midi_output_queue
-// holds their place in the send order. Both queues share the spinlock.
+using MIDI::internal::Sink;
+
+namespace {
+
+constexpr uint8_t sink_bit(Sink sink) {
+  return static_cast<uint8_t>(1u << static_cast<uint8_t>(sink));
+}
+
+constexpr uint8_t ALL_SINKS = sink_bit(Sink::USB) | sink_bit(Sink::DIN);
+
+// A queued message stays in its lane until every sink it is bound for has
+// taken it, so a slow sink never makes a fast one wait.
+struct QueuedMessage {
+  OutgoingMidiMessage message;
+  uint8_t pending_sinks;
+};
+
+} // namespace
+
+// One deque per priority lane, plus the dedicated SysEx payload queue; a
+// SYSTEM_EXCLUSIVE marker in the controller lane holds the payload's place in
+// that lane's send order. All of them share the spinlock.
+static etl::deque<QueuedMessage, MIDI_REALTIME_QUEUE_SIZE> realtime_lane;
+static etl::deque<QueuedMessage, MIDI_QUEUE_SIZE> note_lane;
+static etl::deque<QueuedMessage, MIDI_QUEUE_SIZE> control_lane;
 static etl::queue<SystemExclusiveData, SYSEX_QUEUE_SIZE> sysex_payload_queue;
+static etl::array<MidiOutputLaneStats, MIDI_OUTPUT_LANE_COUNT> lane_stats{};
+
+// Control change coalescing. A queued CC entry only names its channel and
+// controller; its value is read from this table when the first sink claims
+// it. A dirty bit marks keys that have such an unclaimed entry, so further
+// updates just overwrite the table instead of searching the lane.
+constexpr size_t CC_KEY_COUNT = 16 * 128;
+static etl::array<uint8_t, CC_KEY_COUNT> cc_latest_value{};
+static etl::array<uint32_t, CC_KEY_COUNT / 32> cc_dirty{};
+
 static spin_lock_t *midi_queue_lock =
     spin_lock_init(spin_lock_claim_unused(true));
 
+namespace {
+
+etl::ideque<QueuedMessage> &lane_queue(MidiOutputLane lane) {
+  switch (lane) {
+  case MidiOutputLane::REALTIME:
+    return realtime_lane;
+  case MidiOutputLane::NOTE:
+    return note_lane;
+  default:
+    return control_lane;
+  }
+}
+
+// Must be called with midi_queue_lock held.
+bool push_to_lane(MidiOutputLane lane, const OutgoingMidiMessage &message,
+                  uint8_t sinks) {
+  etl::ideque<QueuedMessage> &queue = lane_queue(lane);
+  MidiOutputLaneStats &stats = lane_stats[static_cast<size_t>(lane)];
+  if (queue.full()) {
+    ++stats.dropped;
+    return false;
+  }
+
+  queue.push_back({message, sinks});
+  ++stats.depth;
+  stats.peak_depth = std::max(stats.peak_depth, stats.depth);
+  return true;
+}
+
+// Parameter number and data entry controllers (RPN/NRPN) only make sense in
+// the order they were sent, so every one of them goes out.
+bool is_coalescable(const ControlChangeData &cc) {
+  switch (cc.controller) {
+  case 6:   // Data Entry MSB
+  case 38:  // Data Entry LSB
+  case 96:  // Data Increment
+  case 97:  // Data Decrement
+  case 98:  // NRPN LSB
+  case 99:  // NRPN MSB
+  case 100: // RPN LSB
+  case 101: // RPN MSB
+    return false;
+  default:
+    return true;
+  }
+}
+
+size_t cc_key(const ControlChangeData &cc) {
+  return static_cast<size_t>((cc.channel - 1) & 0x0F) * 128 +
+         (cc.controller & 0x7F);
+}
+
+bool is_cc_dirty(size_t key) {
+  return (cc_dirty[key / 32] >> (key % 32)) & 1u;
+}
+
+void set_cc_dirty(size_t key, bool dirty) {
+  const uint32_t mask = 1u << (key % 32);
+  if (dirty) {
+    cc_dirty[key / 32] |= mask;
+  } else {
+    cc_dirty[key / 32] &= ~mask;
+  }
+}
+
+} // namespace
+
 bool enqueue_midi_message(const OutgoingMidiMessage &message,
                           musin::Logger &logger) {
   uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
 
-  // Coalesce Control Change messages
-  if (message.type == MidiMessageType::CONTROL_CHANGE) {
-    for (auto &queued_message : midi_output_queue) {
-      if (queued_message.type == MidiMessageType::CONTROL_CHANGE &&
-          queued_message.data.control_change_message.channel ==
-              message.data.control_change_message.channel &&
-          queued_message.data.control_change_message.controller ==
-              message.data.control_change_message.controller) {
-        // Found an existing CC for the same channel/controller, update it
-        queued_message.data.control_change_message.value =
-            message.data.control_change_message.value;
-        spin_unlock(midi_queue_lock, irq_status);
-        return true; // Don't enqueue a new one
+  // Coalesce Control Change messages: an unclaimed entry for the same
+  // channel/controller will pick up the latest value when it is sent.
+  if (message.type == MidiMessageType::CONTROL_CHANGE &&
+      is_coalescable(message.data.control_change_message)) {
+    const ControlChangeData &cc = message.data.control_change_message;
+    const size_t key = cc_key(cc);
+    if (is_cc_dirty(key)) {
+      cc_latest_value[key] = cc.value;
+      spin_unlock(midi_queue_lock, irq_status);
+      return true; // Don't enqueue a new one
+    }
+    const bool success = push_to_lane(MidiOutputLane::CONTROL, message,
+                                      ALL_SINKS);
+    if (success) {
+      cc_latest_value[key] = cc.value;
+      set_cc_dirty(key, true);
+      if (cc.controller < 32) {
+        // Receivers reset a 14-bit controller's LSB on its MSB, so an LSB
+        // queued ahead of this entry must not absorb the one that follows.
+        set_cc_dirty(key + 32, false);
       }
+    } else {
+      logger.debug("MIDI queue full - message dropped");
     }
+    spin_unlock(midi_queue_lock, irq_status);
+    return success;
   }
 
   // If no message was coalesced, enqueue this one if there's space
-  bool success = false;
-  if (!midi_output_queue.full()) {
-    midi_output_queue.push_back(message);
-    success = true;
-  } else {
-    // Log queue full error
+  const bool success =
+      push_to_lane(lane_for(message.type), message, ALL_SINKS);
+  if (!success) {
     logger.debug("MIDI queue full - message dropped");
   }
 
@@ -58,7 +163,8 @@ bool enqueue_sysex_message(const uint8_t *payload, unsigned length,
   uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
 
   bool success = false;
-  if (midi_output_queue.full() || sysex_payload_queue.full()) {
+  if (control_lane.full() || sysex_payload_queue.full()) {
+    ++lane_stats[static_cast<size_t>(MidiOutputLane::CONTROL)].dropped;
     logger.debug("MIDI queue full - sysex message dropped");
   } else {
     sysex_payload_queue.emplace();
@@ -70,109 +176,239 @@ bool enqueue_sysex_message(const uint8_t *payload, unsigned length,
       slot.length = 0;
     }
 
+    // SysEx is sent over USB only; see _sendSysEx_actual.
     OutgoingMidiMessage marker;
     marker.type = MidiMessageType::SYSTEM_EXCLUSIVE;
-    midi_output_queue.push_back(marker);
-    success = true;
+    success = push_to_lane(MidiOutputLane::CONTROL, marker,
+                           sink_bit(Sink::USB));
   }
 
   spin_unlock(midi_queue_lock, irq_status);
   return success;
 }
 
-// Rate limiting for non-real-time messages
-constexpr uint32_t MIN_INTERVAL_US_NON_REALTIME =
-    960; // 3125 bytes per second at 3 bytes each
-static absolute_time_t last_non_realtime_send_time = nil_time;
+// DIN pacing: one byte (start, 8 data, stop bits) at 31250 baud. The wire is
+// modelled as busy until every byte written so far has left the UART.
+constexpr uint32_t DIN_BYTE_TIME_US = 320;
+static absolute_time_t din_busy_until = nil_time;
+static uint8_t din_running_status = 0;
 
-void process_midi_output_queue(musin::Logger &logger) {
-  // Scratch buffer for the dequeued SysEx payload; processing happens on a
-  // single context, and keeping it static avoids a 2KB stack copy.
-  static SystemExclusiveData sysex_scratch;
-  std::optional<OutgoingMidiMessage> message_to_send;
-  bool rate_limited = false;
+// A host that stops reading the USB endpoint must not hold the lanes
+// forever; after this long without room in the USB TX ring, messages are
+// dropped for USB.
+constexpr uint32_t USB_STALL_TIMEOUT_US = 10000;
+static absolute_time_t usb_stalled_since = nil_time;
 
-  { // Critical section for accessing the queue
-    uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
-    if (!midi_output_queue.empty()) {
-      OutgoingMidiMessage &message_in_queue = midi_output_queue.front();
-      // SysEx bypasses the rate limit: it is sent over USB only (never DIN),
-      // so the 31250-baud pacing that MIN_INTERVAL_US_NON_REALTIME models
-      // does not apply to it.
-      if (message_in_queue.type == MidiMessageType::SYSTEM_REALTIME ||
-          message_in_queue.type == MidiMessageType::SYSTEM_EXCLUSIVE ||
-          is_nil_time(last_non_realtime_send_time) ||
-          absolute_time_diff_us(last_non_realtime_send_time,
-                                get_absolute_time()) >=
-              MIN_INTERVAL_US_NON_REALTIME) {
-        message_to_send = message_in_queue;
-        midi_output_queue.pop_front();
-        if (message_to_send->type == MidiMessageType::SYSTEM_EXCLUSIVE) {
-          sysex_scratch = sysex_payload_queue.front();
-          sysex_payload_queue.pop();
+namespace {
+
+uint8_t channel_status(const OutgoingMidiMessage &message) {
+  switch (message.type) {
+  case MidiMessageType::NOTE_ON:
+    return 0x90 | ((message.data.note_message.channel - 1) & 0x0F);
+  case MidiMessageType::NOTE_OFF:
+    return 0x80 | ((message.data.note_message.channel - 1) & 0x0F);
+  case MidiMessageType::CONTROL_CHANGE:
+    return 0xB0 |
+           ((message.data.control_change_message.channel - 1) & 0x0F);
+  case MidiMessageType::PITCH_BEND:
+    return 0xE0 | ((message.data.pitch_bend_message.channel - 1) & 0x0F);
+  default:
+    return 0;
+  }
+}
+
+bool din_wire_idle(absolute_time_t now) {
+  return is_nil_time(din_busy_until) ||
+         absolute_time_diff_us(din_busy_until, now) >= 0;
+}
+
+// Extends the busy window by the bytes this message puts on the wire.
+// Real-time bytes interleave and leave running status untouched.
+void account_din_bytes(const OutgoingMidiMessage &message,
+                       absolute_time_t now) {
+  uint32_t bytes = 1;
+  if (message.type != MidiMessageType::SYSTEM_REALTIME) {
+    const uint8_t status = channel_status(message);
+    const bool running =
+        MIDI::DinUsesRunningStatus && status == din_running_status;
+    bytes = running ? 2 : 3;
+    din_running_status = MIDI::DinUsesRunningStatus ? status : 0;
+  }
+  const absolute_time_t start = din_wire_idle(now) ? now : din_busy_until;
+  din_busy_until = delayed_by_us(start, bytes * DIN_BYTE_TIME_US);
+}
+
+// Real-time and SysEx are never held back by a sink's budget: real-time
+// bytes may interleave on DIN, and SysEx never goes there.
+bool within_budget(Sink sink, const OutgoingMidiMessage &message,
+                   absolute_time_t now) {
+  if (sink == Sink::USB ||
+      message.type == MidiMessageType::SYSTEM_REALTIME) {
+    return true;
+  }
+  return din_wire_idle(now);
+}
+
+bool send_message(Sink sink, const OutgoingMidiMessage &message,
+                  const SystemExclusiveData *sysex) {
+  switch (message.type) {
+  case MidiMessageType::NOTE_ON:
+    return MIDI::internal::_sendNoteOn_actual(
+        sink, message.data.note_message.channel,
+        message.data.note_message.note, message.data.note_message.velocity);
+  case MidiMessageType::NOTE_OFF:
+    return MIDI::internal::_sendNoteOff_actual(
+        sink, message.data.note_message.channel,
+        message.data.note_message.note, message.data.note_message.velocity);
+  case MidiMessageType::CONTROL_CHANGE:
+    return MIDI::internal::_sendControlChange_actual(
+        sink, message.data.control_change_message.channel,
+        message.data.control_change_message.controller,
+        message.data.control_change_message.value);
+  case MidiMessageType::PITCH_BEND:
+    return MIDI::internal::_sendPitchBend_actual(
+        sink, message.data.pitch_bend_message.channel,
+        message.data.pitch_bend_message.bend_value);
+  case MidiMessageType::SYSTEM_REALTIME:
+    return MIDI::internal::_sendRealTime_actual(
+        sink, message.data.system_realtime_message.type);
+  case MidiMessageType::SYSTEM_EXCLUSIVE:
+    return MIDI::internal::_sendSysEx_actual(sysex->length,
+                                             sysex->data_buffer.data());
+  }
+  return true;
+}
+
+// Removes entries every sink has taken from the front of a lane. Must be
+// called with midi_queue_lock held.
+void retire_sent(MidiOutputLane lane) {
+  etl::ideque<QueuedMessage> &queue = lane_queue(lane);
+  while (!queue.empty() && queue.front().pending_sinks == 0) {
+    queue.pop_front();
+    --lane_stats[static_cast<size_t>(lane)].depth;
+  }
+}
+
+constexpr etl::array<MidiOutputLane, MIDI_OUTPUT_LANE_COUNT> LANE_PRIORITY = {
+    MidiOutputLane::REALTIME, MidiOutputLane::NOTE, MidiOutputLane::CONTROL};
+
+// Sends everything one sink can take now, highest-priority lane first.
+// Returns the number of messages written to the sink.
+size_t drain_sink(Sink sink, musin::Logger &logger) {
+  const uint8_t bit = sink_bit(sink);
+  size_t sent = 0;
+
+  while (true) {
+    OutgoingMidiMessage message;
+    const SystemExclusiveData *sysex = nullptr;
+    QueuedMessage *entry = nullptr;
+    MidiOutputLane entry_lane = MidiOutputLane::REALTIME;
+    const absolute_time_t now = get_absolute_time();
+
+    { // Critical section: claim the next message for this sink
+      uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
+      for (MidiOutputLane lane : LANE_PRIORITY) {
+        for (auto &queued : lane_queue(lane)) {
+          if (queued.pending_sinks & bit) {
+            entry = &queued;
+            entry_lane = lane;
+            break;
+          }
+        }
+        if (entry != nullptr) {
+          break;
+        }
+      }
+      if (entry != nullptr && within_budget(sink, entry->message, now)) {
+        if (entry->pending_sinks == ALL_SINKS &&
+            entry->message.type == MidiMessageType::CONTROL_CHANGE &&
+            is_coalescable(entry->message.data.control_change_message)) {
+          // First claim: fix the value so every sink sends the same one,
+          // and let later updates queue a new entry.
+          ControlChangeData &cc = entry->message.data.control_change_message;
+          const size_t key = cc_key(cc);
+          cc.value = cc_latest_value[key];
+          set_cc_dirty(key, false);
+        }
+        entry->pending_sinks &= ~bit;
+        message = entry->message;
+        if (message.type == MidiMessageType::SYSTEM_EXCLUSIVE) {
+          // Only this context pops payloads, so the front stays put while
+          // it is sent outside the lock.
+          sysex = &sysex_payload_queue.front();
         }
       } else {
-        rate_limited = true;
+        entry = nullptr;
       }
+      spin_unlock(midi_queue_lock, irq_status);
+    }
+    if (entry == nullptr) {
+      break;
     }
-    spin_unlock(midi_queue_lock, irq_status);
-  }
 
-  if (message_to_send) {
-    OutgoingMidiMessage message = *message_to_send;
-    // Log message processing
     logger.log(LogLevel::DEBUG, "Processing MIDI type",
                static_cast<int32_t>(message.type));
+    const bool delivered = send_message(sink, message, sysex);
+    bool accepted = delivered;
+    if (sink == Sink::DIN) {
+      account_din_bytes(message, now);
+    } else if (delivered) {
+      usb_stalled_since = nil_time;
+    } else if (is_nil_time(usb_stalled_since)) {
+      usb_stalled_since = now;
+    } else if (absolute_time_diff_us(usb_stalled_since, now) >=
+               USB_STALL_TIMEOUT_US) {
+      logger.debug("USB MIDI stalled - message dropped");
+      accepted = true; // Give up on this sink for this message
+    }
 
-    switch (message.type) {
-    case MidiMessageType::NOTE_ON:
-      MIDI::internal::_sendNoteOn_actual(message.data.note_message.channel,
-                                         message.data.note_message.note,
-                                         message.data.note_message.velocity);
-      last_non_realtime_send_time = get_absolute_time();
-      break;
-    case MidiMessageType::NOTE_OFF:
-      MIDI::internal::_sendNoteOff_actual(message.data.note_message.channel,
-                                          message.data.note_message.note,
-                                          message.data.note_message.velocity);
-      last_non_realtime_send_time = get_absolute_time();
-      break;
-    case MidiMessageType::CONTROL_CHANGE:
-      MIDI::internal::_sendControlChange_actual(
-          message.data.control_change_message.channel,
-          message.data.control_change_message.controller,
-          message.data.control_change_message.value);
-      last_non_realtime_send_time = get_absolute_time();
-      break;
-    case MidiMessageType::PITCH_BEND:
-      MIDI::internal::_sendPitchBend_actual(
-          message.data.pitch_bend_message.channel,
-          message.data.pitch_bend_message.bend_value);
-      last_non_realtime_send_time = get_absolute_time();
-      break;
-    case MidiMessageType::SYSTEM_REALTIME:
-      MIDI::internal::_sendRealTime_actual(
-          message.data.system_realtime_message.type);
-      // Real-time messages do not update last_non_realtime_send_time
-      break;
-    case MidiMessageType::SYSTEM_EXCLUSIVE:
-      MIDI::internal::_sendSysEx_actual(sysex_scratch.length,
-                                        sysex_scratch.data_buffer.data());
-      // USB-only; does not consume DIN bandwidth, so it does not push back
-      // the next DIN-bound message.
+    uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
+    if (accepted) {
+      if (sysex != nullptr) {
+        sysex_payload_queue.pop();
+      }
+      retire_sent(entry_lane);
+    } else {
+      entry->pending_sinks |= bit; // Endpoint full; retry on a later pass
+    }
+    spin_unlock(midi_queue_lock, irq_status);
+
+    if (!accepted) {
       break;
     }
-  } else if (rate_limited) {
-    // This logging is not strictly necessary but can be useful for debugging
-    // rate limiting. It's kept outside the lock to avoid holding it during I/O.
-    // int64_t time_since_last =
-    //     is_nil_time(last_non_realtime_send_time)
-    //         ? -1
-    //         : absolute_time_diff_us(last_non_realtime_send_time,
-    //         get_absolute_time());
-    // logger.log(LogLevel::DEBUG, "Deferred MIDI message",
-    // static_cast<int32_t>(time_since_last));
+    sent += delivered ? 1 : 0;
   }
+  return sent;
+}
+
+} // namespace
+
+size_t process_midi_output_queue(musin::Logger &logger) {
+  return drain_sink(Sink::USB, logger) + drain_sink(Sink::DIN, logger);
+}
+
+bool midi_output_queue_empty() {
+  uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
+  const bool empty =
+      realtime_lane.empty() && note_lane.empty() && control_lane.empty();
+  spin_unlock(midi_queue_lock, irq_status);
+  return empty;
+}
+
+MidiOutputLaneStats get_midi_output_lane_stats(MidiOutputLane lane) {
+  uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
+  const MidiOutputLaneStats stats = lane_stats[static_cast<size_t>(lane)];
+  spin_unlock(midi_queue_lock, irq_status);
+  return stats;
+}
+
+void reset_midi_output_lane_stats() {
+  uint32_t irq_status = spin_lock_blocking(midi_queue_lock);
+  for (auto &stats : lane_stats) {
+    stats.peak_depth = stats.depth;
+    stats.dropped = 0;
+  }
+  spin_unlock(midi_queue_lock, irq_status);
 }
 
 } // namespace musin::midi
@@ -2,7 +2,6 @@
 #define MUSIN_MIDI_MIDI_MESSAGE_QUEUE_H
 
 #include "etl/array.h"
-#include "etl/deque.h" // Using deque to allow iteration for coalescing
 #include "midi_common.h"
 #include "midi_wrapper.h" // For MIDI::SysExMaxSize (from musin/midi/midi_wrapper.h)
 #include "musin/hal/logger.h" // Include logger header
@@ -12,7 +11,9 @@ namespace musin::midi {
 
 // Configuration for the MIDI queue
 constexpr size_t MIDI_QUEUE_SIZE =
-    64; // Max number of MIDI messages in the queue
+    64; // Max number of messages in the note and controller lanes
+constexpr size_t MIDI_REALTIME_QUEUE_SIZE =
+    16; // Max number of pending System Real-Time messages
 constexpr size_t SYSEX_QUEUE_SIZE =
     2; // Max number of pending outgoing SysEx payloads
 
@@ -81,7 +82,37 @@ struct OutgoingMidiMessage {
   }
 };
 
-extern etl::deque<OutgoingMidiMessage, MIDI_QUEUE_SIZE> midi_output_queue;
+// Outgoing messages are split into lanes drained in strict priority order:
+// clock and transport first, then notes, then controllers and SysEx. USB and
+// DIN are scheduled as independent sinks: USB is paced by room in the
+// endpoint FIFO, DIN by UART byte time at 31250 baud (running status aware).
+// A message waiting for one sink's budget only holds back that sink's view
+// of its own lane, so a deferred CC on DIN never delays USB or a clock tick.
+enum class MidiOutputLane : uint8_t {
+  REALTIME,
+  NOTE,
+  CONTROL
+};
+
+constexpr size_t MIDI_OUTPUT_LANE_COUNT = 3;
+
+struct MidiOutputLaneStats {
+  uint16_t depth = 0;      // Messages currently queued
+  uint16_t peak_depth = 0; // Highest depth seen since the last reset
+  uint32_t dropped = 0;    // Messages rejected because the lane was full
+};
+
+constexpr MidiOutputLane lane_for(MidiMessageType type) {
+  switch (type) {
+  case MidiMessageType::SYSTEM_REALTIME:
+    return MidiOutputLane::REALTIME;
+  case MidiMessageType::NOTE_ON:
+  case MidiMessageType::NOTE_OFF:
+    return MidiOutputLane::NOTE;
+  default:
+    return MidiOutputLane::CONTROL;
+  }
+}
 
 bool enqueue_midi_message(const OutgoingMidiMessage &message,
                           musin::Logger &logger);
@@ -92,7 +123,18 @@ bool enqueue_midi_message(const OutgoingMidiMessage &message,
 bool enqueue_sysex_message(const uint8_t *payload, unsigned length,
                            musin::Logger &logger);
 
-void process_midi_output_queue(musin::Logger &logger);
+// Sends every queued message each sink can currently take: on USB until the
+// endpoint FIFO is full, on DIN all pending real-time bytes plus a channel
+// message whenever the wire is idle. Returns the number of messages written,
+// counted once per sink.
+size_t process_midi_output_queue(musin::Logger &logger);
+
+bool midi_output_queue_empty();
+
+MidiOutputLaneStats get_midi_output_lane_stats(MidiOutputLane lane);
+
+// Clears the peak depth and drop counters of every lane.
+void reset_midi_output_lane_stats();
 
 } // namespace musin::midi
 
@@ -4,6 +4,11 @@
 
 namespace musin::midi {
 
+namespace {
+constexpr MIDI::internal::Sink ALL_SINKS[] = {MIDI::internal::Sink::USB,
+                                              MIDI::internal::Sink::DIN};
+} // namespace
+
 MidiSender::MidiSender(MidiSendStrategy strategy, musin::Logger &logger)
     : _strategy(strategy), _logger(logger) {
 }
@@ -12,7 +17,9 @@ void MidiSender::sendNoteOn(uint8_t channel, uint8_t note_number,
                             uint8_t velocity) {
   if (_strategy == MidiSendStrategy::DIRECT_BYPASS_QUEUE) {
     _logger.info("MIDI_SENDER: Direct NoteOn");
-    MIDI::internal::_sendNoteOn_actual(channel, note_number, velocity);
+    for (const auto sink : ALL_SINKS) {
+      MIDI::internal::_sendNoteOn_actual(sink, channel, note_number, velocity);
+    }
   } else {
     _logger.info("MIDI_SENDER: Queued NoteOn");
     enqueue_midi_message(
@@ -24,7 +31,10 @@ void MidiSender::sendNoteOff(uint8_t channel, uint8_t note_number,
                              uint8_t velocity) {
   if (_strategy == MidiSendStrategy::DIRECT_BYPASS_QUEUE) {
     _logger.info("MIDI_SENDER: Direct NoteOff");
-    MIDI::internal::_sendNoteOff_actual(channel, note_number, velocity);
+    for (const auto sink : ALL_SINKS) {
+      MIDI::internal::_sendNoteOff_actual(sink, channel, note_number,
+                                          velocity);
+    }
   } else {
     _logger.info("MIDI_SENDER: Queued NoteOff");
     enqueue_midi_message(
@@ -38,7 +48,10 @@ void MidiSender::sendControlChange(uint8_t channel, uint8_t controller,
     _logger.info("MIDI_SENDER: Direct ControlChange CC",
                  static_cast<uint32_t>(controller));
     _logger.info("MIDI_SENDER: CC value", static_cast<uint32_t>(value));
-    MIDI::internal::_sendControlChange_actual(channel, controller, value);
+    for (const auto sink : ALL_SINKS) {
+      MIDI::internal::_sendControlChange_actual(sink, channel, controller,
+                                                value);
+    }
   } else {
     _logger.info("MIDI_SENDER: Queued ControlChange CC",
                  static_cast<uint32_t>(controller));
@@ -1,10 +1,14 @@
 #ifndef MIDI_H_Z6SY8IRY
 #define MIDI_H_Z6SY8IRY
+#include <cstdint>
 #include <midi_Defs.h>
 
 namespace MIDI {
 static const unsigned SysExMaxSize =
     2048; // Max SysEx size for messages in our queue
+// DIN output uses running status; USB MIDI packets always carry the status
+// byte. The output queue's UART byte-time model depends on this.
+static const bool DinUsesRunningStatus = true;
 
 using MidiType = ::midi::MidiType; // Alias the original library's MidiType
 
@@ -14,6 +18,7 @@ typedef void(NoteCallback)(uint8_t channel, uint8_t note, uint8_t velocity);
 typedef void(ControlChangeCallback)(uint8_t channel, uint8_t controller,
                                     uint8_t value);
 typedef void(PitchBendCallback)(uint8_t channel, int bend);
+typedef void(SongPositionCallback)(unsigned beats);
 
 struct Callbacks {
   NoteCallback *note_on = nullptr;
@@ -22,6 +27,7 @@ struct Callbacks {
   VoidCallback *start = nullptr;
   VoidCallback *cont = nullptr;
   VoidCallback *stop = nullptr;
+  SongPositionCallback *song_position = nullptr;
   ControlChangeCallback *cc = nullptr;
   PitchBendCallback *pitch_bend = nullptr;
   SyxCallback *sysex = nullptr;
@@ -41,16 +47,43 @@ void sendNoteOff(uint8_t inNoteNumber, uint8_t inVelocity, uint8_t inChannel);
 void sendPitchBend(int bend, uint8_t channel);
 void sendSysEx(unsigned length, const uint8_t *bytes);
 
+// DIN UART health, for diagnostics
+struct DinStats {
+  uint32_t rx_overruns = 0;    // Received bytes lost before read()
+  uint32_t tx_starvations = 0; // Sends that waited for room in the TX buffer
+  uint16_t rx_peak_depth = 0;  // Highest RX buffer occupancy, in bytes
+};
+DinStats din_stats();
+void reset_din_stats();
+/**
+ * @brief Arrival time (time_us_32) of the message being dispatched. Valid
+ * inside the callbacks run by read(): the last byte's arrival for DIN, the
+ * latest endpoint transfer for USB.
+ */
+uint32_t message_timestamp_us();
+
 namespace internal {
+// Output transports. The queue schedules each one against its own budget.
+enum class Sink : uint8_t {
+  USB,
+  DIN
+};
+
 // These functions perform the actual MIDI sending via underlying libraries.
-// They are called by the midi_message_queue processor.
-void _sendRealTime_actual(MidiType message);
-void _sendControlChange_actual(uint8_t channel, uint8_t controller,
+// They are called by the midi_message_queue processor, once per sink. They
+// return false if the sink cannot take the message right now (USB endpoint
+// FIFO full); the queue keeps the message and retries on a later pass.
+bool _sendRealTime_actual(Sink sink, MidiType message);
+bool _sendControlChange_actual(Sink sink, uint8_t channel, uint8_t controller,
                                uint8_t value);
-void _sendNoteOn_actual(uint8_t channel, uint8_t note, uint8_t velocity);
-void _sendNoteOff_actual(uint8_t channel, uint8_t note, uint8_t velocity);
-void _sendPitchBend_actual(uint8_t channel, int bend);
-void _sendSysEx_actual(unsigned length, const uint8_t *bytes);
+bool _sendNoteOn_actual(Sink sink, uint8_t channel, uint8_t note,
+                        uint8_t velocity);
+bool _sendNoteOff_actual(Sink sink, uint8_t channel, uint8_t note,
+                         uint8_t velocity);
+bool _sendPitchBend_actual(Sink sink, uint8_t channel, int bend);
+// SysEx goes to USB only. Returns false, sending nothing, if the USB TX ring
+// cannot take the whole message yet.
+bool _sendSysEx_actual(unsigned length, const uint8_t *bytes);
 } // namespace internal
 
 }; // namespace MIDI
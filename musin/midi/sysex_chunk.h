@@ -1,7 +1,6 @@
 #ifndef MUSIN_MIDI_SYSEX_CHUNK_H
 #define MUSIN_MIDI_SYSEX_CHUNK_H
 
-#include "etl/array.h"
 #include "etl/span.h"
 #include <cstddef>
 #include <cstdint>
@@ -14,28 +13,26 @@ inline constexpr size_t MAX_PAYLOAD_SIZE = 2046;
 
 /**
  * @class Chunk
- * @brief An owning, fixed-capacity copy of a SysEx message chunk.
+ * @brief A view of one received SysEx payload.
  *
- * Copies the payload at construction so the chunk remains valid after the
- * MIDI driver's receive buffer is reused. Payloads longer than
- * MAX_PAYLOAD_SIZE are truncated.
+ * Chunks are handed out in place by the SysEx input ring (see
+ * musin/midi/sysex_chunk_ring.h) and stay valid until the ring entry is
+ * popped; nothing is copied. Payloads longer than MAX_PAYLOAD_SIZE are
+ * truncated.
  */
 class Chunk {
 public:
   using const_iterator = const uint8_t *;
 
   /**
-   * @brief Constructs a Chunk by copying from a raw pointer and size.
+   * @brief Views @p size bytes at @p data.
    */
   constexpr Chunk(const uint8_t *data, size_t size)
-      : size_(size < MAX_PAYLOAD_SIZE ? size : MAX_PAYLOAD_SIZE) {
-    for (size_t i = 0; i < size_; ++i) {
-      data_[i] = data[i];
-    }
+      : data_(data), size_(size < MAX_PAYLOAD_SIZE ? size : MAX_PAYLOAD_SIZE) {
   }
 
   /**
-   * @brief Constructs a Chunk by copying from an etl::span.
+   * @brief Views the bytes of an etl::span.
    */
   explicit constexpr Chunk(etl::span<const uint8_t> view)
       : Chunk(view.data(), view.size()) {
@@ -51,10 +48,10 @@ public:
     return size_ == 0;
   }
   constexpr const_iterator begin() const {
-    return data_.data();
+    return data_;
   }
   constexpr const_iterator end() const {
-    return data_.data() + size_;
+    return data_ + size_;
   }
   constexpr const_iterator cbegin() const {
     return begin();
@@ -64,7 +61,7 @@ public:
   }
 
 private:
-  etl::array<uint8_t, MAX_PAYLOAD_SIZE> data_{};
+  const uint8_t *data_;
   size_t size_;
 };
 
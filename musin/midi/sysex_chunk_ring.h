@@ -0,0 +1,160 @@
+#ifndef MUSIN_MIDI_SYSEX_CHUNK_RING_H
+#define MUSIN_MIDI_SYSEX_CHUNK_RING_H
+
+#include "musin/midi/sysex_chunk.h"
+#include "etl/array.h"
+#include "etl/optional.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace musin::midi {
+
+struct SysexRingStats {
+  uint32_t dropped = 0;    // Payloads refused because the ring was full
+  uint32_t peak_bytes = 0; // Highest ring occupancy, in bytes
+};
+
+/**
+ * @brief Single-producer, single-consumer ring of SysEx payloads stored back
+ * to back.
+ *
+ * Each payload is copied in once, behind a two-byte length, and read in
+ * place: peek() returns a sysex::Chunk viewing the ring, valid until pop().
+ * A payload is never split; one that does not fit before the end of the ring
+ * starts over at the beginning. Short messages such as SDS packets and
+ * acknowledgements take only their own size, so a burst of them queues up
+ * where fixed slots sized for the largest payload would run out.
+ *
+ * The producer only writes `write_` and the consumer only `read_`, so one
+ * side may run in an interrupt.
+ *
+ * @tparam CapacityBytes Ring size, a power of two so the free-running
+ *         positions stay consistent when they wrap. At least two of the
+ *         largest payloads, so an empty ring always takes one.
+ */
+template <size_t CapacityBytes> class SysexChunkRing {
+public:
+  static constexpr size_t CAPACITY = CapacityBytes;
+  static constexpr size_t HEADER_SIZE = 2;
+
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "Ring size must be a power of two");
+  static_assert(CAPACITY >= 2 * (HEADER_SIZE + sysex::MAX_PAYLOAD_SIZE),
+                "Ring must hold two of the largest payloads");
+
+  /**
+   * @brief Copies a payload into the ring, truncated to MAX_PAYLOAD_SIZE.
+   * @return false if there is no room; the payload is dropped.
+   */
+  bool push(const uint8_t *data, size_t length) {
+    length = std::min(length, sysex::MAX_PAYLOAD_SIZE);
+    const size_t record = HEADER_SIZE + length;
+    size_t write = write_.load(std::memory_order_relaxed);
+    const size_t read = read_.load(std::memory_order_acquire);
+
+    // Bytes left unused before the end of the ring when the record does not
+    // fit there
+    const size_t to_end = CAPACITY - write % CAPACITY;
+    const size_t skip = record > to_end ? to_end : 0;
+    if (skip + record > CAPACITY - (write - read)) {
+      ++stats_.dropped;
+      return false;
+    }
+    if (skip >= HEADER_SIZE) {
+      store_length(write % CAPACITY, WRAP_MARKER);
+    }
+    write += skip;
+
+    const size_t offset = write % CAPACITY;
+    store_length(offset, static_cast<uint16_t>(length));
+    std::memcpy(&bytes_[offset + HEADER_SIZE], data, length);
+    write += record;
+    write_.store(write, std::memory_order_release);
+    stats_.peak_bytes =
+        std::max(stats_.peak_bytes, static_cast<uint32_t>(write - read));
+    return true;
+  }
+
+  /**
+   * @brief Returns the oldest payload, or nullptr if the ring is empty. It
+   * stays valid, and the same payload is returned, until pop().
+   */
+  const sysex::Chunk *peek() {
+    const size_t offset = front_offset();
+    if (offset == EMPTY) {
+      return nullptr;
+    }
+    front_.emplace(&bytes_[offset + HEADER_SIZE], load_length(offset));
+    return &*front_;
+  }
+
+  /** @brief Releases the oldest payload, if any. */
+  void pop() {
+    const size_t offset = front_offset();
+    if (offset == EMPTY) {
+      return;
+    }
+    front_.reset();
+    read_.store(read_.load(std::memory_order_relaxed) + HEADER_SIZE +
+                    load_length(offset),
+                std::memory_order_release);
+  }
+
+  bool empty() const {
+    return read_.load(std::memory_order_relaxed) ==
+           write_.load(std::memory_order_acquire);
+  }
+
+  /** @brief Bytes in use, including headers and skipped ring ends. */
+  size_t used_bytes() const {
+    return write_.load(std::memory_order_acquire) -
+           read_.load(std::memory_order_acquire);
+  }
+
+  const SysexRingStats &stats() const {
+    return stats_;
+  }
+
+private:
+  static constexpr uint16_t WRAP_MARKER = 0xFFFF;
+  static constexpr size_t EMPTY = CAPACITY;
+
+  // Offset of the oldest record's header, skipping past the end of the ring
+  // when the record was placed at the start.
+  size_t front_offset() {
+    size_t read = read_.load(std::memory_order_relaxed);
+    if (read == write_.load(std::memory_order_acquire)) {
+      return EMPTY;
+    }
+    const size_t offset = read % CAPACITY;
+    if (CAPACITY - offset < HEADER_SIZE ||
+        load_length(offset) == WRAP_MARKER) {
+      read += CAPACITY - offset;
+      read_.store(read, std::memory_order_release);
+      return 0;
+    }
+    return offset;
+  }
+
+  void store_length(size_t offset, uint16_t length) {
+    bytes_[offset] = static_cast<uint8_t>(length & 0xFF);
+    bytes_[offset + 1] = static_cast<uint8_t>(length >> 8);
+  }
+
+  uint16_t load_length(size_t offset) const {
+    return static_cast<uint16_t>(bytes_[offset] | (bytes_[offset + 1] << 8));
+  }
+
+  etl::array<uint8_t, CAPACITY> bytes_{};
+  std::atomic<size_t> write_{0};
+  std::atomic<size_t> read_{0};
+  etl::optional<sysex::Chunk> front_;
+  SysexRingStats stats_;
+};
+
+} // namespace musin::midi
+
+#endif // MUSIN_MIDI_SYSEX_CHUNK_RING_H
@@ -1,9 +1,10 @@
 #include "musin/midi/midi_wrapper.h"
 #include "musin/boards/dato_submarine.h"
-#include "musin/hal/UART.h"
+#include "musin/hal/buffered_uart.h"
 #include "musin/hal/null_logger.h"
 #include "musin/hal/pico_logger.h"
 #include "musin/midi/midi_output_queue.h"
+#include "musin/usb/usb.h"
 #include <MIDI.h>
 #include <USB-MIDI.h>
 #include <stdio.h> // For printf
@@ -78,15 +79,23 @@ struct MIDISettings {
   static const uint16_t SenderActiveSensingPeriodicity = 0;
 };
 
+// DIN receivers must accept running status (MIDI 1.0), and it cuts a third
+// of the UART time for runs of notes or CCs on one channel.
+struct DinMIDISettings : public MIDISettings {
+  static const bool UseRunningStatus = MIDI::DinUsesRunningStatus;
+};
+
 static usbMidi::usbMidiTransport usbTransport(0);
 static midi::MidiInterface<usbMidi::usbMidiTransport, MIDISettings>
     usb_midi(usbTransport);
 
-using MidiUart =
-    musin::hal::UART<DATO_SUBMARINE_MIDI_TX_PIN, DATO_SUBMARINE_MIDI_RX_PIN>;
+// Interrupt-fed RX/TX rings: input is buffered between main-loop passes and
+// DIN output no longer blocks the queue drain on the UART.
+using MidiUart = musin::hal::BufferedUART<DATO_SUBMARINE_MIDI_TX_PIN,
+                                          DATO_SUBMARINE_MIDI_RX_PIN>;
 static MidiUart midi_uart;
 static midi::SerialMIDI<MidiUart> serialTransport(midi_uart);
-static midi::MidiInterface<midi::SerialMIDI<MidiUart>, MIDISettings>
+static midi::MidiInterface<midi::SerialMIDI<MidiUart>, DinMIDISettings>
     serial_midi(serialTransport);
 
 #define ALL_TRANSPORTS(function_call)                                          \
@@ -102,25 +111,48 @@ void MIDI::init(const Callbacks &callbacks) {
   ALL_TRANSPORTS(setHandleStart(callbacks.start));
   ALL_TRANSPORTS(setHandleStop(callbacks.stop));
   ALL_TRANSPORTS(setHandleContinue(callbacks.cont));
+  ALL_TRANSPORTS(setHandleSongPosition(callbacks.song_position));
   ALL_TRANSPORTS(setHandleControlChange(callbacks.cc));
   ALL_TRANSPORTS(
       setHandlePitchBend(callbacks.pitch_bend)); // Register pitch bend handler
   ALL_TRANSPORTS(setHandleSystemExclusive(callbacks.sysex));
 }
 
+// Transport whose read() is running callbacks, for message_timestamp_us()
+static bool reading_din = false;
+
 bool MIDI::read(const byte channel) {
+  reading_din = false;
   const bool usb_message = usb_midi.read(channel);
+  reading_din = true;
   const bool serial_message = serial_midi.read(channel);
   return usb_message || serial_message;
 }
 
 // Overload for reading all channels (OMNI)
 bool MIDI::read() {
+  reading_din = false;
   const bool usb_message = usb_midi.read();
+  reading_din = true;
   const bool serial_message = serial_midi.read();
   return usb_message || serial_message;
 }
 
+MIDI::DinStats MIDI::din_stats() {
+  const musin::hal::BufferedUartStats stats = midi_uart.stats();
+  return DinStats{stats.rx_overruns, stats.tx_starvations,
+                  stats.rx_peak_depth};
+}
+
+void MIDI::reset_din_stats() {
+  midi_uart.reset_stats();
+}
+
+uint32_t MIDI::message_timestamp_us() {
+  return reading_din ? midi_uart.last_read_timestamp_us()
+                     : musin::usb::midi_rx_timestamp_us();
+}
+
 // --- Public Send Functions (Enqueue Messages) ---
 
 void MIDI::sendRealTime(const midi::MidiType message) {
@@ -159,38 +191,85 @@ void MIDI::sendSysEx(const unsigned length, const byte *bytes) {
 
 // --- Internal Actual Send Functions (Called by Queue Processor) ---
 
-void MIDI::internal::_sendRealTime_actual(const midi::MidiType message) {
-  // USB MIDI always non-blocking
-  usb_midi.sendRealTime(message);
+// Channel and real-time messages are written to USB as single event packets
+// so a full endpoint FIFO is reported back to the queue instead of blocking.
+static bool usb_send_packet(const uint8_t code_index, const uint8_t byte1,
+                            const uint8_t byte2, const uint8_t byte3) {
+  const uint8_t packet[4] = {code_index, byte1, byte2, byte3};
+  return musin::usb::midi_try_send(packet);
+}
 
-  // DIN MIDI: try non-blocking write first to minimize jitter
-  // Fall back to blocking write to guarantee delivery if FIFO is full
+static bool usb_send_channel_message(const midi::MidiType type,
+                                     const byte channel, const byte data1,
+                                     const byte data2) {
+  const uint8_t status =
+      static_cast<uint8_t>(type) | ((channel - 1) & 0x0F);
+  return usb_send_packet(status >> 4, status, data1, data2);
+}
+
+bool MIDI::internal::_sendRealTime_actual(const Sink sink,
+                                          const midi::MidiType message) {
+  if (sink == Sink::USB) {
+    // Flushed straight away rather than at the end of the loop: clock
+    // jitter matters more than packing.
+    const bool sent =
+        usb_send_packet(0x0F, static_cast<uint8_t>(message), 0, 0);
+    musin::usb::midi_flush();
+    return sent;
+  }
+
+  // DIN MIDI: straight into the hardware FIFO, ahead of queued bytes, to
+  // minimize jitter. Falls back to the TX ring if the FIFO is full
   if (!midi_uart.write_nonblocking(static_cast<byte>(message))) {
     midi_uart.write(static_cast<byte>(message));
   }
+  return true;
 }
 
-void MIDI::internal::_sendControlChange_actual(const byte channel,
+bool MIDI::internal::_sendControlChange_actual(const Sink sink,
+                                               const byte channel,
                                                const byte controller,
                                                const byte value) {
-  ALL_TRANSPORTS(sendControlChange(controller, value, channel));
+  if (sink == Sink::USB) {
+    return usb_send_channel_message(midi::ControlChange, channel, controller,
+                                    value);
+  }
+  serial_midi.sendControlChange(controller, value, channel);
+  return true;
 }
 
-void MIDI::internal::_sendNoteOn_actual(const byte channel, const byte note,
-                                        const byte velocity) {
-  ALL_TRANSPORTS(sendNoteOn(note, velocity, channel));
+bool MIDI::internal::_sendNoteOn_actual(const Sink sink, const byte channel,
+                                        const byte note, const byte velocity) {
+  if (sink == Sink::USB) {
+    return usb_send_channel_message(midi::NoteOn, channel, note, velocity);
+  }
+  serial_midi.sendNoteOn(note, velocity, channel);
+  return true;
 }
 
-void MIDI::internal::_sendNoteOff_actual(const byte channel, const byte note,
+bool MIDI::internal::_sendNoteOff_actual(const Sink sink, const byte channel,
+                                         const byte note,
                                          const byte velocity) {
-  ALL_TRANSPORTS(sendNoteOff(note, velocity, channel));
+  if (sink == Sink::USB) {
+    return usb_send_channel_message(midi::NoteOff, channel, note, velocity);
+  }
+  serial_midi.sendNoteOff(note, velocity, channel);
+  return true;
 }
 
-void MIDI::internal::_sendPitchBend_actual(const byte channel, const int bend) {
-  ALL_TRANSPORTS(sendPitchBend(bend, channel));
+bool MIDI::internal::_sendPitchBend_actual(const Sink sink, const byte channel,
+                                           const int bend) {
+  if (sink == Sink::USB) {
+    // Same encoding as the MIDI library: signed bend centred on 0
+    const unsigned value = static_cast<unsigned>(bend - MIDI_PITCHBEND_MIN);
+    return usb_send_channel_message(midi::PitchBend, channel, value & 0x7F,
+                                    (value >> 7) & 0x7F);
+  }
+  serial_midi.sendPitchBend(bend, channel);
+  return true;
 }
 
-void MIDI::internal::_sendSysEx_actual(const unsigned length,
+bool MIDI::internal::_sendSysEx_actual(const unsigned length,
                                        const byte *bytes) {
   // SysEx goes to USB only. Mirroring to DIN would block the main loop for
   // ~40 ms per 125-byte packet (blocking UART writes at 31250 baud), pacing
@@ -199,10 +278,18 @@ void MIDI::internal::_sendSysEx_actual(const unsigned length,
   // The underlying Arduino MIDI library adds the F0/F7 terminators itself.
   // We must pass only the payload.
   // This wrapper function will strip the terminators if they are present.
-  if (length >= 2 && bytes[0] == 0xF0 && bytes[length - 1] == 0xF7) {
-    usb_midi.sendSysEx(length - 2, bytes + 1);
-  } else {
-    // If the message is not framed, send it as-is.
-    usb_midi.sendSysEx(length, bytes);
+  const bool framed =
+      length >= 2 && bytes[0] == 0xF0 && bytes[length - 1] == 0xF7;
+  const unsigned payload_length = framed ? length - 2 : length;
+
+  // Three bytes per event packet, F0 and F7 included. Messages that would
+  // never fit the ring are sent anyway; midi_send then waits for room.
+  const size_t packets = (payload_length + 2 + 2) / 3;
+  if (packets <= musin::usb::MIDI_TX_RING_PACKETS &&
+      musin::usb::midi_tx_free_packets() < packets) {
+    return false;
   }
+
+  usb_midi.sendSysEx(payload_length, framed ? bytes + 1 : bytes);
+  return true;
 }
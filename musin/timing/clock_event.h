@@ -2,6 +2,7 @@
 #define MUSIN_TIMING_CLOCK_EVENT_H
 
 #include <cstdint>
+#include <optional>
 
 namespace musin::timing {
 
@@ -31,6 +32,9 @@ struct ClockEvent {
   bool is_resync = false; // True when clock resumes after timeout
   // True for a SyncIn rising edge that aligns to the external downbeat.
   bool is_beat = false;
+  // Set on a resync that relocates (MIDI Start, Continue, Song Position
+  // Pointer): this tick's position in ticks since the song start.
+  std::optional<uint32_t> song_position{};
 };
 
 } // namespace musin::timing
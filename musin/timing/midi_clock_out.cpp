@@ -4,6 +4,14 @@
 
 namespace musin::timing {
 
+namespace {
+// Direct send bypasses queue to minimize jitter
+void send_clock_direct() {
+  MIDI::internal::_sendRealTime_actual(MIDI::internal::Sink::USB, midi::Clock);
+  MIDI::internal::_sendRealTime_actual(MIDI::internal::Sink::DIN, midi::Clock);
+}
+} // namespace
+
 MidiClockOut::MidiClockOut(musin::timing::TempoHandler &tempo_handler_ref,
                            bool send_when_stopped_as_master)
     : tempo_handler_(tempo_handler_ref),
@@ -24,16 +32,14 @@ void MidiClockOut::notification(musin::timing::ClockEvent event) {
     // As clock sender, respect playback policy
     if (tempo_handler_.get_playback_state() == PlaybackState::PLAYING ||
         send_when_stopped_) {
-      // Direct send bypasses queue to minimize jitter
-      MIDI::internal::_sendRealTime_actual(midi::Clock);
+      send_clock_direct();
     }
     return;
   }
 
   // Bridge EXTERNAL_SYNC to MIDI clock output
   if (event.source == ClockSource::EXTERNAL_SYNC) {
-    // Direct send bypasses queue to minimize jitter
-    MIDI::internal::_sendRealTime_actual(midi::Clock);
+    send_clock_direct();
   }
 }
 
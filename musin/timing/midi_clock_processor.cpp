@@ -13,27 +13,31 @@ void MidiClockProcessor::on_midi_clock_tick_received() {
   absolute_time_t now = get_absolute_time();
   bool is_first_tick = is_nil_time(_last_raw_tick_time);
 
-  if (is_first_tick) {
-    // Mark as active BEFORE notifying observers so auto-switching can detect it
-    _last_raw_tick_time = now;
+  // A host that sends transport messages pauses by stopping the clock, so a
+  // gap only means a restart for bare clock streams.
+  bool timed_out = false;
+  if (!is_first_tick && !transport_seen_) {
+    uint32_t current_interval_us =
+        absolute_time_diff_us(_last_raw_tick_time, now);
+    timed_out = current_interval_us > MIDI_CLOCK_TIMEOUT_US;
+  }
+
+  // Mark as active BEFORE notifying observers so auto-switching can detect it
+  _last_raw_tick_time = now;
+
+  if (position_pending_) {
+    // Relocate to the song position set by Start, Continue or SPP
+    position_pending_ = false;
+    musin::timing::ClockEvent relocate_event{
+        .source = musin::timing::ClockSource::MIDI,
+        .is_resync = true,
+        .song_position = song_position_};
+    notify_observers(relocate_event);
+  } else if (is_first_tick || timed_out) {
     // Send resync event for first tick to initialize phase
     musin::timing::ClockEvent resync_event{
         .source = musin::timing::ClockSource::MIDI, .is_resync = true};
     notify_observers(resync_event);
-  } else {
-    uint32_t current_interval_us =
-        absolute_time_diff_us(_last_raw_tick_time, now);
-
-    if (current_interval_us > MIDI_CLOCK_TIMEOUT_US) {
-      // Timeout detected, clock might have stopped and restarted.
-      reset();
-      // Mark active and send resync event
-      _last_raw_tick_time = now;
-      musin::timing::ClockEvent resync_event{
-          .source = musin::timing::ClockSource::MIDI, .is_resync = true};
-      notify_observers(resync_event);
-    }
-    _last_raw_tick_time = now;
   }
 
   // Forward MIDI clock tick to observers
@@ -41,11 +45,52 @@ void MidiClockProcessor::on_midi_clock_tick_received() {
       .source = musin::timing::ClockSource::MIDI, .is_resync = false};
   notify_observers(raw_tick_event);
 
+  if (transport_running_) {
+    ++song_position_;
+  }
+
   if (forward_echo_enabled_) {
     MIDI::sendRealTime(midi::Clock);
   }
 }
 
+void MidiClockProcessor::on_midi_start() {
+  song_position_ = 0;
+  transport_running_ = true;
+  transport_seen_ = true;
+  position_pending_ = true;
+  notify_transport(TransportCommand::START);
+}
+
+void MidiClockProcessor::on_midi_continue() {
+  transport_running_ = true;
+  transport_seen_ = true;
+  position_pending_ = true;
+  notify_transport(TransportCommand::CONTINUE);
+}
+
+void MidiClockProcessor::on_midi_stop() {
+  transport_running_ = false;
+  transport_seen_ = true;
+  position_pending_ = false;
+  notify_transport(TransportCommand::STOP);
+}
+
+void MidiClockProcessor::on_song_position(uint16_t sixteenths) {
+  song_position_ = static_cast<uint32_t>(sixteenths) * TICKS_PER_SIXTEENTH;
+  transport_seen_ = true;
+  // While stopped the position is used by the next Continue.
+  if (transport_running_) {
+    position_pending_ = true;
+  }
+}
+
+void MidiClockProcessor::notify_transport(TransportCommand command) {
+  if (transport_listener_ != nullptr) {
+    transport_listener_->on_transport_command(command);
+  }
+}
+
 bool MidiClockProcessor::is_active() const {
   if (is_nil_time(_last_raw_tick_time)) {
     return false;
@@ -57,6 +102,9 @@ bool MidiClockProcessor::is_active() const {
 
 void MidiClockProcessor::reset() {
   _last_raw_tick_time = nil_time;
+  if (transport_running_) {
+    position_pending_ = true;
+  }
 }
 
 } // namespace musin::timing
@@ -12,9 +12,37 @@ namespace musin::timing {
 // SyncOut)
 constexpr size_t MAX_MIDI_CLOCK_PROCESSOR_OBSERVERS = 2;
 
+/**
+ * @brief MIDI transport commands (Start, Continue, Stop).
+ */
+enum class TransportCommand : uint8_t {
+  START,
+  CONTINUE,
+  STOP
+};
+
+/**
+ * @brief Interface for receiving MIDI transport commands.
+ *
+ * START and CONTINUE are delivered when the message arrives; the position to
+ * play from follows with the next clock tick as a resync ClockEvent carrying
+ * song_position.
+ */
+class ITransportListener {
+public:
+  virtual ~ITransportListener() = default;
+  virtual void on_transport_command(TransportCommand command) = 0;
+};
+
 /**
  * @brief Processes raw incoming MIDI clock ticks, forwards them, and detects
  * timeouts.
+ *
+ * It also follows the MIDI transport: Start, Continue and Song Position
+ * Pointer set the song position, and the first tick after them is sent as a
+ * resync carrying that position. Once a host has sent transport messages,
+ * gaps in the clock (a paused host) no longer resync the phase; only hosts
+ * that send bare clock rely on the timeout.
  */
 class MidiClockProcessor
     : public etl::observable<etl::observer<musin::timing::ClockEvent>,
@@ -32,6 +60,42 @@ public:
    */
   void on_midi_clock_tick_received();
 
+  /**
+   * @brief Called on MIDI Start (0xFA): play from the song start.
+   */
+  void on_midi_start();
+
+  /**
+   * @brief Called on MIDI Continue (0xFB): play from the song position.
+   */
+  void on_midi_continue();
+
+  /**
+   * @brief Called on MIDI Stop (0xFC).
+   */
+  void on_midi_stop();
+
+  /**
+   * @brief Called on MIDI Song Position Pointer (0xF2).
+   * @param sixteenths Position in MIDI beats (sixteenth notes).
+   */
+  void on_song_position(uint16_t sixteenths);
+
+  /**
+   * @brief Song position in raw 24 PPQN ticks since the song start.
+   */
+  [[nodiscard]] uint32_t get_song_position() const {
+    return song_position_;
+  }
+
+  [[nodiscard]] bool is_transport_running() const {
+    return transport_running_;
+  }
+
+  void set_transport_listener(ITransportListener *listener) {
+    transport_listener_ = listener;
+  }
+
   /**
    * @brief Checks if the MIDI clock is currently active (receiving ticks within
    * the timeout).
@@ -40,7 +104,8 @@ public:
   [[nodiscard]] bool is_active() const;
 
   /**
-   * @brief Resets the processor's state.
+   * @brief Resets the tick timing. The transport state is kept; if the
+   * transport is running, the next tick relocates to the song position.
    */
   void reset();
 
@@ -54,9 +119,20 @@ public:
   }
 
 private:
+  void notify_transport(TransportCommand command);
+
   absolute_time_t _last_raw_tick_time;
   bool forward_echo_enabled_ = false;
 
+  ITransportListener *transport_listener_ = nullptr;
+  uint32_t song_position_ = 0;
+  bool transport_running_ = false;
+  bool transport_seen_ = false;
+  bool position_pending_ = false;
+
+  // MIDI clock ticks per Song Position Pointer unit (a sixteenth note).
+  static constexpr uint32_t TICKS_PER_SIXTEENTH = 6;
+
   // Timeout for considering MIDI clock inactive.
   static constexpr uint32_t MIDI_CLOCK_TIMEOUT_US = 500000; // 500ms
 };
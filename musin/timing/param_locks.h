@@ -0,0 +1,84 @@
+#ifndef MUSIN_TIMING_PARAM_LOCKS_H
+#define MUSIN_TIMING_PARAM_LOCKS_H
+
+#include "etl/array.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace musin::timing {
+
+/**
+ * @brief Per-step parameter locks: values that override the track's sound
+ * parameters for a single trigger.
+ *
+ * Each lock is a 7-bit value (0-127) over the parameter's normalized range,
+ * or unset. FILTER_OFFSET is signed around FILTER_OFFSET_CENTER. Four bytes,
+ * so locks can travel with the trigger event and be persisted as is.
+ */
+struct ParamLocks {
+  enum Param : uint8_t {
+    PITCH,
+    DECAY,
+    GAIN,
+    FILTER_OFFSET,
+    COUNT
+  };
+
+  static constexpr uint8_t UNSET = 0xFF;
+  static constexpr uint8_t MAX_VALUE = 127;
+  static constexpr uint8_t FILTER_OFFSET_CENTER = 64;
+
+  etl::array<uint8_t, COUNT> values{UNSET, UNSET, UNSET, UNSET};
+
+  [[nodiscard]] constexpr std::optional<uint8_t> get(Param param) const {
+    if (param >= COUNT || values[param] == UNSET) {
+      return std::nullopt;
+    }
+    return values[param];
+  }
+
+  /**
+   * @brief Get a lock as a normalized value (0.0f to 1.0f), if set.
+   */
+  [[nodiscard]] constexpr std::optional<float> get_normalized(
+      Param param) const {
+    const auto value = get(param);
+    if (!value.has_value()) {
+      return std::nullopt;
+    }
+    return static_cast<float>(value.value()) / MAX_VALUE;
+  }
+
+  /**
+   * @brief Set a lock; values above MAX_VALUE are clamped.
+   */
+  constexpr void set(Param param, uint8_t value) {
+    if (param < COUNT) {
+      values[param] = value > MAX_VALUE ? MAX_VALUE : value;
+    }
+  }
+
+  constexpr void clear(Param param) {
+    if (param < COUNT) {
+      values[param] = UNSET;
+    }
+  }
+
+  [[nodiscard]] constexpr bool empty() const {
+    for (const uint8_t value : values) {
+      if (value != UNSET) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  [[nodiscard]] bool operator==(const ParamLocks &) const = default;
+};
+
+static_assert(sizeof(ParamLocks) == 4, "ParamLocks must stay four bytes");
+
+} // namespace musin::timing
+
+#endif // MUSIN_TIMING_PARAM_LOCKS_H
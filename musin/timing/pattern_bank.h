@@ -0,0 +1,255 @@
+#ifndef MUSIN_TIMING_PATTERN_BANK_H
+#define MUSIN_TIMING_PATTERN_BANK_H
+
+#include "etl/array.h"
+#include "etl/span.h"
+#include "etl/vector.h"
+#include "musin/timing/step_sequencer.h"
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+
+namespace musin::timing {
+
+/**
+ * @brief A bank of patterns with queued switching and a chain (song) mode.
+ *
+ * Exactly one pattern is active. A pattern change requested while playing is
+ * queued and only takes effect at the next bar line, so the running pattern
+ * is never left half-played. In song mode the bank walks the chain, moving
+ * to the next entry once the active pattern has played a whole polymetric
+ * cycle (the LCM of its track lengths), rounded up to a bar line.
+ *
+ * The bank itself has no notion of time: the owner calls on_step_boundary()
+ * before each step plays and restarts its pattern step count whenever that
+ * reports a change.
+ *
+ * @tparam NumPatterns Number of patterns in the bank.
+ * @tparam NumTracks Tracks per pattern.
+ * @tparam MaxSteps Maximum steps per track.
+ * @tparam MaxChainLength Maximum number of entries in the chain.
+ */
+template <size_t NumPatterns, size_t NumTracks, size_t MaxSteps,
+          size_t MaxChainLength = 16>
+class PatternBank {
+public:
+  static_assert(NumPatterns > 0 && NumPatterns <= 128,
+                "Pattern indices must fit in 7 bits");
+  static_assert(MaxChainLength > 0, "Chain must hold at least one entry");
+
+  using Pattern = Sequencer<NumTracks, MaxSteps>;
+
+  constexpr PatternBank() = default;
+
+  [[nodiscard]] constexpr Pattern &active() {
+    return patterns_[active_];
+  }
+  [[nodiscard]] constexpr const Pattern &active() const {
+    return patterns_[active_];
+  }
+
+  /**
+   * @brief Get a pattern by index. Asserts on out-of-bounds access.
+   */
+  [[nodiscard]] constexpr Pattern &get_pattern(size_t index) {
+    ETL_ASSERT(index < NumPatterns,
+               etl::range_error("PatternBank::get_pattern: out of bounds"));
+    return patterns_[index];
+  }
+  [[nodiscard]] constexpr const Pattern &get_pattern(size_t index) const {
+    ETL_ASSERT(index < NumPatterns,
+               etl::range_error("PatternBank::get_pattern: out of bounds"));
+    return patterns_[index];
+  }
+
+  [[nodiscard]] static constexpr size_t size() {
+    return NumPatterns;
+  }
+
+  [[nodiscard]] constexpr uint8_t active_index() const {
+    return active_;
+  }
+
+  [[nodiscard]] constexpr std::optional<uint8_t> queued_index() const {
+    return queued_;
+  }
+
+  /**
+   * @brief Switch to a pattern immediately. Use only while stopped.
+   * @return false if the index is out of range.
+   */
+  constexpr bool select(uint8_t index) {
+    if (index >= NumPatterns) {
+      return false;
+    }
+    active_ = index;
+    queued_.reset();
+    sync_chain_position(index);
+    return true;
+  }
+
+  /**
+   * @brief Queue a pattern to become active at the next bar line.
+   * Queuing the active pattern cancels a pending change.
+   * @return false if the index is out of range.
+   */
+  constexpr bool queue(uint8_t index) {
+    if (index >= NumPatterns) {
+      return false;
+    }
+    if (index == active_) {
+      queued_.reset();
+    } else {
+      queued_ = index;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Replace the chain. Out-of-range entries are dropped and the
+   * chain is truncated to MaxChainLength.
+   */
+  constexpr void set_chain(etl::span<const uint8_t> entries) {
+    chain_.clear();
+    for (const uint8_t entry : entries) {
+      if (chain_.full()) {
+        break;
+      }
+      if (entry < NumPatterns) {
+        chain_.push_back(entry);
+      }
+    }
+    chain_position_ = 0;
+  }
+
+  [[nodiscard]] constexpr etl::span<const uint8_t> get_chain() const {
+    return etl::span<const uint8_t>{chain_.data(), chain_.size()};
+  }
+
+  /**
+   * @brief Enable or disable song mode. Enabling it queues the first chain
+   * entry; an empty chain leaves song mode off.
+   */
+  constexpr void set_song_mode(bool enabled) {
+    song_mode_ = enabled && !chain_.empty();
+    if (song_mode_) {
+      chain_position_ = 0;
+      queue(chain_[0]);
+    }
+  }
+
+  [[nodiscard]] constexpr bool is_song_mode() const {
+    return song_mode_;
+  }
+
+  /**
+   * @brief Copy a pattern over another one, e.g. as a starting point for a
+   * variation.
+   * @return false if either index is out of range.
+   */
+  constexpr bool copy_pattern(uint8_t from, uint8_t to) {
+    if (from >= NumPatterns || to >= NumPatterns) {
+      return false;
+    }
+    patterns_[to] = patterns_[from];
+    return true;
+  }
+
+  /**
+   * @brief Resolve pending pattern changes before a step plays.
+   * @param steps_into_pattern Steps already played from the active pattern.
+   * @param steps_per_bar Bar length in steps; queued changes wait for a
+   * multiple of it.
+   * @return true if the active pattern changed (or restarted in song mode),
+   * in which case the caller restarts its pattern step count at zero.
+   */
+  constexpr bool on_step_boundary(uint32_t steps_into_pattern,
+                                  uint32_t steps_per_bar) {
+    if (!will_change_at(steps_into_pattern, steps_per_bar)) {
+      return false;
+    }
+
+    if (queued_.has_value()) {
+      active_ = queued_.value();
+      queued_.reset();
+      sync_chain_position(active_);
+      return true;
+    }
+
+    chain_position_ =
+        static_cast<uint8_t>((chain_position_ + 1) % chain_.size());
+    active_ = chain_[chain_position_];
+    return true;
+  }
+
+  /**
+   * @brief Whether on_step_boundary() would change the pattern at this
+   * position, without changing anything. Lets the owner look a step ahead.
+   */
+  [[nodiscard]] constexpr bool will_change_at(uint32_t steps_into_pattern,
+                                              uint32_t steps_per_bar) const {
+    if (steps_into_pattern == 0) {
+      return false;
+    }
+    if (queued_.has_value()) {
+      return steps_per_bar == 0 || steps_into_pattern % steps_per_bar == 0;
+    }
+    return song_mode_ && steps_into_pattern >= song_length(steps_per_bar);
+  }
+
+  /**
+   * @brief The pattern step count to resume from after relocating to a song
+   * step, e.g. on a MIDI Song Position Pointer.
+   *
+   * The count keeps the song's bar phase, so queued changes still land on
+   * bar lines, and the song's place in the active pattern's cycle. In song
+   * mode it also stays within the pattern's play length.
+   */
+  [[nodiscard]] constexpr uint32_t
+  steps_into_pattern_at(uint32_t song_step, uint32_t steps_per_bar) const {
+    if (song_mode_) {
+      return song_step % song_length(steps_per_bar);
+    }
+    const auto cycle = static_cast<uint32_t>(active().get_cycle_length());
+    const uint32_t period =
+        steps_per_bar == 0 ? cycle : std::lcm(cycle, steps_per_bar);
+    return song_step % period;
+  }
+
+private:
+  // Steps the active pattern plays in song mode: every track plays through
+  // together, and the next pattern starts on a bar line like a queued one.
+  [[nodiscard]] constexpr uint32_t song_length(uint32_t steps_per_bar) const {
+    const auto cycle = static_cast<uint32_t>(active().get_cycle_length());
+    if (steps_per_bar == 0) {
+      return cycle;
+    }
+    return (cycle + steps_per_bar - 1) / steps_per_bar * steps_per_bar;
+  }
+
+  // Keep the chain position on the active pattern after a manual change, so
+  // song mode continues from there rather than jumping back.
+  constexpr void sync_chain_position(uint8_t index) {
+    if (chain_.empty() || chain_[chain_position_] == index) {
+      return;
+    }
+    for (size_t i = 0; i < chain_.size(); ++i) {
+      if (chain_[i] == index) {
+        chain_position_ = static_cast<uint8_t>(i);
+        return;
+      }
+    }
+  }
+
+  etl::array<Pattern, NumPatterns> patterns_{};
+  etl::vector<uint8_t, MaxChainLength> chain_;
+  std::optional<uint8_t> queued_;
+  uint8_t active_ = 0;
+  uint8_t chain_position_ = 0;
+  bool song_mode_ = false;
+};
+
+} // namespace musin::timing
+
+#endif // MUSIN_TIMING_PATTERN_BANK_H
@@ -6,6 +6,15 @@ void SpeedAdapter::notification(musin::timing::ClockEvent event) {
   current_source_ = event.source;
 
   if (event.is_resync) {
+    if (event.song_position.has_value()) {
+      // Relocate: rescale the position to output ticks and continue the
+      // divider from it, so later output ticks stay on the song grid.
+      const uint32_t position = event.song_position.value();
+      event.song_position = position / raw_ticks_per_output_tick();
+      notify_observers(event);
+      tick_counter_ = position;
+      return;
+    }
     notify_observers(event);
     tick_counter_ = 0;
     return;
@@ -46,4 +55,16 @@ void SpeedAdapter::notification(musin::timing::ClockEvent event) {
   }
 }
 
+uint32_t SpeedAdapter::raw_ticks_per_output_tick() const {
+  switch (modifier_) {
+  case SpeedModifier::HALF_SPEED:
+    return 4;
+  case SpeedModifier::NORMAL_SPEED:
+    return 2;
+  case SpeedModifier::DOUBLE_SPEED:
+    return 1;
+  }
+  return 2;
+}
+
 } // namespace musin::timing
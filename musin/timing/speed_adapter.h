@@ -18,7 +18,9 @@ constexpr size_t MAX_SPEED_ADAPTER_OBSERVERS = 2;
  * - DOUBLE: pass through all ticks (24 PPQN output, phase wraps 0→11
  * twice/quarter).
  *
- * Resets divider on incoming resync. DOUBLE mode ticks maintain physical flag.
+ * Resets divider on incoming resync; a resync carrying a song position moves
+ * the divider to that position instead. DOUBLE mode ticks maintain physical
+ * flag.
  */
 class SpeedAdapter
     : public etl::observer<musin::timing::ClockEvent>,
@@ -52,6 +54,8 @@ public:
   void notification(musin::timing::ClockEvent event) override;
 
 private:
+  [[nodiscard]] uint32_t raw_ticks_per_output_tick() const;
+
   SpeedModifier modifier_;
   uint32_t tick_counter_ = 0;
   ClockSource current_source_ = ClockSource::INTERNAL;
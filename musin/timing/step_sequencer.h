@@ -2,150 +2,379 @@
 #define MUSIN_TIMING_STEP_SEQUENCER_H
 
 #include "etl/array.h"
+#include "etl/span.h"
+#include "etl/vector.h"
+#include "musin/timing/param_locks.h"
+#include <bit>
 #include <cstdint>
+#include <numeric>
 #include <optional>
 
 namespace musin::timing {
 
 /**
  * @brief Represents a single step in a sequencer track.
+ *
+ * Packed into three bytes (velocity, a flags bitfield and a micro-timing
+ * offset) so that a bank of long patterns fits in RAM and can be persisted as
+ * a raw byte image. The note is a property of the track, not of the step.
  */
 struct Step {
-  std::optional<uint8_t> note = std::nullopt;     // MIDI note number (0-127)
-  std::optional<uint8_t> velocity = std::nullopt; // MIDI velocity (1-127)
-  bool enabled = false;
+  static constexpr uint8_t FLAG_ENABLED = 1u << 0;
+  // The step has parameter locks in its track's lock pool.
+  static constexpr uint8_t FLAG_LOCKED = 1u << 1;
 
-  constexpr Step() = default;
-  constexpr Step(std::optional<uint8_t> n, std::optional<uint8_t> v, bool en)
-      : note(n), velocity(v), enabled(en) {
+  uint8_t velocity = 0; // MIDI velocity (1-127), 0 if unset
+  uint8_t flags = 0;
+  // Signed offset from the step's grid position, in the owner's micro-timing
+  // units; 0 plays on the grid.
+  int8_t micro_offset = 0;
+
+  [[nodiscard]] constexpr bool is_enabled() const {
+    return (flags & FLAG_ENABLED) != 0;
+  }
+
+  [[nodiscard]] constexpr bool has_locks() const {
+    return (flags & FLAG_LOCKED) != 0;
+  }
+
+  constexpr void set_enabled(bool enabled) {
+    flags = enabled ? static_cast<uint8_t>(flags | FLAG_ENABLED)
+                    : static_cast<uint8_t>(flags & ~FLAG_ENABLED);
+  }
+
+  constexpr void set_locked(bool locked) {
+    flags = locked ? static_cast<uint8_t>(flags | FLAG_LOCKED)
+                   : static_cast<uint8_t>(flags & ~FLAG_LOCKED);
   }
+
+  [[nodiscard]] constexpr bool operator==(const Step &) const = default;
 };
 
+static_assert(sizeof(Step) == 3, "Step must stay packed into three bytes");
+
 /**
  * @brief Represents a single track in the sequencer.
- * @tparam NumSteps The number of steps in this track.
+ *
+ * Storage is allocated for MaxSteps steps; the playing length can be set
+ * anywhere from 1 to MaxSteps. Steps past the length keep their contents so
+ * shortening and re-lengthening a track is non-destructive.
+ *
+ * Alongside the steps the track keeps a bit-plane of their enabled flags, so
+ * queries like "which steps play" are a single word operation rather than a
+ * walk over the steps. Steps are therefore only mutable through the track,
+ * which keeps both in sync.
+ *
+ * Parameter locks are kept sparsely: few steps carry them, so the track holds
+ * a small pool of (step, locks) entries and flags the locked steps, rather
+ * than reserving lock storage in every step.
+ *
+ * @tparam MaxSteps The maximum number of steps in this track.
+ * @tparam MaxLockedSteps How many steps of the track can carry locks.
  */
-template <size_t NumSteps> class Track {
+template <size_t MaxSteps, size_t MaxLockedSteps = 16> class Track {
 public:
-  static_assert(NumSteps > 0, "Track must have at least one step.");
-
-  constexpr Track() = default;
-
   /**
-   * @brief Get a reference to a specific step.
-   * @param index The index of the step (0 to NumSteps - 1). Asserts on
-   * out-of-bounds access.
-   * @return A reference to the Step object.
+   * @brief One entry of the lock pool.
    */
-  [[nodiscard]] constexpr Step &get_step(size_t index) {
-    ETL_ASSERT(index < NumSteps,
-               etl::range_error("Track::get_step: index out of bounds"));
-    return steps[index];
-  }
+  struct LockedStep {
+    uint8_t step;
+    ParamLocks locks;
+  };
+
+  static_assert(MaxSteps > 0, "Track must have at least one step.");
+  static_assert(MaxSteps <= 64,
+                "Enabled steps are tracked in a 64-bit bit-plane.");
+
+  constexpr Track() = default;
 
   /**
    * @brief Get a const reference to a specific step.
-   * @param index The index of the step (0 to NumSteps - 1). Asserts on
+   * @param index The index of the step (0 to MaxSteps - 1). Asserts on
    * out-of-bounds access.
    * @return A const reference to the Step object.
    */
   [[nodiscard]] constexpr const Step &get_step(size_t index) const {
-    ETL_ASSERT(index < NumSteps,
+    ETL_ASSERT(index < MaxSteps,
                etl::range_error("Track::get_step: index out of bounds"));
     return steps[index];
   }
 
   /**
-   * @brief Get the total number of steps in this track.
+   * @brief Get the playing length of this track in steps.
    */
   [[nodiscard]] constexpr size_t size() const {
-    return NumSteps;
+    return length_;
+  }
+
+  /**
+   * @brief Get the number of steps this track can hold.
+   */
+  [[nodiscard]] static constexpr size_t capacity() {
+    return MaxSteps;
+  }
+
+  /**
+   * @brief Bit-plane of enabled steps within the playing length; bit i is
+   * step i.
+   */
+  [[nodiscard]] constexpr uint64_t enabled_mask() const {
+    return enabled_mask_ & length_mask(length_);
+  }
+
+  /**
+   * @brief Whether a step is enabled, regardless of the playing length.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   */
+  [[nodiscard]] constexpr bool is_step_enabled(size_t step_idx) const {
+    ETL_ASSERT(step_idx < MaxSteps,
+               etl::range_error("Track::is_step_enabled: index out of bounds"));
+    return (enabled_mask_ >> step_idx) & 1u;
+  }
+
+  /**
+   * @brief Number of enabled steps within the playing length.
+   */
+  [[nodiscard]] constexpr size_t count_enabled() const {
+    return static_cast<size_t>(std::popcount(enabled_mask()));
+  }
+
+  /**
+   * @brief Sets the playing length, clamped to [1, MaxSteps].
+   */
+  constexpr void set_length(size_t length) {
+    length_ = static_cast<uint8_t>(
+        length < 1 ? 1 : (length > MaxSteps ? MaxSteps : length));
   }
 
   /**
    * @brief Toggles the enabled state of a specific step.
-   * @param step_idx The index of the step (0 to NumSteps-1).
+   * @param step_idx The index of the step (0 to MaxSteps-1).
    * @return The new enabled state of the step.
    */
   constexpr bool toggle_step_enabled(size_t step_idx) {
     ETL_ASSERT(
-        step_idx < NumSteps,
+        step_idx < MaxSteps,
         etl::range_error("Track::toggle_step_enabled: index out of bounds"));
-    steps[step_idx].enabled = !steps[step_idx].enabled;
-    return steps[step_idx].enabled;
+    const bool enabled = !is_step_enabled(step_idx);
+    set_step_enabled(step_idx, enabled);
+    return enabled;
   }
 
   /**
    * @brief Sets the enabled state for a specific step.
-   * @param step_idx The index of the step (0 to NumSteps-1).
+   * @param step_idx The index of the step (0 to MaxSteps-1).
    * @param enabled The new enabled state.
    */
   constexpr void set_step_enabled(size_t step_idx, bool enabled) {
     ETL_ASSERT(
-        step_idx < NumSteps,
+        step_idx < MaxSteps,
         etl::range_error("Track::set_step_enabled: index out of bounds"));
-    steps[step_idx].enabled = enabled;
+    steps[step_idx].set_enabled(enabled);
+    const uint64_t bit = uint64_t{1} << step_idx;
+    enabled_mask_ = enabled ? (enabled_mask_ | bit) : (enabled_mask_ & ~bit);
+    if (!enabled) {
+      clear_step_locks(step_idx); // Locks belong to the trigger
+    }
   }
 
   /**
-   * @brief Sets the note for a specific step.
-   * @param step_idx The index of the step (0 to NumSteps-1).
-   * @param note The MIDI note number (0-127) or std::nullopt.
+   * @brief Sets the velocity for a specific step.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   * @param velocity The MIDI velocity (1-127), or 0 to clear it.
    */
-  constexpr void set_step_note(size_t step_idx, std::optional<uint8_t> note) {
-    ETL_ASSERT(step_idx < NumSteps,
-               etl::range_error("Track::set_step_note: index out of bounds"));
-    steps[step_idx].note = note;
+  constexpr void set_step_velocity(size_t step_idx, uint8_t velocity) {
+    ETL_ASSERT(
+        step_idx < MaxSteps,
+        etl::range_error("Track::set_step_velocity: index out of bounds"));
+    steps[step_idx].velocity = velocity;
   }
 
   /**
-   * @brief Sets the velocity for a specific step.
-   * @param step_idx The index of the step (0 to NumSteps-1).
-   * @param velocity The MIDI velocity (1-127) or std::nullopt.
+   * @brief Sets the micro-timing offset of a specific step.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   * @param offset Signed offset from the grid; 0 plays on the grid.
    */
-  constexpr void set_step_velocity(size_t step_idx,
-                                   std::optional<uint8_t> velocity) {
+  constexpr void set_step_micro_offset(size_t step_idx, int8_t offset) {
     ETL_ASSERT(
-        step_idx < NumSteps,
-        etl::range_error("Track::set_step_velocity: index out of bounds"));
-    steps[step_idx].velocity = velocity;
+        step_idx < MaxSteps,
+        etl::range_error("Track::set_step_micro_offset: index out of bounds"));
+    steps[step_idx].micro_offset = offset;
   }
 
   /**
    * @brief Gets the velocity of a specific step.
-   * @param step_idx The index of the step (0 to NumSteps-1).
+   * @param step_idx The index of the step (0 to MaxSteps-1).
    * @return std::optional<uint8_t> containing the velocity if set.
    */
   [[nodiscard]] constexpr std::optional<uint8_t>
   get_step_velocity(size_t step_idx) const {
     ETL_ASSERT(
-        step_idx < NumSteps,
+        step_idx < MaxSteps,
         etl::range_error("Track::get_step_velocity: index out of bounds"));
+    if (steps[step_idx].velocity == 0) {
+      return std::nullopt;
+    }
     return steps[step_idx].velocity;
   }
 
   /**
-   * @brief Sets the note value for all steps in the track.
+   * @brief Gets the parameter locks of a step; empty if it has none.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   */
+  [[nodiscard]] constexpr ParamLocks get_step_locks(size_t step_idx) const {
+    ETL_ASSERT(step_idx < MaxSteps,
+               etl::range_error("Track::get_step_locks: index out of bounds"));
+    if (!steps[step_idx].has_locks()) {
+      return ParamLocks{};
+    }
+    for (const LockedStep &entry : locks_) {
+      if (entry.step == step_idx) {
+        return entry.locks;
+      }
+    }
+    return ParamLocks{};
+  }
+
+  /**
+   * @brief Locks one parameter of a step.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   * @return false if the step has no locks yet and the pool is full.
+   */
+  constexpr bool set_step_lock(size_t step_idx, ParamLocks::Param param,
+                               uint8_t value) {
+    ParamLocks locks = get_step_locks(step_idx);
+    locks.set(param, value);
+    return set_step_locks(step_idx, locks);
+  }
+
+  /**
+   * @brief Replaces all locks of a step; empty locks clear them.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   * @return false if the step has no locks yet and the pool is full.
+   */
+  constexpr bool set_step_locks(size_t step_idx, const ParamLocks &locks) {
+    ETL_ASSERT(step_idx < MaxSteps,
+               etl::range_error("Track::set_step_locks: index out of bounds"));
+    if (locks.empty()) {
+      clear_step_locks(step_idx);
+      return true;
+    }
+    for (LockedStep &entry : locks_) {
+      if (entry.step == step_idx) {
+        entry.locks = locks;
+        return true;
+      }
+    }
+    if (locks_.full()) {
+      return false;
+    }
+    locks_.push_back({static_cast<uint8_t>(step_idx), locks});
+    steps[step_idx].set_locked(true);
+    return true;
+  }
+
+  /**
+   * @brief Removes all locks of a step.
+   * @param step_idx The index of the step (0 to MaxSteps-1).
+   */
+  constexpr void clear_step_locks(size_t step_idx) {
+    ETL_ASSERT(
+        step_idx < MaxSteps,
+        etl::range_error("Track::clear_step_locks: index out of bounds"));
+    if (!steps[step_idx].has_locks()) {
+      return;
+    }
+    steps[step_idx].set_locked(false);
+    for (size_t i = 0; i < locks_.size(); ++i) {
+      if (locks_[i].step == step_idx) {
+        locks_.erase(locks_.begin() + i);
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief The lock pool, e.g. for serialization.
+   */
+  [[nodiscard]] constexpr etl::span<const LockedStep> get_locked_steps() const {
+    return etl::span<const LockedStep>{locks_.data(), locks_.size()};
+  }
+
+  [[nodiscard]] static constexpr size_t max_locked_steps() {
+    return MaxLockedSteps;
+  }
+
+  /**
+   * @brief Sets the note played by all steps in the track.
    * @param note_value The MIDI note number (0-127).
    */
   constexpr void set_note(uint8_t note_value) {
-    for (size_t i = 0; i < NumSteps; ++i) {
-      steps[i].note = note_value;
+    note_ = note_value;
+  }
+
+  /**
+   * @brief Gets the note played by the track's steps, if one is assigned.
+   */
+  [[nodiscard]] constexpr std::optional<uint8_t> get_note() const {
+    return note_;
+  }
+
+  /**
+   * @brief Disables and clears every step, keeping length and note.
+   */
+  constexpr void clear_steps() {
+    steps.fill(Step{});
+    enabled_mask_ = 0;
+    locks_.clear();
+  }
+
+  /**
+   * @brief Replaces the leading steps with the given ones (e.g. when loading)
+   * and clears the rest. Locks are cleared too; restore them afterwards with
+   * set_step_locks().
+   */
+  constexpr void set_steps(etl::span<const Step> new_steps) {
+    clear_steps();
+    for (size_t i = 0; i < new_steps.size() && i < MaxSteps; ++i) {
+      steps[i] = new_steps[i];
+      steps[i].set_locked(false);
+      if (new_steps[i].is_enabled()) {
+        enabled_mask_ |= uint64_t{1} << i;
+      }
     }
   }
 
+  /**
+   * @brief Contiguous view of all MaxSteps steps, e.g. for serialization.
+   */
+  [[nodiscard]] constexpr etl::span<const Step> get_steps() const {
+    return etl::span<const Step>{steps.data(), MaxSteps};
+  }
+
+  /**
+   * @brief Mask covering the first `length` steps.
+   */
+  [[nodiscard]] static constexpr uint64_t length_mask(size_t length) {
+    return length >= 64 ? ~uint64_t{0} : ((uint64_t{1} << length) - 1);
+  }
+
 private:
-  etl::array<Step, NumSteps> steps;
+  etl::array<Step, MaxSteps> steps{};
+  uint64_t enabled_mask_ = 0;
+  etl::vector<LockedStep, MaxLockedSteps> locks_;
+  std::optional<uint8_t> note_ = std::nullopt;
+  uint8_t length_ = MaxSteps;
 };
 
 /**
- * @brief Represents the main sequencer engine.
+ * @brief Represents one pattern: a set of tracks played together.
  * @tparam NumTracks The number of tracks in the sequencer.
- * @tparam NumSteps The number of steps per track.
+ * @tparam MaxSteps The maximum number of steps per track.
  */
-template <size_t NumTracks, size_t NumSteps> class Sequencer {
+template <size_t NumTracks, size_t MaxSteps> class Sequencer {
 public:
-  static_assert(NumTracks > 0 && NumSteps > 0,
+  static_assert(NumTracks > 0 && MaxSteps > 0,
                 "Sequencer must have at least one track and one step");
 
   constexpr Sequencer() = default;
@@ -156,7 +385,7 @@ public:
    * @return A reference to the Track object.
    * @note Assumes index is valid.
    */
-  [[nodiscard]] constexpr Track<NumSteps> &get_track(size_t index) {
+  [[nodiscard]] constexpr Track<MaxSteps> &get_track(size_t index) {
     return tracks[index];
   }
 
@@ -166,7 +395,7 @@ public:
    * @return A const reference to the Track object.
    * @note Assumes index is valid.
    */
-  [[nodiscard]] constexpr const Track<NumSteps> &get_track(size_t index) const {
+  [[nodiscard]] constexpr const Track<MaxSteps> &get_track(size_t index) const {
     return tracks[index];
   }
 
@@ -178,14 +407,38 @@ public:
   }
 
   /**
-   * @brief Get the number of steps per track.
+   * @brief Get the pattern length: the length of its longest track.
    */
   [[nodiscard]] constexpr size_t get_num_steps() const {
-    return NumSteps;
+    size_t longest = 1;
+    for (const auto &track : tracks) {
+      longest = track.size() > longest ? track.size() : longest;
+    }
+    return longest;
+  }
+
+  /**
+   * @brief Get the number of steps after which all tracks realign (the least
+   * common multiple of the track lengths). Equals get_num_steps() when all
+   * tracks share one length.
+   */
+  [[nodiscard]] constexpr size_t get_cycle_length() const {
+    size_t cycle = 1;
+    for (const auto &track : tracks) {
+      cycle = std::lcm(cycle, track.size());
+    }
+    return cycle;
+  }
+
+  /**
+   * @brief Get the number of steps each track can hold.
+   */
+  [[nodiscard]] static constexpr size_t get_max_steps() {
+    return MaxSteps;
   }
 
 private:
-  etl::array<Track<NumSteps>, NumTracks> tracks;
+  etl::array<Track<MaxSteps>, NumTracks> tracks;
 };
 
 } // namespace musin::timing
@@ -2,6 +2,7 @@
 #define MUSIN_TIMING_TEMPO_EVENT_H
 
 #include <cstdint>
+#include <optional>
 
 namespace musin::timing {
 
@@ -12,6 +13,9 @@ namespace musin::timing {
 struct TempoEvent {
   uint8_t phase_12 = 0; // Phase value 0-11 at 12 PPQN
   bool is_resync = false;
+  // Set on a resync that relocates to a song position: the position in
+  // ticks at this event's rate (phase_12 == song_position % 12).
+  std::optional<uint32_t> song_position{};
 };
 
 } // namespace musin::timing
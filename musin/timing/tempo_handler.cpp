@@ -68,10 +68,17 @@ void TempoHandler::notification(musin::timing::ClockEvent event) {
   }
 
   if (event.is_resync) {
-    phase_12_ = (anchor_phase != NO_ANCHOR) ? anchor_phase : 0;
+    if (event.song_position.has_value()) {
+      // Relocation (MIDI Start/Continue/SPP): the phase follows the position
+      phase_12_ = static_cast<uint8_t>(event.song_position.value() %
+                                       musin::timing::DEFAULT_PPQN);
+    } else {
+      phase_12_ = (anchor_phase != NO_ANCHOR) ? anchor_phase : 0;
+    }
     tick_count_++;
     musin::timing::TempoEvent tempo_event{.phase_12 = phase_12_,
-                                          .is_resync = true};
+                                          .is_resync = true,
+                                          .song_position = event.song_position};
     notify_observers(tempo_event);
     return;
   }
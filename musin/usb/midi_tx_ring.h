@@ -0,0 +1,138 @@
+#ifndef MUSIN_USB_MIDI_TX_RING_H
+#define MUSIN_USB_MIDI_TX_RING_H
+
+#include "etl/array.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace musin::usb {
+
+struct MidiTxStats {
+  uint32_t packets_sent = 0; // Packets handed to the endpoint
+  uint32_t deferred = 0;     // Pushes refused because the ring was full
+  uint32_t dropped = 0;      // Packets discarded (no host, or gave up)
+  uint16_t peak_depth = 0;   // Highest ring occupancy, in packets
+};
+
+/**
+ * @brief Ring of outgoing USB-MIDI event packets, written to the endpoint in
+ * batches.
+ *
+ * Senders push 4-byte packets without touching the USB stack; flush() hands
+ * everything queued to the endpoint in at most two contiguous writes, so the
+ * packets of one main-loop iteration share transfers instead of starting one
+ * each. A full ring refuses the push and the caller retries later, which lets
+ * the MIDI output queue keep the message rather than blocking.
+ *
+ * Not thread safe: push and flush must run on the same context.
+ *
+ * @tparam Endpoint Provides `bool mounted()` and
+ *         `size_t write(const uint8_t *data, size_t length)`, which returns
+ *         the number of bytes taken (a multiple of the packet size).
+ * @tparam CapacityPackets Ring size in event packets.
+ */
+template <typename Endpoint, size_t CapacityPackets> class MidiTxRing {
+public:
+  static constexpr size_t PACKET_SIZE = 4;
+  static constexpr size_t CAPACITY = CapacityPackets;
+
+  explicit MidiTxRing(Endpoint &endpoint) : endpoint_(endpoint) {
+  }
+
+  size_t size() const {
+    return count_;
+  }
+
+  size_t free_packets() const {
+    return CAPACITY - count_;
+  }
+
+  bool has_room(size_t packets) const {
+    return packets <= free_packets();
+  }
+
+  /**
+   * @brief Queues one event packet.
+   * @return false if the ring is full; the packet is not queued. With no
+   * host mounted the packet is discarded and true is returned.
+   */
+  bool try_push(const uint8_t packet[PACKET_SIZE]) {
+    if (!endpoint_.mounted()) {
+      ++stats_.dropped;
+      return true;
+    }
+    if (count_ == CAPACITY) {
+      ++stats_.deferred;
+      return false;
+    }
+    std::memcpy(&buffer_[tail_ * PACKET_SIZE], packet, PACKET_SIZE);
+    tail_ = (tail_ + 1) % CAPACITY;
+    ++count_;
+    stats_.peak_depth =
+        std::max(stats_.peak_depth, static_cast<uint16_t>(count_));
+    return true;
+  }
+
+  /**
+   * @brief Hands queued packets to the endpoint until it stops accepting.
+   * @return The number of packets written.
+   */
+  size_t flush() {
+    if (!endpoint_.mounted()) {
+      stats_.dropped += count_;
+      clear();
+      return 0;
+    }
+
+    size_t written = 0;
+    while (count_ > 0) {
+      // Up to the end of the buffer; a wrapped ring takes a second pass
+      const size_t run = std::min(count_, CAPACITY - head_);
+      const size_t taken =
+          endpoint_.write(&buffer_[head_ * PACKET_SIZE], run * PACKET_SIZE) /
+          PACKET_SIZE;
+      head_ = (head_ + taken) % CAPACITY;
+      count_ -= taken;
+      written += taken;
+      if (taken < run) {
+        break; // Endpoint FIFO full
+      }
+    }
+    stats_.packets_sent += written;
+    return written;
+  }
+
+  void clear() {
+    head_ = 0;
+    tail_ = 0;
+    count_ = 0;
+  }
+
+  const MidiTxStats &stats() const {
+    return stats_;
+  }
+
+  /** @brief Counts packets a caller gave up on without queueing them. */
+  void note_dropped(size_t packets) {
+    stats_.dropped += packets;
+  }
+
+  void reset_stats() {
+    stats_ = MidiTxStats{};
+    stats_.peak_depth = static_cast<uint16_t>(count_);
+  }
+
+private:
+  Endpoint &endpoint_;
+  etl::array<uint8_t, CAPACITY * PACKET_SIZE> buffer_{};
+  size_t head_ = 0;
+  size_t tail_ = 0;
+  size_t count_ = 0;
+  MidiTxStats stats_;
+};
+
+} // namespace musin::usb
+
+#endif // MUSIN_USB_MIDI_TX_RING_H
@@ -14,9 +14,37 @@ extern "C" {
 namespace musin {
 namespace usb {
 
+namespace {
+
+struct TinyUsbMidiEndpoint {
+  bool mounted() const {
+    return tud_ready();
+  }
+
+  // TinyUSB packs whatever sits in its TX FIFO into the next transfer, so a
+  // burst of packets written here shares 64-byte transfers.
+  size_t write(const uint8_t *data, size_t length) {
+    size_t written = 0;
+    while (written + 4 <= length &&
+           tud_midi_packet_write(data + written)) {
+      written += 4;
+    }
+    return written;
+  }
+};
+
+uint32_t midi_rx_time_us = 0;
+
+TinyUsbMidiEndpoint midi_endpoint;
+MidiTxRing<TinyUsbMidiEndpoint, MIDI_TX_RING_PACKETS>
+    midi_tx_ring(midi_endpoint);
+
+} // namespace
+
 bool background_update(void) {
   if (tusb_inited()) {
     tud_task();
+    midi_tx_ring.flush();
     return true;
   } else {
     return false;
@@ -37,20 +65,42 @@ bool midi_read(uint8_t packet[4]) {
   return ret;
 }
 
+uint32_t midi_rx_timestamp_us() {
+  return midi_rx_time_us;
+}
+
 void midi_send(const uint8_t packet[4]) {
-  // A long SysEx message (e.g. a 127-byte SDS data packet) exceeds the
-  // 64-byte MIDI TX FIFO. When the FIFO is full, drain USB and retry instead
-  // of silently dropping the rest of the message; give up after a deadline
-  // so an unresponsive host cannot stall the main loop.
+  // A long SysEx message (e.g. a 127-byte SDS data packet) can outgrow the
+  // ring when the host is slow. Drain USB and retry instead of silently
+  // dropping the rest of the message; give up after a deadline so an
+  // unresponsive host cannot stall the main loop.
   const absolute_time_t deadline = make_timeout_time_ms(10);
-  while (!tud_midi_packet_write(packet)) {
+  while (!midi_tx_ring.try_push(packet)) {
     if (!tud_ready() || time_reached(deadline)) {
+      midi_tx_ring.note_dropped(1);
       return;
     }
     tud_task();
+    midi_tx_ring.flush();
   }
 }
 
+bool midi_try_send(const uint8_t packet[4]) {
+  return midi_tx_ring.try_push(packet);
+}
+
+size_t midi_tx_free_packets() {
+  return midi_tx_ring.free_packets();
+}
+
+void midi_flush() {
+  midi_tx_ring.flush();
+}
+
+MidiTxStats midi_tx_stats() {
+  return midi_tx_ring.stats();
+}
+
 void init(const bool block_until_connected) {
   tusb_init();
 
@@ -63,3 +113,11 @@ void init(const bool block_until_connected) {
 
 } // namespace usb
 } // namespace musin
+
+// Invoked from tud_task() when a MIDI OUT transfer from the host lands. The
+// packets are read later in the same loop pass, so this is the closest
+// arrival time USB offers.
+extern "C" void tud_midi_rx_cb(uint8_t itf) {
+  (void)itf;
+  musin::usb::midi_rx_time_us = time_us_32();
+}
@@ -1,6 +1,8 @@
 #ifndef USB_H_EGTUA9NZ
 #define USB_H_EGTUA9NZ
 
+#include "musin/usb/midi_tx_ring.h"
+#include <stddef.h>
 #include <stdint.h>
 
 namespace musin {
@@ -10,7 +12,23 @@ void init(bool block_until_connected = false);
 void disconnect();
 bool background_update();
 bool midi_read(uint8_t packet[4]);
+// Time (time_us_32) the last MIDI transfer from the host was received
+uint32_t midi_rx_timestamp_us();
+// Outgoing event packets go through a TX ring that is flushed to the
+// endpoint by background_update() and midi_flush(). 256 packets (1 KB) holds
+// a few 127-byte SDS packets plus a loop's worth of notes and clock.
+constexpr size_t MIDI_TX_RING_PACKETS = 256;
+
+// Queues one packet, flushing and servicing USB for up to 10 ms if the ring
+// is full. Used by the MIDI library path (SysEx), which cannot retry.
 void midi_send(const uint8_t packet[4]);
+// Non-blocking: returns false when the ring is full so the caller can keep
+// the message and retry. With no host the packet is discarded and reported
+// as sent.
+bool midi_try_send(const uint8_t packet[4]);
+size_t midi_tx_free_packets();
+void midi_flush();
+MidiTxStats midi_tx_stats();
 
 } // namespace usb
 }; // namespace musin
@@ -0,0 +1,108 @@
+#include "drum/event_bus.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct TestEvent {
+  uint8_t track = 0;
+  uint8_t velocity = 0;
+};
+
+using TestBus = drum::EventBus<TestEvent, 2, 4>;
+
+std::vector<uint8_t> drain_tracks(TestBus::Consumer &consumer) {
+  std::vector<uint8_t> tracks;
+  consumer.drain(
+      [&tracks](const TestEvent &event) { tracks.push_back(event.track); });
+  return tracks;
+}
+
+} // namespace
+
+TEST_CASE("EventBus subscriptions", "[event_bus]") {
+  TestBus bus;
+
+  SECTION("Consumers are limited to MaxConsumers") {
+    REQUIRE(bus.subscribe() != nullptr);
+    REQUIRE(bus.subscribe() != nullptr);
+    REQUIRE(bus.subscribe() == nullptr);
+    REQUIRE(bus.consumer_count() == 2);
+  }
+
+  SECTION("Publishing without consumers does nothing") {
+    bus.publish(TestEvent{1, 100});
+    REQUIRE(bus.consumer_count() == 0);
+  }
+}
+
+TEST_CASE("EventBus fan-out", "[event_bus]") {
+  TestBus bus;
+  auto *audio = bus.subscribe();
+  auto *display = bus.subscribe();
+
+  SECTION("Every consumer receives every event in order") {
+    bus.publish(TestEvent{0, 100});
+    bus.publish(TestEvent{1, 90});
+    REQUIRE(drain_tracks(*audio) == std::vector<uint8_t>{0, 1});
+    REQUIRE(drain_tracks(*display) == std::vector<uint8_t>{0, 1});
+  }
+
+  SECTION("Consumers drain independently") {
+    bus.publish(TestEvent{0, 100});
+    REQUIRE(drain_tracks(*audio) == std::vector<uint8_t>{0});
+    bus.publish(TestEvent{1, 100});
+    REQUIRE(drain_tracks(*audio) == std::vector<uint8_t>{1});
+    REQUIRE(display->size() == 2);
+    REQUIRE(drain_tracks(*display) == std::vector<uint8_t>{0, 1});
+  }
+
+  SECTION("A full ring drops events for its consumer only") {
+    for (uint8_t track = 0; track < 4; ++track) {
+      bus.publish(TestEvent{track, 100});
+      drain_tracks(*audio);
+    }
+    bus.publish(TestEvent{4, 100});
+
+    REQUIRE(audio->dropped() == 0);
+    REQUIRE(drain_tracks(*audio) == std::vector<uint8_t>{4});
+    REQUIRE(display->dropped() == 1);
+    REQUIRE(drain_tracks(*display) == std::vector<uint8_t>{0, 1, 2, 3});
+  }
+
+  SECTION("pop takes one event at a time") {
+    bus.publish(TestEvent{2, 64});
+    TestEvent event;
+    REQUIRE(audio->pop(event));
+    REQUIRE(event.track == 2);
+    REQUIRE(event.velocity == 64);
+    REQUIRE_FALSE(audio->pop(event));
+  }
+}
+
+TEST_CASE("EventBus drain is bounded", "[event_bus]") {
+  TestBus bus;
+  auto *consumer = bus.subscribe();
+
+  SECTION("Events published while draining wait for the next drain") {
+    bus.publish(TestEvent{0, 100});
+    bus.publish(TestEvent{1, 100});
+    std::vector<uint8_t> tracks;
+    const size_t handled =
+        consumer->drain([&](const TestEvent &event) {
+          tracks.push_back(event.track);
+          bus.publish(TestEvent{static_cast<uint8_t>(event.track + 10), 100});
+        });
+
+    REQUIRE(handled == 2);
+    REQUIRE(tracks == std::vector<uint8_t>{0, 1});
+    REQUIRE(drain_tracks(*consumer) == std::vector<uint8_t>{10, 11});
+  }
+
+  SECTION("Draining an empty ring handles nothing") {
+    REQUIRE(consumer->drain([](const TestEvent &) {}) == 0);
+  }
+}
@@ -20,13 +20,16 @@ struct FakeWriter {
   bool finalize_ok = true;
 
   uint32_t begun_size = 0;
+  uint8_t begun_format = 0xFF;
   std::vector<uint8_t> begun_sha;
   std::vector<uint8_t> written;
   int abort_count = 0;
   int finalize_count = 0;
 
-  bool begin(uint32_t total_size, etl::span<const uint8_t> sha256) {
+  bool begin(uint32_t total_size, etl::span<const uint8_t> sha256,
+             uint8_t format) {
     begun_size = total_size;
+    begun_format = format;
     begun_sha.assign(sha256.begin(), sha256.end());
     written.clear();
     return begin_ok;
@@ -96,7 +99,8 @@ std::vector<uint8_t> encode_3_to_16bit(const std::vector<uint8_t> &bytes) {
 }
 
 std::vector<uint8_t> make_begin_chunk(uint32_t total_size,
-                                      uint8_t sha_fill = 0xAB) {
+                                      uint8_t sha_fill = 0xAB,
+                                      int format = -1) {
   std::vector<uint8_t> payload;
   payload.push_back(total_size & 0xFF);
   payload.push_back((total_size >> 8) & 0xFF);
@@ -108,6 +112,9 @@ std::vector<uint8_t> make_begin_chunk(uint32_t total_size,
   payload.push_back(1); // version major
   payload.push_back(2); // minor
   payload.push_back(3); // patch
+  if (format >= 0) {
+    payload.push_back(static_cast<uint8_t>(format));
+  }
 
   std::vector<uint8_t> chunk = HEADER;
   chunk.push_back(Tag::BeginFirmwareUpdate);
@@ -183,6 +190,21 @@ TEST_CASE("FirmwareUpdate tolerates codec padding in the final group") {
           Result::UpdateReady);
 }
 
+TEST_CASE("FirmwareUpdate passes the image format to the writer") {
+  Fixture f;
+
+  SECTION("Hosts without a format byte send UF2") {
+    REQUIRE(f.handle(make_begin_chunk(1024)) == Result::OK);
+    REQUIRE(f.writer.begun_format == 0);
+  }
+
+  SECTION("A compact container is announced after the version") {
+    REQUIRE(f.handle(make_begin_chunk(1000, 0xAB, 1)) == Result::OK);
+    REQUIRE(f.writer.begun_format == 1);
+    REQUIRE(f.writer.begun_sha == std::vector<uint8_t>(32, 0xAB));
+  }
+}
+
 TEST_CASE("FirmwareUpdate rejects Begin with zero size") {
   Fixture f;
   REQUIRE(f.handle(make_begin_chunk(0)) == Result::WriteError);
@@ -0,0 +1,532 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "etl/optional.h"
+#include "etl/span.h"
+#include "etl/string_view.h"
+
+#include "musin/hal/null_logger.h"
+
+#include "drum/sysex/kit_transfer.h"
+
+absolute_time_t mock_current_time = 0;
+
+namespace {
+
+// An in-memory filesystem: a map of paths to contents plus a set of
+// directories.
+struct FakeFileOps {
+  std::map<std::string, std::vector<uint8_t>> files;
+  std::map<std::string, bool> directories;
+  size_t renames_left = SIZE_MAX; // Simulates power loss mid-commit
+  // When set, written data stays staged until the test clears
+  // write_pending, as with StandardFileOps
+  bool defer_writes = false;
+  bool write_pending = false;
+  bool write_fails = false;
+
+  struct Handle {
+    FakeFileOps *parent;
+    std::string path;
+
+    size_t write(const etl::span<const uint8_t> &bytes) {
+      auto &contents = parent->files[path];
+      contents.insert(contents.end(), bytes.begin(), bytes.end());
+      parent->write_pending = parent->defer_writes;
+      return bytes.size();
+    }
+
+    void close() {
+    }
+  };
+
+  struct ReadHandle {
+    const std::vector<uint8_t> *contents;
+    size_t position = 0;
+
+    size_t size() const {
+      return contents->size();
+    }
+
+    size_t read(const etl::span<uint8_t> &bytes) {
+      const size_t count =
+          std::min(bytes.size(), contents->size() - position);
+      std::copy_n(contents->begin() + position, count, bytes.begin());
+      position += count;
+      return count;
+    }
+  };
+
+  Handle open(const etl::string_view &path, bool append) {
+    std::string name(path.begin(), path.end());
+    if (!append) {
+      files[name].clear();
+    }
+    files[name];
+    return Handle{this, name};
+  }
+
+  etl::optional<ReadHandle> open_read(const etl::string_view &path) {
+    const auto found = files.find(std::string(path.begin(), path.end()));
+    if (found == files.end()) {
+      return etl::nullopt;
+    }
+    return ReadHandle{&found->second};
+  }
+
+  bool rename_path(const char *from, const char *to) {
+    const auto found = files.find(from);
+    if (found == files.end() || renames_left == 0) {
+      return false;
+    }
+    --renames_left;
+    files[to] = found->second;
+    files.erase(from);
+    return true;
+  }
+
+  bool remove_path(const char *path) {
+    return files.erase(path) > 0 || directories.erase(path) > 0;
+  }
+
+  bool make_directory(const char *path) {
+    directories[path] = true;
+    return true;
+  }
+
+  bool finishing_write() const {
+    return write_pending;
+  }
+
+  bool write_failed() const {
+    return write_fails;
+  }
+
+  bool complete_write() {
+    write_pending = false;
+    return !write_fails;
+  }
+
+  bool staging_is_empty() const {
+    for (const auto &[path, contents] : files) {
+      if (path.rfind("/kit.new", 0) == 0) {
+        return false;
+      }
+    }
+    return directories.empty();
+  }
+};
+
+using Kit = sysex::KitTransfer<FakeFileOps>;
+using Result = Kit::Result;
+using Tag = Kit::Tag;
+
+struct MockSender {
+  std::vector<uint8_t> &sent;
+  std::vector<uint8_t> &payload;
+  void operator()(Tag tag) {
+    sent.push_back(tag);
+    payload.clear();
+  }
+  void operator()(Tag tag, etl::span<const uint8_t> bytes) {
+    sent.push_back(tag);
+    payload.assign(bytes.begin(), bytes.end());
+  }
+};
+
+const std::vector<uint8_t> HEADER = {0x00, 0x22, 0x01, 0x65};
+
+std::vector<uint8_t> encode_8_to_7(const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < data.size(); i += 7) {
+    uint8_t msbs = 0;
+    for (size_t j = 0; j < 7; ++j) {
+      const uint8_t byte = i + j < data.size() ? data[i + j] : 0;
+      out.push_back(byte & 0x7F);
+      msbs |= static_cast<uint8_t>((byte >> 7) & 0x01) << j;
+    }
+    out.push_back(msbs);
+  }
+  return out;
+}
+
+void push_u32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint32_t crc32(const std::vector<uint8_t> &bytes) {
+  etl::crc32 crc;
+  crc.add(bytes.begin(), bytes.end());
+  return crc.value();
+}
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>(seed + i * 31);
+  }
+  return bytes;
+}
+
+struct KitFile {
+  std::string name;
+  std::vector<uint8_t> contents;
+};
+
+// Drives a KitTransfer the way the host tool does.
+struct Host {
+  FakeFileOps &file_ops;
+  Kit &kit;
+  std::vector<uint8_t> sent;
+  std::vector<uint8_t> payload;
+
+  Result send(uint8_t tag, const std::vector<uint8_t> &body = {}) {
+    std::vector<uint8_t> chunk = HEADER;
+    chunk.push_back(tag);
+    chunk.insert(chunk.end(), body.begin(), body.end());
+    return kit.handle_chunk(sysex::Chunk(chunk.data(), chunk.size()),
+                            MockSender{sent, payload}, mock_current_time);
+  }
+
+  uint8_t last() const {
+    return sent.back();
+  }
+
+  uint32_t status_offset() const {
+    uint32_t offset = 0;
+    for (size_t i = 0; i < 5; ++i) {
+      offset |= static_cast<uint32_t>(payload[1 + i]) << (7 * i);
+    }
+    return offset;
+  }
+
+  Result begin(uint32_t kit_id, uint8_t count) {
+    std::vector<uint8_t> bytes;
+    push_u32(bytes, kit_id);
+    bytes.push_back(count);
+    return send(Tag::BeginKitTransfer, encode_8_to_7(bytes));
+  }
+
+  // Returns the offset the device reports for the entry
+  uint32_t entry(uint8_t index, const KitFile &file) {
+    std::vector<uint8_t> bytes{index};
+    push_u32(bytes, static_cast<uint32_t>(file.contents.size()));
+    push_u32(bytes, crc32(file.contents));
+    bytes.insert(bytes.end(), file.name.begin(), file.name.end());
+    bytes.push_back(0);
+    send(Tag::KitFileEntry, encode_8_to_7(bytes));
+    REQUIRE(last() == Tag::KitFileStatus);
+    REQUIRE(payload[0] == index);
+    return status_offset();
+  }
+
+  Result bytes(uint8_t index, uint32_t offset,
+               const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> body{index};
+    for (size_t i = 0; i < 5; ++i) {
+      body.push_back((offset >> (7 * i)) & 0x7F);
+    }
+    const auto encoded = encode_8_to_7(data);
+    body.insert(body.end(), encoded.begin(), encoded.end());
+    return send(Tag::KitFileBytes, body);
+  }
+
+  // Sends a file from `offset` in chunks of 70 bytes
+  void stream(uint8_t index, const KitFile &file, uint32_t offset = 0,
+              size_t stop_at = SIZE_MAX) {
+    while (offset < file.contents.size() && offset < stop_at) {
+      const size_t length = std::min<size_t>(70, file.contents.size() - offset);
+      const std::vector<uint8_t> data(file.contents.begin() + offset,
+                                      file.contents.begin() + offset + length);
+      bytes(index, offset, data);
+      REQUIRE(last() == Tag::Ack);
+      offset += length;
+    }
+  }
+
+  void manifest(uint32_t kit_id, const std::vector<KitFile> &files) {
+    REQUIRE(begin(kit_id, static_cast<uint8_t>(files.size())) == Result::OK);
+    REQUIRE(last() == Tag::Ack);
+    for (size_t i = 0; i < files.size(); ++i) {
+      entry(static_cast<uint8_t>(i), files[i]);
+    }
+  }
+};
+
+const std::vector<KitFile> KIT = {
+    {"00.pcm", pattern(300, 1)},
+    {"01.pcm", pattern(141, 2)},
+    {"kit.bin", pattern(64, 3)},
+};
+
+} // namespace
+
+TEST_CASE("KitTransfer installs every file on commit") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+  file_ops.files["/00.pcm"] = {0xAA};
+
+  host.manifest(7, KIT);
+  REQUIRE(kit.get_state() == Kit::State::Receiving);
+  for (size_t i = 0; i < KIT.size(); ++i) {
+    host.stream(static_cast<uint8_t>(i), KIT[i]);
+  }
+
+  // Nothing installed is touched before the commit
+  REQUIRE(file_ops.files["/00.pcm"] == std::vector<uint8_t>{0xAA});
+  REQUIRE_FALSE(file_ops.files.count("/kit.bin"));
+
+  REQUIRE(host.send(Tag::CommitKit) == Result::KitCommitted);
+  REQUIRE(host.last() == Tag::Ack);
+  for (const auto &file : KIT) {
+    REQUIRE(file_ops.files["/" + file.name] == file.contents);
+  }
+  REQUIRE(file_ops.staging_is_empty());
+  REQUIRE_FALSE(kit.busy());
+}
+
+TEST_CASE("KitTransfer refuses an incomplete or corrupt kit") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+  host.manifest(7, KIT);
+
+  SECTION("Commit reports the first incomplete file") {
+    host.stream(0, KIT[0]);
+    host.stream(1, KIT[1], 0, 70);
+    REQUIRE(host.send(Tag::CommitKit) == Result::OK);
+    REQUIRE(host.last() == Tag::KitFileStatus);
+    REQUIRE(host.payload[0] == 1);
+    REQUIRE(host.status_offset() == 70);
+    REQUIRE_FALSE(file_ops.files.count("/00.pcm"));
+  }
+
+  SECTION("Data at the wrong offset is answered with the staged offset") {
+    host.stream(0, KIT[0], 0, 140);
+    host.bytes(0, 210, pattern(70, 9));
+    REQUIRE(host.last() == Tag::KitFileStatus);
+    REQUIRE(host.status_offset() == 140);
+    host.stream(0, KIT[0], 140);
+    REQUIRE(file_ops.files["/kit.new/00.pcm"] == KIT[0].contents);
+  }
+
+  SECTION("A file with the wrong CRC starts over") {
+    KitFile corrupt = KIT[2];
+    corrupt.contents[10] ^= 0xFF;
+    host.bytes(2, 0, corrupt.contents);
+    REQUIRE(host.last() == Tag::Nack);
+    REQUIRE(kit.get_state() == Kit::State::Receiving);
+    host.stream(2, KIT[2]);
+    REQUIRE(file_ops.files["/kit.new/kit.bin"] == KIT[2].contents);
+  }
+
+  SECTION("Names that leave the root directory are refused") {
+    REQUIRE(host.begin(8, 1) == Result::OK);
+    std::vector<uint8_t> bytes{0};
+    push_u32(bytes, 4);
+    push_u32(bytes, 0);
+    for (char character : std::string("../kit.bin")) {
+      bytes.push_back(static_cast<uint8_t>(character));
+    }
+    bytes.push_back(0);
+    REQUIRE(host.send(Tag::KitFileEntry, encode_8_to_7(bytes)) ==
+            Result::InvalidContent);
+    REQUIRE(host.last() == Tag::Nack);
+  }
+
+  SECTION("Abort discards the staged files") {
+    host.stream(0, KIT[0]);
+    REQUIRE(host.send(Tag::AbortKitTransfer) == Result::Aborted);
+    REQUIRE(file_ops.staging_is_empty());
+    REQUIRE_FALSE(kit.busy());
+  }
+}
+
+TEST_CASE("KitTransfer acks a file's last bytes once they are written") {
+  FakeFileOps file_ops;
+  file_ops.defer_writes = true;
+  musin::NullLogger logger;
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+  host.manifest(7, KIT);
+
+  const KitFile &file = KIT[2];
+  host.bytes(2, 0, file.contents);
+  REQUIRE(host.sent.back() == Tag::KitFileStatus); // From the manifest
+  REQUIRE(kit.get_state() == Kit::State::Finishing);
+
+  const auto service = [&] {
+    kit.service(MockSender{host.sent, host.payload});
+  };
+
+  SECTION("Ack once the staged data has been written") {
+    service();
+    REQUIRE(host.last() == Tag::KitFileStatus);
+    file_ops.write_pending = false;
+    service();
+    REQUIRE(host.last() == Tag::Ack);
+    REQUIRE(kit.get_state() == Kit::State::Receiving);
+  }
+
+  SECTION("A file that failed to write is Nacked and starts over") {
+    file_ops.write_fails = true;
+    file_ops.write_pending = false;
+    service();
+    REQUIRE(host.last() == Tag::Nack);
+    REQUIRE(host.send(Tag::CommitKit) == Result::OK);
+    REQUIRE(host.last() == Tag::KitFileStatus);
+    REQUIRE(host.payload[0] == 0);
+
+    file_ops.write_fails = false;
+    host.bytes(2, 40, {});
+    REQUIRE(host.last() == Tag::KitFileStatus);
+    REQUIRE(host.payload[0] == 2);
+    REQUIRE(host.status_offset() == 0);
+  }
+
+  SECTION("The next message is answered after the Ack") {
+    REQUIRE(host.send(Tag::CommitKit) == Result::OK);
+    REQUIRE_FALSE(file_ops.write_pending);
+    REQUIRE(host.sent[host.sent.size() - 2] == Tag::Ack);
+    REQUIRE(host.last() == Tag::KitFileStatus);
+  }
+}
+
+TEST_CASE("KitTransfer resumes after a dropped connection") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  {
+    Kit kit(file_ops, logger);
+    Host host{file_ops, kit, {}, {}};
+    host.manifest(7, KIT);
+    host.stream(0, KIT[0]);
+    host.stream(1, KIT[1], 0, 70);
+    mock_current_time += Kit::TIMEOUT_US + 1;
+    REQUIRE(kit.check_timeout(mock_current_time));
+    REQUIRE_FALSE(kit.busy());
+  }
+
+  // The device may also have rebooted in between
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+
+  SECTION("The same kit picks up from the staged bytes") {
+    REQUIRE(host.begin(7, 3) == Result::OK);
+    REQUIRE(host.entry(0, KIT[0]) == 300);
+    REQUIRE(host.entry(1, KIT[1]) == 70);
+    REQUIRE(host.entry(2, KIT[2]) == 0);
+    host.stream(1, KIT[1], 70);
+    host.stream(2, KIT[2]);
+    REQUIRE(host.send(Tag::CommitKit) == Result::KitCommitted);
+    for (const auto &file : KIT) {
+      REQUIRE(file_ops.files["/" + file.name] == file.contents);
+    }
+  }
+
+  SECTION("A changed file starts over") {
+    KitFile changed = KIT[1];
+    changed.contents[0] ^= 0xFF;
+    REQUIRE(host.begin(7, 3) == Result::OK);
+    REQUIRE(host.entry(0, KIT[0]) == 300);
+    REQUIRE(host.entry(1, changed) == 0);
+    REQUIRE(host.entry(2, KIT[2]) == 0);
+    host.stream(1, changed);
+    REQUIRE(file_ops.files["/kit.new/01.pcm"] == changed.contents);
+  }
+
+  SECTION("A different kit discards the staged files") {
+    REQUIRE(host.begin(8, 1) == Result::OK);
+    REQUIRE_FALSE(file_ops.files.count("/kit.new/00.pcm"));
+    REQUIRE_FALSE(file_ops.files.count("/kit.new/01.pcm"));
+    REQUIRE(host.entry(0, KIT[0]) == 0);
+  }
+}
+
+TEST_CASE("KitTransfer finishes an interrupted commit at boot") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  {
+    Kit kit(file_ops, logger);
+    Host host{file_ops, kit, {}, {}};
+    host.manifest(7, KIT);
+    for (size_t i = 0; i < KIT.size(); ++i) {
+      host.stream(static_cast<uint8_t>(i), KIT[i]);
+    }
+    file_ops.renames_left = 1;
+    REQUIRE(host.send(Tag::CommitKit) == Result::FileError);
+    REQUIRE(file_ops.files.count("/00.pcm"));
+    REQUIRE_FALSE(file_ops.files.count("/01.pcm"));
+  }
+
+  file_ops.renames_left = SIZE_MAX;
+  Kit kit(file_ops, logger);
+  REQUIRE(kit.recover());
+  for (const auto &file : KIT) {
+    REQUIRE(file_ops.files["/" + file.name] == file.contents);
+  }
+  REQUIRE(file_ops.staging_is_empty());
+  REQUIRE_FALSE(kit.recover());
+}
+
+TEST_CASE("KitTransfer finishes a failed commit before starting over") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+  file_ops.files["/01.pcm"] = {0xAA};
+  host.manifest(7, KIT);
+  for (size_t i = 0; i < KIT.size(); ++i) {
+    host.stream(static_cast<uint8_t>(i), KIT[i]);
+  }
+  // The first file is moved, then a rename fails
+  file_ops.renames_left = 1;
+  REQUIRE(host.send(Tag::CommitKit) == Result::FileError);
+  REQUIRE(host.last() == Tag::Nack);
+  REQUIRE(file_ops.files.count("/kit.new/.commit"));
+  REQUIRE(file_ops.files["/00.pcm"] == KIT[0].contents);
+  REQUIRE(file_ops.files["/01.pcm"] == std::vector<uint8_t>{0xAA});
+  file_ops.renames_left = SIZE_MAX;
+
+  SECTION("An abort completes the kit instead of discarding it") {
+    REQUIRE(host.send(Tag::AbortKitTransfer) == Result::KitCommitted);
+    REQUIRE(host.last() == Tag::Ack);
+    REQUIRE(file_ops.staging_is_empty());
+  }
+
+  SECTION("A new transfer completes the kit before staging") {
+    REQUIRE(host.begin(7, 3) == Result::KitCommitted);
+    REQUIRE(host.last() == Tag::Ack);
+    REQUIRE_FALSE(file_ops.files.count("/kit.new/.commit"));
+    // Nothing is left staged to resume from
+    REQUIRE(host.entry(0, KIT[0]) == 0);
+  }
+
+  for (const auto &file : KIT) {
+    REQUIRE(file_ops.files["/" + file.name] == file.contents);
+  }
+  Kit rebooted(file_ops, logger);
+  REQUIRE_FALSE(rebooted.recover());
+}
+
+TEST_CASE("KitTransfer leaves an uncommitted kit alone at boot") {
+  FakeFileOps file_ops;
+  musin::NullLogger logger;
+  Kit kit(file_ops, logger);
+  Host host{file_ops, kit, {}, {}};
+  host.manifest(7, KIT);
+  host.stream(0, KIT[0]);
+
+  Kit rebooted(file_ops, logger);
+  REQUIRE_FALSE(rebooted.recover());
+  REQUIRE(file_ops.files["/kit.new/00.pcm"] == KIT[0].contents);
+  REQUIRE_FALSE(file_ops.files.count("/00.pcm"));
+}
@@ -133,6 +133,22 @@ TEST_CASE("Invalidation drops a matching staged load") {
   remove(path.c_str());
 }
 
+TEST_CASE("Invalidating all samples forgets every voice and staged load") {
+  drum::SampleSlotManager manager(logger);
+  auto path = write_pcm_file("slot_test_i.pcm", 1000, 100);
+
+  REQUIRE(manager.request_load(0, 4, path.c_str()));
+  manager.commit_staging();
+  REQUIRE(manager.request_load(1, 5, path.c_str()));
+
+  manager.invalidate_all();
+  REQUIRE_FALSE(manager.voice_has_sample(0, 4));
+  REQUIRE_FALSE(manager.staging_ready_for_voice(1));
+  // The old audio stays playable until a reload commits.
+  REQUIRE(manager.voice_length(0) == 1000);
+  remove(path.c_str());
+}
+
 TEST_CASE("Missing file is reported as failure") {
   drum::SampleSlotManager manager(logger);
   REQUIRE_FALSE(manager.request_load(0, 3, "./does_not_exist.pcm"));
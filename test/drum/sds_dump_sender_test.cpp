@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <cstdint>
+#include <cstring>
 
 #include "etl/array.h"
 #include "etl/optional.h"
@@ -15,14 +16,17 @@ extern absolute_time_t mock_current_time;
 
 namespace {
 
-// File mock backed by an in-memory sample. open_read succeeds only for the
-// configured content; an empty content simulates a missing file.
+// File mock backed by an in-memory sample and its format record. open_read
+// succeeds only for configured content; empty content simulates a missing
+// file.
 struct TestFileOps {
   struct ReadHandle {
     TestFileOps &parent;
+    const etl::ivector<uint8_t> &source;
     size_t position = 0;
 
-    explicit ReadHandle(TestFileOps &parent) : parent(parent) {
+    ReadHandle(TestFileOps &parent, const etl::ivector<uint8_t> &source)
+        : parent(parent), source(source) {
       parent.file_is_open = true;
     }
 
@@ -30,18 +34,20 @@ struct TestFileOps {
     ReadHandle &operator=(const ReadHandle &) = delete;
 
     ReadHandle(ReadHandle &&other) noexcept
-        : parent(other.parent), position(other.position) {
+        : parent(other.parent), source(other.source),
+          position(other.position) {
       other.owns_file = false;
     }
 
     size_t size() const {
-      return parent.content.size();
+      return source.size();
     }
 
     size_t read(const etl::span<uint8_t> &out) {
+      ++parent.read_count;
       size_t count = 0;
-      while (count < out.size() && position < parent.content.size()) {
-        out[count++] = parent.content[position++];
+      while (count < out.size() && position < source.size()) {
+        out[count++] = source[position++];
       }
       return count;
     }
@@ -59,16 +65,24 @@ struct TestFileOps {
   etl::optional<ReadHandle> open_read(const etl::string_view &path) {
     last_opened_path.assign(path.begin(), path.end());
     open_count++;
+    if (path.ends_with(".sds")) {
+      if (format_content.empty()) {
+        return etl::nullopt;
+      }
+      return etl::optional<ReadHandle>(ReadHandle(*this, format_content));
+    }
     if (content.empty()) {
       return etl::nullopt;
     }
-    return etl::optional<ReadHandle>(ReadHandle(*this));
+    return etl::optional<ReadHandle>(ReadHandle(*this, content));
   }
 
   etl::vector<char, 32> last_opened_path;
   etl::vector<uint8_t, 512> content;
+  etl::vector<uint8_t, 32> format_content;
   bool file_is_open = false;
   unsigned open_count = 0;
+  unsigned read_count = 0;
 };
 
 using Sender = sds::DumpSender<TestFileOps>;
@@ -100,6 +114,17 @@ int16_t unpack_sample(const uint8_t *bytes) {
   return static_cast<int16_t>(unsigned_sample - 0x8000);
 }
 
+void store_format(TestFileOps &file_ops, uint8_t bit_depth,
+                  uint32_t period_ns, uint32_t length_words) {
+  sds::StoredFormat format{};
+  format.bit_depth = bit_depth;
+  format.sample_period_ns = period_ns;
+  format.length_words = length_words;
+  format.pcm_bytes = static_cast<uint32_t>(file_ops.content.size());
+  file_ops.format_content.resize(sizeof(format));
+  std::memcpy(file_ops.format_content.data(), &format, sizeof(format));
+}
+
 void fill_with_samples(etl::vector<uint8_t, 512> &content,
                        std::initializer_list<int16_t> samples) {
   for (const int16_t s : samples) {
@@ -405,4 +430,172 @@ TEST_CASE("A second dump request during an active dump is refused") {
   REQUIRE(dump_sender.is_busy()); // original dump unaffected
 }
 
+TEST_CASE("A sample received in another format is dumped in that format",
+          "[format]") {
+  TestFileOps file_ops;
+  // 44.1 kHz PCM that arrived as 21 words of 12-bit audio at 22.05 kHz
+  etl::vector<int16_t, 64> samples;
+  for (int i = 0; i < 42; ++i) {
+    samples.push_back(static_cast<int16_t>(i * 320 - 6400));
+  }
+  for (const int16_t s : samples) {
+    file_ops.content.push_back(static_cast<uint8_t>(s & 0xFF));
+    file_ops.content.push_back(static_cast<uint8_t>((s >> 8) & 0xFF));
+  }
+  musin::NullLogger logger;
+  Sender dump_sender(file_ops, logger);
+  MessageLog log;
+  MockSender out{log};
+
+  SECTION("The header and packets carry the recorded format") {
+    store_format(file_ops, 12, 45351, 21);
+    const auto request = make_dump_request(6);
+    dump_sender.handle_dump_request(etl::span<const uint8_t>{request}, out,
+                                    ONE_SECOND_US);
+    REQUIRE(log.size() == 1);
+    REQUIRE(log[0][3] == 12);
+    REQUIRE((log[0][4] | (log[0][5] << 7) | (log[0][6] << 14)) == 45351);
+    REQUIRE((log[0][7] | (log[0][8] << 7) | (log[0][9] << 14)) == 21);
+
+    // 21 two-byte words fit the one packet that completes the dump
+    dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US);
+    REQUIRE(dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US) ==
+            sds::Result::SampleComplete);
+    REQUIRE(log.size() == 2);
+    const auto &packet = log[1];
+    REQUIRE(packet[122] ==
+            sds::calculate_data_checksum(
+                packet[1], etl::span<const uint8_t>{&packet[2], 120}));
+    for (size_t i = 0; i < 60; ++i) {
+      const uint32_t packed = (packet[2 + i * 2] << 7) | packet[3 + i * 2];
+      const int32_t word = static_cast<int32_t>(packed >> 2) - 2048;
+      const int32_t expected = i < 21 ? samples[2 * i] / 16 : 0;
+      REQUIRE(std::abs(word - expected) <= 1);
+    }
+  }
+
+  SECTION("A record left over from another sample is ignored") {
+    store_format(file_ops, 12, 45351, 21);
+    file_ops.content.push_back(0);
+    file_ops.content.push_back(0);
+    const auto request = make_dump_request(6);
+    dump_sender.handle_dump_request(etl::span<const uint8_t>{request}, out,
+                                    ONE_SECOND_US);
+    REQUIRE(log[0][3] == 16);
+    REQUIRE((log[0][4] | (log[0][5] << 7) | (log[0][6] << 14)) ==
+            sds::ENGINE_SAMPLE_PERIOD_NS);
+    REQUIRE((log[0][7] | (log[0][8] << 7) | (log[0][9] << 14)) == 43);
+  }
+}
+
+void fill_with_ramp(TestFileOps &file_ops, size_t sample_count) {
+  for (size_t i = 0; i < sample_count; ++i) {
+    const auto sample = static_cast<int16_t>(i * 97 - 16000);
+    file_ops.content.push_back(static_cast<uint8_t>(sample & 0xFF));
+    file_ops.content.push_back(static_cast<uint8_t>((sample >> 8) & 0xFF));
+  }
+}
+
+void require_ramp_packets(const MessageLog &log, size_t sample_count) {
+  size_t sample_index = 0;
+  for (size_t p = 1; p < log.size(); ++p) {
+    REQUIRE(log[p][1] == p - 1);
+    for (size_t i = 0; i < 40; ++i, ++sample_index) {
+      const int16_t expected =
+          sample_index < sample_count
+              ? static_cast<int16_t>(sample_index * 97 - 16000)
+              : 0;
+      REQUIRE(unpack_sample(&log[p][2 + i * 3]) == expected);
+    }
+  }
+}
+
+TEST_CASE("The next packet is read while the current one is in flight",
+          "[readahead]") {
+  TestFileOps file_ops;
+  fill_with_ramp(file_ops, 230); // 6 packets, two 256-byte reads
+  musin::NullLogger logger;
+  Sender dump_sender(file_ops, logger);
+  MessageLog log;
+  MockSender out{log};
+
+  const auto request = make_dump_request(8);
+  absolute_time_t now = ONE_SECOND_US;
+  dump_sender.handle_dump_request(etl::span<const uint8_t>{request}, out, now);
+
+  sds::Result result = sds::Result::OK;
+  while (result == sds::Result::OK) {
+    dump_sender.update(out, now);
+    const unsigned reads = file_ops.read_count;
+    result = dump_sender.handle_response(sds::ACK, out, now);
+    REQUIRE(file_ops.read_count == reads);
+    now += 1000;
+  }
+
+  REQUIRE(result == sds::Result::SampleComplete);
+  REQUIRE(log.size() == 7);
+  REQUIRE(file_ops.read_count == 2);
+  require_ramp_packets(log, 230);
+
+  // 6 packets of 120 bytes, from the header to the final ACK after 6 ms
+  REQUIRE(dump_sender.last_bytes_per_second() == 720 * 1000000 / 6000);
+}
+
+TEST_CASE("A NAK resends the packet in flight, not the one read ahead",
+          "[readahead]") {
+  TestFileOps file_ops;
+  fill_with_ramp(file_ops, 100);
+  musin::NullLogger logger;
+  Sender dump_sender(file_ops, logger);
+  MessageLog log;
+  MockSender out{log};
+
+  const auto request = make_dump_request(8);
+  dump_sender.handle_dump_request(etl::span<const uint8_t>{request}, out,
+                                  ONE_SECOND_US);
+  dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US);
+  dump_sender.update(out, ONE_SECOND_US); // builds packet 1
+  dump_sender.handle_response(sds::NAK, out, ONE_SECOND_US);
+  REQUIRE(log.size() == 3);
+  REQUIRE(log[2] == log[1]);
+
+  dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US);
+  dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US);
+  REQUIRE(dump_sender.handle_response(sds::ACK, out, ONE_SECOND_US) ==
+          sds::Result::SampleComplete);
+  log.erase(log.begin() + 2);
+  REQUIRE(log.size() == 4);
+  require_ramp_packets(log, 100);
+}
+
+TEST_CASE("Open-loop packets go out from the read-ahead buffer",
+          "[readahead]") {
+  TestFileOps file_ops;
+  fill_with_ramp(file_ops, 200); // 5 packets
+  musin::NullLogger logger;
+  Sender dump_sender(file_ops, logger);
+  MessageLog log;
+  MockSender out{log};
+
+  const auto request = make_dump_request(8);
+  absolute_time_t now = ONE_SECOND_US;
+  dump_sender.handle_dump_request(etl::span<const uint8_t>{request}, out, now);
+  dump_sender.update(out, now);
+  REQUIRE(file_ops.read_count == 1);
+
+  // The main loop runs far more often than packets are due
+  now += Sender::HEADER_RESPONSE_TIMEOUT_US + 1;
+  sds::Result result = sds::Result::OK;
+  while (result == sds::Result::OK) {
+    result = dump_sender.update(out, now);
+    now += 1000;
+  }
+
+  REQUIRE(result == sds::Result::SampleComplete);
+  REQUIRE(log.size() == 6);
+  REQUIRE(file_ops.read_count == 2);
+  require_ramp_packets(log, 200);
+  REQUIRE(dump_sender.last_bytes_per_second() > 0);
+}
+
 } // namespace
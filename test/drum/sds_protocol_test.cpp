@@ -1,6 +1,10 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
 
 #include "etl/array.h"
 #include "etl/span.h"
@@ -63,9 +67,9 @@ etl::array<uint8_t, 17> make_dump_header(uint32_t length_words) {
           0x1E, // sample number low (= 30)
           0x00, // sample number high
           16,   // bit depth
-          0x10,
-          0x30,
-          0x01, // sample period (~44.1k), arbitrary nonzero
+          0x13,
+          0x31,
+          0x01, // sample period 22675 ns (44.1 kHz), stored unconverted
           static_cast<uint8_t>(length_words & 0x7F),
           static_cast<uint8_t>((length_words >> 7) & 0x7F),
           static_cast<uint8_t>((length_words >> 14) & 0x7F),
@@ -224,4 +228,589 @@ TEST_CASE("SDS check_timeout is a no-op while idle") {
   REQUIRE_FALSE(protocol.is_busy());
 }
 
+// ---------------------------------------------------------------------------
+// Bit depth and sample rate conversion
+// ---------------------------------------------------------------------------
+
+// Keeps what is written to the sample and to its format record apart
+struct MemoryFileOps {
+  struct Handle {
+    std::vector<uint8_t> *target;
+
+    void close() {
+    }
+
+    size_t write(const etl::span<const uint8_t> &bytes) {
+      target->insert(target->end(), bytes.begin(), bytes.end());
+      return bytes.size();
+    }
+  };
+
+  Handle open(const etl::string_view &path) {
+    auto &target = path.ends_with(".sds") ? format : pcm;
+    target.clear();
+    return Handle{&target};
+  }
+
+  std::vector<uint8_t> pcm;
+  std::vector<uint8_t> format;
+};
+
+using ConvertingProtocol = sds::Protocol<MemoryFileOps>;
+
+etl::array<uint8_t, 17> make_header(uint8_t bit_depth, uint32_t period_ns,
+                                    uint32_t length_words) {
+  return {sds::DUMP_HEADER,
+          0x05,
+          0x00,
+          bit_depth,
+          static_cast<uint8_t>(period_ns & 0x7F),
+          static_cast<uint8_t>((period_ns >> 7) & 0x7F),
+          static_cast<uint8_t>((period_ns >> 14) & 0x7F),
+          static_cast<uint8_t>(length_words & 0x7F),
+          static_cast<uint8_t>((length_words >> 7) & 0x7F),
+          static_cast<uint8_t>((length_words >> 14) & 0x7F),
+          0,
+          0,
+          0,
+          0,
+          0,
+          0,
+          0x7F};
+}
+
+// Packs signed words of bit_depth bits into data packets, independently of
+// sds_conversion.h: offset binary, left-justified in 7-bit bytes.
+std::vector<etl::array<uint8_t, 123>>
+make_packets(const std::vector<int32_t> &words, uint8_t bit_depth) {
+  const size_t byte_count = (bit_depth + 6) / 7;
+  const size_t per_packet = 120 / byte_count;
+  std::vector<etl::array<uint8_t, 123>> packets;
+  for (size_t start = 0; start < words.size(); start += per_packet) {
+    etl::array<uint8_t, 123> packet{};
+    packet[0] = sds::DATA_PACKET;
+    packet[1] = static_cast<uint8_t>(packets.size() & 0x7F);
+    for (size_t i = 0; i < per_packet && start + i < words.size(); ++i) {
+      const uint32_t word = static_cast<uint32_t>(words[start + i] +
+                                                  (1 << (bit_depth - 1)));
+      const uint32_t packed = word << (byte_count * 7 - bit_depth);
+      for (size_t b = 0; b < byte_count; ++b) {
+        packet[2 + i * byte_count + b] =
+            (packed >> (7 * (byte_count - 1 - b))) & 0x7F;
+      }
+    }
+    packet[122] = sds::calculate_data_checksum(
+        packet[1], etl::span<const uint8_t>{&packet[2], 120});
+    packets.push_back(packet);
+  }
+  return packets;
+}
+
+std::vector<int16_t> pcm_samples(const std::vector<uint8_t> &pcm) {
+  std::vector<int16_t> samples;
+  for (size_t i = 0; i + 1 < pcm.size(); i += 2) {
+    samples.push_back(static_cast<int16_t>(pcm[i] | (pcm[i + 1] << 8)));
+  }
+  return samples;
+}
+
+struct Receiver {
+  MemoryFileOps file_ops;
+  musin::NullLogger logger;
+  ConvertingProtocol protocol{file_ops, logger};
+  etl::vector<sds::MessageType, 16> replies;
+
+  sds::Result receive(uint8_t bit_depth, uint32_t period_ns,
+                      const std::vector<int32_t> &words) {
+    MockSender sender{replies};
+    const auto header = make_header(bit_depth, period_ns,
+                                    static_cast<uint32_t>(words.size()));
+    auto result = protocol.process_message(etl::span<const uint8_t>{header},
+                                           sender, ONE_SECOND_US);
+    if (result != sds::Result::OK) {
+      return result;
+    }
+    for (const auto &packet : make_packets(words, bit_depth)) {
+      replies.clear();
+      result = protocol.process_message(etl::span<const uint8_t>{packet},
+                                        sender, ONE_SECOND_US);
+      if (replies.empty() || replies.back() != sds::ACK) {
+        return sds::Result::InvalidMessage;
+      }
+    }
+    return result;
+  }
+
+  sds::StoredFormat stored_format() const {
+    sds::StoredFormat format{};
+    REQUIRE(file_ops.format.size() == sizeof(format));
+    std::memcpy(&format, file_ops.format.data(), sizeof(format));
+    return format;
+  }
+};
+
+TEST_CASE("SDS scales 8- to 28-bit words to 16-bit PCM", "[sds][format]") {
+  Receiver receiver;
+
+  SECTION("8-bit words, 60 per packet, are shifted up") {
+    std::vector<int32_t> words;
+    for (int i = 0; i < 70; ++i) {
+      words.push_back(i * 3 - 128);
+    }
+    REQUIRE(receiver.receive(8, sds::ENGINE_SAMPLE_PERIOD_NS, words) ==
+            sds::Result::SampleComplete);
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    REQUIRE(samples.size() == words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+      REQUIRE(samples[i] == words[i] * 256);
+    }
+  }
+
+  SECTION("12-bit words keep their full range") {
+    const std::vector<int32_t> words{-2048, -1, 0, 1, 2047, 1000, -1000};
+    REQUIRE(receiver.receive(12, sds::ENGINE_SAMPLE_PERIOD_NS, words) ==
+            sds::Result::SampleComplete);
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    REQUIRE(samples.size() == words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+      REQUIRE(samples[i] == words[i] * 16);
+    }
+  }
+
+  SECTION("24-bit words, 30 per packet, keep their top 16 bits") {
+    std::vector<int32_t> words;
+    for (int i = 0; i < 45; ++i) {
+      words.push_back((i - 22) * 372000 + (i & 0xFF));
+    }
+    words.push_back(-(1 << 23));
+    words.push_back((1 << 23) - 1);
+    REQUIRE(receiver.receive(24, sds::ENGINE_SAMPLE_PERIOD_NS, words) ==
+            sds::Result::SampleComplete);
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    REQUIRE(samples.size() == words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+      REQUIRE(samples[i] == (words[i] >> 8));
+    }
+  }
+
+  SECTION("The received format is recorded next to the sample") {
+    const std::vector<int32_t> words(10, 0);
+    REQUIRE(receiver.receive(12, 45351, words) ==
+            sds::Result::SampleComplete);
+    const auto format = receiver.stored_format();
+    REQUIRE(format.describes(receiver.file_ops.pcm.size()));
+    REQUIRE(format.bit_depth == 12);
+    REQUIRE(format.sample_period_ns == 45351);
+    REQUIRE(format.length_words == 10);
+  }
+}
+
+TEST_CASE("SDS converts other sample rates to 44.1 kHz", "[sds][format]") {
+  Receiver receiver;
+
+  SECTION("22.05 kHz is interpolated to twice the samples") {
+    std::vector<int32_t> words;
+    for (int i = 0; i < 100; ++i) {
+      words.push_back(i * 300 - 15000);
+    }
+    REQUIRE(receiver.receive(16, 45351, words) == sds::Result::SampleComplete);
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    // Whole-nanosecond periods make the ratio inexact by a sample or so
+    REQUIRE(samples.size() >= 199);
+    REQUIRE(samples.size() <= 201);
+    for (size_t i = 0; i < 198; ++i) {
+      // Every other output falls midway between two input words
+      REQUIRE(std::abs(samples[i] - (static_cast<int>(i) * 150 - 15000)) <= 2);
+    }
+  }
+
+  SECTION("88.2 kHz keeps every other sample") {
+    std::vector<int32_t> words;
+    for (int i = 0; i < 200; ++i) {
+      words.push_back(i * 150 - 15000);
+    }
+    REQUIRE(receiver.receive(16, 11338, words) == sds::Result::SampleComplete);
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    REQUIRE(samples.size() >= 99);
+    REQUIRE(samples.size() <= 101);
+    for (size_t i = 0; i < 99; ++i) {
+      REQUIRE(std::abs(samples[i] - words[2 * i]) <= 2);
+    }
+  }
+
+  SECTION("A long 8 kHz sample streams through the bounded buffer") {
+    std::vector<int32_t> words(3000, 0);
+    for (size_t i = 0; i < words.size(); ++i) {
+      words[i] = static_cast<int32_t>(i % 256) * 100 - 12800;
+    }
+    REQUIRE(receiver.receive(16, 125000, words) ==
+            sds::Result::SampleComplete);
+    const size_t expected = (words.size() * 44100 + 7999) / 8000;
+    const auto samples = pcm_samples(receiver.file_ops.pcm);
+    REQUIRE(samples.size() >= expected - 2);
+    REQUIRE(samples.size() <= expected + 2);
+  }
+}
+
+TEST_CASE("SDS refuses formats it cannot convert", "[sds][format]") {
+  Receiver receiver;
+  const std::vector<int32_t> words(4, 0);
+
+  SECTION("bit depth below 8") {
+    REQUIRE(receiver.receive(7, sds::ENGINE_SAMPLE_PERIOD_NS, words) ==
+            sds::Result::InvalidMessage);
+  }
+  SECTION("bit depth above 28") {
+    REQUIRE(receiver.receive(29, sds::ENGINE_SAMPLE_PERIOD_NS, words) ==
+            sds::Result::InvalidMessage);
+  }
+  SECTION("a sample period faster than 192 kHz") {
+    REQUIRE(receiver.receive(16, 1000, words) == sds::Result::InvalidMessage);
+  }
+  SECTION("a zero sample period") {
+    REQUIRE(receiver.receive(16, 0, words) == sds::Result::InvalidMessage);
+  }
+  REQUIRE(receiver.replies.back() == sds::NAK);
+  REQUIRE_FALSE(receiver.protocol.is_busy());
+}
+
+// ---------------------------------------------------------------------------
+// Windowed handshaking
+// ---------------------------------------------------------------------------
+
+struct Reply {
+  sds::MessageType type;
+  uint8_t packet_num;
+};
+
+struct ReplyLog {
+  std::vector<Reply> &replies;
+  void operator()(sds::MessageType type, uint8_t packet_num) {
+    replies.push_back({type, packet_num});
+  }
+};
+
+std::vector<uint8_t> make_windowed_header(uint32_t length_words,
+                                          uint8_t window) {
+  const auto header =
+      make_header(16, sds::ENGINE_SAMPLE_PERIOD_NS, length_words);
+  std::vector<uint8_t> message(header.begin(), header.end());
+  message.push_back(window);
+  return message;
+}
+
+std::vector<int32_t> ramp(size_t length) {
+  std::vector<int32_t> words(length);
+  for (size_t i = 0; i < length; ++i) {
+    words[i] = static_cast<int32_t>((i * 37) % 65536) - 32768;
+  }
+  return words;
+}
+
+std::vector<uint8_t> expected_pcm(const std::vector<int32_t> &words) {
+  std::vector<uint8_t> pcm;
+  for (const int32_t word : words) {
+    pcm.push_back(static_cast<uint8_t>(word & 0xFF));
+    pcm.push_back(static_cast<uint8_t>((word >> 8) & 0xFF));
+  }
+  return pcm;
+}
+
+struct WindowedReceiver {
+  MemoryFileOps file_ops;
+  musin::NullLogger logger;
+  ConvertingProtocol protocol{file_ops, logger};
+  std::vector<Reply> replies;
+  std::vector<int32_t> words;
+  std::vector<etl::array<uint8_t, 123>> packets;
+
+  WindowedReceiver(size_t length, uint8_t window)
+      : words(ramp(length)), packets(make_packets(words, 16)) {
+    const auto header =
+        make_windowed_header(static_cast<uint32_t>(length), window);
+    send(etl::span<const uint8_t>{header.data(), header.size()});
+  }
+
+  sds::Result send(const etl::span<const uint8_t> &message) {
+    return protocol.process_message(message, ReplyLog{replies},
+                                    ONE_SECOND_US);
+  }
+
+  sds::Result send_packet(size_t index) {
+    return send(etl::span<const uint8_t>{packets[index]});
+  }
+};
+
+TEST_CASE("SDS negotiates an ACK window in the dump header",
+          "[sds][window]") {
+  MemoryFileOps file_ops;
+  musin::NullLogger logger;
+  ConvertingProtocol protocol{file_ops, logger};
+  std::vector<Reply> replies;
+
+  SECTION("A plain header is ACKed with packet number 0") {
+    const auto header = make_header(16, sds::ENGINE_SAMPLE_PERIOD_NS, 100);
+    protocol.process_message(etl::span<const uint8_t>{header},
+                             ReplyLog{replies}, ONE_SECOND_US);
+    REQUIRE(replies.size() == 1);
+    REQUIRE(replies[0].type == sds::ACK);
+    REQUIRE(replies[0].packet_num == 0);
+  }
+
+  SECTION("The accepted window is returned in the header ACK") {
+    const auto header = make_windowed_header(100, 8);
+    protocol.process_message(
+        etl::span<const uint8_t>{header.data(), header.size()},
+        ReplyLog{replies}, ONE_SECOND_US);
+    REQUIRE(replies.back().type == sds::ACK);
+    REQUIRE(replies.back().packet_num == 8);
+  }
+
+  SECTION("A window larger than the device's is reduced") {
+    const auto header = make_windowed_header(100, 100);
+    protocol.process_message(
+        etl::span<const uint8_t>{header.data(), header.size()},
+        ReplyLog{replies}, ONE_SECOND_US);
+    REQUIRE(replies.back().packet_num == ConvertingProtocol::MAX_ACK_WINDOW);
+  }
+
+  SECTION("A window of 0 handshakes every packet") {
+    const auto header = make_windowed_header(100, 0);
+    protocol.process_message(
+        etl::span<const uint8_t>{header.data(), header.size()},
+        ReplyLog{replies}, ONE_SECOND_US);
+    REQUIRE(replies.back().packet_num == 1);
+  }
+}
+
+TEST_CASE("SDS ACKs every half window and the final packet",
+          "[sds][window]") {
+  // 10 packets of 40 words, the last one partial
+  WindowedReceiver receiver(390, 4);
+  receiver.replies.clear();
+
+  for (size_t i = 0; i + 1 < receiver.packets.size(); ++i) {
+    REQUIRE(receiver.send_packet(i) == sds::Result::OK);
+  }
+  REQUIRE(receiver.send_packet(9) == sds::Result::SampleComplete);
+
+  REQUIRE(receiver.replies.size() == 5);
+  for (size_t i = 0; i < receiver.replies.size(); ++i) {
+    REQUIRE(receiver.replies[i].type == sds::ACK);
+    REQUIRE(receiver.replies[i].packet_num == 1 + 2 * i);
+  }
+  REQUIRE(receiver.file_ops.pcm == expected_pcm(receiver.words));
+}
+
+TEST_CASE("SDS NAKs a missing packet once and drops what follows it",
+          "[sds][window]") {
+  WindowedReceiver receiver(400, 8);
+  receiver.replies.clear();
+
+  REQUIRE(receiver.send_packet(0) == sds::Result::OK);
+  // Packet 1 is lost; 2 and 3 arrive behind it
+  receiver.send_packet(2);
+  receiver.send_packet(3);
+  REQUIRE(receiver.replies.size() == 1);
+  REQUIRE(receiver.replies[0].type == sds::NAK);
+  REQUIRE(receiver.replies[0].packet_num == 1);
+
+  // The host goes back to 1; the gap is ACKed as soon as it is filled
+  REQUIRE(receiver.send_packet(1) == sds::Result::OK);
+  REQUIRE(receiver.replies.size() == 2);
+  REQUIRE(receiver.replies[1].type == sds::ACK);
+  REQUIRE(receiver.replies[1].packet_num == 1);
+
+  SECTION("A damaged packet is NAKed by the number expected") {
+    auto damaged = receiver.packets[2];
+    damaged[10] ^= 0x01;
+    REQUIRE(receiver.send(etl::span<const uint8_t>{damaged}) ==
+            sds::Result::ChecksumError);
+    receiver.send_packet(3);
+    REQUIRE(receiver.replies.size() == 3);
+    REQUIRE(receiver.replies[2].type == sds::NAK);
+    REQUIRE(receiver.replies[2].packet_num == 2);
+
+    SECTION("and NAKed again if its resend is damaged too") {
+      REQUIRE(receiver.send(etl::span<const uint8_t>{damaged}) ==
+              sds::Result::ChecksumError);
+      REQUIRE(receiver.replies.size() == 4);
+      REQUIRE(receiver.replies[3].type == sds::NAK);
+      REQUIRE(receiver.replies[3].packet_num == 2);
+    }
+  }
+
+  SECTION("A packet already stored is answered with the last ACK") {
+    REQUIRE(receiver.send_packet(0) == sds::Result::OK);
+    REQUIRE(receiver.replies.size() == 3);
+    REQUIRE(receiver.replies[2].type == sds::ACK);
+    REQUIRE(receiver.replies[2].packet_num == 1);
+  }
+
+  SECTION("Nothing is written twice") {
+    for (size_t i = 2; i < receiver.packets.size(); ++i) {
+      receiver.send_packet(i);
+    }
+    REQUIRE(receiver.file_ops.pcm == expected_pcm(receiver.words));
+  }
+}
+
+// A USB link with fixed latency and a repeatable pattern of lost and damaged
+// data packets, driven by a go-back-N host like drumtool's sender. Time is
+// simulated: the host pays to put each packet on the wire, the device pays
+// to store each one, and replies come back after the link latency.
+struct LinkModel {
+  uint64_t latency_us = 1000; // one way, including the device's main loop
+  uint64_t send_us = 150;     // host putting a 127-byte packet on the wire
+  uint64_t store_us = 300;    // device converting and writing a packet
+  uint64_t timeout_us = 50000;
+  unsigned drop_one_in = 0;   // 0 for a clean link
+  unsigned damage_one_in = 0; // 0 for a clean link
+};
+
+struct LinkResult {
+  bool complete = false;
+  uint64_t elapsed_us = 0;
+  unsigned packets_sent = 0;
+  unsigned replies = 0;
+  unsigned timeouts = 0;
+
+  double bytes_per_second(size_t bytes) const {
+    return static_cast<double>(bytes) * 1e6 / static_cast<double>(elapsed_us);
+  }
+};
+
+LinkResult upload_over_link(MemoryFileOps &file_ops,
+                            const std::vector<int32_t> &words,
+                            uint8_t requested_window, const LinkModel &link) {
+  struct TimedReply {
+    uint64_t at_us;
+    Reply reply;
+  };
+
+  musin::NullLogger logger;
+  ConvertingProtocol protocol{file_ops, logger};
+  std::deque<TimedReply> in_flight;
+  uint64_t host_us = 0;
+  uint64_t device_us = 0;
+  uint32_t seed = 12345;
+  auto one_in = [&seed](unsigned n) {
+    seed = seed * 1664525u + 1013904223u;
+    return n != 0 && (seed >> 8) % n == 0;
+  };
+  auto deliver = [&](const etl::span<const uint8_t> &message) {
+    device_us = std::max(device_us, host_us + link.latency_us) + link.store_us;
+    protocol.process_message(
+        message,
+        [&](sds::MessageType type, uint8_t packet_num) {
+          in_flight.push_back(
+              {device_us + link.latency_us, Reply{type, packet_num}});
+        },
+        device_us);
+  };
+
+  LinkResult result;
+  const auto header =
+      requested_window > 0
+          ? make_windowed_header(static_cast<uint32_t>(words.size()),
+                                 requested_window)
+          : std::vector<uint8_t>{};
+  const auto plain_header = make_header(16, sds::ENGINE_SAMPLE_PERIOD_NS,
+                                        static_cast<uint32_t>(words.size()));
+  host_us += link.send_us;
+  deliver(requested_window > 0
+              ? etl::span<const uint8_t>{header.data(), header.size()}
+              : etl::span<const uint8_t>{plain_header});
+  REQUIRE(in_flight.size() == 1);
+  const uint8_t window =
+      std::max<uint8_t>(requested_window > 0 ? in_flight[0].reply.packet_num
+                                             : 0,
+                        1);
+  host_us = in_flight[0].at_us;
+  in_flight.clear();
+
+  const auto packets = make_packets(words, 16);
+  size_t base = 0;
+  size_t next = 0;
+  while (base < packets.size() && result.timeouts < 1000) {
+    while (next < packets.size() && next < base + window) {
+      auto packet = packets[next++];
+      host_us += link.send_us;
+      ++result.packets_sent;
+      if (one_in(link.damage_one_in)) {
+        packet[10] ^= 0x01;
+      }
+      if (!one_in(link.drop_one_in)) {
+        deliver(etl::span<const uint8_t>{packet});
+      }
+    }
+
+    if (in_flight.empty() ||
+        in_flight.front().at_us > host_us + link.timeout_us) {
+      host_us += link.timeout_us;
+      ++result.timeouts;
+      next = base;
+      continue;
+    }
+    const auto [at_us, reply] = in_flight.front();
+    in_flight.pop_front();
+    host_us = std::max(host_us, at_us);
+    ++result.replies;
+
+    // Packet numbers wrap at 128; only replies about packets in flight count
+    const size_t offset = (reply.packet_num - base) & 0x7F;
+    if (offset >= next - base) {
+      continue;
+    }
+    if (reply.type == sds::ACK) {
+      base += offset + 1;
+    } else if (reply.type == sds::NAK) {
+      base += offset;
+      next = base;
+    }
+  }
+
+  result.complete = base == packets.size() && !protocol.is_busy();
+  result.elapsed_us = host_us;
+  return result;
+}
+
+TEST_CASE("Windowed handshaking speeds up uploads over a lossy link",
+          "[sds][window]") {
+  // A 900 ms sample: about a thousand packets
+  const auto words = ramp(39690);
+  const size_t bytes = words.size() * 2;
+  MemoryFileOps handshaked_files;
+  MemoryFileOps windowed_files;
+
+  SECTION("Clean link") {
+    const LinkModel link{};
+    const auto handshaked = upload_over_link(handshaked_files, words, 0, link);
+    const auto windowed = upload_over_link(windowed_files, words, 16, link);
+
+    REQUIRE(handshaked.complete);
+    REQUIRE(windowed.complete);
+    REQUIRE(windowed_files.pcm == expected_pcm(words));
+    REQUIRE(handshaked.replies == handshaked.packets_sent);
+    REQUIRE(windowed.replies * 7 < windowed.packets_sent);
+    REQUIRE(windowed.bytes_per_second(bytes) >
+            5 * handshaked.bytes_per_second(bytes));
+  }
+
+  SECTION("One packet in 25 lost and one in 40 damaged") {
+    LinkModel link{};
+    link.drop_one_in = 25;
+    link.damage_one_in = 40;
+    const auto handshaked = upload_over_link(handshaked_files, words, 0, link);
+    const auto windowed = upload_over_link(windowed_files, words, 16, link);
+
+    REQUIRE(handshaked.complete);
+    REQUIRE(windowed.complete);
+    REQUIRE(handshaked_files.pcm == expected_pcm(words));
+    REQUIRE(windowed_files.pcm == expected_pcm(words));
+    REQUIRE(windowed.bytes_per_second(bytes) >
+            2 * handshaked.bytes_per_second(bytes));
+  }
+}
+
 } // namespace
@@ -0,0 +1,119 @@
+#include "drum/sequencer_effect_random.h"
+#include "drum/sequencer_rng.h"
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+
+namespace drum {
+
+namespace {
+
+constexpr size_t TRACK_LENGTH = 16;
+
+template <size_t N>
+std::array<size_t, N> play_offsets(SequencerEffectRandom &effect,
+                                   size_t track_idx) {
+  std::array<size_t, N> steps{};
+  for (uint32_t step = 0; step < N; ++step) {
+    effect.begin_step(step);
+    steps[step] = effect
+                      .calculate_randomized_step(0, track_idx, TRACK_LENGTH,
+                                                 /*repeat_active=*/false)
+                      .effective_step_index;
+  }
+  return steps;
+}
+
+} // namespace
+
+TEST_CASE("SequencerRng produces the xorshift32 sequence") {
+  SequencerRng rng(1);
+  REQUIRE(rng.next() == 270369u);
+  REQUIRE(rng.next() == 67634689u);
+  REQUIRE(rng.next() == 2647435461u);
+  REQUIRE(rng.next() == 307599695u);
+}
+
+TEST_CASE("SequencerRng replaces a zero seed") {
+  SequencerRng zero(0);
+  SequencerRng fallback(SequencerRng::DEFAULT_SEED);
+  REQUIRE(zero.next() != 0);
+  REQUIRE(zero.next() == (fallback.next(), fallback.next()));
+}
+
+TEST_CASE("SequencerRng next_below stays in range") {
+  SequencerRng rng(1234);
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(rng.next_below(16) < 16);
+  }
+  REQUIRE(rng.next_below(0) == 0);
+}
+
+TEST_CASE("SequencerEffectRandom offsets replay for a seed") {
+  SequencerEffectRandom effect;
+  effect.seed(42);
+  effect.request_state(RandomEffectState::OffsetActive,
+                       /*repeat_active=*/false);
+
+  const std::array<size_t, 16> expected{4, 0, 3,  10, 10, 1,  12, 13,
+                                        4, 0, 9, 12, 3,  10, 9,  12};
+  REQUIRE(play_offsets<16>(effect, 0) == expected);
+
+  // Reseeding replays the same bars.
+  effect.seed(42);
+  REQUIRE(play_offsets<16>(effect, 0) == expected);
+
+  effect.seed(43);
+  REQUIRE(play_offsets<16>(effect, 0) != expected);
+}
+
+TEST_CASE("SequencerEffectRandom draws only at bar lines") {
+  SequencerEffectRandom effect;
+  effect.seed(42);
+  effect.request_state(RandomEffectState::OffsetActive,
+                       /*repeat_active=*/false);
+
+  effect.begin_step(0);
+  effect.begin_step(3);
+  const auto first = effect.calculate_randomized_step(0, 2, TRACK_LENGTH,
+                                                      /*repeat_active=*/false);
+  // Revisiting a step within the bar reads the same batch.
+  effect.begin_step(3);
+  const auto again = effect.calculate_randomized_step(0, 2, TRACK_LENGTH,
+                                                      /*repeat_active=*/false);
+  REQUIRE(first.effective_step_index == again.effective_step_index);
+}
+
+TEST_CASE("SequencerEffectRandom probability flips replay for a seed") {
+  SequencerEffectRandom effect;
+  effect.seed(42);
+  effect.request_state(RandomEffectState::OffsetWithFlip,
+                       /*repeat_active=*/false);
+
+  const std::array<bool, 16> expected{false, true, true,  true,  true,  false,
+                                      false, true, true,  false, false, true,
+                                      true,  true, true,  true};
+  for (uint32_t step = 0; step < expected.size(); ++step) {
+    effect.begin_step(step);
+    REQUIRE(effect.is_step_flipped(1) == expected[step]);
+  }
+
+  // Without hard press nothing flips.
+  effect.request_state(RandomEffectState::OffsetActive,
+                       /*repeat_active=*/false);
+  REQUIRE_FALSE(effect.is_step_flipped(1));
+}
+
+TEST_CASE("SequencerEffectRandom step preview replays for a seed") {
+  SequencerEffectRandom effect;
+  effect.seed(7);
+  effect.trigger_step_highlighting(TRACK_LENGTH, 4);
+  effect.start_step_highlighting();
+
+  REQUIRE(effect.get_highlighted_step_for_track(0) == 0);
+  REQUIRE(effect.get_highlighted_step_for_track(1) == 1);
+  REQUIRE(effect.get_highlighted_step_for_track(2) == 14);
+  REQUIRE(effect.get_highlighted_step_for_track(3) == 11);
+}
+
+} // namespace drum
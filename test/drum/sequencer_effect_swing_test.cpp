@@ -564,4 +564,30 @@ TEST_CASE("SequencerEffectSwing hit zone classification",
   }
 }
 
+TEST_CASE("SequencerEffectSwing step lengths follow the swung onsets",
+          "[sequencer_effect_swing]") {
+  SequencerEffectSwing swing;
+  constexpr uint8_t OFFSET = config::timing::SWING_OFFSET_PHASES;
+
+  SECTION("Straight steps are all six ticks") {
+    REQUIRE(swing.step_length_ticks(0) == 6);
+    REQUIRE(swing.step_length_ticks(1) == 6);
+  }
+
+  SECTION("Delaying odd steps lengthens even ones") {
+    swing.set_swing_enabled(true);
+    swing.set_swing_target(true);
+    REQUIRE(swing.step_length_ticks(0) == 6 + OFFSET);
+    REQUIRE(swing.step_length_ticks(1) == 6 - OFFSET);
+  }
+
+  SECTION("Delaying even steps lengthens odd ones") {
+    swing.set_swing_enabled(true);
+    swing.set_swing_target(false);
+    REQUIRE(swing.step_length_ticks(0) == 6 - OFFSET);
+    REQUIRE(swing.step_length_ticks(1) == 6 + OFFSET);
+    REQUIRE(swing.step_length_ticks(2) + swing.step_length_ticks(3) == 12);
+  }
+}
+
 } // namespace drum
@@ -0,0 +1,124 @@
+#include "drum/sequencer_recorder.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+
+namespace drum {
+
+namespace {
+
+// 120 BPM at 12 PPQN: 500 ms per beat, 41666 us per tick.
+constexpr uint32_t TICK_US = 41666;
+
+constexpr uint32_t units_after_onset(int32_t units) {
+  return static_cast<uint32_t>(units) * TICK_US /
+         SequencerRecorder::UNITS_PER_TICK;
+}
+
+} // namespace
+
+TEST_CASE("SequencerRecorder defaults") {
+  SequencerRecorder recorder;
+  REQUIRE_FALSE(recorder.is_enabled());
+  REQUIRE(recorder.get_quantize_strength() == 0);
+
+  recorder.set_enabled(true);
+  REQUIRE(recorder.is_enabled());
+  recorder.set_quantize_strength(250);
+  REQUIRE(recorder.get_quantize_strength() == 100);
+}
+
+TEST_CASE("SequencerRecorder places hits on the nearest step") {
+  SequencerRecorder recorder;
+
+  SECTION("On the onset") {
+    const auto hit = recorder.capture(0, TICK_US);
+    REQUIRE_FALSE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == 0);
+  }
+
+  SECTION("Late hit stays on the current step") {
+    const auto hit = recorder.capture(units_after_onset(10) + 1, TICK_US);
+    REQUIRE_FALSE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == 10);
+  }
+
+  SECTION("Last unit of the first half") {
+    const auto hit = recorder.capture(
+        units_after_onset(SequencerRecorder::MAX_OFFSET) + 1, TICK_US);
+    REQUIRE_FALSE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == SequencerRecorder::MAX_OFFSET);
+  }
+
+  SECTION("Second half anticipates the next step") {
+    const auto hit = recorder.capture(units_after_onset(40) + 1, TICK_US);
+    REQUIRE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == 40 - SequencerRecorder::UNITS_PER_STEP);
+  }
+
+  SECTION("Hits past the step are clamped to its last unit") {
+    const auto hit = recorder.capture(10 * TICK_US, TICK_US);
+    REQUIRE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == -1);
+  }
+}
+
+TEST_CASE("SequencerRecorder quantize strength pulls towards the grid") {
+  SequencerRecorder recorder;
+  const uint32_t early = units_after_onset(36) + 1; // 12 units early
+  const uint32_t late = units_after_onset(20) + 1;
+
+  recorder.set_quantize_strength(50);
+  REQUIRE(recorder.capture(late, TICK_US).micro_offset == 10);
+  REQUIRE(recorder.capture(early, TICK_US).micro_offset == -6);
+
+  recorder.set_quantize_strength(100);
+  REQUIRE(recorder.capture(late, TICK_US).micro_offset == 0);
+  const auto hit = recorder.capture(early, TICK_US);
+  REQUIRE(hit.on_next_step);
+  REQUIRE(hit.micro_offset == 0);
+}
+
+TEST_CASE("SequencerRecorder measures swung steps by their own length") {
+  SequencerRecorder recorder;
+  // SWING_OFFSET_PHASES of 2: steps alternate between 8 and 4 ticks
+  constexpr uint8_t LONG_STEP = 8;
+  constexpr uint8_t SHORT_STEP = 4;
+
+  SECTION("Late in a long step anticipates the next onset") {
+    const auto hit = recorder.capture(7 * TICK_US + 1, TICK_US, LONG_STEP);
+    REQUIRE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == -SequencerRecorder::UNITS_PER_TICK);
+  }
+
+  SECTION("A long step keeps hits past three ticks") {
+    const auto hit = recorder.capture(units_after_onset(30) + 1, TICK_US,
+                                      LONG_STEP);
+    REQUIRE_FALSE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == 30);
+  }
+
+  SECTION("A short step hands its second half to the next step") {
+    const auto hit = recorder.capture(units_after_onset(20) + 1, TICK_US,
+                                      SHORT_STEP);
+    REQUIRE(hit.on_next_step);
+    REQUIRE(hit.micro_offset == 20 - SHORT_STEP * 8);
+  }
+}
+
+TEST_CASE("SequencerRecorder without a tempo records on the grid") {
+  SequencerRecorder recorder;
+  const auto hit = recorder.capture(30000, 0);
+  REQUIRE_FALSE(hit.on_next_step);
+  REQUIRE(hit.micro_offset == 0);
+}
+
+TEST_CASE("SequencerRecorder converts units to microseconds") {
+  REQUIRE(SequencerRecorder::units_to_us(0, TICK_US) == 0);
+  REQUIRE(SequencerRecorder::units_to_us(-5, TICK_US) == 0);
+  REQUIRE(SequencerRecorder::units_to_us(SequencerRecorder::UNITS_PER_TICK,
+                                         TICK_US) == TICK_US);
+  REQUIRE(SequencerRecorder::units_to_us(SequencerRecorder::UNITS_PER_STEP,
+                                         8000) == 48000);
+}
+
+} // namespace drum
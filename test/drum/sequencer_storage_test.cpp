@@ -1,9 +1,11 @@
 #include "drum/config.h"
 #include "drum/sequencer_persistence.h"
 #include "drum/sequencer_storage.h"
+#include "musin/timing/pattern_bank.h"
 #include "pico/time.h"
 #include "test/test_support.h"
 #include <catch2/catch_test_macros.hpp>
+#include <array>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
@@ -448,4 +450,162 @@ TEST_CASE("SequencerStorage integration - file path consistency",
   REQUIRE(states_equal(state, loaded_state));
 }
 
+TEST_CASE("SequencerStorage pattern bank round-trip", "[sequencer_storage]") {
+  using Bank = musin::timing::PatternBank<config::NUM_PATTERNS, 4,
+                                          config::MAX_STEPS_PER_TRACK,
+                                          config::MAX_PATTERN_CHAIN_LENGTH>;
+  TempFileManager temp_file;
+  SequencerStorage<4, 8> storage(temp_file.path());
+
+  Bank original;
+  for (size_t pattern = 0; pattern < Bank::size(); ++pattern) {
+    for (size_t track = 0; track < 4; ++track) {
+      auto &t = original.get_pattern(pattern).get_track(track);
+      t.set_length(8 + pattern + track * 13);
+      for (size_t step = 0; step < t.size(); step += 3) {
+        t.set_step_enabled(step, true);
+        t.set_step_velocity(step, static_cast<uint8_t>(1 + pattern + step));
+        t.set_step_micro_offset(step, static_cast<int8_t>(step) - 20);
+      }
+      t.set_step_lock(0, musin::timing::ParamLocks::PITCH,
+                      static_cast<uint8_t>(pattern));
+      t.set_step_lock(3, musin::timing::ParamLocks::FILTER_OFFSET,
+                      static_cast<uint8_t>(track * 30));
+    }
+  }
+
+  SequencerPersistentState state = create_test_state();
+  state.active_pattern = 5;
+  state.song_mode = 1;
+  state.chain_length = 3;
+  state.chain[0] = 5;
+  state.chain[1] = 2;
+  state.chain[2] = 9;
+  REQUIRE(storage.save_state_to_flash(state, original));
+
+  Bank loaded;
+  SequencerPersistentState loaded_state;
+  REQUIRE(storage.load_state_from_flash(loaded_state, loaded));
+  REQUIRE(states_equal(state, loaded_state));
+  REQUIRE_FALSE(loaded_state.is_legacy());
+  REQUIRE(loaded_state.active_pattern == 5);
+  REQUIRE(loaded_state.song_mode == 1);
+  REQUIRE(loaded_state.chain_length == 3);
+  REQUIRE(loaded_state.chain[2] == 9);
+
+  for (size_t pattern = 0; pattern < Bank::size(); ++pattern) {
+    for (size_t track = 0; track < 4; ++track) {
+      const auto &expected = original.get_pattern(pattern).get_track(track);
+      const auto &actual = loaded.get_pattern(pattern).get_track(track);
+      REQUIRE(actual.size() == expected.size());
+      for (size_t step = 0; step < expected.capacity(); ++step) {
+        REQUIRE(actual.get_step(step) == expected.get_step(step));
+        REQUIRE(actual.get_step_locks(step) == expected.get_step_locks(step));
+      }
+    }
+  }
+}
+
+TEST_CASE("SequencerStorage keeps steps past a shortened length",
+          "[sequencer_storage]") {
+  using Bank = musin::timing::PatternBank<2, 4, 32>;
+  TempFileManager temp_file;
+  SequencerStorage<4, 8> storage(temp_file.path());
+
+  Bank original;
+  auto &track = original.get_pattern(1).get_track(2);
+  track.set_length(24);
+  track.set_step_enabled(20, true);
+  track.set_step_velocity(20, 77);
+  track.set_step_lock(20, musin::timing::ParamLocks::DECAY, 40);
+  track.set_length(8);
+
+  SequencerPersistentState state;
+  REQUIRE(storage.save_state_to_flash(state, original));
+
+  Bank loaded;
+  SequencerPersistentState loaded_state;
+  REQUIRE(storage.load_state_from_flash(loaded_state, loaded));
+  const auto &actual = loaded.get_pattern(1).get_track(2);
+  REQUIRE(actual.size() == 8);
+  REQUIRE(actual.get_step(20) == track.get_step(20));
+  REQUIRE(actual.get_step_locks(20) == track.get_step_locks(20));
+}
+
+TEST_CASE("SequencerStorage leaves the bank untouched when a read fails",
+          "[sequencer_storage]") {
+  using Bank = musin::timing::PatternBank<2, 4, 16>;
+  TempFileManager temp_file;
+  SequencerStorage<4, 8> storage(temp_file.path());
+
+  Bank saved;
+  for (size_t pattern = 0; pattern < Bank::size(); ++pattern) {
+    saved.get_pattern(pattern).get_track(0).set_step_enabled(1, true);
+  }
+  SequencerPersistentState state;
+  REQUIRE(storage.save_state_to_flash(state, saved));
+  // Cut the body short in the last track
+  fs::resize_file(temp_file.path(), fs::file_size(temp_file.path()) - 4);
+
+  Bank bank;
+  bank.get_pattern(0).get_track(0).set_length(5);
+  bank.get_pattern(0).get_track(0).set_step_enabled(3, true);
+  SequencerPersistentState loaded_state;
+  REQUIRE_FALSE(storage.load_state_from_flash(loaded_state, bank));
+
+  const auto &track = bank.get_pattern(0).get_track(0);
+  REQUIRE(track.size() == 5);
+  REQUIRE(track.enabled_mask() == 0b1000);
+}
+
+TEST_CASE("SequencerStorage loads legacy v2 files", "[sequencer_storage]") {
+  using Bank = musin::timing::PatternBank<config::NUM_PATTERNS, 4,
+                                          config::MAX_STEPS_PER_TRACK,
+                                          config::MAX_PATTERN_CHAIN_LENGTH>;
+  TempFileManager temp_file;
+  SequencerStorage<4, 8> storage(temp_file.path());
+
+  // A v2 file is exactly the legacy prefix of the current header.
+  SequencerPersistentState legacy = create_test_state();
+  legacy.version = SequencerPersistentState::LEGACY_FORMAT_VERSION;
+  {
+    std::ofstream file(temp_file.path(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&legacy),
+               SEQUENCER_LEGACY_STATE_SIZE);
+  }
+
+  Bank bank;
+  bank.get_pattern(0).get_track(0).set_length(12);
+
+  SequencerPersistentState loaded_state;
+  loaded_state.active_pattern = 7;
+  REQUIRE(storage.load_state_from_flash(loaded_state, bank));
+  REQUIRE(loaded_state.is_legacy());
+  REQUIRE(states_equal(legacy, loaded_state));
+  REQUIRE(loaded_state.active_pattern == 0);
+  REQUIRE(loaded_state.chain_length == 0);
+  // The bank is left for the caller to migrate into.
+  REQUIRE(bank.get_pattern(0).get_track(0).size() == 12);
+
+  SequencerPersistentState header_only;
+  REQUIRE(storage.load_state_from_flash(header_only));
+  REQUIRE(header_only.is_legacy());
+}
+
+TEST_CASE("SequencerStorage rejects a bank from an incompatible build",
+          "[sequencer_storage]") {
+  using Bank = musin::timing::PatternBank<2, 4, 16>;
+  using WideBank = musin::timing::PatternBank<2, 4, 32>;
+  TempFileManager temp_file;
+  SequencerStorage<4, 8> storage(temp_file.path());
+
+  WideBank wide;
+  SequencerPersistentState state;
+  REQUIRE(storage.save_state_to_flash(state, wide));
+
+  Bank narrow;
+  SequencerPersistentState loaded_state;
+  REQUIRE_FALSE(storage.load_state_from_flash(loaded_state, narrow));
+}
+
 } // namespace drum
@@ -55,6 +55,13 @@ TEST_CASE("Settings set validation", "[settings]") {
     REQUIRE_FALSE(settings.set(Id::SliderMode, 8));
     REQUIRE(settings.get(Id::SliderMode) == 0);
   }
+
+  SECTION("High resolution CC output is a switch, off by default") {
+    REQUIRE(settings.get(Id::HighResolutionCc) == 0);
+    REQUIRE(settings.set(Id::HighResolutionCc, 1));
+    REQUIRE_FALSE(settings.set(Id::HighResolutionCc, 2));
+    REQUIRE(settings.get(Id::HighResolutionCc) == 1);
+  }
 }
 
 TEST_CASE("Settings descriptor lookup", "[settings]") {
@@ -153,3 +153,23 @@ TEST_CASE("Encode and decode roundtrip") {
     }
   }));
 }
+
+TEST_CASE("Decode random seed") {
+  CONST_BODY(({
+    // 0xDEADBEEF as 7-bit groups, least significant first.
+    const etl::array<uint8_t, 5> payload{0x6F, 0x7D, 0x36, 0x75, 0x0D};
+    const auto maybe_seed =
+        sysex::decode_random_seed(etl::span<const uint8_t>{payload});
+
+    REQUIRE(maybe_seed.has_value());
+    REQUIRE(maybe_seed.value() == 0xDEADBEEFu);
+  }));
+}
+
+TEST_CASE("Decode random seed rejects too-short payload") {
+  CONST_BODY(({
+    const etl::array<uint8_t, 4> payload{1, 2, 3, 4};
+    REQUIRE(!sysex::decode_random_seed(etl::span<const uint8_t>{payload})
+                 .has_value());
+  }));
+}
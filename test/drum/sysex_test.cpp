@@ -16,8 +16,45 @@
 
 namespace {
 
+// Stands in for the SHA-256 engine: the "digest" mixes the byte count and a
+// running sum, so it changes with the content and has bytes with the MSB set.
+struct FakeSha256 {
+  using Digest = etl::array<uint8_t, 32>;
+
+  static inline bool start_ok = true;
+  static inline size_t aborts = 0;
+
+  bool start() {
+    count = 0;
+    sum = 0;
+    return start_ok;
+  }
+
+  void update(etl::span<const uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+      sum = sum * 31 + byte;
+    }
+    count += bytes.size();
+  }
+
+  bool finish(Digest &digest) {
+    for (size_t i = 0; i < digest.size(); ++i) {
+      digest[i] = static_cast<uint8_t>((sum >> (i % 4 * 8)) + count + i * 73);
+    }
+    return true;
+  }
+
+  void abort() {
+    ++aborts;
+  }
+
+  uint32_t count = 0;
+  uint32_t sum = 0;
+};
+
 struct TestFileOps {
   static constexpr unsigned BlockSize = 256;
+  using Sha256 = FakeSha256;
 
   struct Handle {
     TestFileOps &parent;
@@ -28,6 +65,7 @@ struct TestFileOps {
 
     void close() {
       parent.file_is_open = false;
+      parent.write_pending = parent.defer_writes;
     }
 
     size_t write(const etl::span<const uint8_t> &bytes) {
@@ -39,20 +77,60 @@ struct TestFileOps {
       }
       return bytes.size();
     }
+
+    etl::span<uint8_t> reserve() {
+      return etl::span<uint8_t>{parent.staging.data(), parent.staging.size()};
+    }
+
+    void commit(size_t count) {
+      write(etl::span<const uint8_t>{parent.staging.data(), count});
+    }
   };
 
-  etl::optional<Handle> open(const etl::string_view &path) {
+  struct ReadHandle {
+    size_t size() const {
+      return 0;
+    }
+    size_t read(const etl::span<uint8_t> &) {
+      return 0;
+    }
+  };
+
+  etl::optional<Handle> open(const etl::string_view &path, bool) {
     last_path.assign(path.begin(), path.end());
     return Handle(*this);
   }
 
+  etl::optional<ReadHandle> open_read(const etl::string_view &) {
+    return etl::nullopt;
+  }
+
   bool format() {
     return true;
   }
 
+  bool finishing_write() const {
+    return write_pending;
+  }
+
+  bool write_failed() const {
+    return write_fails;
+  }
+
+  bool complete_write() {
+    write_pending = false;
+    return !write_fails;
+  }
+
   bool file_is_open = false;
+  // When set, a closed file keeps staged data to write until the test
+  // clears write_pending, as StandardFileOps does
+  bool defer_writes = false;
+  bool write_pending = false;
+  bool write_fails = false;
   size_t byte_count = 0;
   etl::array<uint8_t, BlockSize> content{};
+  etl::array<uint8_t, 20> staging{};
   etl::string<drum::config::MAX_PATH_LENGTH> last_path;
 };
 
@@ -66,6 +144,9 @@ struct MockSender {
   void operator()(Protocol::Tag tag) {
     sent_tags.push_back(tag);
   }
+  void operator()(Protocol::Tag tag, etl::span<const uint8_t>) {
+    sent_tags.push_back(tag);
+  }
 };
 
 // Chunk header as seen by Protocol (0xF0 already stripped):
@@ -143,8 +224,9 @@ TEST_CASE("Protocol receives file data") {
       sysex::Chunk(byte_transfer, sizeof(byte_transfer)), sender, now);
 
   REQUIRE(result == Protocol::Result::OK);
-  // Bytes are buffered until the block fills or the transfer ends.
-  REQUIRE(file_ops.byte_count == 0);
+  // Bytes are decoded straight into the file's staging space, which the
+  // file operations write out on their own schedule.
+  REQUIRE(file_ops.byte_count == 7);
   REQUIRE(sent_tags.size() == 1);
   REQUIRE(sent_tags[0] == Protocol::Tag::Ack);
 
@@ -196,6 +278,74 @@ TEST_CASE("Protocol decodes MSBs in FileBytes payload") {
   REQUIRE(file_ops.content[1] == 0);
 }
 
+TEST_CASE("Protocol answers EndFileTransfer once the file is written") {
+  TestFileOps file_ops;
+  file_ops.defer_writes = true;
+  musin::NullLogger logger;
+  Protocol protocol(file_ops, logger);
+  etl::vector<Protocol::Tag, 10> sent_tags;
+  MockSender sender{sent_tags};
+  const absolute_time_t now{};
+
+  const uint8_t begin_file_write[] = {
+      MFR0, MFR1, MFR2, DEV, Protocol::BeginFileWrite, 0, 0, 64};
+  const uint8_t byte_transfer[] = {MFR0, MFR1, MFR2, DEV, Protocol::FileBytes,
+                                   1,    2,    3,    4,   5,
+                                   6,    7,    0};
+  const uint8_t end_write[] = {MFR0, MFR1, MFR2, DEV,
+                               Protocol::EndFileTransfer};
+  protocol.handle_chunk(
+      sysex::Chunk(begin_file_write, sizeof(begin_file_write)), sender, now);
+  protocol.handle_chunk(sysex::Chunk(byte_transfer, sizeof(byte_transfer)),
+                        sender, now);
+  sent_tags.clear();
+
+  REQUIRE(protocol.handle_chunk(sysex::Chunk(end_write, sizeof(end_write)),
+                                sender, now) ==
+          Protocol::Result::FileWritten);
+  REQUIRE(sent_tags.empty());
+  REQUIRE(protocol.get_state() == State::Finishing);
+  REQUIRE(protocol.busy());
+
+  SECTION("Ack once the staged data has been written") {
+    protocol.service(sender);
+    REQUIRE(sent_tags.empty());
+    file_ops.write_pending = false;
+    protocol.service(sender);
+    REQUIRE(sent_tags.size() == 1);
+    REQUIRE(sent_tags[0] == Protocol::Tag::Ack);
+    REQUIRE(protocol.get_state() == State::Idle);
+  }
+
+  SECTION("Nack if a write failed") {
+    file_ops.write_fails = true;
+    file_ops.write_pending = false;
+    protocol.service(sender);
+    REQUIRE(sent_tags.size() == 1);
+    REQUIRE(sent_tags[0] == Protocol::Tag::Nack);
+  }
+
+  SECTION("A resent EndFileTransfer finishes the write and is answered") {
+    REQUIRE(protocol.handle_chunk(sysex::Chunk(end_write, sizeof(end_write)),
+                                  sender, now) == Protocol::Result::OK);
+    REQUIRE_FALSE(file_ops.write_pending);
+    REQUIRE(sent_tags.size() == 1);
+    REQUIRE(sent_tags[0] == Protocol::Tag::Ack);
+    protocol.service(sender);
+    REQUIRE(sent_tags.size() == 1);
+  }
+
+  SECTION("The next transfer is answered after the last one") {
+    protocol.handle_chunk(
+        sysex::Chunk(begin_file_write, sizeof(begin_file_write)), sender,
+        now);
+    REQUIRE(sent_tags.size() == 2);
+    REQUIRE(sent_tags[0] == Protocol::Tag::Ack);
+    REQUIRE(sent_tags[1] == Protocol::Tag::Ack);
+    REQUIRE(protocol.get_state() == State::FileTransfer);
+  }
+}
+
 TEST_CASE("Protocol maps no-body commands to results") {
   TestFileOps file_ops;
   musin::NullLogger logger;
@@ -213,6 +363,815 @@ TEST_CASE("Protocol maps no-body commands to results") {
   REQUIRE(result == Protocol::Result::PrintFirmwareVersion);
 }
 
+TEST_CASE("Protocol passes SetRandomSeed through with its raw payload") {
+  TestFileOps file_ops;
+  musin::NullLogger logger;
+  Protocol protocol(file_ops, logger);
+  etl::vector<Protocol::Tag, 10> sent_tags;
+  MockSender sender{sent_tags};
+
+  const uint8_t set_seed[] = {MFR0, MFR1, MFR2, DEV, Protocol::SetRandomSeed,
+                              0x01, 0x00, 0x00, 0x00, 0x00};
+  const auto result = protocol.handle_chunk(
+      sysex::Chunk(set_seed, sizeof(set_seed)), sender, absolute_time_t{});
+
+  REQUIRE(result == Protocol::Result::SetRandomSeed);
+  REQUIRE(sent_tags.empty());
+}
+
+TEST_CASE("Protocol passes SetPatternChain through with its raw payload") {
+  TestFileOps file_ops;
+  musin::NullLogger logger;
+  Protocol protocol(file_ops, logger);
+  etl::vector<Protocol::Tag, 10> sent_tags;
+  MockSender sender{sent_tags};
+
+  const uint8_t set_chain[] = {MFR0, MFR1, MFR2, DEV,
+                               Protocol::SetPatternChain, 0x00, 0x02, 0x01};
+  const auto result = protocol.handle_chunk(
+      sysex::Chunk(set_chain, sizeof(set_chain)), sender, absolute_time_t{});
+
+  REQUIRE(result == Protocol::Result::SetPatternChain);
+  REQUIRE(sent_tags.empty());
+}
+
+// ---------------------------------------------------------------------------
+// Windowed file transfers
+// ---------------------------------------------------------------------------
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct RecordingFileOps {
+  static constexpr unsigned BlockSize = 256;
+  using Sha256 = FakeSha256;
+
+  struct Handle {
+    RecordingFileOps &parent;
+
+    explicit Handle(RecordingFileOps &parent) : parent(parent) {
+      parent.file_is_open = true;
+    }
+
+    void close() {
+      parent.file_is_open = false;
+    }
+
+    size_t write(const etl::span<const uint8_t> &bytes) {
+      parent.data.insert(parent.data.end(), bytes.begin(), bytes.end());
+      return bytes.size();
+    }
+
+    // Offers 20, 15, 10 and 5 bytes in turn, so some 8-byte groups have to
+    // be decoded aside because they do not fit
+    etl::span<uint8_t> reserve() {
+      const size_t size = 20 - parent.reserves++ % 4 * 5;
+      return etl::span<uint8_t>{parent.staging.data(), size};
+    }
+
+    void commit(size_t count) {
+      write(etl::span<const uint8_t>{parent.staging.data(), count});
+    }
+  };
+
+  struct ReadHandle {
+    const std::vector<uint8_t> *data;
+    size_t position = 0;
+
+    size_t size() const {
+      return data->size();
+    }
+
+    size_t read(const etl::span<uint8_t> &bytes) {
+      const size_t count = std::min(bytes.size(), data->size() - position);
+      std::copy_n(data->begin() + position, count, bytes.begin());
+      position += count;
+      return count;
+    }
+  };
+
+  etl::optional<Handle> open(const etl::string_view &, bool append) {
+    if (!append) {
+      data.clear();
+    }
+    exists = true;
+    return Handle(*this);
+  }
+
+  etl::optional<ReadHandle> open_read(const etl::string_view &) {
+    if (!exists) {
+      return etl::nullopt;
+    }
+    return ReadHandle{&data};
+  }
+
+  bool format() {
+    return true;
+  }
+
+  bool finishing_write() const {
+    return false;
+  }
+
+  bool write_failed() const {
+    return false;
+  }
+
+  bool complete_write() {
+    return true;
+  }
+
+  bool file_is_open = false;
+  bool exists = false;
+  std::vector<uint8_t> data;
+  etl::array<uint8_t, 20> staging{};
+  size_t reserves = 0;
+};
+
+using WindowedProtocol = sysex::Protocol<RecordingFileOps>;
+using Tag = WindowedProtocol::Tag;
+using WindowedState = WindowedProtocol::State;
+
+struct Reply {
+  Tag tag;
+  std::vector<uint8_t> payload;
+};
+
+struct RecordingSender {
+  std::vector<Reply> &replies;
+  void operator()(Tag tag) {
+    replies.push_back({tag, {}});
+  }
+  void operator()(Tag tag, etl::span<const uint8_t> payload) {
+    replies.push_back({tag, {payload.begin(), payload.end()}});
+  }
+};
+
+using Message = std::vector<uint8_t>;
+
+void pack_3_to_16(Message &message, uint16_t value) {
+  message.push_back((value >> 14) & 0x7F);
+  message.push_back((value >> 7) & 0x7F);
+  message.push_back(value & 0x7F);
+}
+
+Message begin_message(const char *path, uint8_t window) {
+  std::vector<uint8_t> body(path, path + std::char_traits<char>::length(path));
+  body.push_back(0);
+  if (window > 0) {
+    body.push_back(window);
+  }
+  if (body.size() % 2 != 0) {
+    body.push_back(0);
+  }
+  Message message{MFR0, MFR1, MFR2, DEV, Tag::BeginFileWrite};
+  for (size_t i = 0; i < body.size(); i += 2) {
+    pack_3_to_16(message, static_cast<uint16_t>(body[i + 1] << 8 | body[i]));
+  }
+  return message;
+}
+
+void encode_7_to_8(Message &message, const uint8_t *bytes, size_t size) {
+  for (size_t i = 0; i < size; i += 7) {
+    uint8_t msbs = 0;
+    for (size_t j = 0; j < 7; ++j) {
+      const uint8_t byte = (i + j < size) ? bytes[i + j] : 0;
+      message.push_back(byte & 0x7F);
+      msbs |= (byte >> 7) << j;
+    }
+    message.push_back(msbs);
+  }
+}
+
+Message file_bytes_message(const std::vector<uint8_t> &file, size_t start,
+                           size_t size) {
+  Message message{MFR0, MFR1, MFR2, DEV, Tag::FileBytes};
+  encode_7_to_8(message, file.data() + start, size);
+  return message;
+}
+
+Message sequenced_message(const std::vector<uint8_t> &file,
+                          size_t chunk_size, uint32_t index) {
+  const uint16_t sequence = index & WindowedProtocol::SEQUENCE_MASK;
+  Message message{MFR0,
+                  MFR1,
+                  MFR2,
+                  DEV,
+                  Tag::SequencedFileBytes,
+                  static_cast<uint8_t>(sequence >> 7),
+                  static_cast<uint8_t>(sequence & 0x7F)};
+  const size_t start = index * chunk_size;
+  encode_7_to_8(message, file.data() + start,
+                std::min(chunk_size, file.size() - start));
+  return message;
+}
+
+Message end_message(uint32_t chunk_count) {
+  Message message{MFR0, MFR1, MFR2, DEV, Tag::EndFileTransfer};
+  pack_3_to_16(message, chunk_count & WindowedProtocol::SEQUENCE_MASK);
+  return message;
+}
+
+std::vector<uint8_t> make_file(size_t size) {
+  std::vector<uint8_t> file(size);
+  for (size_t i = 0; i < size; ++i) {
+    file[i] = static_cast<uint8_t>(i * 37 + (i >> 8));
+  }
+  return file;
+}
+
+uint16_t ack_sequence(const Reply &reply) {
+  return static_cast<uint16_t>(reply.payload[0] << 7 | reply.payload[1]);
+}
+
+struct WindowedFixture {
+  RecordingFileOps file_ops;
+  musin::NullLogger logger;
+  WindowedProtocol protocol{file_ops, logger};
+  std::vector<Reply> replies;
+
+  WindowedProtocol::Result send(const Message &message) {
+    return protocol.handle_chunk(sysex::Chunk(message.data(), message.size()),
+                                 RecordingSender{replies}, absolute_time_t{});
+  }
+};
+
+// A host that keeps up to `window` chunks in flight over a link that drops
+// and reorders messages in both directions. It retransmits NACKed chunks.
+// Once everything is sent and the link is idle it sends EndFileTransfer and
+// resends whatever the reply lists as missing. If no reply comes at all it
+// stalls, and resends the same way.
+struct LossyTransfer {
+  WindowedFixture &device;
+  const std::vector<uint8_t> &file;
+  size_t chunk_size;
+  uint8_t window;
+  std::mt19937 random;
+  double loss;
+
+  uint32_t retransmissions = 0;
+  uint32_t stalls = 0;
+
+  bool lost() {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random) < loss;
+  }
+
+  bool run() {
+    const uint32_t count =
+        static_cast<uint32_t>((file.size() + chunk_size - 1) / chunk_size);
+    std::vector<bool> acked(count, false);
+    std::deque<uint32_t> link; // Chunk indices on their way to the device
+    uint32_t base = 0;
+    uint32_t next = 0;
+    bool polled = false;
+
+    auto send_chunk = [&](uint32_t index) {
+      if (!lost()) {
+        link.push_back(index);
+      }
+    };
+
+    auto resend_unacked = [&]() {
+      for (uint32_t i = base; i < std::min(base + window, next); ++i) {
+        if (!acked[i]) {
+          ++retransmissions;
+          send_chunk(i);
+          polled = false;
+        }
+      }
+    };
+
+    auto handle_replies = [&]() -> bool {
+      std::vector<Reply> replies;
+      replies.swap(device.replies);
+      for (const Reply &reply : replies) {
+        if (lost()) {
+          continue;
+        }
+        if (reply.tag == Tag::WindowAck) {
+          const uint32_t delta =
+              (ack_sequence(reply) - base) & WindowedProtocol::SEQUENCE_MASK;
+          if (delta <= window) {
+            for (uint32_t i = 0; i < delta; ++i) {
+              acked[base + i] = true;
+            }
+            base += delta;
+          }
+          const uint32_t held = reply.payload[3] | reply.payload[4] << 7 |
+                                reply.payload[5] << 14;
+          for (uint32_t bit = 0; bit < 21; ++bit) {
+            if ((held >> bit) & 1u && base + 1 + bit < count) {
+              acked[base + 1 + bit] = true;
+            }
+          }
+        } else if (reply.tag == Tag::WindowNack) {
+          const uint32_t offset =
+              (ack_sequence(reply) - base) & WindowedProtocol::SEQUENCE_MASK;
+          if (offset < window && base + offset < count) {
+            ++retransmissions;
+            send_chunk(base + offset);
+          }
+        } else if (reply.tag == Tag::Ack) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    for (uint32_t round = 0; round < count * 20 + 100; ++round) {
+      while (next < count && next - base < window) {
+        send_chunk(next++);
+      }
+
+      if (!link.empty()) {
+        // Deliver one of the next few messages, so the link reorders
+        const size_t pick = std::uniform_int_distribution<size_t>(
+            0, std::min<size_t>(link.size(), 3) - 1)(random);
+        const uint32_t index = link[pick];
+        link.erase(link.begin() + pick);
+        device.send(sequenced_message(file, chunk_size, index));
+      } else if (next == count && !polled) {
+        device.send(end_message(count));
+        polled = true;
+        if (handle_replies()) {
+          return true;
+        }
+        resend_unacked();
+        continue;
+      } else {
+        // Nothing in flight and no reply: the host times out
+        ++stalls;
+        polled = false;
+        resend_unacked();
+      }
+
+      if (handle_replies()) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+} // namespace
+
+TEST_CASE("Protocol negotiates the transfer window in BeginFileWrite",
+          "[sysex][windowed]") {
+  WindowedFixture f;
+
+  SECTION("A window byte after the path selects a windowed transfer") {
+    f.send(begin_message("kit.bin", 8));
+    REQUIRE(f.protocol.get_state() == WindowedState::FileTransfer);
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    REQUIRE(f.replies[0].payload ==
+            std::vector<uint8_t>{0, 0, 8, 0, 0, 0});
+  }
+
+  SECTION("The window is clamped to what the device supports") {
+    f.send(begin_message("kit.bin", 100));
+    REQUIRE(f.replies[0].payload[2] == WindowedProtocol::MAX_WINDOW);
+  }
+
+  SECTION("A path padded with NUL starts a legacy transfer") {
+    f.send(begin_message("ab", 0));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::Ack);
+
+    const auto file = make_file(7);
+    f.replies.clear();
+    f.send(sequenced_message(file, 7, 0));
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+  }
+}
+
+TEST_CASE("Protocol writes legacy chunks across block boundaries once",
+          "[sysex]") {
+  WindowedFixture f;
+  const auto file = make_file(98 * 7);
+
+  f.send(begin_message("a.bin", 0));
+  for (size_t start = 0; start < file.size(); start += 98) {
+    f.send(file_bytes_message(file, start, 98));
+  }
+  f.replies.clear();
+  const Message end{MFR0, MFR1, MFR2, DEV, Tag::EndFileTransfer};
+  REQUIRE(f.send(end) == WindowedProtocol::Result::FileWritten);
+
+  REQUIRE(f.file_ops.data == file);
+}
+
+TEST_CASE("Protocol acknowledges windowed chunks", "[sysex][windowed]") {
+  WindowedFixture f;
+  const auto file = make_file(7 * 8);
+  f.send(begin_message("a.bin", 4));
+  f.replies.clear();
+
+  SECTION("In-order chunks are acknowledged every window / 2") {
+    f.send(sequenced_message(file, 7, 0));
+    REQUIRE(f.replies.empty());
+    f.send(sequenced_message(file, 7, 1));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    REQUIRE(ack_sequence(f.replies[0]) == 2);
+  }
+
+  SECTION("A gap is NACKed once and acknowledged as soon as it fills") {
+    f.send(sequenced_message(file, 7, 0));
+    f.send(sequenced_message(file, 7, 2));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowNack);
+    REQUIRE(ack_sequence(f.replies[0]) == 1);
+
+    f.send(sequenced_message(file, 7, 3));
+    REQUIRE(f.replies.size() == 1); // Chunk 1 was already NACKed
+
+    f.send(sequenced_message(file, 7, 1));
+    REQUIRE(f.replies.size() == 2);
+    REQUIRE(f.replies[1].tag == Tag::WindowAck);
+    REQUIRE(ack_sequence(f.replies[1]) == 4);
+    REQUIRE(f.replies[1].payload[3] == 0);
+  }
+
+  SECTION("Held chunks are listed in the selective bitmap") {
+    f.send(sequenced_message(file, 7, 2));
+    f.send(sequenced_message(file, 7, 3));
+    f.replies.clear();
+    REQUIRE(f.send(end_message(4)) == WindowedProtocol::Result::OK);
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    REQUIRE(ack_sequence(f.replies[0]) == 0);
+    REQUIRE(f.replies[0].payload[3] == 0b110);
+    REQUIRE(f.protocol.get_state() == WindowedState::FileTransfer);
+
+    f.send(sequenced_message(file, 7, 0));
+    f.send(sequenced_message(file, 7, 1));
+    REQUIRE(f.send(end_message(4)) == WindowedProtocol::Result::FileWritten);
+    REQUIRE(f.file_ops.data ==
+            std::vector<uint8_t>(file.begin(), file.begin() + 28));
+  }
+
+  SECTION("A duplicate is acknowledged and not written again") {
+    f.send(sequenced_message(file, 7, 0));
+    f.send(sequenced_message(file, 7, 0));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    REQUIRE(ack_sequence(f.replies[0]) == 1);
+    REQUIRE(f.send(end_message(1)) == WindowedProtocol::Result::FileWritten);
+    REQUIRE(f.file_ops.data.size() == 7);
+  }
+}
+
+TEST_CASE("Windowed transfers survive loss and reordering",
+          "[sysex][windowed]") {
+  WindowedFixture f;
+
+  SECTION("Lossy links deliver the file intact") {
+    const auto file = make_file(98 * 60 + 49);
+    for (uint32_t seed : {1u, 2u, 3u}) {
+      f.send(begin_message("kit.bin", 8));
+      f.replies.clear();
+      LossyTransfer transfer{f, file, 98, 8, std::mt19937(seed), 0.1};
+      REQUIRE(transfer.run());
+      REQUIRE(f.file_ops.data == file);
+      REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+      REQUIRE(transfer.retransmissions > 0);
+    }
+  }
+
+  SECTION("A link that only reorders never stalls") {
+    const auto file = make_file(98 * 40);
+    f.send(begin_message("kit.bin", 16));
+    f.replies.clear();
+    LossyTransfer transfer{f, file, 98, 16, std::mt19937(4), 0.0};
+    REQUIRE(transfer.run());
+    REQUIRE(f.file_ops.data == file);
+    REQUIRE(transfer.stalls == 0);
+  }
+
+  SECTION("Sequence numbers wrap") {
+    const auto file = make_file(7 * 16500);
+    f.send(begin_message("big.bin", 16));
+    f.replies.clear();
+    LossyTransfer transfer{f, file, 7, 16, std::mt19937(5), 0.02};
+    REQUIRE(transfer.run());
+    REQUIRE(f.file_ops.data == file);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// StatFile and resumed file writes
+// ---------------------------------------------------------------------------
+
+namespace {
+
+Message path_message(uint8_t tag, const char *path,
+                     const std::vector<uint8_t> &after_nul = {}) {
+  std::vector<uint8_t> body(path, path + std::char_traits<char>::length(path));
+  body.push_back(0);
+  body.insert(body.end(), after_nul.begin(), after_nul.end());
+  if (body.size() % 2 != 0) {
+    body.push_back(0);
+  }
+  Message message{MFR0, MFR1, MFR2, DEV, tag};
+  for (size_t i = 0; i < body.size(); i += 2) {
+    pack_3_to_16(message, static_cast<uint16_t>(body[i + 1] << 8 | body[i]));
+  }
+  return message;
+}
+
+Message resume_message(const char *path, uint8_t window, uint32_t offset) {
+  return path_message(Tag::ResumeFileWrite, path,
+                      {window, static_cast<uint8_t>(offset),
+                       static_cast<uint8_t>(offset >> 8),
+                       static_cast<uint8_t>(offset >> 16),
+                       static_cast<uint8_t>(offset >> 24)});
+}
+
+FakeSha256::Digest fake_digest(const std::vector<uint8_t> &bytes) {
+  FakeSha256 sha;
+  sha.start();
+  sha.update(etl::span<const uint8_t>{bytes.data(), bytes.size()});
+  FakeSha256::Digest digest{};
+  sha.finish(digest);
+  return digest;
+}
+
+// Runs service() until the FileStat reply, returning the passes it took
+size_t service_until_reply(WindowedFixture &f) {
+  size_t passes = 0;
+  while (f.replies.empty() && passes < 1000) {
+    f.protocol.service(RecordingSender{f.replies});
+    ++passes;
+  }
+  return passes;
+}
+
+} // namespace
+
+TEST_CASE("StatFile reports the size and hash of a stored file",
+          "[sysex][stat]") {
+  WindowedFixture f;
+  FakeSha256::start_ok = true;
+
+  SECTION("A stored file is hashed over several main loop passes") {
+    const auto file = make_file(5000);
+    f.file_ops.data = file;
+    f.file_ops.exists = true;
+
+    f.send(path_message(Tag::StatFile, "01.pcm"));
+    REQUIRE(f.replies.empty());
+    REQUIRE(f.protocol.get_state() == WindowedState::Hashing);
+    REQUIRE(f.protocol.busy());
+
+    REQUIRE(service_until_reply(f) > 1);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::FileStat);
+
+    const auto &payload = f.replies[0].payload;
+    REQUIRE(payload.size() == WindowedProtocol::FILE_STAT_PAYLOAD_SIZE);
+    REQUIRE(payload[0] == 1);
+    const uint32_t size = static_cast<uint32_t>(
+        payload[1] << 28 | payload[2] << 21 | payload[3] << 14 |
+        payload[4] << 7 | payload[5]);
+    REQUIRE(size == 5000);
+
+    etl::array<uint8_t, 35> decoded{};
+    const auto result = sysex::codec::decode_8_to_7(
+        payload.begin() + 6, payload.end(), decoded.begin(), decoded.end());
+    REQUIRE(result.second == 35);
+    const auto expected = fake_digest(file);
+    REQUIRE(std::equal(expected.begin(), expected.end(), decoded.begin()));
+  }
+
+  SECTION("A missing file is reported without a hash") {
+    f.send(path_message(Tag::StatFile, "01.pcm"));
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::FileStat);
+    REQUIRE(f.replies[0].payload == std::vector<uint8_t>(6, 0));
+  }
+
+  SECTION("An empty file has size zero") {
+    f.file_ops.exists = true;
+    f.send(path_message(Tag::StatFile, "01.pcm"));
+    REQUIRE(service_until_reply(f) == 1);
+    REQUIRE(f.replies[0].payload[0] == 1);
+    REQUIRE(f.replies[0].payload[5] == 0);
+  }
+
+  SECTION("StatFile is refused during a transfer") {
+    f.send(begin_message("a.bin", 0));
+    f.replies.clear();
+    f.send(path_message(Tag::StatFile, "a.bin"));
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::FileTransfer);
+  }
+
+  SECTION("An unavailable hash engine refuses StatFile") {
+    f.file_ops.exists = true;
+    FakeSha256::start_ok = false;
+    f.send(path_message(Tag::StatFile, "01.pcm"));
+    FakeSha256::start_ok = true;
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+  }
+
+  SECTION("A new file write abandons the hash") {
+    f.file_ops.data = make_file(5000);
+    f.file_ops.exists = true;
+    f.send(path_message(Tag::StatFile, "01.pcm"));
+    const size_t aborts = FakeSha256::aborts;
+    f.send(begin_message("a.bin", 0));
+    REQUIRE(FakeSha256::aborts == aborts + 1);
+    REQUIRE(f.protocol.get_state() == WindowedState::FileTransfer);
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::Ack);
+  }
+}
+
+TEST_CASE("ResumeFileWrite appends at the stored size", "[sysex][stat]") {
+  WindowedFixture f;
+  const auto file = make_file(7 * 40);
+  const size_t stored = 7 * 15;
+  f.file_ops.data.assign(file.begin(), file.begin() + stored);
+  f.file_ops.exists = true;
+
+  SECTION("A legacy transfer continues from the offset") {
+    f.send(resume_message("a.bin", 0, stored));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::Ack);
+    REQUIRE(f.protocol.get_state() == WindowedState::FileTransfer);
+
+    f.send(file_bytes_message(file, stored, file.size() - stored));
+    const Message end{MFR0, MFR1, MFR2, DEV, Tag::EndFileTransfer};
+    REQUIRE(f.send(end) == WindowedProtocol::Result::FileWritten);
+    REQUIRE(f.file_ops.data == file);
+  }
+
+  SECTION("A windowed transfer continues from the offset") {
+    f.send(resume_message("a.bin", 4, stored));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    REQUIRE(ack_sequence(f.replies[0]) == 0);
+
+    const std::vector<uint8_t> rest(file.begin() + stored, file.end());
+    for (uint32_t index = 0; index < 5; ++index) {
+      f.send(sequenced_message(rest, 35, index));
+    }
+    REQUIRE(f.send(end_message(5)) == WindowedProtocol::Result::FileWritten);
+    REQUIRE(f.file_ops.data == file);
+  }
+
+  SECTION("An offset other than the stored size is refused") {
+    f.send(resume_message("a.bin", 0, stored + 7));
+    REQUIRE(f.replies.size() == 1);
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+    REQUIRE(f.file_ops.data.size() == stored);
+  }
+
+  SECTION("Offset zero of a missing file starts it afresh") {
+    f.file_ops.exists = false;
+    f.file_ops.data.clear();
+    f.send(resume_message("a.bin", 0, 0));
+    REQUIRE(f.replies[0].tag == Tag::Ack);
+    REQUIRE(f.file_ops.exists);
+  }
+
+  SECTION("A message without the offset is refused") {
+    f.send(path_message(Tag::ResumeFileWrite, "a.bin", {0, 1}));
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+  }
+}
+
+namespace {
+
+std::vector<uint8_t> u32_bytes(uint32_t value) {
+  return {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+          static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+}
+
+Message sized_begin_message(const char *path, uint8_t window, uint32_t size) {
+  std::vector<uint8_t> after_nul{window};
+  const auto size_bytes = u32_bytes(size);
+  after_nul.insert(after_nul.end(), size_bytes.begin(), size_bytes.end());
+  return path_message(Tag::BeginFileWrite, path, after_nul);
+}
+
+Message sized_resume_message(const char *path, uint8_t window,
+                             uint32_t offset, uint32_t size) {
+  std::vector<uint8_t> after_nul{window};
+  for (const uint32_t value : {offset, size}) {
+    const auto bytes = u32_bytes(value);
+    after_nul.insert(after_nul.end(), bytes.begin(), bytes.end());
+  }
+  return path_message(Tag::ResumeFileWrite, path, after_nul);
+}
+
+// Uploads @p file in 98-byte windowed chunks, returning the final reply
+Tag send_windowed(WindowedFixture &f, const std::vector<uint8_t> &file) {
+  const uint32_t count = static_cast<uint32_t>((file.size() + 97) / 98);
+  for (uint32_t index = 0; index < count; ++index) {
+    f.send(sequenced_message(file, 98, index));
+  }
+  f.replies.clear();
+  f.send(end_message(count));
+  return f.replies.back().tag;
+}
+
+// The size and decoded digest of a FileStat reply
+std::pair<uint32_t, FakeSha256::Digest> stat_reply(const Reply &reply) {
+  const auto &payload = reply.payload;
+  const uint32_t size = static_cast<uint32_t>(
+      payload[1] << 28 | payload[2] << 21 | payload[3] << 14 |
+      payload[4] << 7 | payload[5]);
+  etl::array<uint8_t, 35> decoded{};
+  sysex::codec::decode_8_to_7(payload.begin() + 6, payload.end(),
+                              decoded.begin(), decoded.end());
+  FakeSha256::Digest digest{};
+  std::copy_n(decoded.begin(), digest.size(), digest.begin());
+  return {size, digest};
+}
+
+} // namespace
+
+TEST_CASE("A declared file size keeps the last group's padding off flash",
+          "[sysex][stat]") {
+  WindowedFixture f;
+  FakeSha256::start_ok = true;
+  const auto file = make_file(20);
+
+  SECTION("A file that is not a multiple of 7 stats, then resumes") {
+    const std::vector<uint8_t> half(file.begin(), file.begin() + 10);
+    f.send(sized_begin_message("a.bin", 8, 10));
+    REQUIRE(send_windowed(f, half) == Tag::Ack);
+    REQUIRE(f.file_ops.data == half);
+
+    f.replies.clear();
+    f.send(path_message(Tag::StatFile, "a.bin"));
+    service_until_reply(f);
+    const auto [size, digest] = stat_reply(f.replies[0]);
+    REQUIRE(size == 10);
+    REQUIRE(digest == fake_digest(half));
+
+    f.replies.clear();
+    f.send(sized_resume_message("a.bin", 8, size, 20));
+    REQUIRE(f.replies[0].tag == Tag::WindowAck);
+    const std::vector<uint8_t> rest(file.begin() + 10, file.end());
+    REQUIRE(send_windowed(f, rest) == Tag::Ack);
+    REQUIRE(f.file_ops.data == file);
+
+    f.replies.clear();
+    f.send(path_message(Tag::StatFile, "a.bin"));
+    service_until_reply(f);
+    REQUIRE(stat_reply(f.replies[0]) == std::make_pair(uint32_t{20},
+                                                       fake_digest(file)));
+  }
+
+  SECTION("A legacy transfer is trimmed as well") {
+    f.send(sized_begin_message("a.bin", 0, 20));
+    REQUIRE(f.replies[0].tag == Tag::Ack);
+    f.send(file_bytes_message(file, 0, 20));
+    const Message end{MFR0, MFR1, MFR2, DEV, Tag::EndFileTransfer};
+    REQUIRE(f.send(end) == WindowedProtocol::Result::FileWritten);
+    REQUIRE(f.file_ops.data == file);
+  }
+
+  SECTION("Without a size the padding is stored, as before") {
+    f.send(begin_message("a.bin", 8));
+    send_windowed(f, file);
+    REQUIRE(f.file_ops.data.size() == 21);
+  }
+
+  SECTION("A transfer that ends short of the size is refused") {
+    f.send(sized_begin_message("a.bin", 8, 30));
+    REQUIRE(send_windowed(f, file) == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+  }
+
+  SECTION("Data past the size is refused") {
+    f.send(sized_begin_message("a.bin", 8, 13));
+    f.replies.clear();
+    f.send(sequenced_message(file, 98, 0));
+    REQUIRE(f.replies.back().tag == Tag::Nack);
+    REQUIRE(f.protocol.get_state() == WindowedState::Idle);
+  }
+
+  SECTION("A size below the resume offset is refused") {
+    f.file_ops.data.assign(file.begin(), file.begin() + 10);
+    f.file_ops.exists = true;
+    f.send(sized_resume_message("a.bin", 8, 10, 5));
+    REQUIRE(f.replies[0].tag == Tag::Nack);
+  }
+}
+
 // ---------------------------------------------------------------------------
 // SDS Protocol tests (for issue #550: sample slot tracking)
 // ---------------------------------------------------------------------------
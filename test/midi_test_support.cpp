@@ -1,6 +1,6 @@
 #include "midi_test_support.h"
 #include "musin/hal/null_logger.h"
-#include "musin/midi/midi_output_queue.h" // For midi_output_queue and MIDI_QUEUE_SIZE
+#include "musin/midi/midi_output_queue.h" // For the output queue and MIDI_QUEUE_SIZE
 #include <algorithm>                       // For std::equal, std::min
 #include <utility>                         // For std::move
 
@@ -15,9 +15,12 @@ static musin::NullLogger test_logger;
 
 // --- Mock MIDI Call Recording Implementation ---
 std::vector<MockMidiCallRecord> mock_midi_calls;
+std::vector<MockMidiCallRecord> mock_usb_midi_calls;
+bool mock_usb_midi_accepts = true;
 
 void reset_mock_midi_calls() {
   mock_midi_calls.clear();
+  mock_usb_midi_calls.clear();
 }
 
 // --- MockMidiCallRecord Implementation ---
@@ -62,24 +65,43 @@ bool MockMidiCallRecord::operator==(const MockMidiCallRecord &other) const {
 }
 
 // --- Mock MIDI::internal Function Implementations ---
+namespace {
+bool record_call(MIDI::internal::Sink sink, MockMidiCallRecord record) {
+  if (sink == MIDI::internal::Sink::DIN) {
+    mock_midi_calls.push_back(std::move(record));
+    return true;
+  }
+  if (!mock_usb_midi_accepts) {
+    return false;
+  }
+  mock_usb_midi_calls.push_back(std::move(record));
+  return true;
+}
+} // namespace
+
 namespace MIDI::internal {
-void _sendNoteOn_actual(uint8_t channel, uint8_t note, uint8_t velocity) {
-  mock_midi_calls.push_back(MockMidiCallRecord::NoteOn(channel, note, velocity));
+bool _sendNoteOn_actual(Sink sink, uint8_t channel, uint8_t note, uint8_t velocity) {
+  return record_call(sink, MockMidiCallRecord::NoteOn(channel, note, velocity));
 }
-void _sendNoteOff_actual(uint8_t channel, uint8_t note, uint8_t velocity) {
-  mock_midi_calls.push_back(MockMidiCallRecord::NoteOff(channel, note, velocity));
+bool _sendNoteOff_actual(Sink sink, uint8_t channel, uint8_t note, uint8_t velocity) {
+  return record_call(sink, MockMidiCallRecord::NoteOff(channel, note, velocity));
 }
-void _sendControlChange_actual(uint8_t channel, uint8_t controller, uint8_t value) {
-  mock_midi_calls.push_back(MockMidiCallRecord::ControlChange(channel, controller, value));
+bool _sendControlChange_actual(Sink sink, uint8_t channel, uint8_t controller,
+                               uint8_t value) {
+  return record_call(sink, MockMidiCallRecord::ControlChange(channel, controller, value));
 }
-void _sendPitchBend_actual(uint8_t channel, int bend) {
-  mock_midi_calls.push_back(MockMidiCallRecord::PitchBend(channel, bend));
+bool _sendPitchBend_actual(Sink sink, uint8_t channel, int bend) {
+  return record_call(sink, MockMidiCallRecord::PitchBend(channel, bend));
 }
-void _sendRealTime_actual(::midi::MidiType message) {
-  mock_midi_calls.push_back(MockMidiCallRecord::RealTime(message));
+bool _sendRealTime_actual(Sink sink, ::midi::MidiType message) {
+  return record_call(sink, MockMidiCallRecord::RealTime(message));
 }
-void _sendSysEx_actual(unsigned length, const uint8_t *bytes) {
+bool _sendSysEx_actual(unsigned length, const uint8_t *bytes) {
+  if (!mock_usb_midi_accepts) {
+    return false;
+  }
   mock_midi_calls.push_back(MockMidiCallRecord::SysEx(length, bytes));
+  return true;
 }
 } // namespace MIDI::internal
 
@@ -89,15 +111,17 @@ constexpr uint32_t MIN_INTERVAL_US_NON_REALTIME_TEST = 960;
 
 void reset_test_state() {
   reset_mock_midi_calls();
+  mock_usb_midi_accepts = true;
 
   const uint64_t significant_time_jump =
       MIN_INTERVAL_US_NON_REALTIME_TEST * musin::midi::MIDI_QUEUE_SIZE * 2;
   advance_mock_time_us(significant_time_jump);
 
-  while (!musin::midi::midi_output_queue.empty()) {
+  while (!musin::midi::midi_output_queue_empty()) {
     advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
     musin::midi::process_midi_output_queue(test_logger);
   }
+  musin::midi::reset_midi_output_lane_stats();
   reset_mock_midi_calls();
 
   advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
@@ -8,12 +8,13 @@
 
 // Forward declare the mock implementations in the MIDI::internal namespace
 namespace MIDI::internal {
-void _sendNoteOn_actual(uint8_t channel, uint8_t note, uint8_t velocity);
-void _sendNoteOff_actual(uint8_t channel, uint8_t note, uint8_t velocity);
-void _sendControlChange_actual(uint8_t channel, uint8_t controller, uint8_t value);
-void _sendPitchBend_actual(uint8_t channel, int bend);
-void _sendRealTime_actual(::midi::MidiType message);
-void _sendSysEx_actual(unsigned length, const uint8_t *bytes);
+bool _sendNoteOn_actual(Sink sink, uint8_t channel, uint8_t note, uint8_t velocity);
+bool _sendNoteOff_actual(Sink sink, uint8_t channel, uint8_t note, uint8_t velocity);
+bool _sendControlChange_actual(Sink sink, uint8_t channel, uint8_t controller,
+                               uint8_t value);
+bool _sendPitchBend_actual(Sink sink, uint8_t channel, int bend);
+bool _sendRealTime_actual(Sink sink, ::midi::MidiType message);
+bool _sendSysEx_actual(unsigned length, const uint8_t *bytes);
 } // namespace MIDI::internal
 
 // Mock time management is handled by the mock pico/time.h included in tests.
@@ -47,7 +48,12 @@ struct MockMidiCallRecord {
   bool operator==(const MockMidiCallRecord &other) const;
 };
 
+// Calls that reached the DIN port, plus SysEx (which is sent on USB only).
 extern std::vector<MockMidiCallRecord> mock_midi_calls;
+// Channel and real-time calls sent on USB.
+extern std::vector<MockMidiCallRecord> mock_usb_midi_calls;
+// When false, the mock USB endpoint reports a full FIFO.
+extern bool mock_usb_midi_accepts;
 
 void reset_mock_midi_calls();
 void reset_test_state();
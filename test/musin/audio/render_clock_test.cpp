@@ -0,0 +1,72 @@
+#include "musin/audio/render_clock.h"
+
+#include "test_support.h"
+
+#include <cstdint>
+
+using musin::audio::RenderClock;
+
+namespace {
+
+struct CountingSource : ::BufferSource {
+  int blocks = 0;
+  void fill_buffer(::AudioBlock &out_samples) override {
+    for (auto &sample : out_samples) {
+      sample = 0;
+    }
+    ++blocks;
+  }
+};
+
+} // namespace
+
+TEST_CASE("RenderClock counts rendered frames") {
+  set_mock_time_us(0);
+  CountingSource source;
+  RenderClock clock(source);
+  AudioBlock block;
+
+  REQUIRE(clock.next_frame() == 0);
+  clock.fill_buffer(block);
+  clock.fill_buffer(block);
+  REQUIRE(source.blocks == 2);
+  REQUIRE(clock.block_start_frame() == AUDIO_BLOCK_SAMPLES);
+  REQUIRE(clock.next_frame() == 2 * AUDIO_BLOCK_SAMPLES);
+}
+
+TEST_CASE("RenderClock maps timestamps onto the render timeline") {
+  set_mock_time_us(10'000);
+  CountingSource source;
+  RenderClock clock(source);
+  AudioBlock block;
+  clock.fill_buffer(block); // Frame 0 rendered at 10 ms
+
+  SECTION("Later and earlier times") {
+    REQUIRE(clock.frame_at(10'000) == 0u);
+    REQUIRE(clock.frame_at(11'000) == 44u); // 1 ms at 44.1 kHz
+    REQUIRE(static_cast<int32_t>(clock.frame_at(9'000)) == -44);
+  }
+
+  SECTION("A timestamp keeps its frame as later blocks render") {
+    const uint32_t event_us = 10'300;
+    const uint32_t first = clock.frame_at(event_us);
+
+    // Each block renders one block period after the previous one
+    for (int i = 0; i < 5; ++i) {
+      advance_mock_time_us(AUDIO_BLOCK_SAMPLES * 1'000'000ull /
+                           AudioOutput::SAMPLE_FREQUENCY);
+      clock.fill_buffer(block);
+      const int32_t drift =
+          static_cast<int32_t>(clock.frame_at(event_us) - first);
+      REQUIRE(drift >= -1);
+      REQUIRE(drift <= 1);
+    }
+  }
+
+  SECTION("Timestamps wrap with time_us_32") {
+    set_mock_time_us(0xFFFF'FF00ull);
+    clock.fill_buffer(block);
+    const uint32_t frame = clock.block_start_frame();
+    REQUIRE(clock.frame_at(0x0000'0100u) - frame == 22u); // 512 us later
+  }
+}
@@ -0,0 +1,163 @@
+#include "musin/audio/voice_scheduler.h"
+
+#include "test_support.h"
+
+#include <cstdint>
+#include <vector>
+
+using musin::audio::VoiceScheduler;
+
+namespace {
+
+constexpr size_t BLOCK = AUDIO_BLOCK_SAMPLES;
+
+struct Trigger {
+  uint32_t frame = 0;
+  int16_t id = 0;
+};
+
+// Renders trigger `id` as id * 1000 plus the frames since it started, and
+// silence before the first trigger.
+struct RampVoice {
+  int16_t id = 0;
+  int16_t position = 0;
+  int starts = 0;
+
+  void start(const Trigger &trigger) {
+    id = trigger.id;
+    position = 0;
+    ++starts;
+  }
+
+  void render(AudioBlock &out_samples) {
+    for (int16_t &sample : out_samples) {
+      sample = id == 0 ? 0 : static_cast<int16_t>(id * 1000 + position++);
+    }
+  }
+};
+
+using Scheduler = VoiceScheduler<Trigger, 4>;
+
+struct Harness {
+  Scheduler scheduler;
+  RampVoice voice;
+  uint32_t next_block_frame = 0;
+
+  std::vector<int16_t> render_block() {
+    AudioBlock block;
+    scheduler.fill_buffer(block, next_block_frame, voice);
+    next_block_frame += BLOCK;
+    return {block.begin(), block.end()};
+  }
+};
+
+// Samples of trigger `id`, `first` frames after its start, for `count` frames
+std::vector<int16_t> ramp(int16_t id, int16_t first, size_t count) {
+  std::vector<int16_t> samples;
+  for (size_t i = 0; i < count; ++i) {
+    samples.push_back(static_cast<int16_t>(id * 1000 + first + i));
+  }
+  return samples;
+}
+
+std::vector<int16_t> concat(std::vector<int16_t> a,
+                            const std::vector<int16_t> &b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+} // namespace
+
+TEST_CASE("VoiceScheduler starts a sound on its exact frame") {
+  Harness h;
+
+  SECTION("Mid-block, after silence") {
+    REQUIRE(h.scheduler.schedule({.frame = 5, .id = 1}));
+    REQUIRE(h.render_block() ==
+            concat(std::vector<int16_t>(5, 0), ramp(1, 0, BLOCK - 5)));
+    REQUIRE(h.scheduler.pending_count() == 0);
+  }
+
+  SECTION("On a later block's first frame") {
+    h.scheduler.schedule({.frame = 2 * BLOCK, .id = 1});
+    REQUIRE(h.render_block() == std::vector<int16_t>(BLOCK, 0));
+    REQUIRE(h.render_block() == std::vector<int16_t>(BLOCK, 0));
+    REQUIRE(h.scheduler.pending_count() == 1);
+    REQUIRE(h.render_block() == ramp(1, 0, BLOCK));
+  }
+
+  SECTION("On a later block's last frame") {
+    h.scheduler.schedule({.frame = 2 * BLOCK - 1, .id = 1});
+    h.render_block();
+    REQUIRE(h.render_block() ==
+            concat(std::vector<int16_t>(BLOCK - 1, 0), ramp(1, 0, 1)));
+    REQUIRE(h.render_block() == ramp(1, 1, BLOCK));
+  }
+}
+
+TEST_CASE("VoiceScheduler carries an offset sound across blocks") {
+  Harness h;
+  h.scheduler.schedule({.frame = 7, .id = 1});
+  h.render_block();
+
+  // The sound continues sample for sample, still delayed by its offset
+  for (int16_t block = 1; block < 4; ++block) {
+    const auto first = static_cast<int16_t>(block * BLOCK - 7);
+    REQUIRE(h.render_block() == ramp(1, first, BLOCK));
+  }
+  REQUIRE(h.voice.starts == 1);
+}
+
+TEST_CASE("VoiceScheduler cuts a sounding trigger at the next one's frame") {
+  Harness h;
+  h.scheduler.schedule({.frame = 3, .id = 1});
+  h.scheduler.schedule({.frame = BLOCK + 12, .id = 2});
+  h.render_block();
+
+  // Carried samples of the first sound, then the second from its frame
+  REQUIRE(h.render_block() ==
+          concat(ramp(1, BLOCK - 3, 12), ramp(2, 0, BLOCK - 12)));
+  REQUIRE(h.render_block() == ramp(2, BLOCK - 12, BLOCK));
+}
+
+TEST_CASE("VoiceScheduler starts triggers in frame order") {
+  Harness h;
+  h.scheduler.schedule({.frame = 15, .id = 2});
+  h.scheduler.schedule({.frame = 4, .id = 1});
+
+  REQUIRE(h.render_block() == concat(concat(std::vector<int16_t>(4, 0),
+                                            ramp(1, 0, 11)),
+                                     ramp(2, 0, BLOCK - 15)));
+  REQUIRE(h.voice.starts == 2);
+}
+
+TEST_CASE("VoiceScheduler starts an overdue trigger at the block start") {
+  Harness h;
+  h.render_block();
+  h.render_block();
+
+  // Frame 10 has already been rendered
+  h.scheduler.schedule({.frame = 10, .id = 1});
+  REQUIRE(h.render_block() == ramp(1, 0, BLOCK));
+  REQUIRE(h.render_block() == ramp(1, BLOCK, BLOCK));
+}
+
+TEST_CASE("VoiceScheduler queue limits") {
+  Harness h;
+  for (int16_t i = 1; i <= 4; ++i) {
+    REQUIRE(h.scheduler.schedule({.frame = 100u + i, .id = i}));
+  }
+
+  SECTION("A full queue drops the trigger") {
+    REQUIRE_FALSE(h.scheduler.schedule({.frame = 50, .id = 5}));
+    REQUIRE(h.scheduler.pending_count() == 4);
+  }
+
+  SECTION("Cleared triggers never start") {
+    h.scheduler.clear();
+    for (int i = 0; i < 8; ++i) {
+      REQUIRE(h.render_block() == std::vector<int16_t>(BLOCK, 0));
+    }
+    REQUIRE(h.voice.starts == 0);
+  }
+}
@@ -0,0 +1,252 @@
+#include "musin/filesystem/staged_writer.h"
+
+#include "test_support.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using musin::filesystem::StagedWriter;
+
+namespace {
+
+// Records what reaches "flash". Each write costs cost_us of mock time and
+// the first erase_cost_us write pays for an erase on top.
+struct FakeFlash {
+  std::vector<uint8_t> contents;
+  std::vector<size_t> write_sizes;
+  std::vector<std::string> opened;
+  size_t closes = 0;
+  bool open_file = false;
+  uint32_t cost_us = 100;
+  uint32_t erase_cost_us = 0;
+  size_t fail_after_writes = SIZE_MAX;
+};
+
+struct FakeFile {
+  FakeFlash *flash = nullptr;
+
+  bool open(const char *path, bool) {
+    flash->opened.emplace_back(path);
+    flash->open_file = true;
+    return true;
+  }
+
+  size_t write(etl::span<const uint8_t> bytes) {
+    if (flash->write_sizes.size() == flash->fail_after_writes) {
+      return 0;
+    }
+    uint32_t cost = flash->cost_us;
+    if (flash->write_sizes.empty()) {
+      cost += flash->erase_cost_us;
+    }
+    advance_mock_time_us(cost);
+    flash->contents.insert(flash->contents.end(), bytes.begin(), bytes.end());
+    flash->write_sizes.push_back(bytes.size());
+    return bytes.size();
+  }
+
+  bool close() {
+    flash->open_file = false;
+    ++flash->closes;
+    return true;
+  }
+};
+
+using Writer = StagedWriter<FakeFile, 64, 16>;
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed = 0) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+  return bytes;
+}
+
+size_t stage(Writer &writer, uint32_t id, const std::vector<uint8_t> &bytes) {
+  return writer.stage(id, etl::span<const uint8_t>{bytes.data(), bytes.size()});
+}
+
+} // namespace
+
+TEST_CASE("StagedWriter defers writes to service()") {
+  set_mock_time_us(0);
+  FakeFlash flash;
+  Writer writer{FakeFile{&flash}};
+  const uint32_t id = writer.open("/a.wav");
+  REQUIRE(id != 0);
+
+  SECTION("Staging does not write") {
+    const auto bytes = pattern(40);
+    REQUIRE(stage(writer, id, bytes) == 40);
+    REQUIRE(flash.write_sizes.empty());
+    REQUIRE(writer.bytes_pending() == 40);
+  }
+
+  SECTION("Whole steps are written within the budget, the tail waits") {
+    const auto bytes = pattern(40);
+    stage(writer, id, bytes);
+    writer.service(1000);
+    REQUIRE(flash.write_sizes == std::vector<size_t>{16, 16});
+    REQUIRE(writer.bytes_pending() == 8);
+  }
+
+  SECTION("At least one step is written however small the budget") {
+    const auto bytes = pattern(48);
+    stage(writer, id, bytes);
+    writer.service(0);
+    REQUIRE(flash.write_sizes.size() == 1);
+    writer.service(150);
+    REQUIRE(flash.write_sizes.size() == 3);
+  }
+
+  SECTION("Finishing writes the tail, then closes") {
+    const auto bytes = pattern(40);
+    stage(writer, id, bytes);
+    REQUIRE(writer.finish(id));
+    REQUIRE(writer.finishing());
+    REQUIRE(flash.open_file);
+
+    writer.service(1000);
+    REQUIRE_FALSE(writer.finishing());
+    REQUIRE(flash.closes == 1);
+    REQUIRE(flash.contents == bytes);
+    REQUIRE(flash.write_sizes == std::vector<size_t>{16, 16, 8});
+  }
+
+  SECTION("Finishing with nothing staged closes at once") {
+    REQUIRE(writer.finish(id));
+    REQUIRE_FALSE(writer.finishing());
+    REQUIRE(flash.closes == 1);
+  }
+}
+
+TEST_CASE("StagedWriter ring") {
+  set_mock_time_us(0);
+  FakeFlash flash;
+  Writer writer{FakeFile{&flash}};
+  const uint32_t id = writer.open("/a.wav");
+
+  SECTION("Data wraps around the ring intact") {
+    std::vector<uint8_t> sent;
+    for (uint8_t i = 0; i < 20; ++i) {
+      const auto bytes = pattern(13 + i % 5, i);
+      stage(writer, id, bytes);
+      sent.insert(sent.end(), bytes.begin(), bytes.end());
+      writer.service(0);
+    }
+    writer.finish(id);
+    writer.complete();
+    REQUIRE(flash.contents == sent);
+  }
+
+  SECTION("A full ring writes synchronously rather than refuse data") {
+    const auto bytes = pattern(100);
+    REQUIRE(stage(writer, id, bytes) == 100);
+    REQUIRE(writer.bytes_pending() <= 64);
+    REQUIRE(writer.peak_bytes_pending() == 64);
+    writer.finish(id);
+    writer.complete();
+    REQUIRE(flash.contents == bytes);
+  }
+
+  SECTION("Reserved space is filled in place, up to the end of the ring") {
+    const auto bytes = pattern(40);
+    stage(writer, id, bytes);
+    writer.service(0);
+
+    // 24 bytes free before the end of the ring, 16 more at its start
+    const etl::span<uint8_t> space = writer.reserve(id);
+    REQUIRE(space.size() == 24);
+    const auto more = pattern(10, 3);
+    std::copy(more.begin(), more.end(), space.begin());
+    writer.commit(id, more.size());
+    REQUIRE(writer.bytes_pending() == 34);
+
+    writer.finish(id);
+    writer.complete();
+    auto expected = bytes;
+    expected.insert(expected.end(), more.begin(), more.end());
+    REQUIRE(flash.contents == expected);
+  }
+
+  SECTION("Reserving in a full ring writes a step first") {
+    const auto bytes = pattern(64);
+    stage(writer, id, bytes);
+    REQUIRE(flash.write_sizes.empty());
+    REQUIRE(writer.reserve(id).size() == 16);
+    REQUIRE(flash.write_sizes == std::vector<size_t>{16});
+  }
+
+  SECTION("A stale id reserves nothing and commits nothing") {
+    REQUIRE(writer.reserve(id + 1).empty());
+    writer.commit(id + 1, 8);
+    REQUIRE(writer.bytes_pending() == 0);
+  }
+}
+
+TEST_CASE("StagedWriter file boundaries") {
+  set_mock_time_us(0);
+  FakeFlash flash;
+  Writer writer{FakeFile{&flash}};
+
+  SECTION("Opening the next file completes the previous one") {
+    const uint32_t first = writer.open("/a.wav");
+    const auto a = pattern(30, 1);
+    stage(writer, first, a);
+    writer.finish(first);
+
+    const uint32_t second = writer.open("/b.wav");
+    REQUIRE(flash.contents == a);
+    REQUIRE(flash.closes == 1);
+    REQUIRE_FALSE(writer.finishing());
+    REQUIRE(second != first);
+  }
+
+  SECTION("A stale id cannot write to or close its successor") {
+    const uint32_t first = writer.open("/a.wav");
+    const uint32_t second = writer.open("/b.wav");
+    REQUIRE(flash.closes == 1);
+
+    const auto bytes = pattern(8);
+    REQUIRE(stage(writer, first, bytes) == 0);
+    REQUIRE_FALSE(writer.finish(first));
+    REQUIRE(flash.open_file);
+    REQUIRE(stage(writer, second, bytes) == 8);
+  }
+}
+
+TEST_CASE("StagedWriter metrics and failures") {
+  set_mock_time_us(0);
+  FakeFlash flash;
+  Writer writer{FakeFile{&flash}};
+  const uint32_t id = writer.open("/a.wav");
+
+  SECTION("The worst stall is the slowest single step") {
+    flash.erase_cost_us = 40000;
+    const auto bytes = pattern(48);
+    stage(writer, id, bytes);
+    writer.service(1000);
+    REQUIRE(flash.write_sizes.size() == 1);
+    writer.service(1000);
+    REQUIRE(flash.write_sizes.size() == 3);
+    REQUIRE(writer.worst_stall_us() == 40100);
+  }
+
+  SECTION("A failed write is latched until the next file") {
+    flash.fail_after_writes = 1;
+    const auto bytes = pattern(48);
+    stage(writer, id, bytes);
+    writer.service(1000);
+    REQUIRE(writer.failed());
+    REQUIRE(writer.bytes_pending() == 0);
+    REQUIRE(stage(writer, id, bytes) == 0);
+    REQUIRE_FALSE(writer.finish(id));
+    REQUIRE(flash.closes == 1);
+
+    flash.fail_after_writes = SIZE_MAX;
+    const uint32_t next = writer.open("/b.wav");
+    REQUIRE_FALSE(writer.failed());
+    REQUIRE(stage(writer, next, bytes) == 48);
+  }
+}
@@ -0,0 +1,483 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "etl/span.h"
+
+#include "musin/flash/compact_image_parser.h"
+
+using musin::flash::CompactImageParser;
+using Result = CompactImageParser::Result;
+
+namespace {
+
+constexpr uint32_t PARTITION_OFFSET = 0x100000; // Firmware B
+constexpr uint32_t PARTITION_SIZE = 0x40000;
+
+using Digest = std::array<uint8_t, 32>;
+
+// Straightforward FIPS 180-4 SHA-256, standing in for the hardware engine.
+Digest sha256(const std::vector<uint8_t> &data) {
+  static constexpr uint32_t K[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+  uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  const auto rotr = [](uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+  };
+
+  std::vector<uint8_t> message = data;
+  const uint64_t bit_length = static_cast<uint64_t>(data.size()) * 8;
+  message.push_back(0x80);
+  while (message.size() % 64 != 56) {
+    message.push_back(0);
+  }
+  for (int i = 7; i >= 0; --i) {
+    message.push_back(static_cast<uint8_t>(bit_length >> (8 * i)));
+  }
+
+  for (size_t block = 0; block < message.size(); block += 64) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+      const uint8_t *p = &message[block + 4 * i];
+      w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+             (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+      const uint32_t s0 =
+          rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 =
+          rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+    uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; ++i) {
+      const uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                          ((e & f) ^ (~e & g)) + K[i] + w[i];
+      const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+      hh = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+  }
+
+  Digest digest{};
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      digest[4 * i + j] = static_cast<uint8_t>(h[i] >> (24 - 8 * j));
+    }
+  }
+  return digest;
+}
+
+// Flash as the sink sees it: the target partition starts erased, and the
+// running image is readable for delta copies.
+struct SimulatedFlash {
+  std::vector<uint8_t> flash =
+      std::vector<uint8_t>(PARTITION_OFFSET + PARTITION_SIZE, 0xFF);
+  std::vector<uint8_t> base;
+  std::vector<uint8_t> range_bytes;
+  uint32_t next_offset = 0;
+  size_t ranges_verified = 0;
+
+  bool begin_range(uint32_t flash_offset, uint32_t) {
+    range_bytes.clear();
+    next_offset = flash_offset;
+    return true;
+  }
+
+  bool write(uint32_t flash_offset, etl::span<const uint8_t> bytes) {
+    if (flash_offset != next_offset) {
+      return false;
+    }
+    std::copy(bytes.begin(), bytes.end(), flash.begin() + flash_offset);
+    range_bytes.insert(range_bytes.end(), bytes.begin(), bytes.end());
+    next_offset += bytes.size();
+    return true;
+  }
+
+  bool end_range(etl::span<const uint8_t> expected) {
+    const Digest digest = sha256(range_bytes);
+    if (!std::equal(digest.begin(), digest.end(), expected.begin())) {
+      return false;
+    }
+    ++ranges_verified;
+    return true;
+  }
+
+  bool read_output(uint32_t flash_offset, etl::span<uint8_t> out) {
+    if (flash_offset + out.size() > next_offset) {
+      return false;
+    }
+    std::copy_n(flash.begin() + flash_offset, out.size(), out.begin());
+    return true;
+  }
+
+  bool read_base(uint32_t image_offset, etl::span<uint8_t> out) {
+    if (image_offset + out.size() > base.size()) {
+      return false;
+    }
+    std::copy_n(base.begin() + image_offset, out.size(), out.begin());
+    return true;
+  }
+
+  std::vector<uint8_t> image(uint32_t image_offset, size_t length) const {
+    const auto start = flash.begin() + PARTITION_OFFSET + image_offset;
+    return {start, start + length};
+  }
+};
+
+void put_u32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void put_leb128(std::vector<uint8_t> &out, uint32_t value) {
+  do {
+    const uint8_t byte = value & 0x7F;
+    value >>= 7;
+    out.push_back(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+struct Range {
+  uint32_t image_offset;
+  std::vector<uint8_t> bytes;
+  bool compress = true;
+};
+
+// Greedy encoder in the spirit of the host tool: at each position, take the
+// longest of a copy from the same offset in the base image, an LZ match
+// earlier in the range, or a hashed match anywhere in the base.
+std::vector<uint8_t> encode_ops(const Range &range,
+                                const std::vector<uint8_t> &base) {
+  constexpr size_t MIN_MATCH = 4;
+  const auto &data = range.bytes;
+  const auto key = [](const std::vector<uint8_t> &v, size_t i) {
+    return uint32_t(v[i]) | (uint32_t(v[i + 1]) << 8) |
+           (uint32_t(v[i + 2]) << 16) | (uint32_t(v[i + 3]) << 24);
+  };
+  std::map<uint32_t, size_t> base_index;
+  for (size_t i = 0; i + MIN_MATCH <= base.size(); ++i) {
+    base_index.emplace(key(base, i), i);
+  }
+  std::map<uint32_t, size_t> output_index;
+
+  const auto match_length = [&](const std::vector<uint8_t> &source,
+                                size_t from, size_t at) {
+    size_t n = 0;
+    while (at + n < data.size() && from + n < source.size() &&
+           source[from + n] == data[at + n]) {
+      ++n;
+    }
+    return n;
+  };
+
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> literal;
+  const auto flush_literal = [&]() {
+    if (!literal.empty()) {
+      out.push_back(CompactImageParser::Literal);
+      put_leb128(out, literal.size());
+      out.insert(out.end(), literal.begin(), literal.end());
+      literal.clear();
+    }
+  };
+
+  size_t i = 0;
+  while (i < data.size()) {
+    size_t best = 0;
+    uint8_t op = 0;
+    uint32_t argument = 0;
+    const uint32_t image_pos = range.image_offset + i;
+    if (image_pos < base.size()) {
+      const size_t n = match_length(base, image_pos, i);
+      if (n > best) {
+        best = n;
+        op = CompactImageParser::CopyBase;
+        argument = image_pos;
+      }
+    }
+    if (i + MIN_MATCH <= data.size()) {
+      if (auto it = output_index.find(key(data, i));
+          it != output_index.end()) {
+        const size_t n = match_length(data, it->second, i);
+        if (n > best) {
+          best = n;
+          op = CompactImageParser::CopyOutput;
+          argument = static_cast<uint32_t>(i - it->second);
+        }
+      }
+      if (auto it = base_index.find(key(data, i)); it != base_index.end()) {
+        const size_t n = match_length(base, it->second, i);
+        if (n > best) {
+          best = n;
+          op = CompactImageParser::CopyBase;
+          argument = static_cast<uint32_t>(it->second);
+        }
+      }
+    }
+
+    if (best < MIN_MATCH) {
+      if (i + MIN_MATCH <= data.size()) {
+        output_index[key(data, i)] = i;
+      }
+      literal.push_back(data[i++]);
+      continue;
+    }
+    flush_literal();
+    out.push_back(op);
+    put_leb128(out, best);
+    put_leb128(out, argument);
+    for (size_t end = i + best; i < end; ++i) {
+      if (i + MIN_MATCH <= data.size()) {
+        output_index[key(data, i)] = i;
+      }
+    }
+  }
+  flush_literal();
+  return out;
+}
+
+std::vector<uint8_t> build_container(const std::vector<Range> &ranges,
+                                     const std::vector<uint8_t> &base = {}) {
+  std::vector<uint8_t> out;
+  put_u32(out, CompactImageParser::MAGIC);
+  out.push_back(ranges.size() & 0xFF);
+  out.push_back(ranges.size() >> 8);
+  for (const auto &range : ranges) {
+    put_u32(out, range.image_offset);
+    put_u32(out, range.bytes.size());
+    out.push_back(range.compress ? CompactImageParser::Ops
+                                 : CompactImageParser::Raw);
+    const Digest digest = sha256(range.bytes);
+    out.insert(out.end(), digest.begin(), digest.end());
+    const auto data = range.compress ? encode_ops(range, base) : range.bytes;
+    out.insert(out.end(), data.begin(), data.end());
+  }
+  return out;
+}
+
+// Something firmware-like: repeated instruction patterns, tables and noise.
+std::vector<uint8_t> make_image(size_t size, uint32_t seed) {
+  std::vector<uint8_t> image(size);
+  uint32_t state = seed;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1664525u + 1013904223u;
+    if ((i / 512) % 3 == 0) {
+      image[i] = static_cast<uint8_t>(state >> 24);
+    } else {
+      image[i] = static_cast<uint8_t>((i % 16) * 0x11 ^ (i / 4096));
+    }
+  }
+  return image;
+}
+
+Result push_all(CompactImageParser &parser, SimulatedFlash &sink,
+                const std::vector<uint8_t> &stream,
+                std::initializer_list<size_t> slices = {4096}) {
+  Result last = Result::Ok;
+  size_t pos = 0;
+  size_t index = 0;
+  const std::vector<size_t> sizes(slices);
+  while (pos < stream.size()) {
+    const size_t n =
+        std::min(sizes[index++ % sizes.size()], stream.size() - pos);
+    last = parser.push(etl::span<const uint8_t>{stream.data() + pos, n}, sink);
+    if (last != Result::Ok && last != Result::Complete) {
+      return last;
+    }
+    pos += n;
+  }
+  return last;
+}
+
+} // namespace
+
+TEST_CASE("sha256 reference matches known digests") {
+  const Digest abc = sha256({'a', 'b', 'c'});
+  REQUIRE(abc[0] == 0xba);
+  REQUIRE(abc[1] == 0x78);
+  REQUIRE(abc[31] == 0xad);
+}
+
+TEST_CASE("CompactImageParser flashes raw ranges byte-exactly") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  const auto image = make_image(10000, 1);
+  const auto stream = build_container({{0, image, false}});
+
+  REQUIRE(push_all(parser, sink, stream) == Result::Complete);
+  REQUIRE(parser.is_complete());
+  REQUIRE(sink.image(0, image.size()) == image);
+  REQUIRE(sink.ranges_verified == 1);
+  REQUIRE(parser.bytes_emitted() == image.size());
+}
+
+TEST_CASE("CompactImageParser decodes LZ-compressed ranges") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  const auto image = make_image(60000, 2);
+  const auto stream = build_container({{0, image}});
+
+  REQUIRE(stream.size() < image.size() / 2);
+  REQUIRE(push_all(parser, sink, stream, {1, 7, 300, 511, 200, 5}) ==
+          Result::Complete);
+  REQUIRE(sink.image(0, image.size()) == image);
+}
+
+TEST_CASE("CompactImageParser applies a delta against the running image") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  sink.base = make_image(60000, 3);
+
+  // A new build: a patched function, an inserted block shifting the rest,
+  // and a changed tail.
+  std::vector<uint8_t> image = sink.base;
+  for (size_t i = 1000; i < 1040; ++i) {
+    image[i] ^= 0x5A;
+  }
+  const auto inserted = make_image(700, 4);
+  image.insert(image.begin() + 20000, inserted.begin(), inserted.end());
+  image.resize(image.size() - 300);
+
+  const auto delta = build_container({{0, image}}, sink.base);
+  const auto full = build_container({{0, image}});
+  REQUIRE(delta.size() < full.size() / 4);
+
+  REQUIRE(push_all(parser, sink, delta) == Result::Complete);
+  REQUIRE(sink.image(0, image.size()) == image);
+}
+
+TEST_CASE("CompactImageParser writes only the listed ranges") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  const auto first = make_image(5000, 5);
+  const auto second = make_image(3000, 6);
+  const auto stream =
+      build_container({{0, first}, {0x8000, second, false}});
+
+  REQUIRE(push_all(parser, sink, stream, {33}) == Result::Complete);
+  REQUIRE(sink.image(0, first.size()) == first);
+  REQUIRE(sink.image(0x8000, second.size()) == second);
+  REQUIRE(sink.image(first.size(), 0x8000 - first.size()) ==
+          std::vector<uint8_t>(0x8000 - first.size(), 0xFF));
+  REQUIRE(sink.ranges_verified == 2);
+}
+
+TEST_CASE("CompactImageParser copies overlapping back-references") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  std::vector<uint8_t> expected(1 + 300, 0xAA);
+
+  std::vector<uint8_t> stream;
+  put_u32(stream, CompactImageParser::MAGIC);
+  stream.insert(stream.end(), {1, 0});
+  put_u32(stream, 0);
+  put_u32(stream, expected.size());
+  stream.push_back(CompactImageParser::Ops);
+  const Digest digest = sha256(expected);
+  stream.insert(stream.end(), digest.begin(), digest.end());
+  stream.insert(stream.end(), {CompactImageParser::Literal, 1, 0xAA});
+  stream.push_back(CompactImageParser::CopyOutput);
+  put_leb128(stream, 300);
+  put_leb128(stream, 1);
+
+  REQUIRE(push_all(parser, sink, stream) == Result::Complete);
+  REQUIRE(sink.image(0, expected.size()) == expected);
+}
+
+TEST_CASE("CompactImageParser rejects corrupt containers") {
+  CompactImageParser parser(PARTITION_OFFSET, PARTITION_SIZE);
+  SimulatedFlash sink;
+  const auto image = make_image(2000, 7);
+
+  SECTION("Bad magic") {
+    auto stream = build_container({{0, image}});
+    stream[0] ^= 1;
+    REQUIRE(push_all(parser, sink, stream) == Result::BadMagic);
+  }
+
+  SECTION("A damaged range fails its hash") {
+    auto stream = build_container({{0, image, false}});
+    stream.back() ^= 1;
+    REQUIRE(push_all(parser, sink, stream) == Result::HashMismatch);
+  }
+
+  SECTION("Ranges out of order") {
+    const auto stream = build_container({{0x1000, image}, {0, image}});
+    REQUIRE(push_all(parser, sink, stream) == Result::NonSequential);
+  }
+
+  SECTION("A range past the partition") {
+    const auto stream = build_container({{PARTITION_SIZE - 100, image}});
+    REQUIRE(push_all(parser, sink, stream) == Result::OutOfRange);
+  }
+
+  SECTION("A back-reference before the start of the range") {
+    std::vector<uint8_t> stream;
+    put_u32(stream, CompactImageParser::MAGIC);
+    stream.insert(stream.end(), {1, 0});
+    put_u32(stream, 0);
+    put_u32(stream, 8);
+    stream.push_back(CompactImageParser::Ops);
+    stream.insert(stream.end(), 32, 0);
+    stream.insert(stream.end(), {CompactImageParser::Literal, 2, 1, 2});
+    stream.insert(stream.end(), {CompactImageParser::CopyOutput, 6, 3});
+    REQUIRE(push_all(parser, sink, stream) == Result::BadEncoding);
+  }
+
+  SECTION("An operation longer than the range") {
+    std::vector<uint8_t> stream;
+    put_u32(stream, CompactImageParser::MAGIC);
+    stream.insert(stream.end(), {1, 0});
+    put_u32(stream, 0);
+    put_u32(stream, 2);
+    stream.push_back(CompactImageParser::Ops);
+    stream.insert(stream.end(), 32, 0);
+    stream.insert(stream.end(), {CompactImageParser::Literal, 3, 1, 2, 3});
+    REQUIRE(push_all(parser, sink, stream) == Result::BadEncoding);
+  }
+
+  SECTION("Trailing bytes") {
+    auto stream = build_container({{0, image}});
+    stream.push_back(0);
+    REQUIRE(push_all(parser, sink, stream) == Result::TrailingData);
+  }
+
+  SECTION("A delta without a running image to copy from") {
+    SimulatedFlash other;
+    other.base = image;
+    const auto stream = build_container({{0, image}}, other.base);
+    REQUIRE(push_all(parser, sink, stream) == Result::EmitFailed);
+  }
+}
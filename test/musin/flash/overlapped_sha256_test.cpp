@@ -0,0 +1,150 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "etl/span.h"
+
+#include "musin/flash/overlapped_sha256.h"
+
+namespace {
+
+// Stands in for the DMA-fed SHA block: an update stays "in flight" and is
+// only read from its buffer when the next update or finish arrives, the
+// latest point the real engine could consume it. A staging buffer reused too
+// early therefore shows up as corrupted input.
+struct EngineLog {
+  std::vector<uint8_t> consumed;
+  const uint8_t *in_flight = nullptr;
+  size_t in_flight_size = 0;
+  size_t updates = 0;
+  bool start_ok = true;
+  size_t aborts = 0;
+
+  void consume() {
+    if (in_flight) {
+      consumed.insert(consumed.end(), in_flight, in_flight + in_flight_size);
+      in_flight = nullptr;
+    }
+  }
+};
+
+struct MockEngine {
+  EngineLog *log = nullptr;
+
+  bool start() {
+    if (!log->start_ok) {
+      return false;
+    }
+    log->consumed.clear();
+    return true;
+  }
+
+  void update(const uint8_t *data, size_t size) {
+    log->consume();
+    log->in_flight = data;
+    log->in_flight_size = size;
+    ++log->updates;
+  }
+
+  void finish(etl::array<uint8_t, 32> &digest) {
+    log->consume();
+    digest.fill(static_cast<uint8_t>(log->consumed.size()));
+  }
+
+  void abort() {
+    log->consume();
+    ++log->aborts;
+  }
+};
+
+using Sha = musin::flash::OverlappedSha256<MockEngine, 16>;
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>(seed + i * 13);
+  }
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("OverlappedSha256 hashes exactly the bytes fed, in order") {
+  EngineLog log;
+  Sha sha{MockEngine{&log}};
+  REQUIRE(sha.start());
+
+  std::vector<uint8_t> fed;
+  std::vector<uint8_t> scratch;
+  for (size_t size : {1, 15, 16, 17, 40, 3, 64, 7}) {
+    scratch = pattern(size, static_cast<uint8_t>(size));
+    sha.update(etl::span<const uint8_t>{scratch.data(), scratch.size()});
+    fed.insert(fed.end(), scratch.begin(), scratch.end());
+    // The caller's buffer is free as soon as update() returns
+    std::fill(scratch.begin(), scratch.end(), 0xEE);
+  }
+
+  Sha::Digest digest{};
+  REQUIRE(sha.finish(digest));
+  REQUIRE(log.consumed == fed);
+  REQUIRE(digest[0] == static_cast<uint8_t>(fed.size()));
+  REQUIRE_FALSE(sha.active());
+}
+
+TEST_CASE("OverlappedSha256 returns while the engine is still hashing") {
+  EngineLog log;
+  Sha sha{MockEngine{&log}};
+  REQUIRE(sha.start());
+
+  const auto bytes = pattern(40, 1);
+  sha.update(etl::span<const uint8_t>{bytes.data(), bytes.size()});
+  REQUIRE(log.updates == 3);
+  REQUIRE(log.in_flight != nullptr);
+  REQUIRE(log.consumed.size() == 32);
+}
+
+TEST_CASE("OverlappedSha256 start, abort and restart") {
+  EngineLog log;
+  Sha sha{MockEngine{&log}};
+  Sha::Digest digest{};
+
+  SECTION("Nothing is hashed before start") {
+    const auto bytes = pattern(8, 2);
+    sha.update(etl::span<const uint8_t>{bytes.data(), bytes.size()});
+    REQUIRE(log.updates == 0);
+    REQUIRE_FALSE(sha.finish(digest));
+  }
+
+  SECTION("An unavailable engine fails start") {
+    log.start_ok = false;
+    REQUIRE_FALSE(sha.start());
+    REQUIRE_FALSE(sha.active());
+  }
+
+  SECTION("Abort waits for the engine and releases it") {
+    REQUIRE(sha.start());
+    const auto bytes = pattern(20, 3);
+    sha.update(etl::span<const uint8_t>{bytes.data(), bytes.size()});
+    sha.abort();
+    REQUIRE(log.aborts == 1);
+    REQUIRE(log.in_flight == nullptr);
+    REQUIRE_FALSE(sha.active());
+    sha.abort();
+    REQUIRE(log.aborts == 1);
+  }
+
+  SECTION("Starting again abandons the previous hash") {
+    REQUIRE(sha.start());
+    const auto first = pattern(20, 4);
+    sha.update(etl::span<const uint8_t>{first.data(), first.size()});
+    REQUIRE(sha.start());
+    REQUIRE(log.aborts == 1);
+
+    const auto second = pattern(5, 5);
+    sha.update(etl::span<const uint8_t>{second.data(), second.size()});
+    REQUIRE(sha.finish(digest));
+    REQUIRE(log.consumed == second);
+  }
+}
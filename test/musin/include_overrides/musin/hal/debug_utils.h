@@ -9,6 +9,7 @@ namespace DebugUtils {
 
 inline std::atomic<uint32_t> g_attack_buffer_reader_underruns{0};
 inline std::atomic<uint32_t> g_pitch_shifter_underruns{0};
+inline std::atomic<uint32_t> g_late_audio_triggers{0};
 
 #if !defined(ENABLE_PROFILING)
 #define ENABLE_PROFILING
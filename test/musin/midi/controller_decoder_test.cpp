@@ -0,0 +1,158 @@
+#include "musin/midi/controller_decoder.h"
+
+#include "test_support.h"
+
+#include <cstdint>
+#include <vector>
+
+using musin::midi::ControllerDecoder;
+using musin::midi::ControllerValue;
+
+namespace {
+
+struct Decoded {
+  ControllerValue::Kind kind;
+  uint16_t number;
+  uint16_t value;
+  bool high_resolution;
+
+  bool operator==(const Decoded &other) const = default;
+};
+
+struct Recorder {
+  ControllerDecoder decoder;
+  std::vector<Decoded> values;
+
+  void cc(uint8_t controller, uint8_t value) {
+    decoder.process(controller, value, [this](const ControllerValue &v) {
+      values.push_back({v.kind, v.number, v.value, v.high_resolution});
+    });
+  }
+
+  void flush() {
+    decoder.flush([this](const ControllerValue &v) {
+      values.push_back({v.kind, v.number, v.value, v.high_resolution});
+    });
+  }
+};
+
+constexpr auto CC = ControllerValue::Kind::CC;
+constexpr auto NRPN = ControllerValue::Kind::NRPN;
+
+} // namespace
+
+TEST_CASE("ControllerDecoder assembles 14-bit CC pairs") {
+  Recorder r;
+
+  SECTION("An MSB/LSB pair is applied once at full resolution") {
+    r.cc(7, 100);
+    REQUIRE(r.values.empty());
+    r.cc(39, 3);
+    REQUIRE(r.values.size() == 1);
+    REQUIRE(r.values[0] == Decoded{CC, 7, (100 << 7) | 3, true});
+    r.flush();
+    REQUIRE(r.values.size() == 1);
+  }
+
+  SECTION("A lone MSB is emitted as a 7-bit value on flush") {
+    r.cc(21, 64);
+    r.flush();
+    REQUIRE(r.values.size() == 1);
+    REQUIRE(r.values[0] == Decoded{CC, 21, 64, false});
+  }
+
+  SECTION("A lone MSB is emitted before an unrelated controller") {
+    r.cc(7, 10);
+    r.cc(74, 20);
+    REQUIRE(r.values.size() == 2);
+    REQUIRE(r.values[0] == Decoded{CC, 7, 10, false});
+    REQUIRE(r.values[1] == Decoded{CC, 74, 20, false});
+  }
+
+  SECTION("Repeated MSBs are each emitted") {
+    r.cc(7, 10);
+    r.cc(7, 11);
+    r.flush();
+    REQUIRE(r.values.size() == 2);
+    REQUIRE(r.values[0] == Decoded{CC, 7, 10, false});
+    REQUIRE(r.values[1] == Decoded{CC, 7, 11, false});
+  }
+
+  SECTION("An LSB on its own reuses the last MSB") {
+    r.cc(7, 100);
+    r.cc(39, 3);
+    r.cc(39, 4);
+    REQUIRE(r.values.size() == 2);
+    REQUIRE(r.values[1] == Decoded{CC, 7, (100 << 7) | 4, true});
+  }
+
+  SECTION("Normalized values reach both ends of the range") {
+    r.cc(7, 127);
+    r.cc(39, 127);
+    r.cc(9, 127);
+    r.flush();
+    REQUIRE(r.values.size() == 2);
+    ControllerValue fine{CC, 7, r.values[0].value, true};
+    ControllerValue coarse{CC, 9, r.values[1].value, false};
+    REQUIRE(fine.normalized() == 1.0f);
+    REQUIRE(coarse.normalized() == 1.0f);
+    REQUIRE(fine.coarse() == 127);
+  }
+}
+
+TEST_CASE("ControllerDecoder assembles NRPN values") {
+  Recorder r;
+
+  SECTION("Parameter select and data entry MSB/LSB") {
+    r.cc(99, 0);
+    r.cc(98, 74);
+    r.cc(6, 64);
+    r.cc(38, 5);
+    REQUIRE(r.values.size() == 1);
+    REQUIRE(r.values[0] == Decoded{NRPN, 74, (64 << 7) | 5, true});
+  }
+
+  SECTION("Data entry MSB on its own is a 7-bit value") {
+    r.cc(99, 1);
+    r.cc(98, 2);
+    r.cc(6, 90);
+    r.flush();
+    REQUIRE(r.values.size() == 1);
+    REQUIRE(r.values[0] == Decoded{NRPN, (1 << 7) | 2, 90, false});
+  }
+
+  SECTION("The selection holds for later data entries") {
+    r.cc(99, 0);
+    r.cc(98, 75);
+    r.cc(6, 1);
+    r.cc(38, 0);
+    r.cc(38, 1);
+    REQUIRE(r.values.size() == 2);
+    REQUIRE(r.values[1] == Decoded{NRPN, 75, (1 << 7) | 1, true});
+  }
+
+  SECTION("Data entry is ignored without a selection, for RPNs and after "
+          "the null parameter") {
+    r.cc(6, 1);
+    r.cc(38, 1);
+    r.cc(101, 0);
+    r.cc(100, 0);
+    r.cc(6, 2);
+    r.cc(38, 0);
+    r.cc(99, 0);
+    r.cc(98, 74);
+    r.cc(99, 127);
+    r.cc(98, 127);
+    r.cc(6, 3);
+    r.flush();
+    REQUIRE(r.values.empty());
+  }
+
+  SECTION("Parameter and data entry controllers are never plain CCs") {
+    for (uint8_t controller : {96, 97, 98, 99, 100, 101}) {
+      r.cc(controller, 1);
+    }
+    r.flush();
+    REQUIRE(r.values.empty());
+  }
+}
@@ -7,6 +7,8 @@
 // This should match the value in the implementation file.
 // We define it here to ensure tests are aware of the value without exposing it in the header.
 constexpr uint32_t MIN_INTERVAL_US_NON_REALTIME_TEST = 960;
+// One byte at 31250 baud; a three-byte message takes 960 us.
+constexpr uint32_t DIN_BYTE_TIME_US_TEST = 320;
 
 // --- Mock Logger ---
 static musin::NullLogger test_logger;
@@ -25,14 +27,14 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     reset_test_state();
     OutgoingMidiMessage msg(1, 60, 100, true); // Note On, Ch 1, Note 60, Vel 100
     REQUIRE(enqueue_midi_message(msg, test_logger));
-    REQUIRE_FALSE(midi_output_queue.empty());
+    REQUIRE_FALSE(midi_output_queue_empty());
 
     process_midi_output_queue(test_logger);
 
     REQUIRE(mock_midi_calls.size() == 1);
     REQUIRE(mock_midi_calls[0] ==
             MockMidiCallRecord::NoteOn(1, 60, 100));
-    REQUIRE(midi_output_queue.empty());
+    REQUIRE(midi_output_queue_empty());
   }
 
   SECTION("Queue Full Behavior") {
@@ -45,7 +47,8 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
       OutgoingMidiMessage msg(1, note, 100, true);
       REQUIRE(enqueue_midi_message(msg, test_logger));
     }
-    REQUIRE(midi_output_queue.full());
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::NOTE).depth ==
+            MIDI_QUEUE_SIZE);
 
     // Try to add one more message (should fail)
     const uint8_t extra_note = (last_note < 127) ? last_note + 1 : 0;
@@ -53,7 +56,7 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     REQUIRE_FALSE(enqueue_midi_message(extra_msg, test_logger));
 
     // Process all queued messages
-    while (!midi_output_queue.empty()) {
+    while (!midi_output_queue_empty()) {
       advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
       process_midi_output_queue(test_logger);
     }
@@ -79,7 +82,7 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
 
   SECTION("Processing an Empty Queue") {
     reset_test_state();
-    REQUIRE(midi_output_queue.empty());
+    REQUIRE(midi_output_queue_empty());
     process_midi_output_queue(test_logger);
     REQUIRE(mock_midi_calls.empty());
   }
@@ -96,7 +99,8 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     REQUIRE(enqueue_midi_message(note_on_msg, test_logger));
     REQUIRE(enqueue_midi_message(cc_msg, test_logger));
 
-    INFO("Queue size after enqueue: " << midi_output_queue.size());
+    INFO("Note lane depth after enqueue: "
+         << get_midi_output_lane_stats(MidiOutputLane::NOTE).depth);
 
     // First process - should send Note On
     process_midi_output_queue(test_logger);
@@ -129,7 +133,7 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     }
     REQUIRE(mock_midi_calls[1] ==
             MockMidiCallRecord::ControlChange(1, 7, 127));
-    REQUIRE(midi_output_queue.empty());
+    REQUIRE(midi_output_queue_empty());
   }
 
   SECTION("Rate Limiting for Non-Real-Time Messages") {
@@ -146,7 +150,7 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     REQUIRE(enqueue_midi_message(cc_msg2, test_logger));
     process_midi_output_queue(test_logger); // Attempt to send cc_msg2, should be deferred
     REQUIRE(mock_midi_calls.size() == 1); // Still 1, not sent yet
-    REQUIRE_FALSE(midi_output_queue.empty());
+    REQUIRE_FALSE(midi_output_queue_empty());
 
     advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST / 2);
     process_midi_output_queue(test_logger); // Still deferred
@@ -159,19 +163,21 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     REQUIRE(mock_midi_calls.size() == 2);
     REQUIRE(mock_midi_calls[1] ==
             MockMidiCallRecord::ControlChange(1, 11, 60));
-    REQUIRE(midi_output_queue.empty());
+    REQUIRE(midi_output_queue_empty());
   }
 
   SECTION("Real-Time Messages Bypass Rate Limiting") {
     reset_test_state();
-    OutgoingMidiMessage cc_msg(1, 10, 50);
+    // Channel 3 and 4 statuses are not used by earlier sections, so neither
+    // CC can go out with running status.
+    OutgoingMidiMessage cc_msg(3, 10, 50);
     OutgoingMidiMessage clock_msg(::midi::Clock);
 
     REQUIRE(enqueue_midi_message(cc_msg, test_logger));
     process_midi_output_queue(test_logger); // Send cc_msg
     REQUIRE(mock_midi_calls.size() == 1);
     REQUIRE(mock_midi_calls[0] ==
-            MockMidiCallRecord::ControlChange(1, 10, 50));
+            MockMidiCallRecord::ControlChange(3, 10, 50));
     absolute_time_t time_after_cc = get_mock_time_us(); // Use the mock time getter
 
     REQUIRE(enqueue_midi_message(clock_msg, test_logger));
@@ -180,19 +186,22 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     REQUIRE(mock_midi_calls[1] ==
             MockMidiCallRecord::RealTime(::midi::Clock));
 
-    // Check that last_non_realtime_send_time was not updated by the RT message
-    OutgoingMidiMessage cc_msg2(1, 11, 60);
+    // The clock byte is queued behind the CC on the wire, so the next CC
+    // waits for all four bytes to leave the UART.
+    OutgoingMidiMessage cc_msg2(4, 11, 60);
     REQUIRE(enqueue_midi_message(cc_msg2, test_logger));
-    // Since RT message did not update last_non_realtime_send_time,
-    // cc_msg2 should be deferred based on time_after_cc.
     process_midi_output_queue(test_logger);
     REQUIRE(mock_midi_calls.size() == 2); // cc_msg2 deferred
 
     set_mock_time_us(time_after_cc + MIN_INTERVAL_US_NON_REALTIME_TEST);
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 2); // Clock byte still on the wire
+
+    set_mock_time_us(time_after_cc + DIN_BYTE_TIME_US_TEST * 4);
     process_midi_output_queue(test_logger); // Now cc_msg2 should send
     REQUIRE(mock_midi_calls.size() == 3);
     REQUIRE(mock_midi_calls[2] ==
-            MockMidiCallRecord::ControlChange(1, 11, 60));
+            MockMidiCallRecord::ControlChange(4, 11, 60));
   }
 
   SECTION("Test All Message Types") {
@@ -319,3 +328,284 @@ TEST_CASE("MidiMessageQueue Tests", "[midi_queue]") {
     }
   }
 }
+
+TEST_CASE("MidiMessageQueue priority lanes", "[midi_queue]") {
+  using namespace musin::midi;
+
+  SECTION("Real-time is not held behind a rate-limited message") {
+    reset_test_state();
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 10, 50), test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 11, 60), test_logger));
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 1);
+
+    // cc 11 is now waiting for the DIN wire; the clock must still go out
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(::midi::Clock),
+                                 test_logger));
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 2);
+    REQUIRE(mock_midi_calls[1] == MockMidiCallRecord::RealTime(::midi::Clock));
+    REQUIRE_FALSE(midi_output_queue_empty());
+  }
+
+  SECTION("Notes are sent before queued controllers") {
+    reset_test_state();
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 7, 100), test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 36, 127, true),
+                                 test_logger));
+
+    process_midi_output_queue(test_logger);
+    advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    process_midi_output_queue(test_logger);
+
+    REQUIRE(mock_midi_calls.size() == 2);
+    REQUIRE(mock_midi_calls[0] == MockMidiCallRecord::NoteOn(1, 36, 127));
+    REQUIRE(mock_midi_calls[1] == MockMidiCallRecord::ControlChange(1, 7, 100));
+    REQUIRE(mock_usb_midi_calls == mock_midi_calls);
+  }
+
+  SECTION("SysEx is not held behind a deferred note") {
+    reset_test_state();
+    mock_usb_midi_accepts = false; // Notes wait on both sinks
+    uint8_t payload[] = {0xF0, 0x7E, 0x00, 0x06, 0x01, 0xF7};
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 36, 127, true),
+                                 test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 38, 127, true),
+                                 test_logger));
+    REQUIRE(enqueue_sysex_message(payload, sizeof(payload), test_logger));
+
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 1);
+    REQUIRE(mock_midi_calls[0] == MockMidiCallRecord::NoteOn(1, 36, 127));
+
+    // Once the endpoint drains, the SysEx follows the notes on USB while
+    // the second note still waits for the DIN wire.
+    mock_usb_midi_accepts = true;
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_usb_midi_calls.size() == 2);
+    REQUIRE(mock_midi_calls.size() == 2);
+    REQUIRE(mock_midi_calls[1] ==
+            MockMidiCallRecord::SysEx(sizeof(payload), payload));
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::NOTE).depth == 1);
+  }
+
+  SECTION("One drain sends all eligible messages") {
+    reset_test_state();
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(::midi::Clock),
+                                   test_logger));
+    }
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(2, 36, 127, true),
+                                 test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(2, 36, 0, false),
+                                 test_logger));
+
+    // USB takes everything; DIN takes the clocks, whose bytes then hold
+    // the wire for the notes
+    REQUIRE(process_midi_output_queue(test_logger) == 8);
+    REQUIRE(mock_usb_midi_calls.size() == 5);
+    REQUIRE(mock_midi_calls.size() == 3);
+    REQUIRE(process_midi_output_queue(test_logger) == 0);
+
+    advance_mock_time_us(DIN_BYTE_TIME_US_TEST * 3);
+    REQUIRE(process_midi_output_queue(test_logger) == 1);
+    REQUIRE(mock_midi_calls[3] == MockMidiCallRecord::NoteOn(2, 36, 127));
+
+    advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    REQUIRE(process_midi_output_queue(test_logger) == 1);
+    REQUIRE(midi_output_queue_empty());
+  }
+
+  SECTION("Lane stats track depth, peak and drops") {
+    reset_test_state();
+    for (size_t i = 0; i < MIDI_REALTIME_QUEUE_SIZE; ++i) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(::midi::Clock),
+                                   test_logger));
+    }
+    REQUIRE_FALSE(enqueue_midi_message(OutgoingMidiMessage(::midi::Clock),
+                                       test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(1, 7, 1), test_logger));
+
+    MidiOutputLaneStats rt =
+        get_midi_output_lane_stats(MidiOutputLane::REALTIME);
+    REQUIRE(rt.depth == MIDI_REALTIME_QUEUE_SIZE);
+    REQUIRE(rt.dropped == 1);
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::CONTROL).depth == 1);
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::NOTE).depth == 0);
+
+    process_midi_output_queue(test_logger);
+    rt = get_midi_output_lane_stats(MidiOutputLane::REALTIME);
+    REQUIRE(rt.depth == 0);
+    REQUIRE(rt.peak_depth == MIDI_REALTIME_QUEUE_SIZE);
+
+    reset_midi_output_lane_stats();
+    rt = get_midi_output_lane_stats(MidiOutputLane::REALTIME);
+    REQUIRE(rt.peak_depth == 0);
+    REQUIRE(rt.dropped == 0);
+  }
+}
+
+TEST_CASE("MidiMessageQueue independent sinks", "[midi_queue]") {
+  using namespace musin::midi;
+
+  SECTION("DIN pacing does not throttle USB") {
+    reset_test_state();
+    for (uint8_t note = 40; note < 50; ++note) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(5, note, 100, true),
+                                   test_logger));
+    }
+
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_usb_midi_calls.size() == 10);
+    REQUIRE(mock_midi_calls.size() == 1);
+
+    // The rest reach DIN one wire slot at a time, in order
+    for (int i = 0; i < 9; ++i) {
+      advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+      process_midi_output_queue(test_logger);
+    }
+    REQUIRE(mock_midi_calls == mock_usb_midi_calls);
+    REQUIRE(midi_output_queue_empty());
+  }
+
+  SECTION("A full USB endpoint does not throttle DIN") {
+    reset_test_state();
+    mock_usb_midi_accepts = false;
+    for (uint8_t note = 40; note < 44; ++note) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(6, note, 100, true),
+                                   test_logger));
+      process_midi_output_queue(test_logger);
+      advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    }
+    REQUIRE(mock_midi_calls.size() == 4);
+    REQUIRE(mock_usb_midi_calls.empty());
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::NOTE).depth == 4);
+
+    SECTION("USB resumes in order once the endpoint has room") {
+      mock_usb_midi_accepts = true;
+      process_midi_output_queue(test_logger);
+      REQUIRE(mock_usb_midi_calls == mock_midi_calls);
+      REQUIRE(midi_output_queue_empty());
+    }
+
+    SECTION("A stalled endpoint is given up on") {
+      advance_mock_time_us(10000);
+      process_midi_output_queue(test_logger);
+      REQUIRE(mock_usb_midi_calls.empty());
+      REQUIRE(midi_output_queue_empty());
+    }
+  }
+
+  SECTION("Running status shortens DIN spacing") {
+    reset_test_state();
+    // Prime running status for channel 7 note on
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(7, 36, 100, true),
+                                 test_logger));
+    process_midi_output_queue(test_logger);
+
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(7, 38, 100, true),
+                                 test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(7, 40, 100, true),
+                                 test_logger));
+    advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 2);
+
+    // Same status: two bytes on the wire
+    advance_mock_time_us(DIN_BYTE_TIME_US_TEST * 2);
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_midi_calls.size() == 3);
+    REQUIRE(mock_midi_calls[2] == MockMidiCallRecord::NoteOn(7, 40, 100));
+  }
+}
+
+TEST_CASE("MidiMessageQueue coalesces control changes", "[midi_queue]") {
+  using namespace musin::midi;
+
+  SECTION("Repeated updates send only the latest value") {
+    reset_test_state();
+    for (uint8_t value = 0; value < 100; ++value) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 74, value),
+                                   test_logger));
+    }
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 71, 5), test_logger));
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::CONTROL).depth == 2);
+
+    process_midi_output_queue(test_logger);
+    advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    process_midi_output_queue(test_logger);
+
+    REQUIRE(mock_midi_calls.size() == 2);
+    REQUIRE(mock_midi_calls[0] == MockMidiCallRecord::ControlChange(8, 74, 99));
+    REQUIRE(mock_midi_calls[1] == MockMidiCallRecord::ControlChange(8, 71, 5));
+    REQUIRE(mock_usb_midi_calls == mock_midi_calls);
+  }
+
+  SECTION("An update after one sink has sent queues a new message") {
+    reset_test_state();
+    // Hold DIN busy so USB takes the CC first
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 36, 100, true),
+                                 test_logger));
+    process_midi_output_queue(test_logger);
+
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 74, 10), test_logger));
+    process_midi_output_queue(test_logger);
+    REQUIRE(mock_usb_midi_calls.back() ==
+            MockMidiCallRecord::ControlChange(8, 74, 10));
+
+    // DIN must still send 10, then the new value
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 74, 20), test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 74, 30), test_logger));
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::CONTROL).depth == 2);
+
+    for (int i = 0; i < 2; ++i) {
+      advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+      process_midi_output_queue(test_logger);
+    }
+    REQUIRE(mock_midi_calls.size() == 3);
+    REQUIRE(mock_midi_calls[1] == MockMidiCallRecord::ControlChange(8, 74, 10));
+    REQUIRE(mock_midi_calls[2] == MockMidiCallRecord::ControlChange(8, 74, 30));
+    REQUIRE(mock_usb_midi_calls == mock_midi_calls);
+  }
+
+  SECTION("A 14-bit controller's LSB is resent after its MSB") {
+    reset_test_state();
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 39, 5), test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 7, 11), test_logger));
+    REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, 39, 6), test_logger));
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::CONTROL).depth == 3);
+
+    for (int i = 0; i < 3; ++i) {
+      process_midi_output_queue(test_logger);
+      advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    }
+    REQUIRE(mock_midi_calls.size() == 3);
+    REQUIRE(mock_midi_calls[0] == MockMidiCallRecord::ControlChange(8, 39, 6));
+    REQUIRE(mock_midi_calls[1] == MockMidiCallRecord::ControlChange(8, 7, 11));
+    REQUIRE(mock_midi_calls[2] == MockMidiCallRecord::ControlChange(8, 39, 6));
+    REQUIRE(mock_usb_midi_calls == mock_midi_calls);
+  }
+
+  SECTION("NRPN sequences are sent in full and in order") {
+    reset_test_state();
+    const uint8_t sequence[][2] = {{99, 0}, {98, 74}, {6, 10}, {38, 1},
+                                   {99, 0}, {98, 75}, {6, 20}, {38, 2}};
+    for (const auto &cc : sequence) {
+      REQUIRE(enqueue_midi_message(OutgoingMidiMessage(8, cc[0], cc[1]),
+                                   test_logger));
+    }
+    REQUIRE(get_midi_output_lane_stats(MidiOutputLane::CONTROL).depth == 8);
+
+    for (int i = 0; i < 8; ++i) {
+      process_midi_output_queue(test_logger);
+      advance_mock_time_us(MIN_INTERVAL_US_NON_REALTIME_TEST);
+    }
+    REQUIRE(mock_usb_midi_calls.size() == 8);
+    for (size_t i = 0; i < 8; ++i) {
+      REQUIRE(mock_usb_midi_calls[i] ==
+              MockMidiCallRecord::ControlChange(8, sequence[i][0],
+                                                sequence[i][1]));
+    }
+    REQUIRE(mock_midi_calls == mock_usb_midi_calls);
+  }
+}
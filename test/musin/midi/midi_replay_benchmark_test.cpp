@@ -0,0 +1,569 @@
+// Host-side replay of MIDI streams through musin's MIDI queues: the input
+// queue fed by the transport callbacks, the controller decoder, and the
+// output queue that echoes notes and CCs. Transports and time are simulated,
+// so every number is deterministic and a change in the queues shows up as a
+// change in the report.
+//
+// The report gives how long each event waits in the input queue before a
+// simulated loop pass takes it, plus queue depths and drops. It is not a
+// latency measurement: the drum firmware's MidiManager, MessageRouter and
+// AudioEngine are not run, so it says nothing about when notes sound.
+//
+// The "[benchmark]" cases are hidden; run them with
+//   ./musin-test "[benchmark]"
+// and set MIDI_REPLAY_FILE to a Standard MIDI File to replay a recording.
+
+#include "musin/hal/null_logger.h"
+#include "musin/midi/controller_decoder.h"
+#include "musin/midi/midi_input_queue.h"
+#include "musin/midi/midi_output_queue.h"
+
+#include "midi_test_support.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t DIN_BYTE_TIME_US = 320;
+constexpr uint64_t REPLAY_EPOCH_US = 1'000'000'000;
+constexpr uint8_t CHANNEL = 10;
+
+musin::NullLogger replay_logger;
+
+// One complete message as it appears on the wire, at the time the sender
+// started transmitting it.
+struct ReplayEvent {
+  uint64_t time_us;
+  std::vector<uint8_t> bytes;
+};
+
+enum class Transport : uint8_t {
+  DIN, // Bytes serialize at 31250 baud
+  USB  // Whole messages arrive at once
+};
+
+struct ReplayConfig {
+  Transport transport = Transport::DIN;
+  uint32_t loop_period_us = 200; // One main-loop pass
+  uint32_t stall_every_us = 0;   // Models flash writes, display updates...
+  uint32_t stall_us = 0;
+  bool echo_output = true; // Send notes and CCs back out, as BOTH mode does
+};
+
+enum EventKind : size_t { NOTE, CONTROL, REALTIME, SYSEX, EVENT_KIND_COUNT };
+
+constexpr const char *EVENT_KIND_NAMES[EVENT_KIND_COUNT] = {
+    "note", "control", "realtime", "sysex"};
+
+struct QueueWaits {
+  std::vector<uint32_t> samples_us;
+
+  uint32_t percentile(double p) const {
+    if (samples_us.empty()) {
+      return 0;
+    }
+    std::vector<uint32_t> sorted = samples_us;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t index = std::min(
+        sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+    return sorted[index];
+  }
+};
+
+struct ReplayReport {
+  // Time from arrival at the transport until the loop dequeues the event
+  QueueWaits queue_wait[EVENT_KIND_COUNT];
+  uint32_t input_drops = 0;
+  uint32_t sysex_drops = 0;
+  uint32_t controller_values = 0; // Values applied after decoding
+  size_t input_peak_depth = 0;
+  musin::midi::MidiOutputLaneStats output[musin::midi::MIDI_OUTPUT_LANE_COUNT];
+
+  void print(const char *title) const {
+    std::printf("\n%s\n  queue wait per event\n", title);
+    std::printf("  %-9s %7s %8s %8s %8s %8s\n", "event", "count", "p50 us",
+                "p95 us", "p99 us", "max us");
+    for (size_t kind = 0; kind < EVENT_KIND_COUNT; ++kind) {
+      const QueueWaits &w = queue_wait[kind];
+      std::printf("  %-9s %7zu %8u %8u %8u %8u\n", EVENT_KIND_NAMES[kind],
+                  w.samples_us.size(), w.percentile(50), w.percentile(95),
+                  w.percentile(99), w.percentile(100));
+    }
+    std::printf("  controller values %u\n", controller_values);
+    std::printf("  input: peak depth %zu, drops %u, sysex drops %u\n",
+                input_peak_depth, input_drops, sysex_drops);
+    constexpr const char *LANES[] = {"realtime", "note", "control"};
+    for (size_t lane = 0; lane < musin::midi::MIDI_OUTPUT_LANE_COUNT; ++lane) {
+      std::printf("  output %-8s: peak depth %u, drops %u\n", LANES[lane],
+                  output[lane].peak_depth, output[lane].dropped);
+    }
+  }
+};
+
+// A received message waiting in the transport for MIDI::read()
+struct Arrival {
+  uint32_t timestamp_us;
+  std::vector<uint8_t> bytes;
+};
+
+class ReplayRunner {
+public:
+  explicit ReplayRunner(const ReplayConfig &config) : config_(config) {
+  }
+
+  ReplayReport run(const std::vector<ReplayEvent> &events) {
+    // The output queue keeps its last send times across tests, and earlier
+    // tests may have set the clock back; start after anything they reached.
+    set_mock_time_us(std::max(mock_current_time, REPLAY_EPOCH_US));
+    reset_test_state();
+    // Empty the input queues left by earlier runs
+    musin::midi::TimestampedMidiMessage stale;
+    while (musin::midi::dequeue_incoming_midi_message(stale)) {
+    }
+    while (musin::midi::peek_incoming_sysex_chunk() != nullptr) {
+      musin::midi::pop_incoming_sysex_chunk();
+    }
+
+    const uint64_t start = mock_current_time;
+    uint64_t next_loop = start;
+    uint64_t next_stall = start + config_.stall_every_us;
+    uint64_t wire_free = start;
+    size_t next_event = 0;
+
+    // Keep looping until everything received has been handled and sent on
+    while (next_event < events.size() || !arrivals_.empty() ||
+           !musin::midi::midi_output_queue_empty()) {
+      const uint64_t now = next_loop;
+      set_mock_time_us(now);
+
+      // Messages finish arriving while the loop runs
+      while (next_event < events.size() &&
+             start + events[next_event].time_us <= now) {
+        const ReplayEvent &event = events[next_event++];
+        uint64_t arrival = start + event.time_us;
+        if (config_.transport == Transport::DIN) {
+          arrival = std::max(arrival, wire_free) +
+                    event.bytes.size() * DIN_BYTE_TIME_US;
+          wire_free = arrival;
+        }
+        arrivals_.push_back({static_cast<uint32_t>(arrival), event.bytes});
+      }
+
+      run_loop_pass();
+      next_loop += config_.loop_period_us;
+      if (config_.stall_every_us > 0 && next_loop >= next_stall) {
+        next_loop += config_.stall_us;
+        next_stall += config_.stall_every_us;
+      }
+    }
+
+    for (size_t lane = 0; lane < musin::midi::MIDI_OUTPUT_LANE_COUNT;
+         ++lane) {
+      report_.output[lane] = musin::midi::get_midi_output_lane_stats(
+          static_cast<musin::midi::MidiOutputLane>(lane));
+    }
+    return report_;
+  }
+
+private:
+  // Stands in for MIDI::read(): parses one message that has fully arrived
+  // and queues it as the transport callbacks do.
+  bool read_one(uint32_t now_us) {
+    if (arrivals_.empty() ||
+        static_cast<int32_t>(now_us - arrivals_.front().timestamp_us) < 0) {
+      return false;
+    }
+    const Arrival arrival = arrivals_.front();
+    arrivals_.pop_front();
+    const std::vector<uint8_t> &bytes = arrival.bytes;
+    const uint8_t status = bytes[0];
+    const uint8_t channel = static_cast<uint8_t>((status & 0x0F) + 1);
+    bool queued = true;
+
+    switch (status & 0xF0) {
+    case 0x80:
+      queued = musin::midi::enqueue_incoming_midi_message(
+          musin::midi::NoteOffData{channel, bytes[1], bytes[2]},
+          arrival.timestamp_us);
+      break;
+    case 0x90:
+      if (bytes[2] == 0) { // Null velocity is handled as Note Off
+        queued = musin::midi::enqueue_incoming_midi_message(
+            musin::midi::NoteOffData{channel, bytes[1], 0},
+            arrival.timestamp_us);
+      } else {
+        queued = musin::midi::enqueue_incoming_midi_message(
+            musin::midi::NoteOnData{channel, bytes[1], bytes[2]},
+            arrival.timestamp_us);
+      }
+      break;
+    case 0xB0:
+      queued = musin::midi::enqueue_incoming_midi_message(
+          musin::midi::ControlChangeData{channel, bytes[1], bytes[2]},
+          arrival.timestamp_us);
+      break;
+    case 0xF0:
+      if (status == 0xF0) {
+        if (bytes.size() >= 2 &&
+            musin::midi::enqueue_incoming_sysex_chunk(bytes.data() + 1,
+                                                      bytes.size() - 2)) {
+          sysex_arrivals_.push_back(arrival.timestamp_us);
+        } else {
+          ++report_.sysex_drops;
+        }
+        return true;
+      }
+      if (status == 0xF2 && bytes.size() >= 3) {
+        queued = musin::midi::enqueue_incoming_midi_message(
+            musin::midi::SongPositionData{
+                static_cast<uint16_t>(bytes[1] | (bytes[2] << 7))},
+            arrival.timestamp_us);
+      } else if (status >= 0xF8) {
+        queued = musin::midi::enqueue_incoming_midi_message(
+            musin::midi::SystemRealtimeData{
+                static_cast<::midi::MidiType>(status)},
+            arrival.timestamp_us);
+      }
+      break;
+    default:
+      break; // No handler registered (program change, pressure...)
+    }
+    if (!queued) {
+      ++report_.input_drops;
+    }
+    report_.input_peak_depth = std::max(
+        report_.input_peak_depth, musin::midi::midi_input_queue.size());
+    return true;
+  }
+
+  auto apply_controller() {
+    return [this](const musin::midi::ControllerValue &value) {
+      ++report_.controller_values;
+      if (value.kind == musin::midi::ControllerValue::Kind::CC) {
+        echo(musin::midi::OutgoingMidiMessage(
+            CHANNEL, static_cast<uint8_t>(value.number), value.coarse()));
+      }
+    };
+  }
+
+  // Reads everything that has arrived, drains the input queues, then sends
+  // what was echoed.
+  void run_loop_pass() {
+    const uint32_t now_us = time_us_32();
+
+    while (read_one(now_us)) {
+    }
+    while (musin::midi::peek_incoming_sysex_chunk() != nullptr) {
+      report_.queue_wait[SYSEX].samples_us.push_back(now_us -
+                                                   sysex_arrivals_.front());
+      sysex_arrivals_.pop_front();
+      musin::midi::pop_incoming_sysex_chunk();
+    }
+
+    musin::midi::TimestampedMidiMessage message;
+    while (musin::midi::dequeue_incoming_midi_message(message)) {
+      const uint32_t waited_us = now_us - message.timestamp_us;
+      if (const auto *cc =
+              etl::get_if<musin::midi::ControlChangeData>(&message.message)) {
+        report_.queue_wait[CONTROL].samples_us.push_back(waited_us);
+        if (cc->channel == CHANNEL) {
+          decoder_.process(cc->controller, cc->value, apply_controller());
+        }
+        continue;
+      }
+      decoder_.flush(apply_controller());
+
+      if (const auto *note =
+              etl::get_if<musin::midi::NoteOnData>(&message.message)) {
+        report_.queue_wait[NOTE].samples_us.push_back(waited_us);
+        if (note->channel == CHANNEL) {
+          echo(musin::midi::OutgoingMidiMessage(CHANNEL, note->note,
+                                                note->velocity, true));
+        }
+      } else if (etl::holds_alternative<musin::midi::NoteOffData>(
+                     message.message)) {
+        report_.queue_wait[NOTE].samples_us.push_back(waited_us);
+      } else {
+        report_.queue_wait[REALTIME].samples_us.push_back(waited_us);
+      }
+    }
+    decoder_.flush(apply_controller());
+
+    musin::midi::process_midi_output_queue(replay_logger);
+    reset_mock_midi_calls(); // Only the queue statistics matter here
+  }
+
+  void echo(const musin::midi::OutgoingMidiMessage &message) {
+    if (config_.echo_output) {
+      musin::midi::enqueue_midi_message(message, replay_logger);
+    }
+  }
+
+  ReplayConfig config_;
+  ReplayReport report_;
+  musin::midi::ControllerDecoder decoder_;
+  std::deque<Arrival> arrivals_;
+  std::deque<uint32_t> sysex_arrivals_;
+};
+
+// --- Streams ---
+
+void add(std::vector<ReplayEvent> &events, uint64_t time_us,
+         std::vector<uint8_t> bytes) {
+  events.push_back({time_us, std::move(bytes)});
+}
+
+// A clocked four-track pattern with filter and volume automation, the
+// densest stream a typical DAW session sends the device.
+std::vector<ReplayEvent> performance_stream(uint64_t duration_us) {
+  std::vector<ReplayEvent> events;
+  const uint8_t cc_status = 0xB0 | (CHANNEL - 1);
+  const uint8_t note_status = 0x90 | (CHANNEL - 1);
+  constexpr uint64_t CLOCK_US = 20'833; // 24 PPQN at 120 BPM
+  constexpr uint64_t CC_US = 5'000;     // 200 Hz automation
+
+  add(events, 0, {0xFA});
+  for (uint64_t t = 0; t < duration_us; t += CLOCK_US) {
+    add(events, t, {0xF8});
+    if ((t / CLOCK_US) % 6 == 0) { // Sixteenth notes
+      for (uint8_t track = 0; track < 4; ++track) {
+        add(events, t,
+            {note_status, static_cast<uint8_t>(36 + track * 8), 100});
+      }
+    }
+  }
+  for (uint64_t t = 0; t < duration_us; t += CC_US) {
+    const uint8_t value = static_cast<uint8_t>((t / CC_US) % 128);
+    add(events, t, {cc_status, 74, value});
+    add(events, t, {cc_status, 7, value});
+    add(events, t, {cc_status, 39, static_cast<uint8_t>(127 - value)});
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const ReplayEvent &a, const ReplayEvent &b) {
+                     return a.time_us < b.time_us;
+                   });
+  return events;
+}
+
+// Everything at once: the performance stream plus a CC storm and SysEx
+// chunks as large as a sample upload sends them.
+std::vector<ReplayEvent> stress_stream(uint64_t duration_us) {
+  std::vector<ReplayEvent> events = performance_stream(duration_us);
+  const uint8_t cc_status = 0xB0 | (CHANNEL - 1);
+  for (uint64_t t = 0; t < duration_us; t += 250) {
+    add(events, t, {cc_status, static_cast<uint8_t>(21 + (t / 250) % 4),
+                    static_cast<uint8_t>((t / 250) % 128)});
+  }
+  for (uint64_t t = 0; t < duration_us; t += 20'000) {
+    std::vector<uint8_t> sysex(128, 0x55);
+    sysex.front() = 0xF0;
+    sysex.back() = 0xF7;
+    add(events, t, std::move(sysex));
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const ReplayEvent &a, const ReplayEvent &b) {
+                     return a.time_us < b.time_us;
+                   });
+  return events;
+}
+
+// --- Standard MIDI File loading ---
+
+uint32_t read_variable_length(const std::vector<uint8_t> &data, size_t &pos) {
+  uint32_t value = 0;
+  while (pos < data.size()) {
+    const uint8_t byte = data[pos++];
+    value = (value << 7) | (byte & 0x7F);
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+uint32_t read_be(const std::vector<uint8_t> &data, size_t pos, size_t bytes) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value = (value << 8) | data[pos + i];
+  }
+  return value;
+}
+
+// Loads the channel, SysEx and real-time events of a format 0 or 1 file,
+// merged across tracks and timed by its tempo map. Returns nullopt for
+// unreadable files and SMPTE time division.
+std::optional<std::vector<ReplayEvent>>
+load_standard_midi_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  if (data.size() < 14 || read_be(data, 0, 4) != 0x4D546864) { // "MThd"
+    return std::nullopt;
+  }
+  const uint32_t division = read_be(data, 12, 2);
+  if (division == 0 || (division & 0x8000)) {
+    return std::nullopt;
+  }
+
+  std::multimap<uint64_t, std::vector<uint8_t>> by_tick;
+  std::map<uint64_t, uint32_t> tempo_map{{0, 500'000}}; // us per quarter
+  size_t pos = 8 + read_be(data, 4, 4);
+  while (pos + 8 <= data.size()) {
+    const uint32_t chunk_length = read_be(data, pos + 4, 4);
+    const bool is_track = read_be(data, pos, 4) == 0x4D54726B; // "MTrk"
+    pos += 8;
+    const size_t end = std::min(data.size(), pos + chunk_length);
+    uint64_t tick = 0;
+    uint8_t running_status = 0;
+    while (is_track && pos < end) {
+      tick += read_variable_length(data, pos);
+      if (pos >= end) {
+        break;
+      }
+      uint8_t status = data[pos];
+      if (status & 0x80) {
+        ++pos;
+      } else {
+        status = running_status;
+      }
+      if (status == 0xFF && pos + 1 < end) { // Meta event
+        const uint8_t type = data[pos++];
+        const uint32_t length = read_variable_length(data, pos);
+        if (type == 0x51 && length == 3 && pos + 3 <= end) {
+          tempo_map[tick] = read_be(data, pos, 3);
+        }
+        pos += length;
+      } else if (status == 0xF0 || status == 0xF7) {
+        const uint32_t length = read_variable_length(data, pos);
+        if (status == 0xF0 && pos + length <= end) {
+          std::vector<uint8_t> bytes{0xF0};
+          bytes.insert(bytes.end(), data.begin() + pos,
+                       data.begin() + pos + length);
+          by_tick.emplace(tick, std::move(bytes));
+        }
+        pos += length;
+      } else if (status >= 0x80 && status < 0xF0) {
+        running_status = status;
+        const size_t length =
+            ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+        if (pos + length > end) {
+          break;
+        }
+        std::vector<uint8_t> bytes{status};
+        bytes.insert(bytes.end(), data.begin() + pos,
+                     data.begin() + pos + length);
+        by_tick.emplace(tick, std::move(bytes));
+        pos += length;
+      } else {
+        break; // Corrupt track
+      }
+    }
+    pos = end;
+  }
+
+  std::vector<ReplayEvent> events;
+  auto tempo = tempo_map.begin();
+  uint64_t tempo_tick = 0;
+  uint64_t tempo_time_us = 0;
+  for (auto &[tick, bytes] : by_tick) {
+    for (auto next = std::next(tempo);
+         next != tempo_map.end() && next->first <= tick; ++next) {
+      tempo_time_us += (next->first - tempo_tick) * tempo->second / division;
+      tempo_tick = next->first;
+      tempo = next;
+    }
+    events.push_back(
+        {tempo_time_us + (tick - tempo_tick) * tempo->second / division,
+         std::move(bytes)});
+  }
+  return events;
+}
+
+} // namespace
+
+TEST_CASE("MIDI replay keeps up with a performance stream over DIN",
+          "[midi_replay]") {
+  ReplayConfig config;
+  config.transport = Transport::DIN;
+  config.stall_every_us = 50'000;
+  config.stall_us = 2'000;
+
+  const std::vector<ReplayEvent> events = performance_stream(2'000'000);
+  const ReplayReport report = ReplayRunner(config).run(events);
+
+  REQUIRE(report.input_drops == 0);
+  REQUIRE(report.sysex_drops == 0);
+  const auto notes = std::count_if(
+      events.begin(), events.end(),
+      [](const ReplayEvent &event) { return (event.bytes[0] & 0xF0) == 0x90; });
+  REQUIRE(report.queue_wait[NOTE].samples_us.size() ==
+          static_cast<size_t>(notes));
+  for (const auto &lane : report.output) {
+    REQUIRE(lane.dropped == 0);
+  }
+}
+
+TEST_CASE("MIDI replay applies a 14-bit pair once", "[midi_replay]") {
+  const uint8_t cc_status = 0xB0 | (CHANNEL - 1);
+  std::vector<ReplayEvent> events;
+  add(events, 0, {cc_status, 7, 100});
+  add(events, 0, {cc_status, 39, 1});
+  add(events, 0, {cc_status, 74, 5});
+
+  ReplayConfig config;
+  config.transport = Transport::USB;
+  const ReplayReport report = ReplayRunner(config).run(events);
+
+  REQUIRE(report.queue_wait[CONTROL].samples_us.size() == 3);
+  REQUIRE(report.controller_values == 2);
+}
+
+TEST_CASE("MIDI queue replay benchmarks", "[.][benchmark]") {
+  SECTION("Performance stream over DIN") {
+    ReplayConfig config;
+    config.stall_every_us = 50'000;
+    config.stall_us = 2'000;
+    ReplayRunner(config)
+        .run(performance_stream(10'000'000))
+        .print("Performance stream, DIN, 2 ms stall every 50 ms");
+  }
+
+  SECTION("Stress stream over USB") {
+    ReplayConfig config;
+    config.transport = Transport::USB;
+    config.stall_every_us = 100'000;
+    config.stall_us = 5'000;
+    ReplayRunner(config)
+        .run(stress_stream(5'000'000))
+        .print("Stress stream, USB, 5 ms stall every 100 ms");
+  }
+
+  SECTION("Recorded MIDI file") {
+    const char *path = std::getenv("MIDI_REPLAY_FILE");
+    if (path == nullptr) {
+      WARN("Set MIDI_REPLAY_FILE to replay a Standard MIDI File");
+      return;
+    }
+    const auto events = load_standard_midi_file(path);
+    REQUIRE(events.has_value());
+    for (const Transport transport : {Transport::DIN, Transport::USB}) {
+      ReplayConfig config;
+      config.transport = transport;
+      const std::string title =
+          std::string(path) +
+          (transport == Transport::DIN ? ", DIN" : ", USB");
+      ReplayRunner(config).run(*events).print(title.c_str());
+    }
+  }
+}
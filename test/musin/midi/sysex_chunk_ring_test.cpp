@@ -0,0 +1,126 @@
+#include "musin/midi/sysex_chunk_ring.h"
+
+#include "test_support.h"
+
+#include <cstdint>
+#include <vector>
+
+using musin::midi::SysexChunkRing;
+
+namespace {
+
+using Ring = SysexChunkRing<8192>;
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = static_cast<uint8_t>((seed + i * 7) & 0x7F);
+  }
+  return bytes;
+}
+
+bool push(Ring &ring, const std::vector<uint8_t> &bytes) {
+  return ring.push(bytes.data(), bytes.size());
+}
+
+std::vector<uint8_t> take(Ring &ring) {
+  const sysex::Chunk *chunk = ring.peek();
+  REQUIRE(chunk != nullptr);
+  std::vector<uint8_t> bytes(chunk->begin(), chunk->end());
+  ring.pop();
+  return bytes;
+}
+
+} // namespace
+
+TEST_CASE("SysexChunkRing hands out payloads in order, in place") {
+  Ring ring;
+  REQUIRE(ring.peek() == nullptr);
+
+  const auto first = pattern(5, 1);
+  const auto second = pattern(130, 2);
+  REQUIRE(push(ring, first));
+  REQUIRE(push(ring, second));
+
+  const sysex::Chunk *chunk = ring.peek();
+  REQUIRE(chunk != nullptr);
+  REQUIRE(ring.peek()->begin() == chunk->begin());
+  REQUIRE(take(ring) == first);
+  REQUIRE(take(ring) == second);
+  REQUIRE(ring.peek() == nullptr);
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("SysexChunkRing queues a burst of short payloads") {
+  Ring ring;
+
+  // SDS data packets are 124 bytes of payload; fixed 2 KB slots held two
+  std::vector<std::vector<uint8_t>> sent;
+  for (uint8_t i = 0; i < 60; ++i) {
+    sent.push_back(pattern(124, i));
+    REQUIRE(push(ring, sent.back()));
+  }
+  REQUIRE(ring.stats().peak_bytes == 60 * 126);
+
+  for (const auto &bytes : sent) {
+    REQUIRE(take(ring) == bytes);
+  }
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("SysexChunkRing never splits a payload at the end of the ring") {
+  Ring ring;
+  std::vector<uint8_t> received;
+  std::vector<uint8_t> sent;
+
+  // Odd sizes walk the write position past the end of the ring many times,
+  // leaving both short and header-sized gaps before it
+  for (size_t i = 0; i < 400; ++i) {
+    const auto bytes = pattern(1 + i * 37 % sysex::MAX_PAYLOAD_SIZE,
+                               static_cast<uint8_t>(i));
+    REQUIRE(push(ring, bytes));
+    sent.insert(sent.end(), bytes.begin(), bytes.end());
+    if (i % 2 == 1) {
+      for (const auto &taken : {take(ring), take(ring)}) {
+        received.insert(received.end(), taken.begin(), taken.end());
+      }
+    }
+  }
+  REQUIRE(received == sent);
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("SysexChunkRing drops a payload that does not fit") {
+  Ring ring;
+  const auto largest = pattern(sysex::MAX_PAYLOAD_SIZE, 3);
+
+  SECTION("An empty ring always takes the largest payload") {
+    for (size_t i = 0; i < 10; ++i) {
+      REQUIRE(push(ring, largest));
+      REQUIRE(take(ring) == largest);
+    }
+    REQUIRE(ring.stats().dropped == 0);
+  }
+
+  SECTION("A full ring refuses, and takes payloads again once drained") {
+    size_t pushed = 0;
+    while (push(ring, largest)) {
+      ++pushed;
+    }
+    REQUIRE(pushed == 4);
+    REQUIRE(ring.stats().dropped == 1);
+
+    take(ring);
+    REQUIRE(push(ring, largest));
+    for (size_t i = 0; i < pushed; ++i) {
+      REQUIRE(take(ring) == largest);
+    }
+    REQUIRE(ring.empty());
+  }
+
+  SECTION("Longer payloads are truncated") {
+    const auto longer = pattern(sysex::MAX_PAYLOAD_SIZE + 10, 4);
+    REQUIRE(push(ring, longer));
+    REQUIRE(ring.peek()->size() == sysex::MAX_PAYLOAD_SIZE);
+  }
+}
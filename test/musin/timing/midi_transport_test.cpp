@@ -0,0 +1,239 @@
+#include "midi_test_support.h"
+#include "musin/timing/clock_router.h"
+#include "musin/timing/internal_clock.h"
+#include "musin/timing/midi_clock_processor.h"
+#include "musin/timing/speed_adapter.h"
+#include "musin/timing/sync_in.h"
+#include "musin/timing/tempo_handler.h"
+#include "pico/time.h"
+#include "test_support.h"
+
+#include <etl/observer.h>
+#include <vector>
+
+using musin::timing::ClockEvent;
+using musin::timing::ClockRouter;
+using musin::timing::ClockSource;
+using musin::timing::InternalClock;
+using musin::timing::MidiClockProcessor;
+using musin::timing::SpeedAdapter;
+using musin::timing::SpeedModifier;
+using musin::timing::SyncIn;
+using musin::timing::TempoEvent;
+using musin::timing::TempoHandler;
+using musin::timing::TransportCommand;
+
+namespace {
+struct ClockEventRecorder : etl::observer<ClockEvent> {
+  std::vector<ClockEvent> events;
+  void notification(ClockEvent e) {
+    events.push_back(e);
+  }
+};
+
+struct TempoEventRecorder : etl::observer<TempoEvent> {
+  std::vector<TempoEvent> events;
+  void notification(TempoEvent e) {
+    events.push_back(e);
+  }
+};
+
+struct TransportRecorder : musin::timing::ITransportListener {
+  std::vector<TransportCommand> commands;
+  void on_transport_command(TransportCommand command) override {
+    commands.push_back(command);
+  }
+};
+
+// 120 BPM at 24 PPQN
+constexpr uint64_t TICK_US = 20833;
+
+void send_ticks(MidiClockProcessor &proc, int count) {
+  for (int i = 0; i < count; ++i) {
+    advance_mock_time_us(TICK_US);
+    proc.on_midi_clock_tick_received();
+  }
+}
+
+size_t count_resyncs(const std::vector<ClockEvent> &events) {
+  size_t count = 0;
+  for (const auto &e : events) {
+    count += e.is_resync ? 1 : 0;
+  }
+  return count;
+}
+} // namespace
+
+TEST_CASE("MIDI Start relocates the first tick to the song start") {
+  reset_test_state();
+  MidiClockProcessor proc;
+  ClockEventRecorder rec;
+  TransportRecorder transport;
+  proc.add_observer(rec);
+  proc.set_transport_listener(&transport);
+
+  proc.on_song_position(8);
+  proc.on_midi_start();
+  REQUIRE(transport.commands.size() == 1);
+  REQUIRE(transport.commands[0] == TransportCommand::START);
+  REQUIRE(rec.events.empty()); // The position follows with the next tick
+
+  send_ticks(proc, 1);
+  REQUIRE(rec.events.size() == 2);
+  REQUIRE(rec.events[0].is_resync);
+  REQUIRE(rec.events[0].song_position == 0u);
+  REQUIRE_FALSE(rec.events[1].is_resync);
+
+  send_ticks(proc, 5);
+  REQUIRE(count_resyncs(rec.events) == 1);
+  REQUIRE(proc.get_song_position() == 6);
+}
+
+TEST_CASE("MIDI SPP and Continue resume from the song position") {
+  reset_test_state();
+  MidiClockProcessor proc;
+  ClockEventRecorder rec;
+  TransportRecorder transport;
+  proc.add_observer(rec);
+  proc.set_transport_listener(&transport);
+
+  proc.on_midi_start();
+  send_ticks(proc, 30);
+  proc.on_midi_stop();
+  REQUIRE(transport.commands.back() == TransportCommand::STOP);
+  REQUIRE_FALSE(proc.is_transport_running());
+
+  // Clock keeps running while stopped; the position does not move
+  send_ticks(proc, 12);
+  REQUIRE(proc.get_song_position() == 30);
+
+  // Host relocates to bar 2, beat 1 (16 sixteenths) and continues
+  proc.on_song_position(16);
+  proc.on_midi_continue();
+  REQUIRE(transport.commands.back() == TransportCommand::CONTINUE);
+
+  rec.events.clear();
+  send_ticks(proc, 1);
+  REQUIRE(rec.events.size() == 2);
+  REQUIRE(rec.events[0].is_resync);
+  REQUIRE(rec.events[0].song_position == 96u);
+  REQUIRE(proc.get_song_position() == 97);
+}
+
+TEST_CASE("MIDI SPP while running relocates at the next tick") {
+  reset_test_state();
+  MidiClockProcessor proc;
+  ClockEventRecorder rec;
+  proc.add_observer(rec);
+
+  proc.on_midi_start();
+  send_ticks(proc, 10);
+  proc.on_song_position(4);
+  rec.events.clear();
+  send_ticks(proc, 1);
+  REQUIRE(rec.events[0].is_resync);
+  REQUIRE(rec.events[0].song_position == 24u);
+}
+
+TEST_CASE("Paused transport-aware host is not resynced by the timeout") {
+  reset_test_state();
+  MidiClockProcessor proc;
+  ClockEventRecorder rec;
+  proc.add_observer(rec);
+
+  proc.on_midi_start();
+  send_ticks(proc, 18);
+  proc.on_midi_stop();
+
+  // Host pauses with the clock stopped for two seconds, then continues
+  advance_mock_time_us(2000000);
+  proc.on_midi_continue();
+  rec.events.clear();
+  send_ticks(proc, 24);
+
+  REQUIRE(count_resyncs(rec.events) == 1);
+  REQUIRE(rec.events[0].song_position == 18u);
+  REQUIRE(proc.get_song_position() == 42);
+}
+
+TEST_CASE("Bare MIDI clock still resyncs after a timeout") {
+  reset_test_state();
+  MidiClockProcessor proc;
+  ClockEventRecorder rec;
+  proc.add_observer(rec);
+
+  send_ticks(proc, 6);
+  advance_mock_time_us(1000000);
+  send_ticks(proc, 1);
+
+  REQUIRE(count_resyncs(rec.events) == 2);
+  REQUIRE_FALSE(rec.events.back().song_position.has_value());
+  REQUIRE(rec.events[rec.events.size() - 2].is_resync);
+  REQUIRE_FALSE(rec.events[rec.events.size() - 2].song_position.has_value());
+}
+
+TEST_CASE("Switching to MIDI while the transport runs relocates") {
+  reset_test_state();
+  InternalClock internal_clock(120.0f);
+  MidiClockProcessor proc;
+  SyncIn sync_in(0, 1);
+  ClockRouter router(internal_clock, proc, sync_in, ClockSource::INTERNAL);
+  ClockEventRecorder rec;
+  router.add_observer(rec);
+
+  // Start and the first ticks arrive before the router follows MIDI
+  proc.on_midi_start();
+  send_ticks(proc, 3);
+  router.set_clock_source(ClockSource::MIDI);
+  rec.events.clear();
+
+  send_ticks(proc, 1);
+  REQUIRE(rec.events.size() == 2);
+  REQUIRE(rec.events[0].is_resync);
+  REQUIRE(rec.events[0].song_position == 3u);
+}
+
+TEST_CASE("Song position reaches the tempo phase through the speed adapter") {
+  reset_test_state();
+  InternalClock internal_clock(120.0f);
+  MidiClockProcessor proc;
+  SyncIn sync_in(0, 1);
+  ClockRouter router(internal_clock, proc, sync_in, ClockSource::MIDI);
+  SpeedAdapter speed_adapter;
+  router.add_observer(speed_adapter);
+  TempoHandler tempo(router, speed_adapter,
+                     /*send_midi_clock_when_stopped*/ false, ClockSource::MIDI);
+  TempoEventRecorder rec;
+  tempo.add_observer(rec);
+
+  SECTION("Normal speed") {
+    // Three sixteenths in: 18 raw ticks, 9 ticks at 12 PPQN
+    proc.on_song_position(3);
+    proc.on_midi_continue();
+    send_ticks(proc, 1);
+    REQUIRE(rec.events.size() == 1);
+    REQUIRE(rec.events[0].is_resync);
+    REQUIRE(rec.events[0].song_position == 9u);
+    REQUIRE(rec.events[0].phase_12 == 9);
+
+    // Later ticks stay on the song grid
+    send_ticks(proc, 2);
+    REQUIRE(rec.events.back().phase_12 == 10);
+  }
+
+  SECTION("Double speed") {
+    tempo.set_speed_modifier(SpeedModifier::DOUBLE_SPEED);
+    proc.on_song_position(3);
+    proc.on_midi_continue();
+    send_ticks(proc, 1);
+    REQUIRE(rec.events[0].song_position == 18u);
+    REQUIRE(rec.events[0].phase_12 == 6);
+  }
+
+  SECTION("Start") {
+    proc.on_midi_start();
+    send_ticks(proc, 1);
+    REQUIRE(rec.events[0].song_position == 0u);
+    REQUIRE(rec.events[0].phase_12 == 0);
+  }
+}
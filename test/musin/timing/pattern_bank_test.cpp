@@ -0,0 +1,193 @@
+#include "musin/timing/pattern_bank.h"
+#include "musin/timing/step_sequencer.h"
+
+#include "test_support.h"
+
+#include <array>
+
+using musin::timing::PatternBank;
+using musin::timing::Sequencer;
+using musin::timing::Track;
+
+namespace {
+constexpr uint32_t STEPS_PER_BAR = 8;
+using Bank = PatternBank<4, 2, 64, 4>;
+} // namespace
+
+TEST_CASE("Track length is clamped and non-destructive") {
+  Track<64> track;
+  REQUIRE(track.size() == 64);
+
+  track.set_length(0);
+  REQUIRE(track.size() == 1);
+  track.set_length(100);
+  REQUIRE(track.size() == 64);
+
+  track.set_step_enabled(40, true);
+  track.set_step_velocity(40, 90);
+  track.set_length(16);
+  track.set_length(48);
+  REQUIRE(track.get_step(40).is_enabled());
+  REQUIRE(track.get_step_velocity(40) == 90);
+}
+
+TEST_CASE("Sequencer cycle length is the LCM of its track lengths") {
+  Sequencer<3, 64> pattern;
+  pattern.get_track(0).set_length(16);
+  pattern.get_track(1).set_length(12);
+  pattern.get_track(2).set_length(5);
+
+  REQUIRE(pattern.get_num_steps() == 16);
+  REQUIRE(pattern.get_cycle_length() == 240);
+}
+
+TEST_CASE("PatternBank queued switch waits for the bar line") {
+  Bank bank;
+  REQUIRE(bank.queue(2));
+  REQUIRE(bank.queued_index() == 2);
+
+  for (uint32_t step = 0; step < STEPS_PER_BAR; ++step) {
+    REQUIRE_FALSE(bank.on_step_boundary(step, STEPS_PER_BAR));
+    REQUIRE(bank.active_index() == 0);
+  }
+  REQUIRE(bank.on_step_boundary(STEPS_PER_BAR, STEPS_PER_BAR));
+  REQUIRE(bank.active_index() == 2);
+  REQUIRE_FALSE(bank.queued_index().has_value());
+}
+
+TEST_CASE("PatternBank will_change_at looks ahead without switching") {
+  Bank bank;
+  REQUIRE_FALSE(bank.will_change_at(STEPS_PER_BAR, STEPS_PER_BAR));
+
+  REQUIRE(bank.queue(3));
+  REQUIRE_FALSE(bank.will_change_at(0, STEPS_PER_BAR));
+  REQUIRE_FALSE(bank.will_change_at(STEPS_PER_BAR - 1, STEPS_PER_BAR));
+  REQUIRE(bank.will_change_at(STEPS_PER_BAR, STEPS_PER_BAR));
+  REQUIRE(bank.active_index() == 0);
+  REQUIRE(bank.queued_index() == 3);
+}
+
+TEST_CASE("PatternBank queuing the active pattern cancels a switch") {
+  Bank bank;
+  REQUIRE(bank.queue(1));
+  REQUIRE(bank.queue(0));
+  REQUIRE_FALSE(bank.queued_index().has_value());
+  REQUIRE_FALSE(bank.on_step_boundary(STEPS_PER_BAR, STEPS_PER_BAR));
+  REQUIRE(bank.active_index() == 0);
+}
+
+TEST_CASE("PatternBank rejects out-of-range indices") {
+  Bank bank;
+  REQUIRE_FALSE(bank.select(4));
+  REQUIRE_FALSE(bank.queue(4));
+  REQUIRE_FALSE(bank.copy_pattern(0, 4));
+
+  const std::array<uint8_t, 6> chain{1, 7, 2, 3, 0, 1};
+  bank.set_chain(chain);
+  // Index 7 is dropped, the rest truncated to the chain capacity.
+  REQUIRE(bank.get_chain().size() == 4);
+  REQUIRE(bank.get_chain()[1] == 2);
+}
+
+TEST_CASE("PatternBank song mode walks the chain as patterns play through") {
+  Bank bank;
+  bank.get_pattern(1).get_track(0).set_length(16);
+  bank.get_pattern(1).get_track(1).set_length(16);
+  bank.get_pattern(3).get_track(0).set_length(8);
+  bank.get_pattern(3).get_track(1).set_length(8);
+
+  const std::array<uint8_t, 2> chain{1, 3};
+  bank.set_chain(chain);
+  bank.set_song_mode(true);
+  REQUIRE(bank.queued_index() == 1);
+  REQUIRE(bank.select(1));
+
+  // Pattern 1 is two bars long.
+  REQUIRE_FALSE(bank.on_step_boundary(8, STEPS_PER_BAR));
+  REQUIRE(bank.on_step_boundary(16, STEPS_PER_BAR));
+  REQUIRE(bank.active_index() == 3);
+
+  REQUIRE(bank.on_step_boundary(8, STEPS_PER_BAR));
+  REQUIRE(bank.active_index() == 1);
+}
+
+TEST_CASE("PatternBank song mode plays a whole polymetric cycle") {
+  Bank bank;
+  const std::array<uint8_t, 2> chain{1, 2};
+  bank.set_chain(chain);
+  bank.set_song_mode(true);
+  REQUIRE(bank.select(1));
+
+  SECTION("Uneven tracks play until they realign") {
+    // 8 against 6 steps realign after 24 steps, three bars
+    bank.get_pattern(1).get_track(0).set_length(8);
+    bank.get_pattern(1).get_track(1).set_length(6);
+    REQUIRE_FALSE(bank.will_change_at(8, STEPS_PER_BAR));
+    REQUIRE_FALSE(bank.will_change_at(16, STEPS_PER_BAR));
+    REQUIRE(bank.on_step_boundary(24, STEPS_PER_BAR));
+    REQUIRE(bank.active_index() == 2);
+  }
+
+  SECTION("A cycle that ends mid-bar runs on to the bar line") {
+    // 5 against 3 steps realign after 15 steps
+    bank.get_pattern(1).get_track(0).set_length(5);
+    bank.get_pattern(1).get_track(1).set_length(3);
+    REQUIRE_FALSE(bank.will_change_at(15, STEPS_PER_BAR));
+    REQUIRE(bank.on_step_boundary(16, STEPS_PER_BAR));
+    REQUIRE(bank.active_index() == 2);
+  }
+}
+
+TEST_CASE("PatternBank relocation keeps queued switches on the bar line") {
+  Bank bank;
+  // 6 against 4 steps: the cycle (12) is not a whole number of bars
+  bank.active().get_track(0).set_length(6);
+  bank.active().get_track(1).set_length(4);
+
+  SECTION("A switch queued after relocating waits for the song's bar line") {
+    // Song step 20 is four steps into the third bar
+    const uint32_t relocated = bank.steps_into_pattern_at(20, STEPS_PER_BAR);
+    REQUIRE(relocated % STEPS_PER_BAR == 20 % STEPS_PER_BAR);
+    REQUIRE(relocated % bank.active().get_cycle_length() == 20 % 12);
+
+    REQUIRE(bank.queue(1));
+    uint32_t steps = relocated;
+    for (uint32_t song_step = 20; song_step < 24; ++song_step, ++steps) {
+      REQUIRE_FALSE(bank.on_step_boundary(steps, STEPS_PER_BAR));
+    }
+    REQUIRE(bank.on_step_boundary(steps, STEPS_PER_BAR));
+    REQUIRE(bank.active_index() == 1);
+  }
+
+  SECTION("Song mode relocates within the pattern's play length") {
+    const std::array<uint8_t, 2> chain{0, 1};
+    bank.set_chain(chain);
+    bank.set_song_mode(true);
+
+    // The 12-step cycle plays for two bars, so song step 20 is four steps
+    // into the pattern's second play and the chain moves on at step 32.
+    const uint32_t relocated = bank.steps_into_pattern_at(20, STEPS_PER_BAR);
+    REQUIRE(relocated == 4);
+    REQUIRE_FALSE(bank.will_change_at(relocated + 11, STEPS_PER_BAR));
+    REQUIRE(bank.will_change_at(relocated + 12, STEPS_PER_BAR));
+  }
+}
+
+TEST_CASE("PatternBank song mode requires a chain") {
+  Bank bank;
+  bank.set_song_mode(true);
+  REQUIRE_FALSE(bank.is_song_mode());
+}
+
+TEST_CASE("PatternBank copy_pattern duplicates steps and lengths") {
+  Bank bank;
+  auto &source = bank.get_pattern(0).get_track(1);
+  source.set_length(24);
+  source.set_step_enabled(20, true);
+  source.set_step_velocity(20, 64);
+
+  REQUIRE(bank.copy_pattern(0, 3));
+  const auto &copy = bank.get_pattern(3).get_track(1);
+  REQUIRE(copy.size() == 24);
+  REQUIRE(copy.get_step(20) == source.get_step(20));
+}
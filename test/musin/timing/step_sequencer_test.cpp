@@ -0,0 +1,248 @@
+#include "musin/timing/step_sequencer.h"
+
+#include "test_support.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <array>
+#include <bit>
+#include <optional>
+
+using musin::timing::ParamLocks;
+using musin::timing::Sequencer;
+using musin::timing::Step;
+using musin::timing::Track;
+
+TEST_CASE("Track enabled mask follows step edits") {
+  Track<64> track;
+  REQUIRE(track.enabled_mask() == 0);
+
+  track.set_step_enabled(0, true);
+  track.set_step_enabled(63, true);
+  REQUIRE(track.toggle_step_enabled(5));
+  REQUIRE(track.enabled_mask() == ((1ull << 63) | (1ull << 5) | 1ull));
+  REQUIRE(track.count_enabled() == 3);
+
+  REQUIRE_FALSE(track.toggle_step_enabled(5));
+  REQUIRE_FALSE(track.is_step_enabled(5));
+  REQUIRE_FALSE(track.get_step(5).is_enabled());
+
+  track.clear_steps();
+  REQUIRE(track.enabled_mask() == 0);
+  REQUIRE_FALSE(track.get_step(0).is_enabled());
+}
+
+TEST_CASE("Track enabled mask is limited to the playing length") {
+  Track<64> track;
+  track.set_step_enabled(3, true);
+  track.set_step_enabled(20, true);
+
+  track.set_length(16);
+  REQUIRE(track.enabled_mask() == (1ull << 3));
+  REQUIRE(track.is_step_enabled(20));
+
+  track.set_length(64);
+  REQUIRE(track.enabled_mask() == ((1ull << 20) | (1ull << 3)));
+}
+
+TEST_CASE("Track set_steps rebuilds the enabled mask") {
+  std::array<Step, 3> steps{};
+  steps[0].velocity = 100;
+  steps[0].set_enabled(true);
+  steps[2].velocity = 50;
+  steps[2].set_enabled(true);
+
+  Track<16> track;
+  track.set_step_enabled(10, true);
+  track.set_steps(steps);
+
+  REQUIRE(track.enabled_mask() == 0b101);
+  REQUIRE(track.get_step(2).velocity == 50);
+  REQUIRE_FALSE(track.is_step_enabled(10));
+}
+
+TEST_CASE("ParamLocks start unset and clamp values") {
+  ParamLocks locks;
+  REQUIRE(locks.empty());
+  REQUIRE_FALSE(locks.get(ParamLocks::PITCH).has_value());
+
+  locks.set(ParamLocks::DECAY, 200);
+  REQUIRE(locks.get(ParamLocks::DECAY) == ParamLocks::MAX_VALUE);
+  REQUIRE(locks.get_normalized(ParamLocks::DECAY) == 1.0f);
+  REQUIRE_FALSE(locks.empty());
+
+  locks.clear(ParamLocks::DECAY);
+  REQUIRE(locks.empty());
+}
+
+TEST_CASE("Track stores parameter locks per step") {
+  Track<16, 2> track;
+  track.set_step_enabled(3, true);
+  REQUIRE(track.get_step_locks(3).empty());
+
+  REQUIRE(track.set_step_lock(3, ParamLocks::PITCH, 10));
+  REQUIRE(track.set_step_lock(3, ParamLocks::GAIN, 90));
+  REQUIRE(track.get_step(3).has_locks());
+  REQUIRE(track.get_locked_steps().size() == 1);
+
+  const ParamLocks locks = track.get_step_locks(3);
+  REQUIRE(locks.get(ParamLocks::PITCH) == 10);
+  REQUIRE(locks.get(ParamLocks::GAIN) == 90);
+  REQUIRE_FALSE(locks.get(ParamLocks::DECAY).has_value());
+
+  SECTION("Replacing with empty locks clears them") {
+    REQUIRE(track.set_step_locks(3, ParamLocks{}));
+    REQUIRE_FALSE(track.get_step(3).has_locks());
+    REQUIRE(track.get_locked_steps().empty());
+  }
+
+  SECTION("A full pool rejects new steps but updates existing ones") {
+    REQUIRE(track.set_step_lock(5, ParamLocks::DECAY, 1));
+    REQUIRE_FALSE(track.set_step_lock(7, ParamLocks::DECAY, 1));
+    REQUIRE_FALSE(track.get_step(7).has_locks());
+    REQUIRE(track.set_step_lock(5, ParamLocks::DECAY, 2));
+    REQUIRE(track.get_step_locks(5).get(ParamLocks::DECAY) == 2);
+  }
+
+  SECTION("Disabling a step drops its locks") {
+    track.set_step_enabled(3, false);
+    REQUIRE(track.get_step_locks(3).empty());
+    REQUIRE(track.get_locked_steps().empty());
+  }
+
+  SECTION("Loading steps clears locks and stale lock flags") {
+    std::array<Step, 4> steps{};
+    steps[3].set_enabled(true);
+    steps[3].set_locked(true);
+    track.set_steps(steps);
+    REQUIRE_FALSE(track.get_step(3).has_locks());
+    REQUIRE(track.get_locked_steps().empty());
+  }
+}
+
+namespace {
+
+// Pre-bit-plane step layout, kept as the benchmark baseline.
+struct LegacyStep {
+  std::optional<uint8_t> note;
+  std::optional<uint8_t> velocity;
+  bool enabled = false;
+};
+
+constexpr size_t BENCH_TRACKS = 4;
+constexpr size_t BENCH_STEPS = 64;
+
+// The last track has no note and some steps have no velocity, so both
+// layouts have steps that are enabled but must not sound.
+struct BenchPatterns {
+  Sequencer<BENCH_TRACKS, BENCH_STEPS> packed;
+  std::array<std::array<LegacyStep, BENCH_STEPS>, BENCH_TRACKS> legacy{};
+
+  BenchPatterns() {
+    for (size_t t = 0; t < BENCH_TRACKS; ++t) {
+      auto &track = packed.get_track(t);
+      track.set_length(BENCH_STEPS);
+      const std::optional<uint8_t> note =
+          t + 1 < BENCH_TRACKS ? std::optional<uint8_t>(36 + t)
+                               : std::nullopt;
+      if (note.has_value()) {
+        track.set_note(*note);
+      }
+      for (size_t s = 0; s < BENCH_STEPS; ++s) {
+        const bool enabled = ((s * 7 + t * 3) % 5) < 2;
+        const auto velocity = static_cast<uint8_t>(s % 9 == 0 ? 0 : 40 + s);
+        track.set_step_velocity(s, velocity);
+        track.set_step_enabled(s, enabled);
+        legacy[t][s] = {note, velocity, enabled};
+      }
+    }
+  }
+};
+
+// Draw: accumulate the brightness of every lit step, as the display does.
+uint32_t draw_legacy(const BenchPatterns &patterns) {
+  uint32_t lit = 0;
+  for (const auto &track : patterns.legacy) {
+    for (const auto &step : track) {
+      if (step.enabled && step.note.has_value() && step.velocity.has_value()) {
+        lit += step.velocity.value();
+      }
+    }
+  }
+  return lit;
+}
+
+uint32_t draw_bit_plane(const BenchPatterns &patterns) {
+  uint32_t lit = 0;
+  for (size_t t = 0; t < BENCH_TRACKS; ++t) {
+    const auto &track = patterns.packed.get_track(t);
+    if (!track.get_note().has_value()) {
+      continue;
+    }
+    uint64_t enabled = track.enabled_mask();
+    while (enabled != 0) {
+      lit += track.get_step(static_cast<size_t>(std::countr_zero(enabled)))
+                 .velocity;
+      enabled &= enabled - 1;
+    }
+  }
+  return lit;
+}
+
+// Step resolution: decide which tracks fire on each step of a cycle.
+uint32_t resolve_legacy(const BenchPatterns &patterns) {
+  uint32_t fired = 0;
+  for (size_t s = 0; s < BENCH_STEPS; ++s) {
+    for (const auto &track : patterns.legacy) {
+      const LegacyStep &step = track[s];
+      fired += (step.enabled && step.note.has_value() &&
+                step.velocity.value_or(0) > 0)
+                   ? 1u
+                   : 0u;
+    }
+  }
+  return fired;
+}
+
+uint32_t resolve_bit_plane(const BenchPatterns &patterns) {
+  uint32_t fired = 0;
+  for (size_t s = 0; s < BENCH_STEPS; ++s) {
+    for (size_t t = 0; t < BENCH_TRACKS; ++t) {
+      const auto &track = patterns.packed.get_track(t);
+      fired += (track.is_step_enabled(s) && track.get_note().has_value() &&
+                track.get_step(s).velocity > 0)
+                   ? 1u
+                   : 0u;
+    }
+  }
+  return fired;
+}
+
+} // namespace
+
+TEST_CASE("Bit-plane step walks match the legacy step fields") {
+  const BenchPatterns patterns;
+  REQUIRE(draw_bit_plane(patterns) == draw_legacy(patterns));
+  REQUIRE(resolve_bit_plane(patterns) == resolve_legacy(patterns));
+  REQUIRE(resolve_legacy(patterns) > 0);
+}
+
+TEST_CASE("Step representation benchmarks", "[.][benchmark]") {
+  const BenchPatterns patterns;
+
+  BENCHMARK("draw: walk legacy steps") {
+    return draw_legacy(patterns);
+  };
+
+  BENCHMARK("draw: walk enabled bit-plane") {
+    return draw_bit_plane(patterns);
+  };
+
+  BENCHMARK("resolve: legacy step fields") {
+    return resolve_legacy(patterns);
+  };
+
+  BENCHMARK("resolve: enabled bit-plane") {
+    return resolve_bit_plane(patterns);
+  };
+}
@@ -78,7 +78,7 @@ TEST_CASE("TempoHandler internal clock emits tempo events and MIDI clock") {
 
   // Flush MIDI queue to collect all realtime clocks
   musin::NullLogger logger;
-  while (!musin::midi::midi_output_queue.empty()) {
+  while (!musin::midi::midi_output_queue_empty()) {
     musin::midi::process_midi_output_queue(logger);
   }
 
@@ -476,7 +476,7 @@ TEST_CASE("TempoHandler playback state affects MIDI clock transmission") {
   // Flush MIDI queue so realtime clock is recorded by mock
   {
     musin::NullLogger logger;
-    while (!musin::midi::midi_output_queue.empty()) {
+    while (!musin::midi::midi_output_queue_empty()) {
       musin::midi::process_midi_output_queue(logger);
     }
   }
@@ -534,7 +534,7 @@ TEST_CASE("MidiClockOut uses direct send bypassing queue") {
   REQUIRE(rt_count >= 3);
 
   // Queue should remain empty since we bypassed it
-  REQUIRE(musin::midi::midi_output_queue.empty());
+  REQUIRE(musin::midi::midi_output_queue_empty());
 }
 
 TEST_CASE("MidiClockOut direct send works for EXTERNAL_SYNC source") {
@@ -572,5 +572,5 @@ TEST_CASE("MidiClockOut direct send works for EXTERNAL_SYNC source") {
   }
 
   REQUIRE(rt_count >= 3);
-  REQUIRE(musin::midi::midi_output_queue.empty());
+  REQUIRE(musin::midi::midi_output_queue_empty());
 }
@@ -0,0 +1,131 @@
+#include "musin/usb/midi_tx_ring.h"
+
+#include "test_support.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+using musin::usb::MidiTxRing;
+
+namespace {
+
+// Stands in for the TinyUSB MIDI endpoint: a TX FIFO with a fixed amount
+// of free space, recording each write as one transfer.
+struct FakeMidiEndpoint {
+  bool is_mounted = true;
+  size_t free_bytes = 64;
+  std::vector<std::vector<uint8_t>> transfers;
+
+  bool mounted() const {
+    return is_mounted;
+  }
+
+  size_t write(const uint8_t *data, size_t length) {
+    const size_t taken = std::min(length, free_bytes) / 4 * 4;
+    if (taken > 0) {
+      transfers.emplace_back(data, data + taken);
+      free_bytes -= taken;
+    }
+    return taken;
+  }
+
+  std::vector<uint8_t> sent_bytes() const {
+    std::vector<uint8_t> bytes;
+    for (const auto &transfer : transfers) {
+      bytes.insert(bytes.end(), transfer.begin(), transfer.end());
+    }
+    return bytes;
+  }
+};
+
+std::array<uint8_t, 4> note_on_packet(uint8_t note) {
+  return {0x09, 0x90, note, 100};
+}
+
+} // namespace
+
+TEST_CASE("MidiTxRing batches queued packets into one write") {
+  FakeMidiEndpoint endpoint;
+  MidiTxRing<FakeMidiEndpoint, 8> ring(endpoint);
+
+  for (uint8_t note = 36; note < 40; ++note) {
+    REQUIRE(ring.try_push(note_on_packet(note).data()));
+  }
+  REQUIRE(endpoint.transfers.empty()); // Nothing goes out until flush
+
+  REQUIRE(ring.flush() == 4);
+  REQUIRE(endpoint.transfers.size() == 1);
+  REQUIRE(endpoint.transfers[0].size() == 16);
+  REQUIRE(endpoint.transfers[0][2] == 36);
+  REQUIRE(endpoint.transfers[0][14] == 39);
+  REQUIRE(ring.size() == 0);
+  REQUIRE(ring.stats().packets_sent == 4);
+  REQUIRE(ring.stats().peak_depth == 4);
+}
+
+TEST_CASE("MidiTxRing reports back-pressure instead of blocking") {
+  FakeMidiEndpoint endpoint;
+  endpoint.free_bytes = 8;
+  MidiTxRing<FakeMidiEndpoint, 4> ring(endpoint);
+
+  for (uint8_t note = 0; note < 4; ++note) {
+    REQUIRE(ring.try_push(note_on_packet(note).data()));
+  }
+  REQUIRE_FALSE(ring.has_room(1));
+  REQUIRE_FALSE(ring.try_push(note_on_packet(4).data()));
+  REQUIRE(ring.stats().deferred == 1);
+
+  // The endpoint only has room for two packets; the rest stay queued
+  REQUIRE(ring.flush() == 2);
+  REQUIRE(ring.size() == 2);
+  REQUIRE(ring.try_push(note_on_packet(4).data()));
+
+  endpoint.free_bytes = 64;
+  REQUIRE(ring.flush() == 3);
+
+  // Order survives the partial flush and the wrap around the buffer
+  const std::vector<uint8_t> bytes = endpoint.sent_bytes();
+  REQUIRE(bytes.size() == 20);
+  for (uint8_t note = 0; note < 5; ++note) {
+    REQUIRE(bytes[note * 4 + 2] == note);
+  }
+  REQUIRE(ring.stats().dropped == 0);
+}
+
+TEST_CASE("MidiTxRing flushes a wrapped ring in two writes") {
+  FakeMidiEndpoint endpoint;
+  MidiTxRing<FakeMidiEndpoint, 4> ring(endpoint);
+
+  for (uint8_t note = 0; note < 3; ++note) {
+    REQUIRE(ring.try_push(note_on_packet(note).data()));
+  }
+  ring.flush();
+  endpoint.transfers.clear();
+
+  for (uint8_t note = 3; note < 7; ++note) {
+    REQUIRE(ring.try_push(note_on_packet(note).data()));
+  }
+  REQUIRE(ring.flush() == 4);
+  REQUIRE(endpoint.transfers.size() == 2);
+  REQUIRE(endpoint.transfers[0].size() == 4);
+  REQUIRE(endpoint.transfers[1].size() == 12);
+}
+
+TEST_CASE("MidiTxRing discards packets with no host") {
+  FakeMidiEndpoint endpoint;
+  MidiTxRing<FakeMidiEndpoint, 4> ring(endpoint);
+
+  REQUIRE(ring.try_push(note_on_packet(1).data()));
+  endpoint.is_mounted = false;
+
+  // Queued packets and new ones are dropped rather than backing up
+  REQUIRE(ring.try_push(note_on_packet(2).data()));
+  REQUIRE(ring.flush() == 0);
+  REQUIRE(ring.size() == 0);
+  REQUIRE(ring.stats().dropped == 2);
+  REQUIRE(endpoint.transfers.empty());
+
+  ring.reset_stats();
+  REQUIRE(ring.stats().dropped == 0);
+}
@@ -10,6 +10,12 @@ export enum Command {
   Ack = 0x13,
   Nack = 0x14,
   FormatFilesystem = 0x15,
+  SequencedFileBytes = 0x16,
+  WindowAck = 0x17,
+  WindowNack = 0x18,
+  StatFile = 0x19,
+  FileStat = 0x1A,
+  ResumeFileWrite = 0x1B,
   RequestSequencerState = 0x30,
   SequencerStateResponse = 0x31,
   SetSequencerState = 0x32,
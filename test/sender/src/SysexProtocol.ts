@@ -1,15 +1,30 @@
+import { createHash } from 'crypto';
 import { IMidiTransport } from './IMidiTransport';
 import { Command } from './Command';
 
 const SYSEX_MANUFACTURER_ID = [0x00, 0x22, 0x01];
 const SYSEX_DEVICE_ID = 0x65;
+const SEQUENCE_MASK = 0x3FFF;
 
+type WindowReply = {
+  tag: Command;
+  sequence: number; // Next expected (WindowAck) or missing (WindowNack)
+  window: number;
+  held: number; // Bit i: chunk sequence + 1 + i already arrived
+};
+
+export type FileStat = {
+  exists: boolean;
+  size: number;
+  sha256: Buffer | null;
+};
 
 export class SysexProtocol {
   private transport: IMidiTransport;
   private ackQueue: { resolve: () => void; reject: (reason?: any) => void; timer: NodeJS.Timeout }[] = [];
   private replyPromise: { resolve: (data: any) => void; reject: (reason?: any) => void; timer: NodeJS.Timeout } | null = null;
   private boundMessageHandler: (message: Uint8Array) => void;
+  private windowListener: ((reply: WindowReply) => void) | null = null;
 
   constructor(transport: IMidiTransport) {
     this.transport = transport;
@@ -35,7 +50,16 @@ export class SysexProtocol {
         if (message.length < 6) return;
         const tag = message[5];
 
-        if (tag === Command.Ack) {
+        if (this.windowListener &&
+            (tag === Command.WindowAck || tag === Command.WindowNack ||
+             tag === Command.Ack || tag === Command.Nack)) {
+          this.windowListener({
+            tag,
+            sequence: ((message[6] ?? 0) << 7) | (message[7] ?? 0),
+            window: message[8] ?? 0,
+            held: (message[9] ?? 0) | ((message[10] ?? 0) << 7) | ((message[11] ?? 0) << 14),
+          });
+        } else if (tag === Command.Ack) {
           const ackResolver = this.ackQueue.shift();
           if (ackResolver) {
             clearTimeout(ackResolver.timer);
@@ -76,6 +100,18 @@ export class SysexProtocol {
             this.replyPromise.resolve({ total: total_bytes, free: free_bytes });
             this.replyPromise = null;
           }
+        } else if (tag === Command.FileStat) {
+          if (this.replyPromise) {
+            const exists = message[6] === 1;
+            let size = 0;
+            for (let i = 0; i < 5; i++) {
+              size = size * 128 + message[7 + i];
+            }
+            const sha256 = exists ? this.decode_8_to_7(message.subarray(12, 52)).subarray(0, 32) : null;
+            clearTimeout(this.replyPromise.timer);
+            this.replyPromise.resolve({ exists, size, sha256 });
+            this.replyPromise = null;
+          }
         } else if (tag === Command.SequencerStateResponse) {
           if (this.replyPromise) {
             const NUM_TRACKS = 4;
@@ -138,20 +174,172 @@ export class SysexProtocol {
     await this.waitForAck();
   }
 
-  async beginFileTransfer(fileName: string): Promise<void> {
-    const encoded = new TextEncoder().encode(fileName);
-    const encoded_with_null = new Uint8Array(encoded.length + 1);
-    encoded_with_null.set(encoded);
-    encoded_with_null[encoded.length] = 0;
+  // With `size` given, the device drops the zero padding of the last 8-to-7
+  // group instead of storing it.
+  async beginFileTransfer(fileName: string, size?: number): Promise<void> {
+    await this.sendCommandAndWait(Command.BeginFileWrite, this.packFileName(fileName, 0, undefined, size));
+  }
 
-    let bytes: number[] = [];
-    for (let i = 0; i < encoded_with_null.length; i += 2) {
-      const lower = encoded_with_null[i];
-      const upper = (i + 1 < encoded_with_null.length) ? encoded_with_null[i + 1] : 0;
-      bytes = bytes.concat(this.pack3_16((upper << 8) | lower));
+  // Sends a whole file with up to `window` chunks in flight (see "Windowed
+  // Transfers" in drum/README.md). Only chunks the device reports missing
+  // are resent.
+  //
+  // With `offset` > 0 the transfer appends to a file the device already
+  // holds `offset` bytes of (ResumeFileWrite), and only the rest is sent.
+  async sendFileWindowed(fileName: string, data: Buffer, window = 8, chunkSize = 98,
+                         timeout = 2000, offset = 0): Promise<{ resent: number }> {
+    const replies: WindowReply[] = [];
+    let wake: (() => void) | null = null;
+    this.windowListener = (reply) => {
+      replies.push(reply);
+      wake?.();
+    };
+
+    const nextReply = (): Promise<WindowReply | null> => {
+      const queued = replies.shift();
+      if (queued) {
+        return Promise.resolve(queued);
+      }
+      return new Promise((resolve) => {
+        const timer = setTimeout(() => {
+          wake = null;
+          resolve(null);
+        }, timeout);
+        wake = () => {
+          clearTimeout(timer);
+          wake = null;
+          resolve(replies.shift() ?? null);
+        };
+      });
+    };
+
+    try {
+      const size = data.length;
+      if (offset > 0) {
+        await this.sendMessage([Command.ResumeFileWrite, ...this.packFileName(fileName, window, offset, size)]);
+        data = data.subarray(offset);
+      } else {
+        await this.sendMessage([Command.BeginFileWrite, ...this.packFileName(fileName, window, undefined, size)]);
+      }
+      const begin = await nextReply();
+      if (!begin || begin.tag !== Command.WindowAck) {
+        throw new Error('Device did not accept a windowed transfer.');
+      }
+      const accepted = begin.window;
+
+      const count = Math.ceil(data.length / chunkSize);
+      const acked: boolean[] = new Array(count).fill(false);
+      let base = 0;
+      let next = 0;
+      let resent = 0;
+      let timeouts = 0;
+      let ending = false;
+
+      const sendChunk = async (index: number) => {
+        const sequence = index & SEQUENCE_MASK;
+        const chunk = data.subarray(index * chunkSize, (index + 1) * chunkSize);
+        await this.sendMessage([Command.SequencedFileBytes, sequence >> 7, sequence & 0x7F,
+                                ...this.encode_7_to_8(chunk)]);
+      };
+
+      const resendUnacked = async () => {
+        for (let i = base; i < Math.min(base + accepted, next); i++) {
+          if (!acked[i]) {
+            resent++;
+            await sendChunk(i);
+          }
+        }
+      };
+
+      const applyAck = (reply: WindowReply) => {
+        const delta = (reply.sequence - base) & SEQUENCE_MASK;
+        if (delta <= accepted) {
+          acked.fill(true, base, base + delta);
+          base += delta;
+        }
+        for (let bit = 0; bit < 21; bit++) {
+          if ((reply.held >> bit) & 1 && base + 1 + bit < count) {
+            acked[base + 1 + bit] = true;
+          }
+        }
+      };
+
+      for (;;) {
+        while (next < count && next - base < accepted) {
+          await sendChunk(next++);
+        }
+
+        if (next === count && !ending) {
+          // Everything is sent: ending doubles as a request for what is missing
+          await this.sendMessage([Command.EndFileTransfer, ...this.pack3_16(count & SEQUENCE_MASK)]);
+          ending = true;
+        }
+
+        const reply = await nextReply();
+        if (!reply) {
+          if (++timeouts > 10) {
+            throw new Error('Timeout waiting for window ACK.');
+          }
+          ending = false;
+          await resendUnacked();
+          continue;
+        }
+        timeouts = 0;
+
+        if (reply.tag === Command.Ack) {
+          return { resent };
+        } else if (reply.tag === Command.Nack) {
+          throw new Error('Received NACK from device.');
+        } else if (reply.tag === Command.WindowNack) {
+          const offset = (reply.sequence - base) & SEQUENCE_MASK;
+          if (offset < accepted && base + offset < count && !acked[base + offset]) {
+            resent++;
+            await sendChunk(base + offset);
+          }
+        } else {
+          applyAck(reply);
+          if (ending) {
+            ending = false;
+            await resendUnacked();
+          }
+        }
+      }
+    } finally {
+      this.windowListener = null;
     }
+  }
+
+  // Size and SHA-256 of a stored file. Hashing a large file takes the device
+  // a moment, hence the longer timeout.
+  async statFile(fileName: string, timeout = 10000): Promise<FileStat> {
+    await this.sendMessage([Command.StatFile, ...this.packFileName(fileName)]);
+    return new Promise((resolve, reject) => {
+      this.replyPromise = {
+        resolve: resolve,
+        reject: reject,
+        timer: setTimeout(() => {
+          this.replyPromise = null;
+          reject(new Error('Timeout waiting for file stat reply.'));
+        }, timeout)
+      };
+    });
+  }
 
-    await this.sendCommandAndWait(Command.BeginFileWrite, bytes);
+  // Brings a stored file up to date with `data`. An identical file is left
+  // alone, and one whose stored bytes are a prefix of `data` (an interrupted
+  // transfer) is resumed. Anything else is written from the start.
+  async syncFile(fileName: string, data: Buffer,
+                 window = 8): Promise<{ skipped: boolean; offset: number }> {
+    const stat = await this.statFile(fileName);
+    const prefixMatches = stat.exists && stat.size <= data.length &&
+      createHash('sha256').update(data.subarray(0, stat.size)).digest().equals(stat.sha256!);
+
+    if (prefixMatches && stat.size === data.length) {
+      return { skipped: true, offset: stat.size };
+    }
+    const offset = prefixMatches ? stat.size : 0;
+    await this.sendFileWindowed(fileName, data, window, 98, 2000, offset);
+    return { skipped: false, offset };
   }
 
   async endFileTransfer(): Promise<void> {
@@ -262,10 +450,49 @@ export class SysexProtocol {
     await this.waitForAck();
   }
 
+  // Null-terminated name, optionally followed by a window size, for
+  // ResumeFileWrite a little-endian 32-bit offset, and the whole file's size
+  // encoded the same way. Packed two bytes per 3-to-16bit value.
+  private packFileName(fileName: string, window = 0, offset?: number, size?: number): number[] {
+    const encoded = new TextEncoder().encode(fileName);
+    const body = [...encoded, 0];
+    const pushU32 = (value: number) => {
+      body.push(value & 0xFF, (value >>> 8) & 0xFF, (value >>> 16) & 0xFF, (value >>> 24) & 0xFF);
+    };
+    if (offset !== undefined || size !== undefined || window > 0) {
+      body.push(window);
+    }
+    if (offset !== undefined) {
+      pushU32(offset);
+    }
+    if (size !== undefined) {
+      pushU32(size);
+    }
+
+    let bytes: number[] = [];
+    for (let i = 0; i < body.length; i += 2) {
+      const lower = body[i];
+      const upper = (i + 1 < body.length) ? body[i + 1] : 0;
+      bytes = bytes.concat(this.pack3_16((upper << 8) | lower));
+    }
+    return bytes;
+  }
+
   private pack3_16(value: number): number[] {
     return [(value >> 14) & 0x7F, (value >> 7) & 0x7F, value & 0x7F];
   }
 
+  private decode_8_to_7(encoded: Uint8Array): Buffer {
+    const decoded: number[] = [];
+    for (let i = 0; i + 8 <= encoded.length; i += 8) {
+      const msbs = encoded[i + 7];
+      for (let j = 0; j < 7; j++) {
+        decoded.push(encoded[i + j] | (((msbs >> j) & 0x01) << 7));
+      }
+    }
+    return Buffer.from(decoded);
+  }
+
   private encode_7_to_8(buffer: Buffer): number[] {
     let encoded: number[] = [];
     for (let i = 0; i < buffer.length; i += 7) {
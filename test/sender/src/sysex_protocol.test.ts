@@ -28,7 +28,7 @@ describe('SysexProtocol', () => {
     const fileName = 'test.bin';
     const fileData = fs.readFileSync(filePath);
 
-    await protocol.beginFileTransfer(fileName);
+    await protocol.beginFileTransfer(fileName, fileData.length);
 
     const CHUNK_SIZE = 98;
     for (let i = 0; i < fileData.length; i += CHUNK_SIZE) {
@@ -37,6 +37,17 @@ describe('SysexProtocol', () => {
     }
 
     await protocol.endFileTransfer();
+
+    const stat = await protocol.statFile(fileName);
+    expect(stat.size).toBe(fileData.length);
+  });
+
+  test('should transfer a file with a sliding window', async () => {
+    const filePath = path.join(__dirname, '../test-files/test.bin');
+    const fileData = fs.readFileSync(filePath);
+
+    const { resent } = await protocol.sendFileWindowed('test_windowed.bin', fileData, 8);
+    console.log(`Windowed transfer resent ${resent} chunks.`);
   });
 
   test('should recover after a transfer is aborted mid-stream', async () => {
@@ -75,6 +86,28 @@ describe('SysexProtocol', () => {
     expect(recoverySuccessful).toBe(true);
   }, 15000); // Increase jest timeout for this long-running test
 
+  test('should skip an identical file and resume a partial one', async () => {
+    const filePath = path.join(__dirname, '../test-files/test.bin');
+    const fileData = fs.readFileSync(filePath);
+    const fileName = 'test_sync.bin';
+
+    // Leave only the first half on the device, as an interrupted transfer would
+    const half = Math.floor(fileData.length / 2);
+    await protocol.sendFileWindowed(fileName, fileData.subarray(0, half), 8);
+
+    const resumed = await protocol.syncFile(fileName, fileData);
+    expect(resumed).toEqual({ skipped: false, offset: half });
+
+    const synced = await protocol.syncFile(fileName, fileData);
+    expect(synced.skipped).toBe(true);
+
+    const stat = await protocol.statFile(fileName);
+    expect(stat.size).toBe(fileData.length);
+
+    const missing = await protocol.statFile('no_such_file.bin');
+    expect(missing.exists).toBe(false);
+  }, 30000);
+
   test('should reject a file with an invalid name', async () => {
     const invalidFileName = '../invalid.bin';
     await expect(protocol.beginFileTransfer(invalidFileName)).rejects.toThrow('Received NACK from device.');
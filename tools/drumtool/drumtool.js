@@ -13,6 +13,7 @@
  * - Filesystem formatting
  * - Bootloader reboot
  * - ACK/NAK handshaking with timeout fallback
+ * - Windowed handshaking (one ACK per half window) on firmware that offers it
  * - Checksum validation and progress monitoring
  */
 
@@ -47,6 +48,10 @@ const PACKET_TIMEOUT = 500;
 const HEADER_TIMEOUT = 2000; // 2 second timeout for dump header
 const PACKET_RETRY_WINDOW = 5000; // Give up on a packet after this long without any response
 const WAIT_RESPONSE_TIMEOUT = 30000; // Deadline for the follow-up after a WAIT
+// Packets in flight before an ACK is needed. Sent after the 17-byte dump
+// header; the device returns the window it accepts in the header's ACK, and
+// older firmware ACKs with 0 and handshakes every packet.
+const SDS_ACK_WINDOW = 16;
 
 // Custom SysEx Configuration (for firmware/format commands)
 const SYSEX_MANUFACTURER_ID = [0x00, 0x22, 0x01]; // Dato Musical Instruments
@@ -87,6 +92,18 @@ const ABORT_FIRMWARE_UPDATE = 0x23;
 const FIRMWARE_CHUNK_SIZE = 7 * 146; // 1022 bytes
 const FIRMWARE_ACK_TIMEOUT = 5000;
 
+// Kit Transfer Commands (a whole kit in one session, see
+// drum/sysex/kit_transfer.h)
+const BEGIN_KIT_TRANSFER = 0x50;
+const KIT_FILE_ENTRY = 0x51;
+const KIT_FILE_BYTES = 0x52;
+const COMMIT_KIT = 0x53;
+const KIT_FILE_STATUS = 0x55;
+const KIT_MAX_FILES = 33; // 32 samples and kit.bin
+// Decoded bytes per KitFileBytes message, whole 8-byte encoded groups
+const KIT_CHUNK_SIZE = 7 * 146; // 1022 bytes
+const KIT_ACK_TIMEOUT = 5000;
+
 // Find and connect to DRUM device
 function find_dato_drum() {
   const output = new midi.Output();
@@ -580,20 +597,207 @@ function encode3to16(bytes) {
 
 const UF2_MAGIC_START_0 = 0x0A324655;
 const UF2_BLOCK_SIZE = 512;
-
-async function flash_firmware(filePath) {
-  const crypto = require('crypto');
+const UF2_FLAG_NOT_MAIN_FLASH = 0x00000001;
+const UF2_FAMILY_RP2350_ARM_S = 0xE48BFF59;
+const XIP_LINK_BASE = 0x10000000;
+
+// Compact firmware container (see musin/flash/compact_image_parser.h)
+const COMPACT_MAGIC = 0x31574644; // "DFW1"
+const COMPACT_MAX_RANGES = 16;
+const COMPACT_ENCODING_OPS = 1;
+const COMPACT_OP_LITERAL = 0;
+const COMPACT_OP_COPY_OUTPUT = 1;
+const COMPACT_OP_COPY_BASE = 2;
+const COMPACT_MIN_MATCH = 4;
+const COMPACT_MERGE_GAP = 4096;
+const FIRMWARE_FORMAT_UF2 = 0;
+const FIRMWARE_FORMAT_COMPACT = 1;
+
+function readUf2(filePath) {
   const uf2 = fs.readFileSync(filePath);
-
   if (uf2.length === 0 || uf2.length % UF2_BLOCK_SIZE !== 0) {
     throw new Error(`${filePath} is not a UF2 file (size not a multiple of 512).`);
   }
   if (uf2.readUInt32LE(0) !== UF2_MAGIC_START_0) {
     throw new Error(`${filePath} is not a UF2 file (bad magic).`);
   }
+  return uf2;
+}
+
+// The image's payload bytes as contiguous ranges of image offsets, skipping
+// blocks the device skips (other families, the RP2350-A2 erratum block).
+// Ranges separated by small gaps are merged, with the gap erased (0xFF).
+function uf2ToRanges(uf2) {
+  const ranges = [];
+  for (let offset = 0; offset < uf2.length; offset += UF2_BLOCK_SIZE) {
+    const flags = uf2.readUInt32LE(offset + 8);
+    const address = uf2.readUInt32LE(offset + 12);
+    const size = uf2.readUInt32LE(offset + 16);
+    const family = uf2.readUInt32LE(offset + 28);
+    if (family !== UF2_FAMILY_RP2350_ARM_S || (flags & UF2_FLAG_NOT_MAIN_FLASH)) {
+      continue;
+    }
+    const payload = uf2.subarray(offset + 32, offset + 32 + size);
+    const imageOffset = address - XIP_LINK_BASE;
+    const last = ranges[ranges.length - 1];
+    if (last && imageOffset >= last.end && imageOffset - last.end <= COMPACT_MERGE_GAP) {
+      last.parts.push(Buffer.alloc(imageOffset - last.end, 0xFF), payload);
+      last.end = imageOffset + size;
+    } else {
+      ranges.push({ start: imageOffset, end: imageOffset + size, parts: [payload] });
+    }
+  }
+  if (ranges.length > COMPACT_MAX_RANGES) {
+    throw new Error(`Image has ${ranges.length} ranges; the compact format allows ${COMPACT_MAX_RANGES}.`);
+  }
+  return ranges.map((r) => ({ start: r.start, bytes: Buffer.concat(r.parts) }));
+}
+
+// The image as flashed, for use as the base of a delta.
+function uf2ToImage(uf2) {
+  const ranges = uf2ToRanges(uf2);
+  const end = Math.max(...ranges.map((r) => r.start + r.bytes.length));
+  const image = Buffer.alloc(end, 0xFF);
+  for (const range of ranges) {
+    range.bytes.copy(image, range.start);
+  }
+  return image;
+}
+
+function pushLeb128(out, value) {
+  do {
+    const byte = value & 0x7F;
+    value = Math.floor(value / 128);
+    out.push(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+// Greedy LZ plus delta: at each position take the longest of a copy from
+// the same offset in the base image, a match earlier in the range, or a
+// match anywhere in the base; otherwise emit a literal byte.
+function encodeRangeOps(range, base) {
+  const data = range.bytes;
+  const key = (buffer, i) => buffer.readUInt32LE(i);
+  const baseIndex = new Map();
+  if (base) {
+    for (let i = 0; i + COMPACT_MIN_MATCH <= base.length; i++) {
+      const k = key(base, i);
+      if (!baseIndex.has(k)) {
+        baseIndex.set(k, i);
+      }
+    }
+  }
+  const outputIndex = new Map();
+  const matchLength = (source, from, at) => {
+    let n = 0;
+    while (at + n < data.length && from + n < source.length && source[from + n] === data[at + n]) {
+      n++;
+    }
+    return n;
+  };
+
+  const out = [];
+  let literal = [];
+  const flushLiteral = () => {
+    if (literal.length > 0) {
+      out.push(COMPACT_OP_LITERAL);
+      pushLeb128(out, literal.length);
+      out.push(...literal);
+      literal = [];
+    }
+  };
 
-  const sha256 = crypto.createHash('sha256').update(uf2).digest();
+  let i = 0;
+  while (i < data.length) {
+    let best = 0;
+    let op = 0;
+    let argument = 0;
+    const imagePos = range.start + i;
+    if (base && imagePos < base.length) {
+      const n = matchLength(base, imagePos, i);
+      if (n > best) {
+        [best, op, argument] = [n, COMPACT_OP_COPY_BASE, imagePos];
+      }
+    }
+    if (i + COMPACT_MIN_MATCH <= data.length) {
+      const k = key(data, i);
+      if (outputIndex.has(k)) {
+        const from = outputIndex.get(k);
+        const n = matchLength(data, from, i);
+        if (n > best) {
+          [best, op, argument] = [n, COMPACT_OP_COPY_OUTPUT, i - from];
+        }
+      }
+      if (baseIndex.has(k)) {
+        const from = baseIndex.get(k);
+        const n = matchLength(base, from, i);
+        if (n > best) {
+          [best, op, argument] = [n, COMPACT_OP_COPY_BASE, from];
+        }
+      }
+    }
+
+    const end = best >= COMPACT_MIN_MATCH ? i + best : i + 1;
+    if (best < COMPACT_MIN_MATCH) {
+      literal.push(data[i]);
+    } else {
+      flushLiteral();
+      out.push(op);
+      pushLeb128(out, best);
+      pushLeb128(out, argument);
+    }
+    for (; i < end; i++) {
+      if (i + COMPACT_MIN_MATCH <= data.length) {
+        outputIndex.set(key(data, i), i);
+      }
+    }
+  }
+  flushLiteral();
+  return Buffer.from(out);
+}
+
+// Builds the compact container for a UF2 image, optionally as a delta
+// against the image currently installed. The announced SHA-256 is the hash
+// of the per-range digests.
+function buildCompactImage(uf2, baseUf2) {
+  const crypto = require('crypto');
+  const base = baseUf2 ? uf2ToImage(baseUf2) : null;
+  const ranges = uf2ToRanges(uf2);
+
+  const header = Buffer.alloc(6);
+  header.writeUInt32LE(COMPACT_MAGIC, 0);
+  header.writeUInt16LE(ranges.length, 4);
+  const parts = [header];
+  const digests = [];
+  for (const range of ranges) {
+    const digest = crypto.createHash('sha256').update(range.bytes).digest();
+    digests.push(digest);
+    const rangeHeader = Buffer.alloc(9);
+    rangeHeader.writeUInt32LE(range.start, 0);
+    rangeHeader.writeUInt32LE(range.bytes.length, 4);
+    rangeHeader.writeUInt8(COMPACT_ENCODING_OPS, 8);
+    parts.push(rangeHeader, digest, encodeRangeOps(range, base));
+  }
+  return {
+    stream: Buffer.concat(parts),
+    sha256: crypto.createHash('sha256').update(Buffer.concat(digests)).digest(),
+  };
+}
+
+async function flash_firmware(filePath, options = {}) {
+  const crypto = require('crypto');
+  const uf2 = readUf2(filePath);
+
+  let stream = uf2;
+  let sha256 = crypto.createHash('sha256').update(uf2).digest();
+  let format = FIRMWARE_FORMAT_UF2;
   console.log(`Firmware: ${filePath} (${uf2.length} bytes, ${uf2.length / UF2_BLOCK_SIZE} UF2 blocks)`);
+  if (options.compact) {
+    const baseUf2 = options.base ? readUf2(options.base) : null;
+    ({ stream, sha256 } = buildCompactImage(uf2, baseUf2));
+    format = FIRMWARE_FORMAT_COMPACT;
+    console.log(`Compact:  ${stream.length} bytes${baseUf2 ? ` (delta against ${options.base})` : ''}`);
+  }
   console.log(`SHA-256:  ${sha256.toString('hex')}`);
 
   try {
@@ -603,11 +807,11 @@ async function flash_firmware(filePath) {
   }
 
   // Begin: total size (32-bit LE) + SHA-256 + version placeholder (the device
-  // treats the version as informational).
+  // treats the version as informational) + image format.
   const beginPayload = [
-    uf2.length & 0xFF, (uf2.length >> 8) & 0xFF,
-    (uf2.length >> 16) & 0xFF, (uf2.length >> 24) & 0xFF,
-    ...sha256, 0, 0, 0,
+    stream.length & 0xFF, (stream.length >> 8) & 0xFF,
+    (stream.length >> 16) & 0xFF, (stream.length >> 24) & 0xFF,
+    ...sha256, 0, 0, 0, format,
   ];
   sendCustomMessage([BEGIN_FIRMWARE_UPDATE, ...encode3to16(beginPayload)]);
   await waitForCustomAck(FIRMWARE_ACK_TIMEOUT);
@@ -615,17 +819,17 @@ async function flash_firmware(filePath) {
 
   const startTime = Date.now();
   try {
-    for (let offset = 0; offset < uf2.length; offset += FIRMWARE_CHUNK_SIZE) {
-      const chunk = uf2.subarray(offset, Math.min(offset + FIRMWARE_CHUNK_SIZE, uf2.length));
+    for (let offset = 0; offset < stream.length; offset += FIRMWARE_CHUNK_SIZE) {
+      const chunk = stream.subarray(offset, Math.min(offset + FIRMWARE_CHUNK_SIZE, stream.length));
       sendCustomMessage([FIRMWARE_BYTES, ...encode8to7(chunk)]);
       await waitForCustomAck(FIRMWARE_ACK_TIMEOUT);
 
-      const done = Math.min(offset + FIRMWARE_CHUNK_SIZE, uf2.length);
-      const percent = Math.floor((done / uf2.length) * 100);
+      const done = Math.min(offset + FIRMWARE_CHUNK_SIZE, stream.length);
+      const percent = Math.floor((done / stream.length) * 100);
       const barLength = 30;
-      const filled = Math.floor((done / uf2.length) * barLength);
+      const filled = Math.floor((done / stream.length) * barLength);
       const bar = '█'.repeat(filled) + '░'.repeat(barLength - filled);
-      process.stdout.write(`\r[${bar}] ${percent}% (${done}/${uf2.length} bytes)`);
+      process.stdout.write(`\r[${bar}] ${percent}% (${done}/${stream.length} bytes)`);
     }
   } catch (e) {
     process.stdout.write('\n');
@@ -644,6 +848,192 @@ async function flash_firmware(filePath) {
   console.log("Run 'drumtool.js version' after the device reconnects to confirm.");
 }
 
+// --- Kit transfer over SysEx ---
+
+const CRC32_TABLE = (() => {
+  const table = new Uint32Array(256);
+  for (let i = 0; i < 256; i++) {
+    let crc = i;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = (crc >>> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+    }
+    table[i] = crc >>> 0;
+  }
+  return table;
+})();
+
+// CRC-32 as computed by etl::crc32 on the device
+function crc32(bytes) {
+  let crc = 0xFFFFFFFF;
+  for (const byte of bytes) {
+    crc = CRC32_TABLE[(crc ^ byte) & 0xFF] ^ (crc >>> 8);
+  }
+  return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+function u32le(value) {
+  return [value & 0xFF, (value >>> 8) & 0xFF, (value >>> 16) & 0xFF, (value >>> 24) & 0xFF];
+}
+
+// Waits for the reply to a kit transfer message. Resolves with { ack: true },
+// { ack: false } for a NACK, or { status: true, index, offset } when the
+// device reports how many bytes of a file it has staged.
+function waitForKitReply(timeout = KIT_ACK_TIMEOUT) {
+  return new Promise((resolve, reject) => {
+    let timer = null;
+    const ackResolver = { timer: null };
+    const settle = (reply) => {
+      clearTimeout(timer);
+      const index = customAckQueue.indexOf(ackResolver);
+      if (index > -1) {
+        customAckQueue.splice(index, 1);
+      }
+      customReplyPromise = {};
+      resolve(reply);
+    };
+    ackResolver.resolve = () => settle({ ack: true });
+    ackResolver.reject = () => settle({ ack: false });
+    customAckQueue.push(ackResolver);
+    customReplyPromise = {
+      resolve: (message) => {
+        if (message[5] !== KIT_FILE_STATUS || message.length < 13) {
+          settle({ ack: false });
+          return;
+        }
+        let offset = 0;
+        for (let i = 0; i < 5; i++) {
+          offset += message[7 + i] * 2 ** (7 * i);
+        }
+        settle({ status: true, index: message[6], offset });
+      },
+    };
+    timer = setTimeout(() => {
+      const index = customAckQueue.indexOf(ackResolver);
+      if (index > -1) {
+        customAckQueue.splice(index, 1);
+      }
+      customReplyPromise = {};
+      reject(new Error(`Timeout waiting for reply after ${timeout}ms.`));
+    }, timeout);
+  });
+}
+
+// Installs samples (and optionally kit.bin) as one kit. The device stages the
+// files and swaps them in together on commit, so an interrupted transfer
+// leaves the installed kit untouched. The kit id is derived from the files,
+// so running the same command again resumes where the device left off.
+async function send_kit(transfers, kitBinPath, verboseMode = false) {
+  const files = transfers.map(({ filePath, slot, sampleRate }) => ({
+    name: `${slot.toString().padStart(2, '0')}.pcm`,
+    source: filePath,
+    data: loadSamplePcm(filePath, sampleRate, verboseMode).pcmData,
+  }));
+  if (kitBinPath) {
+    files.push({ name: 'kit.bin', source: kitBinPath, data: fs.readFileSync(kitBinPath) });
+  }
+  if (files.length > KIT_MAX_FILES) {
+    throw new Error(`A kit holds at most ${KIT_MAX_FILES} files, got ${files.length}.`);
+  }
+  for (const file of files) {
+    file.crc = crc32(file.data);
+  }
+  const kitId = crc32(Buffer.from(files.map(f => `${f.name}:${f.data.length}:${f.crc}`).join('|')));
+  const totalBytes = files.reduce((sum, f) => sum + f.data.length, 0);
+  console.log(`
+=== Kit Transfer: ${files.length} files, ${formatBytes(totalBytes)} ===`);
+
+  sendCustomMessage([BEGIN_KIT_TRANSFER, ...encode8to7([...u32le(kitId), files.length])]);
+  await waitForCustomAck(KIT_ACK_TIMEOUT);
+
+  const offsets = [];
+  for (let i = 0; i < files.length; i++) {
+    const { name, data, crc } = files[i];
+    const entry = [i, ...u32le(data.length), ...u32le(crc), ...Buffer.from(name, 'ascii'), 0];
+    sendCustomMessage([KIT_FILE_ENTRY, ...encode8to7(entry)]);
+    const reply = await waitForKitReply();
+    if (!reply.status || reply.index !== i) {
+      throw new Error(`Device rejected the manifest entry for ${name}.`);
+    }
+    offsets.push(reply.offset);
+    if (verboseMode) {
+      console.log(`  /${name} ← ${files[i].source} (${data.length} bytes, CRC ${crc.toString(16).padStart(8, '0')})`);
+    }
+  }
+  const resumedBytes = offsets.reduce((sum, offset) => sum + offset, 0);
+  if (resumedBytes > 0) {
+    console.log(`Resuming: ${formatBytes(resumedBytes)} already on the device.`);
+  }
+
+  const startTime = Date.now();
+  let sentBytes = resumedBytes;
+  // Sends every file from the offset the device reported for it
+  const sendKitFiles = async () => {
+    for (let i = 0; i < files.length; i++) {
+      const { name, data } = files[i];
+      let offset = offsets[i];
+      let restarted = false;
+      while (offset < data.length) {
+        const chunk = data.subarray(offset, Math.min(offset + KIT_CHUNK_SIZE, data.length));
+        const position = [0, 1, 2, 3, 4].map(group => Math.floor(offset / 2 ** (7 * group)) & 0x7F);
+        sendCustomMessage([KIT_FILE_BYTES, i, ...position, ...encode8to7(chunk)]);
+        const reply = await waitForKitReply();
+        if (reply.ack) {
+          offset += chunk.length;
+          sentBytes += chunk.length;
+        } else if (reply.status) {
+          // The device continues from what it has staged
+          sentBytes += reply.offset - offset;
+          offset = reply.offset;
+        } else if (offset + chunk.length === data.length && !restarted) {
+          // A CRC mismatch on the final chunk; the device starts the file over
+          console.log(`\n${name} failed verification, sending it again.`);
+          sentBytes -= offset;
+          offset = 0;
+          restarted = true;
+        } else {
+          throw new Error(`Device rejected data for ${name}.`);
+        }
+
+        const percent = Math.floor((sentBytes / totalBytes) * 100);
+        const barLength = 30;
+        const filled = Math.floor((sentBytes / totalBytes) * barLength);
+        const bar = '█'.repeat(filled) + '░'.repeat(barLength - filled);
+        process.stdout.write(`\r[${bar}] ${percent}% (${i + 1}/${files.length} files)`);
+      }
+    }
+  };
+
+  try {
+    await sendKitFiles();
+  } catch (error) {
+    process.stdout.write('\n');
+    throw new Error(`${error.message} Run the same command again to resume.`);
+  }
+  process.stdout.write('\n');
+
+  sendCustomMessage([COMMIT_KIT]);
+  const reply = await waitForKitReply();
+  if (!reply.ack) {
+    throw new Error('Device did not commit the kit.');
+  }
+  const elapsed = ((Date.now() - startTime) / 1000).toFixed(1);
+  console.log(`Kit installed in ${elapsed}s.`);
+  return true;
+}
+
+// Splits 'send-kit' arguments into sample transfers and an optional kit.bin
+function parseSendKitArgs(args) {
+  const kitIndex = args.indexOf('--kit');
+  const kitBinPath = kitIndex !== -1 ? args[kitIndex + 1] : undefined;
+  if (kitIndex !== -1 && !kitBinPath) {
+    throw new Error("'--kit' requires a kit.bin file argument.");
+  }
+  const rest = args.filter((arg, index) =>
+    (kitIndex === -1 || (index !== kitIndex && index !== kitIndex + 1)) &&
+    arg !== '--verbose' && arg !== '-v');
+  return { transfers: rest.length > 0 ? parseFileSlotArgs(rest) : [], kitBinPath };
+}
+
 // Test universal SysEx identity request
 async function test_universal_identity() {
   console.log("Testing universal SysEx identity request...");
@@ -786,6 +1176,75 @@ async function deliverPacket(packet, expectedPacketNum, verbose) {
   return 'failed';
 }
 
+// Send packets [0, totalPackets) with up to `window` of them unacknowledged.
+// An ACK covers every packet up to the one it names. A NAK names the packet
+// the device expects next; it dropped everything sent after it, so sending
+// goes back to it. On a timeout the unacknowledged packets are resent.
+// Returns 'ack', 'cancel' or 'failed'.
+async function deliverWindowed(makePacket, totalPackets, window, verbose, onAcked) {
+  let base = 0;
+  let next = 0;
+  let deadline = Date.now() + PACKET_RETRY_WINDOW;
+  let responseTimeout = PACKET_TIMEOUT;
+
+  while (base < totalPackets) {
+    while (next < totalPackets && next < base + window) {
+      if (stallAfter !== null && next >= stallAfter) {
+        console.log(`\nTEST: stalling after ${next} packets — exiting without SDS cancel.`);
+        process.exit(0);
+      }
+      sendSDSMessage(makePacket(next));
+      next++;
+    }
+    if (Date.now() >= deadline) {
+      return 'failed';
+    }
+
+    const response = await waitForResponse(responseTimeout, base & 0x7F);
+    responseTimeout = PACKET_TIMEOUT;
+    // Packet numbers wrap at 128; only replies about packets in flight count
+    const offset = (response.packet - base) & 0x7F;
+    const inFlight = offset < next - base;
+
+    switch (response.type) {
+      case SDS_ACK:
+        if (inFlight) {
+          base += offset + 1;
+          deadline = Date.now() + PACKET_RETRY_WINDOW;
+          onAcked(base);
+        }
+        break;
+      case SDS_NAK:
+        if (inFlight) {
+          if (verbose) {
+            console.log(`\nPacket ${response.packet} NAK - resending from there`);
+          }
+          base += offset;
+          next = base;
+          onAcked(base);
+        }
+        break;
+      case SDS_WAIT:
+        if (verbose) {
+          console.log(`\nPacket ${base & 0x7F} WAIT - device is busy`);
+        }
+        deviceStatus = 'slow';
+        responseTimeout = WAIT_RESPONSE_TIMEOUT;
+        deadline = Date.now() + WAIT_RESPONSE_TIMEOUT;
+        break;
+      case SDS_CANCEL:
+        return 'cancel';
+      default: // timeout: a packet or an ACK was lost in transit
+        if (verbose) {
+          console.log(`\nPacket ${base & 0x7F} timeout - resending ${next - base} packets`);
+        }
+        next = base;
+        break;
+    }
+  }
+  return 'ack';
+}
+
 // Convert sample rate to SDS period format (3-byte nanosecond period)
 function sampleRateToPeriod(sampleRate) {
   const periodNs = Math.round(1000000000 / sampleRate);
@@ -806,8 +1265,8 @@ function lengthToSdsFormat(byteLength) {
   ];
 }
 
-// Create SDS Dump Header
-function createDumpHeader(sampleNum, bitDepth, sampleRate, sampleLength) {
+// Create SDS Dump Header, with the requested ACK window appended if given
+function createDumpHeader(sampleNum, bitDepth, sampleRate, sampleLength, window = 0) {
   const sampleNumBytes = [sampleNum & 0x7F, (sampleNum >> 7) & 0x7F];
   const periodBytes = sampleRateToPeriod(sampleRate);
   const lengthBytes = lengthToSdsFormat(sampleLength);
@@ -817,7 +1276,7 @@ function createDumpHeader(sampleNum, bitDepth, sampleRate, sampleLength) {
   const loopEndBytes = lengthBytes.slice();   // Copy length
   const loopType = 0x7F; // No loop
 
-  return [
+  const header = [
     SDS_DUMP_HEADER,
     ...sampleNumBytes,    // sl sh - sample number
     bitDepth,             // ee - bits per sample
@@ -827,6 +1286,10 @@ function createDumpHeader(sampleNum, bitDepth, sampleRate, sampleLength) {
     ...loopEndBytes,      // il im ih - loop end (set to length for no-loop)
     loopType              // jj - loop type (0x7F = no loop)
   ];
+  if (window > 0) {
+    header.push(window);
+  }
+  return header;
 }
 
 // Pack 16-bit sample into SDS 3-byte format
@@ -929,23 +1392,9 @@ async function transferMultipleSamples(transfers, verboseMode = false) {
 }
 
 // Main sample transfer function
-async function transferSample(filePath, sampleNumber, sampleRate = 44100, verboseMode = false) {
-  const verbose = verboseMode;
-
-  // Validate sample number
-  if (sampleNumber < 0 || sampleNumber > 127) {
-    console.error(`Error: Sample number must be between 0-127, got: ${sampleNumber}`);
-    return false;
-  }
-
-  const targetFilename = `${sampleNumber.toString().padStart(2, '0')}.pcm`;
-  console.log(`\n=== SDS Transfer: ${filePath} → /${targetFilename} (slot ${sampleNumber}) ===`);
-
-  if (!fs.existsSync(filePath)) {
-    console.error(`Error: Source file not found at '${filePath}'`);
-    return false;
-  }
-
+// Reads a WAV file as 16-bit mono PCM in the device's format, or a file that
+// does not parse as WAV as raw 16-bit PCM at the given sample rate.
+function loadSamplePcm(filePath, sampleRate = 44100, verbose = false) {
   let pcmData;
   let finalSampleRate;
 
@@ -998,7 +1447,29 @@ async function transferSample(filePath, sampleNumber, sampleRate = 44100, verbos
     finalSampleRate = sampleRate; // Use the rate from command line
     console.log(`Using raw file data: ${pcmData.length} bytes, ${finalSampleRate}Hz`);
   }
-  
+
+  return { pcmData, sampleRate: finalSampleRate };
+}
+
+async function transferSample(filePath, sampleNumber, sampleRate = 44100, verboseMode = false) {
+  const verbose = verboseMode;
+
+  // Validate sample number
+  if (sampleNumber < 0 || sampleNumber > 127) {
+    console.error(`Error: Sample number must be between 0-127, got: ${sampleNumber}`);
+    return false;
+  }
+
+  const targetFilename = `${sampleNumber.toString().padStart(2, '0')}.pcm`;
+  console.log(`\n=== SDS Transfer: ${filePath} → /${targetFilename} (slot ${sampleNumber}) ===`);
+
+  if (!fs.existsSync(filePath)) {
+    console.error(`Error: Source file not found at '${filePath}'`);
+    return false;
+  }
+
+  const { pcmData, sampleRate: finalSampleRate } = loadSamplePcm(filePath, sampleRate, verbose);
+
   // Calculate transfer parameters
   const packetsNeeded = Math.ceil(pcmData.length / 80); // 40 samples * 2 bytes per packet
   if (verbose) {
@@ -1012,7 +1483,7 @@ async function transferSample(filePath, sampleNumber, sampleRate = 44100, verbos
     const transferStartTime = Date.now();
     
     // Step 1: Send Dump Header
-    const header = createDumpHeader(sampleNumber, 16, finalSampleRate, pcmData.length);
+    const header = createDumpHeader(sampleNumber, 16, finalSampleRate, pcmData.length, SDS_ACK_WINDOW);
     if (verbose) {
       console.log("\n1. Sending Dump Header...");
       console.log("Header bytes:", header.length, ">", header.map(b => `0x${b.toString(16).padStart(2, '0')}`).join(' '));
@@ -1024,7 +1495,7 @@ async function transferSample(filePath, sampleNumber, sampleRate = 44100, verbos
       if (verbose) {
         console.log("Header NAK received, retrying...");
       }
-      sendSDSMessage(createDumpHeader(sampleNumber, 16, finalSampleRate, pcmData.length));
+      sendSDSMessage(header);
       const retryResponse = await waitForResponse(HEADER_TIMEOUT);
       if (retryResponse.type !== SDS_ACK && retryResponse.type !== 'timeout') {
         throw new Error("Header rejected twice");
@@ -1032,8 +1503,9 @@ async function transferSample(filePath, sampleNumber, sampleRate = 44100, verbos
     }
     
     let handshaking = headerResponse.type === SDS_ACK;
+    const window = handshaking ? Math.max(1, headerResponse.packet) : 1;
     if (verbose) {
-      console.log(`Header ${headerResponse.type === SDS_ACK ? 'ACK' : headerResponse.type} - ${handshaking ? 'handshaking mode' : 'non-handshaking mode'}`);
+      console.log(`Header ${headerResponse.type === SDS_ACK ? 'ACK' : headerResponse.type} - ${handshaking ? 'handshaking mode' : 'non-handshaking mode'}${window > 1 ? `, window ${window}` : ''}`);
       console.log("\n2. Sending data packets...");
     }
     let packetNum = 0;
@@ -1043,68 +1515,90 @@ async function transferSample(filePath, sampleNumber, sampleRate = 44100, verbos
     const totalPackets = Math.ceil(pcmData.length / 80);
     const showProgress = totalPackets > 4;
     let lastProgressUpdate = 0;
-    
-    while (offset < pcmData.length) {
-      if (stallAfter !== null && packetNum >= stallAfter) {
-        console.log(`\nTEST: stalling after ${packetNum} packets — exiting without SDS cancel.`);
-        process.exit(0);
+
+    const reportProgress = () => {
+      // Progress indicator (skip for very small transfers)
+      if (!showProgress) {
+        return;
       }
-      const packet = createDataPacket(packetNum & 0x7F, pcmData, offset);
-      if (verbose && packetNum < 5) { // Debug first few packets
-        console.log(`Packet ${packetNum} size:`, packet.length, "checksum:", `0x${packet[packet.length-1].toString(16)}`);
+      const progress = Math.min(100, (successfulPackets / totalPackets) * 100);
+
+      // Only update progress every 1% or every 50 packets to reduce flicker
+      const progressPercent = Math.round(progress);
+      if (progressPercent > lastProgressUpdate || successfulPackets % 50 === 0) {
+        lastProgressUpdate = progressPercent;
+
+        const bar_length = 40;
+        const filled_length = Math.round(bar_length * (progress / 100));
+        const bar = '█'.repeat(filled_length) + '░'.repeat(bar_length - filled_length);
+
+        // Status indicator based on device feedback
+        const statusText = deviceStatus === 'slow' ? '[BUSY]' :
+                          deviceStatus === 'error' ? '[ERROR]' :
+                          deviceStatus === 'ok' ? '[OK]' : '[??]';
+
+        if (process.stdout.clearLine) {
+          process.stdout.clearLine(0);
+          process.stdout.cursorTo(0);
+          process.stdout.write(`${statusText} Progress: ${progressPercent}% |${bar}| ${successfulPackets}/${totalPackets} packets`);
+        } else {
+          // Fallback for environments without clearLine
+          console.log(`${statusText} Progress: ${progressPercent}% |${bar}| ${successfulPackets}/${totalPackets} packets`);
+        }
       }
-      if (handshaking) {
-        const status = await deliverPacket(packet, packetNum & 0x7F, verbose);
-        if (status === 'cancel') {
-          throw new Error('Device cancelled transfer - storage may be full');
+    };
+
+    if (handshaking && window > 1) {
+      const status = await deliverWindowed(
+        (index) => createDataPacket(index & 0x7F, pcmData, index * 80),
+        totalPackets, window, verbose,
+        (acked) => {
+          deviceStatus = 'ok';
+          successfulPackets = acked;
+          reportProgress();
+        });
+      if (status === 'cancel') {
+        throw new Error('Device cancelled transfer - storage may be full');
+      }
+      if (status !== 'ack') {
+        throw new Error(`No response for packet ${successfulPackets & 0x7F} after ${PACKET_RETRY_WINDOW}ms`);
+      }
+    } else {
+      while (offset < pcmData.length) {
+        if (stallAfter !== null && packetNum >= stallAfter) {
+          console.log(`\nTEST: stalling after ${packetNum} packets — exiting without SDS cancel.`);
+          process.exit(0);
         }
-        if (status !== 'ack') {
-          throw new Error(`No response for packet ${packetNum & 0x7F} after ${PACKET_RETRY_WINDOW}ms`);
+        const packet = createDataPacket(packetNum & 0x7F, pcmData, offset);
+        if (verbose && packetNum < 5) { // Debug first few packets
+          console.log(`Packet ${packetNum} size:`, packet.length, "checksum:", `0x${packet[packet.length-1].toString(16)}`);
         }
-        deviceStatus = 'ok';
-        successfulPackets++;
-        offset += 80; // Move to next 40 samples (80 bytes)
-        packetNum++;
-      } else {
-        // Non-handshaking mode (the device never ACKed the header): pace
-        // packets open-loop so the receiver can keep up.
-        sendSDSMessage(packet);
-        await new Promise(resolve => setTimeout(resolve, 10));
-        successfulPackets++;
-        offset += 80;
-        packetNum++;
-      }
-      
-      // Progress indicator (skip for very small transfers)
-      if (showProgress) {
-        const progress = Math.min(100, (successfulPackets / totalPackets) * 100);
-        
-        // Only update progress every 1% or every 50 packets to reduce flicker
-        const progressPercent = Math.round(progress);
-        if (progressPercent > lastProgressUpdate || successfulPackets % 50 === 0) {
-          lastProgressUpdate = progressPercent;
-          
-          const bar_length = 40;
-          const filled_length = Math.round(bar_length * (progress / 100));
-          const bar = '█'.repeat(filled_length) + '░'.repeat(bar_length - filled_length);
-          
-          // Status indicator based on device feedback
-          const statusText = deviceStatus === 'slow' ? '[BUSY]' : 
-                            deviceStatus === 'error' ? '[ERROR]' : 
-                            deviceStatus === 'ok' ? '[OK]' : '[??]';
-          
-          if (process.stdout.clearLine) {
-            process.stdout.clearLine(0);
-            process.stdout.cursorTo(0);
-            process.stdout.write(`${statusText} Progress: ${progressPercent}% |${bar}| ${successfulPackets}/${totalPackets} packets`);
-          } else {
-            // Fallback for environments without clearLine
-            console.log(`${statusText} Progress: ${progressPercent}% |${bar}| ${successfulPackets}/${totalPackets} packets`);
+        if (handshaking) {
+          const status = await deliverPacket(packet, packetNum & 0x7F, verbose);
+          if (status === 'cancel') {
+            throw new Error('Device cancelled transfer - storage may be full');
+          }
+          if (status !== 'ack') {
+            throw new Error(`No response for packet ${packetNum & 0x7F} after ${PACKET_RETRY_WINDOW}ms`);
           }
+          deviceStatus = 'ok';
+          successfulPackets++;
+          offset += 80; // Move to next 40 samples (80 bytes)
+          packetNum++;
+        } else {
+          // Non-handshaking mode (the device never ACKed the header): pace
+          // packets open-loop so the receiver can keep up.
+          sendSDSMessage(packet);
+          await new Promise(resolve => setTimeout(resolve, 10));
+          successfulPackets++;
+          offset += 80;
+          packetNum++;
         }
+      
+        reportProgress();
       }
     }
-    
+
     const transferDuration = Date.now() - transferStartTime;
     const transferSeconds = (transferDuration / 1000).toFixed(1);
     console.log(`\n\nTransfer complete: ${successfulPackets} packets sent in ${transferSeconds} s`);
@@ -1477,6 +1971,7 @@ if (!command) {
   console.log("");
   console.log("Usage:");
   console.log("  drumtool.js send <file:slot> [file:slot] ... [sample_rate] [--verbose|-v]");
+  console.log("  drumtool.js send-kit <file:slot> [file:slot] ... [sample_rate] [--kit kit.bin] [--verbose|-v]");
   console.log("  drumtool.js receive <slot> [output_file] [--raw] [--verbose|-v]");
   console.log("  drumtool.js receive <start>-<end>|--all [output_dir] [--raw] [--verbose|-v]");
   console.log("  drumtool.js version");
@@ -1484,7 +1979,7 @@ if (!command) {
   console.log("  drumtool.js format");
   console.log("  drumtool.js reboot-bootloader");
   console.log("  drumtool.js identity");
-  console.log("  drumtool.js flash <firmware.uf2>");
+  console.log("  drumtool.js flash <firmware.uf2> [--compact [--base <installed.uf2>]]");
   console.log("  drumtool.js get-sequencer [--json]");
   console.log("  drumtool.js set-sequencer <state.json|->");
   console.log("  drumtool.js get-setting [name]");
@@ -1492,6 +1987,8 @@ if (!command) {
   console.log("");
   console.log("Commands:");
   console.log("  send           - Transfer audio samples (WAV or raw PCM) using SDS protocol");
+  console.log("  send-kit       - Install samples (and kit.bin) as one kit. The device swaps the files in");
+  console.log("                   together once all have arrived; rerunning an interrupted send-kit resumes it");
   console.log("  receive        - Download samples from the device (WAV by default, --raw for PCM).");
   console.log("                   A range or --all downloads every occupied slot, skipping empty ones");
   console.log("  version        - Get device firmware version");
@@ -1499,7 +1996,8 @@ if (!command) {
   console.log("  format         - Format device filesystem");
   console.log("  reboot-bootloader - Reboot device into bootloader mode");
   console.log("  identity       - Test universal SysEx identity request");
-  console.log("  flash          - Update firmware over MIDI (A/B partition, auto-revert on failure)");
+  console.log("  flash          - Update firmware over MIDI (A/B partition, auto-revert on failure).");
+  console.log("                   --compact sends a compressed image, --base a delta against the installed one");
   console.log("  get-sequencer  - Read the sequencer pattern (velocities + active notes)");
   console.log("  set-sequencer  - Write a sequencer pattern from a JSON file ('-' for stdin)");
   console.log("  get-setting    - Read a device setting (all settings when no name given)");
@@ -1532,6 +2030,7 @@ if (!command) {
   console.log("  drumtool.js storage                           # Check storage usage");
   console.log("  drumtool.js format                            # Format filesystem");
   console.log("  drumtool.js reboot-bootloader                 # Enter bootloader mode");
+  console.log("  drumtool.js send-kit kick.wav:0 snare.wav:1 --kit kit.bin # Replace a kit in one go");
   console.log("  drumtool.js receive 0 kick.wav                # Download slot 0 as WAV");
   console.log("  drumtool.js receive 30 --raw                  # Download slot 30 as raw PCM");
   console.log("  drumtool.js receive --all backup/             # Download every occupied slot");
@@ -1602,6 +2101,23 @@ async function main() {
         console.error(`Error: ${error.message}`);
         process.exit(1);
       }
+    } else if (command === 'send-kit') {
+      try {
+        const { transfers, kitBinPath } = parseSendKitArgs(process.argv.slice(3));
+        if (transfers.length === 0 && !kitBinPath) {
+          console.error("Error: 'send-kit' requires at least one file argument.");
+          process.exit(1);
+        }
+        for (const file of [...transfers.map(t => t.filePath), ...(kitBinPath ? [kitBinPath] : [])]) {
+          if (!fs.existsSync(file)) {
+            console.error(`Error: File not found: ${file}`);
+            process.exit(1);
+          }
+        }
+      } catch (error) {
+        console.error(`Error: ${error.message}`);
+        process.exit(1);
+      }
     } else if (command === 'receive') {
       try {
         parseReceiveArgs(process.argv.slice(3));
@@ -1645,7 +2161,7 @@ async function main() {
     } else if (command !== 'version' && command !== 'storage' && command !== 'format' &&
                command !== 'reboot-bootloader' && command !== 'identity' &&
                command !== 'get-sequencer') {
-      console.error(`Error: Unknown command '${command}'. Use 'send', 'receive', 'version', 'storage', 'format', 'reboot-bootloader', 'identity', 'flash', 'get-sequencer', 'set-sequencer', 'get-setting', or 'set-setting'.`);
+      console.error(`Error: Unknown command '${command}'. Use 'send', 'send-kit', 'receive', 'version', 'storage', 'format', 'reboot-bootloader', 'identity', 'flash', 'get-sequencer', 'set-sequencer', 'get-setting', or 'set-setting'.`);
       process.exit(1);
     }
 
@@ -1671,6 +2187,9 @@ async function main() {
         ? await transferSample(transfers[0].filePath, transfers[0].slot, transfers[0].sampleRate, verbose)
         : await transferMultipleSamples(transfers, verbose);
       process.exitCode = success ? 0 : 1;
+    } else if (command === 'send-kit') {
+      const { transfers, kitBinPath } = parseSendKitArgs(process.argv.slice(3)); // Already validated above
+      process.exitCode = await send_kit(transfers, kitBinPath, verbose) ? 0 : 1;
     } else if (command === 'receive') {
       const receive = parseReceiveArgs(process.argv.slice(3)); // Already validated above
       let success;
@@ -1692,7 +2211,11 @@ async function main() {
     } else if (command === 'identity') {
       await test_universal_identity();
     } else if (command === 'flash') {
-      await flash_firmware(process.argv[3]);
+      const baseIndex = process.argv.indexOf('--base');
+      await flash_firmware(process.argv[3], {
+        compact: process.argv.includes('--compact') || baseIndex !== -1,
+        base: baseIndex !== -1 ? process.argv[baseIndex + 1] : undefined,
+      });
     } else if (command === 'get-sequencer') {
       await get_sequencer_state(process.argv.includes('--json'));
     } else if (command === 'set-sequencer') {